@@ -11,14 +11,21 @@
  *  - GPIO 17 ---> Vsync
  *  - GPIO 16 ---> PCLK (pixel clock)
  *  - GPIO 8:15 ---> Pdata[0:8] (pixel data 8bit grayscale)
+ *  - GPIO 2, 3, 4 <--- SPI upload MOSI, SCK, CS;  GPIO 5 ---> READY, GPIO 1 ---> NAK
  *
  * RESOURCES USED
- *  - PIO state machines 0, 1, 2 and 3 on PIO instance 0
- *  - DMA channels 0 and 1
- *  - 230.4 kBytes of RAM (for pixel color data)
+ *  - PIO state machines 0, 1, 2 and 3 on PIO instance 0, one state machine on PIO 1 (SPI)
+ *  - DMA channels 0 and 1, DMA_IRQ_0, two more DMA channels and the DMA sniffer (uploads)
+ *  - one hardware alarm (exposure timing)
+ *  - core1 (frame decoding and patterns, see render_core.h)
+ *  - the system clock, set at boot by the clock plan (clock_plan.h)
+ *  - flash from FRAME_LIBRARY_OFFSET on (frame library, see frame_library.h)
+ *  - 230.4 kBytes of RAM (for pixel color data; 115.2 kBytes with DLP_PIXEL_BPP=1, the window
+ *    plus 10 lines with DLP_ROI, the tile with DLP_TILE), or ~12 kBytes when built with DLP_LINE_RING
  *
  */
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include "pico/stdlib.h"
 #include "hardware/pio.h"
@@ -27,12 +34,30 @@
 #include "hardware/gpio.h"
 
 #include "test_image.h" // Include the header file
+#include "framebuffer.h"
+#include "frame_codec.h"
+#include "scanout.h"
+#include "delta.h"
+#include "usb_link.h"
+#include "spi_link.h"
+#include "exposure.h"
+#include "i2c_queue.h"
+#include "dlpc_regs.h"
+#include "video_mode.h"
+#include "bitplane.h"
+#include "staging.h"
+#include "render_core.h"
+#include "vector.h"
+#include "frame_library.h"
+#include "telemetry.h"
+#include "dlpc_bringup.h"
+#include "clock_plan.h"
+#include "job.h"
 
 // Our assembled programs:
 // Each gets the name <pio_filename.pio.h>
 #include "hsync.pio.h"
 #include "vsync.pio.h"
-#include "pxl.pio.h"
 #include "pxl_clk.pio.h"
 
 const int PROJ_ON_GPIO = 20;  // physical pin nr 26
@@ -43,8 +68,6 @@ const uint LED_PIN_R = 22;  // GPIO 26
 const uint SDA_PIN = 6; // GPIO 6
 const uint SCL_PIN = 7; // GPIO 7
 
-static uint16_t exposure_time = 200;
-
 enum ProjectorMode {
     TESTPATTERN,
     SPLASHSCREEN,
@@ -52,11 +75,6 @@ enum ProjectorMode {
     STANDBY
 };
 
-enum LightState {
-    OFF,
-    ON
-};
-
 //////// i2c config (max freq 100 kHz)
 
 // we define the i2c address of the DLPC1438. For whatever reason (I guess conflict with other
@@ -64,56 +82,6 @@ enum LightState {
 // factory setting of 36h. I assume this will be the same for all boards. 
 const int DLPC_addr = 0x1B;  
 
-void initialise_DLPC() {  
-    gpio_init(PROJ_ON_GPIO);
-    gpio_set_dir(PROJ_ON_GPIO, GPIO_OUT);
-    gpio_init(HOST_IRQ_GPIO);
-    gpio_set_dir(HOST_IRQ_GPIO, GPIO_IN);
-    bool current_IRQ_state = 0;
-
-    printf(">> Attempting to initialise the DLPC1438...\n\n");
-
-    // HOST_IRQ will be pulled HIGH by the pullup on eViewTek board
-    // but in theory it could also be LOW at this time
-    current_IRQ_state = gpio_get(HOST_IRQ_GPIO);  
-    printf("HOST_IRQ at startup is: %d\n", current_IRQ_state);
-    
-
-    // to signal to the DLPC1438 that we want to start up, we must set PROJ_ON high
-    printf("Setting PROJ_ON (DLPC1436:GPIO8) HIGH...\n");
-    gpio_put(PROJ_ON_GPIO, 1);  // this will let the DLPC1438 know we want to go, go go
-
-    // now we must let the DLPC1438 run through its initialisation cycle
-    // it will let us know it is done by pulling HOST_IRQ low (~500ms)
-    printf("Waiting for HOST_IRQ LOW...\n");
-
-    bool last_IRQ_state = 0;
-    bool transition = 0;
-    int count = 0;
-    int sleeptime = 50;  // in ms 
-
-    // TODO: the HOST_IRQ signal is 1.8V when high; hard to interpret on the pico; right
-    // on the threshold of detectable voltage. Code below assumes we can reliably distinguish
-    // between 0 and 1.8V. Alternative: wait for 1 s and assume it is ready.
-
-    // while (!transition) {
-    //     sleep_ms(sleeptime);
-    //     current_IRQ_state = gpio_get(HOST_IRQ_GPIO);  
-    //     //printf("HOST IRQ IS: %d\n", current_IRQ_state);
-    //     if ((last_IRQ_state == 1) && (current_IRQ_state == 0)) { transition = 1; }
-    //     last_IRQ_state = current_IRQ_state;
-    //     count += 1;
-    // }  // typically this takes ~650ms
-
-    sleep_ms(1000);  // makeshift solution if the HOST_IRQ based approach does not work.
-
-    printf("HOST_IRQ has been pulled low by DLPC1438, %dms after PROJ_ON signal\n", count*sleeptime);
-    
-    // now that HOST_IRQ is low we can start i2c communication. Lets give it 100ms to be safe
-    sleep_ms(100);
-    printf("DLPC1438 is ready for I2C communication!");
-}
-
 // set up i2c hardware on pico
 void configure_i2c() {
     printf("\n>> setting up I2C...\n\n");
@@ -122,78 +90,15 @@ void configure_i2c() {
     gpio_set_function(SCL_PIN, GPIO_FUNC_I2C); 
     //gpio_pull_up(SDA_PIN);  // Don't need these since we have hardware pullup on the PCB
     //gpio_pull_up(SCL_PIN);  // Don't need these since we have hardware pullup on the PCB
-    i2c_init(i2c1, 40 * 1000);  // DLPC1438 supports up to 100KHz; we use i2c HW block 0
+    i2c_init(i2c1, 100 * 1000);  // DLPC1438 supports up to 100KHz; we use i2c HW block 1
     printf("i2c should be ready!\n");
 }
 
-/// TEMPORARY TODO: remove
-bool reserved_addr(uint8_t addr) {
-    return (addr & 0x78) == 0 || (addr & 0x78) == 0x78;
-}
-
-void scan_i2c() {
-    printf("\nI2C Bus Scan\n");
-    printf("   0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F\n");
-
-    for (int addr = 0; addr < (1 << 7); ++addr) {
-        if (addr % 16 == 0) {
-            printf("%02x ", addr);
-        }
-
-        // Perform a 1-byte dummy read from the probe address. If a slave
-        // acknowledges this address, the function returns the number of bytes
-        // transferred. If the address byte is ignored, the function returns
-        // -1.
-
-        // Skip over any reserved addresses.
-        int ret;
-        uint8_t rxdata[3];
-        if (reserved_addr(addr))
-            ret = PICO_ERROR_GENERIC;
-        else
-            ret = i2c_read_blocking(i2c1, addr, rxdata, 1, false);
-
-        printf(ret < 0 ? "." : "@");
-        printf(addr % 16 == 15 ? "\n" : "  ");
-    }
-    printf("Done.\n");
-}
-
-// can we actually see AND talk to DLPC1438 over i2c?
-void check_i2c_communication() {
-    // Can we see the DLPC1438?
-    scan_i2c();
-    sleep_ms(500);
-
-    // Can we talk to the DLPC1438?
-    int ret;
-    uint8_t rxdata;
-    ret = i2c_read_blocking(i2c1, DLPC_addr, &rxdata, 1, false); 
-    printf(ret < 0 ? "Could not connect to DLPC1438 over i2c\n" : "Found DLPC1438 on i2c\n");
-    if (ret >= 0) { 
-        gpio_put(LED_PIN_R, 1);  // turn on LED so we know we are connected.
-    }
-}
-
-void i2c_write(uint8_t addr, uint8_t *data, int length) {
+// queue a register write (see i2c_queue.h); returns straight away, the raw data shows up in
+// the log printed by i2c_queue_print_log()
+i2c_handle_t i2c_write(uint8_t addr, uint8_t *data, int length) {
     // note that length is here the length of data (so excluding the addr)
-    uint8_t send_data[length+1];  // but we we must combine [addr, data...] to send over
-
-    send_data[0] = addr;
-
-    int i = 0;
-    for (i = 0; i < length; i++) {
-        send_data[i+1] = data[i];
-    }
-
-    printf("(i2c-send) raw data: ");  // just for my sanity
-
-    for (int i = 0; i < sizeof send_data / sizeof send_data[0]; i++) {
-        printf("%x ", send_data[i]);
-    }
-    printf("\n");
-
-    i2c_write_blocking(i2c1, DLPC_addr, send_data, length+1, false);
+    return i2c_queue_write(addr, data, length);
 }
 
 // read I2C data back
@@ -203,8 +108,7 @@ void i2c_write(uint8_t addr, uint8_t *data, int length) {
 void i2c_read(uint8_t addr, uint8_t length, char* message) {
     uint8_t data_in[length+1];
 
-    i2c_write_blocking(i2c1, DLPC_addr, &addr, 1, true);
-    i2c_read_blocking(i2c1, DLPC_addr, data_in, length+1, false);
+    i2c_queue_wait(i2c_queue_read(addr, data_in, length+1));  // after everything queued before it
 
     printf(message);
     for (int i = 0; i < length; i++) {
@@ -235,14 +139,9 @@ void switch_projector_mode(enum ProjectorMode mode) {
             break;
     }
 
-    // checking initial state:
-    i2c_read(0x06, 1, "Mode before switching: ");
-
+    // read back (0x06) only in verify mode, see dlpc_regs.h
     uint8_t data[] = {mode_value};
-    i2c_write(addr, data, 1);
-
-    // temporary: check that we switched ok  --> works fine
-    i2c_read(0x06, 1, "Mode after switching: ");
+    dlpc_write(addr, data, 1);
 }
 
 void curtain_flood_exposure(int duration, int count) {
@@ -252,17 +151,16 @@ void curtain_flood_exposure(int duration, int count) {
 
     // note that projector cannot be in standby mode for this to work. Try Testpattern.
 
-    i2c_read(0x17, 1, "Base curtain settings: "); //TODO: remove
     uint8_t curtain[1];
 
     for (int i = 0; i < count; i++) {
         // flood exposure ON
         curtain[0] = 0b00001111;
-        i2c_write(0x16, curtain, 1);
+        dlpc_write(0x16, curtain, 1);
         sleep_ms(duration);
         // flood exposure OFF
         curtain[0] = 0b00000000;
-        i2c_write(0x16, curtain, 1);
+        dlpc_write(0x16, curtain, 1);
         sleep_ms(duration);
     }
 }
@@ -271,52 +169,12 @@ void configure_external_print(){  // see section 3.3.6 (and 3.3.1) of programmin
     // in this step we set both the transfer fuction gamma and select which LED to use
     printf("\n>> Configuring External Print mode...\n\n");
 
-    // temporary: checking initial state:
-    i2c_read(0xA9, 2, "intial gamma/led config settings: \n");
-    sleep_ms(100);
-
     // write the new values to register (actually configure the DLPC1438)
     int gamma = 0x00;  // we want the linear kind (also used by Anycubic)
     // Select which LED to use. b(7:2) are reserved. The final 3 bits are toggles for LED 3,2,1 
     int led_select = 0b00000100;  // one LED at a time. Anyubic board says we need LED3.
     uint8_t data[] = {gamma, led_select};  
-    i2c_write(0xA8, data, 2);
-
-    i2c_read(0xA9, 2, "new gamma/led config settings: \n");
-    sleep_ms(100);
-}
-
-// programming guide section 3.3.8 & 9
-// exposure values taken from Anycubic Board's I2C commands during test patterns
-void switch_light_state(enum LightState light_on) { 
-    uint8_t print_control, dark_frames_LSB, dark_frames_MSB, exp_frames_LSB, exp_frames_MSB;
-
-    if (light_on) {
-        printf("[!UV!] Switching Projector Light ON\n");
-        // "External Print Control" byte; b(7:1) reserved; 0 is START, 1 is STOP.
-        print_control   = 0b00000000;  // 1 for light off, 0 for light on
-        dark_frames_LSB = 0x03; 
-        dark_frames_MSB = 0x00; 
-        exp_frames_LSB  = 0xFF;  // if both exp_frames are 0xFF the LED will stay on indefinitely
-        exp_frames_MSB  = 0xFF;  // and turning off is then done by sending this command with 
-                                        // print_control being 0b00000001 
-    } else {
-        printf("Switching Projector Light OFF\n");
-        print_control   = 0b00000001;  // 1 for light off, 0 for light on
-        dark_frames_LSB = 0x00; 
-        dark_frames_MSB = 0x00; 
-        exp_frames_LSB  = 0x00;  
-        exp_frames_MSB  = 0x00;  
-    }
-
-    uint8_t data[] = {print_control, dark_frames_LSB, dark_frames_MSB, exp_frames_LSB, exp_frames_MSB}; 
-    sleep_ms(30);  // give it a little moment 
-    i2c_write(0xC1, data, 5);
-
-    // i2c_read the 0xC2 register never seems to actually return logical numbers
-    // I assume there is something wrong on the firmware side. The effect of the write command
-    // is okay though.
-    // i2c_read(0xC2, 5, "New Dark and Exposed frame settings: \n");
+    dlpc_write(0xA8, data, 2);
 }
 
 void set_illumination_PWM(unsigned short PWM_value) {
@@ -329,8 +187,7 @@ void set_illumination_PWM(unsigned short PWM_value) {
     uint8_t MSByte = (PWM_value >> 8) & 0xFF;
 
     uint8_t data[] = {0, 0, 0, 0, LSByte, MSByte};
-    i2c_write(0x54, data, 6);
-    i2c_read(0x55, 6, "Set LED PWM settings: \n");
+    dlpc_write(0x54, data, 6);
 }
 
 void set_image_orientation(bool flip_short_axis, bool flip_long_axis) {
@@ -339,14 +196,10 @@ void set_image_orientation(bool flip_short_axis, bool flip_long_axis) {
     uint8_t orientation_setting = (shifted_sa | shifted_la);
     uint8_t data[1] = {orientation_setting};
 
-    i2c_write(0x14, data, 1);
-    i2c_read(0x15, 1, "Set image orientation settings: \n");
+    dlpc_write(0x14, data, 1);
 }
 
 void configure_test_pattern_settings(uint8_t pattern_idx) {
-
-    i2c_read(0x0C, 6, "old test pattern settings: \n");
-
     uint8_t pattern_select = 0b10000111;  // b(6:4) reserved
     // parameters (effect depends on selected pattern)
     // note that if a parameter is not used by pattern then the bytes will not be set
@@ -361,9 +214,7 @@ void configure_test_pattern_settings(uint8_t pattern_idx) {
 
     uint8_t test_pattern_settings[6] = {pattern_select, 0x00, param_1, param_2, param_3, param_4};
 
-    i2c_write(0x0B, test_pattern_settings, 6);
-
-    i2c_read(0x0C, 6, "new test pattern settings: \n");
+    dlpc_write(0x0B, test_pattern_settings, 6);
 }
 
 void intialise_DLP_test_pattern() {
@@ -392,21 +243,12 @@ void intialise_DLP_test_pattern() {
 //////// PIO stuff
 
 
-// VGA timing constants
-#define H_ACTIVE 1295    // (active (1280) + frontporch - 1) - one cycle delay for mov //TODO Tune +27
-#define V_ACTIVE 719    // (active (720) - 1) //TODO Tune  
-#define DATAEM_CMD_ACTIVE 319    // (horizontal_pixels/pixels_per_byte - 1)
+// The VGA timing constants, the length of the pixel array and the number of DMA transfers are
+// all derived from the timing description in video_mode.h.
 
-
-// Length of the pixel array, and number of DMA transfers
-#define TXCOUNT 230400 // Total number of chars/8bit numbers we need. (for DLP300/301 in normal mode)
-                       // We run 1280x720 pixels and 1 bit per pixel so we need 1280*720*(1/8) 
-
-// // Pixel grayscale array that is DMA's to the PIO machines and
-// // a pointer to the ADDRESS of this color array.
-// // Note that this array is automatically initialized to all 0's (black)
-// unsigned char DLP_data_array[TXCOUNT];
-char * address_pointer = &DLP_data_array[0] ;
+// Bits per pixel of the scan-out (1, 2, 4 or 8). DLP_data_array is sized for DLP_PIXEL_BPP and
+// the DLP_ROI window (cmake options); a mode whose window is larger than that shows its top rows.
+static uint8_t pixel_bpp = DLP_PIXEL_BPP;
 
 
 // Give the I/O pins that we're using some names that make sense
@@ -417,122 +259,407 @@ char * address_pointer = &DLP_data_array[0] ;
 #define PXL_CLK   16
 #define BASE_PXL_PIN   8  // first pin (of 8) contiguous pixel bits
 
-// A function for drawing a pixel with a specified grayscale value.
-// Note that because information is passed to the PIO state machines through
-// a DMA channel, we only need to modify the contents of the array and the
-// pixels will be automatically updated on the screen.
+// SPI upload link (see spi_link.h); SCK and CS follow MOSI
+#define SPI_MOSI   2
+#define SPI_READY  5
+#define SPI_NAK    1
 
-// NOTE: for now we constrain brightness to be 0 or 1 (1-bit)
-void drawPixel(int x, int y, enum LightState lit) {
-    
-    // we first find the linear index of the pixel. This is just a unique number for each 
-    // pixel that runs from 0 to x_range*y_range (1280*720)
-    long pixel_idx = ((1280 * y) + x) ;
-
-    // our data array contains fewer element than the range of our pixel index
-    // since we store the 1-bit info for 8 pixels in a single byte of that data array
-    // we need to to map our pixel index into array address. Note that 8 pixel indices should
-    // map to the same address.
-    
-    // so we do 2 things: first determine what pixel are we looking at (at our set of 8?)
-    // that one is not so hard: simply pixel_idx % 8.
-
-    // To efficiently find the array index, we can simply divide (and round) the pixel_index by 8. 
-    // A triple right bit shift should do the trick (pixel_idx >> 3)
-
-    // We then bit shift the pixel brightness (lit; 0 or 1) to the appropriate location in the byte
-    // by using lit << (7 - pixel_idx % 8). This means the lower pixel_index will be "to the left" in
-    // the byte.
-
-    DLP_data_array[pixel_idx>>3] |= lit << (7 - (pixel_idx % 8));
-
-    // switch (pixel_idx % 8)
-    // {
-    //     case 0:
-    //         DLP_data_array[pixel_idx>>3] |= lit << 7;
-    //         break;
-    //     case 1:
-    //         DLP_data_array[pixel_idx>>3] |= lit << 6;
-    //         break;
-    //     case 2:
-    //         DLP_data_array[pixel_idx>>3] |= lit << 5;
-    //         break;
-    //     case 3:
-    //         DLP_data_array[pixel_idx>>3] |= lit << 4;
-    //         break;
-    //     case 4:
-    //         DLP_data_array[pixel_idx>>3] |= lit << 3;
-    //         break;
-    //     case 5:
-    //         DLP_data_array[pixel_idx>>3] |= lit << 2;
-    //         break;
-    //     case 6:
-    //         DLP_data_array[pixel_idx>>3] |= lit << 1;
-    //         break;
-    //     default:
-    //         DLP_data_array[pixel_idx>>3] |= lit;
-    //         break;
-    // }
+#if DLP_LINE_RING
+
+static uint32_t line_ring_buffers[SCANOUT_LINE_RING_WORDS(VIDEO_LINE_BYTES(8))];  // any mode
+
+// Line ring scan-out (see scanout.h): the same checkerboard as below, but rendered one line at
+// a time just before the DMA needs it, so no framebuffer is needed at all.
+void checkerboard_line(uint16_t y, uint32_t *line, const uint32_t *prev_line, void *ctx) {
+    framebuffer_t row;
+    fb_init(&row, line, FB_WIDTH, 1, pixel_bpp);
+
+    for (int bx = 0; bx < FB_WIDTH / 160; bx++) {
+        fb_fill_span(&row, bx * 160, (bx + 1) * 160, 0, (bx + y / 80) % (1 << pixel_bpp));
+    }
+}
+
+// show the checkerboard until a compressed frame has been uploaded over USB
+static scanout_frame_source_t uploaded_frame;
+
+// or a display list (see vector.h), rasterised line by line; it has to keep up with the beam
+static vector_raster_t vector;
+static const uint8_t *volatile pending_vector;
+static volatile bool vector_shown;
+
+// or a raw frame from the flash frame library (see frame_library.h), copied out line by line
+static const uint8_t *volatile pending_library;
+static const uint8_t *volatile library_shown;
+
+// an upload has become the source: the staging area of the one before is read until this frame ends
+static volatile bool staging_released;
+
+void render_line(uint16_t y, uint32_t *line, const uint32_t *prev_line, void *ctx) {
+    if (y == 0 && staging_released) {
+        staging_released = false;
+        staging_locked = false;  // nothing of the previous frame is rendered from here on
+    }
+    if (y == 0 && pending_vector) {
+        vector_start(&vector, pending_vector);  // switch lists between frames only
+        pending_vector = NULL;
+        vector_shown = true;
+    }
+    if (y == 0 && pending_library) {
+        library_shown = pending_library;
+        pending_library = NULL;
+    }
+    if (vector_shown) {
+        vector_render_line(&vector, y, line, pixel_bpp);
+    } else if (library_shown) {
+        memcpy(line, library_shown + (uint32_t)y * VIDEO_LINE_BYTES(pixel_bpp), VIDEO_LINE_BYTES(pixel_bpp));
+    } else if (uploaded_frame.data) {
+        scanout_render_frame(y, line, prev_line, &uploaded_frame);
+    } else {
+        checkerboard_line(y, line, prev_line, ctx);
+    }
+}
+
+// the upload in the staging area is the render source from the next frame on: uploads go into
+// the other staging area, once the current frame no longer reads from it
+static void show_staging(void) {
+    staging_locked = true;
+    staging_flip();
+    staging_released = true;
 }
 
+// a DLPF frame the line buffers can take: full width, at most a frame high, at our bit depth
+static bool frame_fits(const uint8_t *data, uint32_t length) {
+    frame_decoder_t decoder;
+    return frame_decoder_init(&decoder, data, length) == FRAME_OK && decoder.width == FB_WIDTH &&
+           decoder.height <= VIDEO_HEIGHT && decoder.bpp == pixel_bpp;
+}
+
+// called once a complete upload has arrived over USB or SPI (see usb_link.h)
+int upload_complete(uint8_t target, uint8_t *data, uint32_t length) {
+    pending_library = NULL;
+    library_shown = NULL;  // show the upload instead of the library frame
+
+    if (target == USB_TARGET_VECTOR) {
+        int status = vector_validate(data, length, FB_WIDTH, VIDEO_HEIGHT);
+        if (status == VECTOR_OK) {
+            pending_vector = data;  // picked up at the start of the next frame
+            show_staging();
+        }
+        return status;
+    }
+    if (target != USB_TARGET_FRAME) { return -1; }  // no framebuffer to put anything else in
+    if (!frame_fits(data, length)) { return FRAME_ERROR_SIZE; }  // the lines are sized for our mode
+
+    // the decoder picks the new frame up at the start of the next frame
+    uploaded_frame.length = length;
+    uploaded_frame.data = data;
+    vector_shown = false;
+    show_staging();
+    return 0;
+}
+
+// show frame <index> of the flash frame library from the next frame on: DLPF frames are decoded
+// from flash like uploads, raw ones are copied out of flash
+int show_library_frame(uint32_t index) {
+    const frame_library_entry_t *entry = frame_library_entry(index);
+    if (!entry || entry->bpp != pixel_bpp) { return FRAME_LIBRARY_ERROR_ENTRY; }
+
+    if (entry->format == FRAME_LIBRARY_DLPF) {
+        if (!frame_fits(frame_library_data(entry), entry->length)) { return FRAME_LIBRARY_ERROR_ENTRY; }
+        library_shown = NULL;
+        uploaded_frame.length = entry->length;
+        uploaded_frame.data = frame_library_data(entry);
+    } else if (entry->length >= VIDEO_FRAME_BYTES(pixel_bpp)) {
+        pending_library = frame_library_data(entry);
+    } else {
+        return FRAME_LIBRARY_ERROR_ENTRY;
+    }
+    vector_shown = false;
+    return FRAME_LIBRARY_OK;
+}
+
+#else
+
+// The framebuffer wraps DLP_data_array. Because information is passed to the PIO state machines
+// through a DMA channel, we only need to modify the contents of the array and the pixels will be
+// automatically updated on the screen. See framebuffer.h for the pixel packing.
+framebuffer_t frame;
+
 void checkerboard_PIO() {
-    // simple checkerboard-like pattenr with grayscale blocks. 
-    // due to memory constraints we only use 2 bits for each pixel
+    // simple checkerboard-like pattern with grayscale blocks, as many gray levels as the mode has
 
     printf("{{ making checkerboard }}\n");
 
-    uint64_t begin_time; 
-    uint64_t curr_time; 
-    uint64_t frametime = 1000000;  // time between frame transitions (in us) 
-    uint32_t framenum = 0;
-
-    begin_time = time_us_64() ;
+    uint64_t begin_time = time_us_64();
 
     // grayscale block size
     int xsize = 160;
     int ysize = 80;
-    int xprog = 0;  // just a counter
-    int yprog = 0;  // just a counter
- 
-
-    while((time_us_64() - begin_time) < 5000000) {  
-        
-        int x = 0 ; 
-        int y = 0 ; 
-        int yoink = 0;
-        int drawstate = 1;
-
-        for (x=0; x<1280; x++) { 
-            //printf("... line x=%d.\n", x);
-            if (xprog == xsize) {
-                framenum = (framenum + 1) % 4;  // new grayscale value for block
-                xprog=0;
-            } 
-            xprog++;
-            for (y=0; y<720; y++) {         
-                if (yprog == ysize) {
-                    framenum = (framenum + 1) % 4;  // new grayscale value for block
-                    yprog=0;
-                } 
-                yprog++;
-                
-                drawPixel(x, y, drawstate) ;  // actually pack the pixel into DLP_data_array //TODO make dyanmic
-                if (yoink > 10) {
-                    yoink = 0;
-                    drawstate = drawstate ^ 1; // should flip 0->1 and 1->0
-                }
-                yoink++;
-            }
+
+    for (int by = 0; by < FB_HEIGHT / ysize; by++) {
+        for (int bx = 0; bx < FB_WIDTH / xsize; bx++) {
+            // new grayscale value for each block
+            fb_fill_rect(&frame, bx * xsize, by * ysize, xsize, ysize, (bx + by) % (1 << frame.bpp));
         }
     }
 
-    printf("Stopped sending checkerboard...\n");
+    uint64_t elapsed = time_us_64() - begin_time;
+    printf("Checkerboard drawn in %llu us (%llu pixels/s)\n", elapsed,
+           elapsed ? (uint64_t)FB_WIDTH * FB_HEIGHT * 1000000 / elapsed : 0);
+}
+
+// tile builds (cmake DLP_TILE): a checkerboard over the whole field from a tile with two of its
+// quadrants lit, which the scan-out repeats (see scanout_init_tile())
+void checkerboard_tile() {
+    uint64_t begin_time = time_us_64();
+    uint16_t half_width = frame.width / 2;
+    uint16_t half_height = frame.height / 2;
+    uint8_t lit = (1 << frame.bpp) - 1;
+
+    fb_clear(&frame, 0);
+    fb_fill_rect(&frame, 0, 0, half_width, half_height, lit);
+    fb_fill_rect(&frame, half_width, half_height, frame.width - half_width, frame.height - half_height, lit);
+
+    printf("Checkerboard tile of %ux%u drawn in %llu us\n", frame.width, frame.height, time_us_64() - begin_time);
+}
+
+// drawing the checkerboard as a core1 job: render_submit(checkerboard_job, NULL, NULL)
+int checkerboard_job(void *ctx) {
+    checkerboard_PIO();
+    return 0;
+}
+
+// an uploaded DLPF frame waiting in the staging area to be decoded on core1
+typedef struct {
+    const uint8_t *data;
+    uint32_t length;
+    uint32_t elapsed_us;
+} frame_job_t;
+
+static frame_job_t upload_job;
+
+static int decode_upload(void *ctx) {
+    frame_job_t *job = ctx;
+    uint64_t begin_time = time_us_64();
+    int status = frame_decode(job->data, job->length, &frame);
+    job->elapsed_us = time_us_64() - begin_time;
+    return status;
+}
+
+// back on core0: the staging area can take the next upload, report how long decoding took
+static void decode_upload_done(void *ctx, int status) {
+    frame_job_t *job = ctx;
+    staging_locked = false;
+
+    if (status != FRAME_OK) {
+        printf("Could not decode frame (error %d)\n", status);
+    } else {
+        printf("Decoded %lu byte frame in %lu us\n", job->length, job->elapsed_us);
+    }
+}
+
+// decode a compressed DLPF frame (see frame_codec.h and utils/frame_encoder.py) into the
+// scan-out buffer. The header is checked here, the decoding itself happens on core1 so the
+// links, the I2C queue and exposures carry on meanwhile; the staging area stays locked until then.
+int load_frame(const uint8_t *data, uint32_t length) {
+    frame_decoder_t decoder;
+    int status = frame_decoder_init(&decoder, data, length);
+    if (status != FRAME_OK) {
+        printf("Could not decode frame (error %d)\n", status);
+        return status;
+    }
+
+    upload_job.data = data;
+    upload_job.length = length;
+    staging_locked = true;
+    if (!render_submit(decode_upload, decode_upload_done, &upload_job)) {
+        staging_locked = false;
+        return -1;  // core1 is backed up, the host can retry
+    }
+    return FRAME_OK;
+}
+
+// an uploaded display list (see vector.h), rasterised into the framebuffer on core1
+static vector_raster_t vector;
+static uint32_t vector_elapsed_us;
+
+static int rasterise_upload(void *ctx) {
+    uint64_t begin_time = time_us_64();
+    vector_start(&vector, ctx);
+    vector_render(&vector, &frame);
+    vector_elapsed_us = time_us_64() - begin_time;
+    return VECTOR_OK;
+}
+
+static void rasterise_upload_done(void *ctx, int status) {
+    staging_locked = false;  // the framebuffer holds the result, the list is not needed anymore
+    printf("Rasterised %u primitives in %lu us (%lu lines/ms); up to %u primitives and %u edges on a line",
+           vector.primitives, vector_elapsed_us,
+           vector_elapsed_us ? (uint32_t)frame.height * 1000 / vector_elapsed_us : 0, vector.max_active,
+           vector.max_edges);
+    if (vector.dropped) {
+        printf(", %lu dropped!", vector.dropped);
+    }
+    printf("\n");
+}
+
+// check a display list (see vector.h and utils/gerber_to_vector.py) and have core1 rasterise
+// it into the scan-out buffer; the staging area stays locked until then.
+int load_vector(const uint8_t *data, uint32_t length) {
+    int status = vector_validate(data, length, frame.width, VIDEO_HEIGHT);
+    if (status != VECTOR_OK) {
+        printf("Could not rasterise display list (error %d)\n", status);
+        return status;
+    }
+
+    staging_locked = true;
+    if (!render_submit(rasterise_upload, rasterise_upload_done, (void *)data)) {
+        staging_locked = false;
+        return -1;  // core1 is backed up, the host can retry
+    }
+    return VECTOR_OK;
+}
+
+// a DLPF frame the line buffers can take: full width, at most a frame high, at our bit depth
+static bool frame_fits(const uint8_t *data, uint32_t length) {
+    frame_decoder_t decoder;
+    return frame_decoder_init(&decoder, data, length) == FRAME_OK && decoder.width == FB_WIDTH &&
+           decoder.height <= VIDEO_HEIGHT && decoder.bpp == pixel_bpp;
+}
+
+// called once a complete upload has arrived over USB or SPI (see usb_link.h)
+int upload_complete(uint8_t target, uint8_t *data, uint32_t length) {
+    scanout_set_framebuffer(DLP_data_array);  // back from a library frame to the framebuffer
+
+    switch (target) {
+        case USB_TARGET_FRAMEBUFFER:
+            return 0;  // already written in place
+        case USB_TARGET_FRAME:
+            return load_frame(data, length);
+        case USB_TARGET_DELTA:
+            return delta_queue(data, length, &frame);  // applied at the end of the next frame
+        case USB_TARGET_BITPLANES:
+            return bitplane_queue(data, length, &frame);  // exposed plane by plane (see bitplane.h)
+        case USB_TARGET_VECTOR:
+            return load_vector(data, length);
+        case USB_TARGET_JOB:
+            return job_start(data, length, &frame);  // layers from the frame library (see job.h)
+        default:
+            return -1;
+    }
+}
+
+// show frame <index> of the flash frame library from the next frame on: raw frames are scanned
+// out of flash directly (no copy), DLPF frames are decoded from flash into the framebuffer
+int show_library_frame(uint32_t index) {
+    const frame_library_entry_t *entry = frame_library_entry(index);
+    if (!entry || entry->bpp != frame.bpp) { return FRAME_LIBRARY_ERROR_ENTRY; }
+
+    if (entry->format == FRAME_LIBRARY_DLPF) {
+        scanout_set_framebuffer(DLP_data_array);
+        return load_frame(frame_library_data(entry), entry->length);
+    }
+    // the DMA streams whole frames only in framebuffer mode (see scanout.h)
+    if (frame.width != VIDEO_WIDTH || frame.height != VIDEO_HEIGHT || entry->length < VIDEO_FRAME_BYTES(frame.bpp)) {
+        return FRAME_LIBRARY_ERROR_ENTRY;
+    }
+    scanout_set_framebuffer(frame_library_data(entry));
+    return FRAME_LIBRARY_OK;
+}
+
+#endif
+
+// binary commands over USB (see usb_link.h)
+// set by the host (USB_CMD_END_SESSION); the main loop runs until then
+static volatile bool session_ended;
+
+int usb_command(uint8_t command, uint32_t argument, uint32_t *value, const void **reply, uint16_t *reply_length) {
+    switch (command) {
+        case USB_CMD_SELECT_FRAME:
+            return show_library_frame(argument);
+        case USB_CMD_TELEMETRY:
+            *reply = telemetry_read();
+            *reply_length = sizeof(telemetry_t);
+            return 0;
+        case USB_CMD_END_SESSION:
+            session_ended = true;
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+// runs in the scan-out interrupt at the end of every frame: a queued layer update lands
+// first, then an armed exposure can start on the new layer (see exposure.h)
+void frame_end(void) {
+#if !DLP_LINE_RING
+    delta_frame_end();
+#endif
+    exposure_frame_end();
+    telemetry_frame_end();
+}
+
+// time of the next frame boundary, with the frame count it brought, for measuring the frame rate
+static uint64_t wait_frame(uint32_t *frames) {
+    uint32_t seen = scanout_stats.frames;
+    while (scanout_stats.frames == seen) {
+        tight_loop_contents();
+    }
+    *frames = scanout_stats.frames;
+    return time_us_64();
+}
+
+
+// programming guide section 3.3.1 ("3D Print Procedure Without FPGA Front-End"): queued by
+// the bring-up as soon as the DLPC answers (see dlpc_bringup.h)
+void setup_external_print() {
+    printf("\n>> EXTERNAL PRINT SETUP <<\n\n");
+    configure_external_print();
+    switch_projector_mode(EXTERNALPRINT);
+    set_illumination_PWM(0xB4);
+    set_image_orientation(false, false);
 }
 
 
 int main() {
+    // the system clock first: stdio, I2C and the video dividers are all set up from it
+    const clock_plan_t *plan = clock_plan_init();
+
     // Initialize stdio
     stdio_init_all();
+    clock_plan_report(plan);
+    render_init();  // core1 takes the framebuffer work from here on
+
+    // start the DLPC first: it boots while we set up the scan-out (see dlpc_bringup.h)
+    configure_i2c();  // set up i2c hardware
+    i2c_queue_init(i2c1, DLPC_addr, 100 * 1000);  // from here on DLPC commands are queued
+    bringup_start(PROJ_ON_GPIO, HOST_IRQ_GPIO, setup_external_print);
+
+    const video_mode_t *mode = video_mode_find(pixel_bpp);
+    if (!mode) {
+        mode = video_mode_find(DLP_PIXEL_BPP);
+        pixel_bpp = DLP_PIXEL_BPP;
+    }
+
+#if DLP_TILE_WIDTH
+    // the framebuffer is a single tile that the scan-out repeats over the whole frame (it keeps
+    // its size in bytes if pixel_bpp differs from DLP_PIXEL_BPP)
+    fb_init(&frame, DLP_data_array, DLP_TILE_WIDTH * DLP_PIXEL_BPP / mode->bpp, DLP_TILE_HEIGHT, mode->bpp);
+    uint32_t frame_bytes = DLP_DATA_BYTES;
+    printf("%u bit pixels, tile of %ux%u repeated over the frame, %lu bytes\n", mode->bpp, frame.width,
+           frame.height, frame_bytes);
+    checkerboard_tile();
+#elif !DLP_LINE_RING
+    // framebuffer on top of the image array: the window of the frame that holds pixel data
+    // (DLP_ROI, by default the whole frame), as many of its rows as fit next to the line
+    // buffers that scan out anything but the whole frame
+    video_window_t window = { DLP_ROI_X, DLP_ROI_Y, DLP_ROI_WIDTH, DLP_ROI_HEIGHT };
+    window = video_mode_fit_window(mode, window, DLP_DATA_BYTES);
+    fb_init(&frame, DLP_data_array, window.width, window.height, mode->bpp);
+    uint32_t frame_bytes = frame.height * frame.stride * 4;
+    printf("%u bit pixels, window of %ux%u at (%u, %u), %lu bytes\n", mode->bpp, window.width, window.height,
+           window.x, window.y, frame_bytes);
+#endif
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // ===========================-== PIO Stuff ====================================================
@@ -553,7 +680,6 @@ int main() {
     // and is of the form <program name_program>
     uint hsync_offset = pio_add_program(pio, &hsync_program);
     uint vsync_offset = pio_add_program(pio, &vsync_program);
-    uint pxl_offset = pio_add_program(pio, &pxl_program);
     uint clk_offset = pio_add_program(pio, &pxl_clk_program);
 
     // Manually select a few state machines from pio instance pio0.
@@ -566,52 +692,46 @@ int main() {
     // Why not create these programs here? By putting the initialization function in
     // the pio file, then all information about how to use/setup that state machine
     // is consolidated in one place. Here in the C, we then just import and use it.
-    hsync_program_init(pio, hsync_sm, hsync_offset, HSYNC);
-    vsync_program_init(pio, vsync_sm, vsync_offset, VSYNC);
-    pxl_program_init(pio, pxl_sm, pxl_offset, BASE_PXL_PIN, DATAEN_CMD);
-    pxl_clk_program_init(pio, clk_sm, clk_offset, PXL_CLK);
+    // The clock dividers come from the clock plan: hsync and vsync take one cycle per PCLK
+    // period, pxl and pxl_clk VIDEO_PCLK_DIV.
+    uint16_t div_int;
+    uint8_t div_frac;
+    clock_plan_sm_div(plan, 1, &div_int, &div_frac);
+    hsync_program_init(pio, hsync_sm, hsync_offset, HSYNC, div_int, div_frac);
+    vsync_program_init(pio, vsync_sm, vsync_offset, VSYNC, div_int, div_frac);
+    video_mode_load(mode, pio, pxl_sm, BASE_PXL_PIN, DATAEN_CMD);  // pxl program for the bit depth
+    clock_plan_sm_div(plan, VIDEO_PCLK_DIV, &div_int, &div_frac);
+    pxl_clk_program_init(pio, clk_sm, clk_offset, PXL_CLK, div_int, div_frac);
 
 
     /////////////////////////////////////////////////////////////////////////////////////////////////////
     // ===========================-== DMA Data Channels =================================================
     /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    // DMA channels - 0 sends color data, 1 reconfigures and restarts 0
-    int pxl_chan_0 = 0;
-    int pxl_chan_1 = 1;
-
-    // Channel Zero (sends color data to PIO VGA machine)
-    dma_channel_config c0 = dma_channel_get_default_config(pxl_chan_0);  // default configs
-    channel_config_set_transfer_data_size(&c0, DMA_SIZE_8);              // 4-bit txfers
-    channel_config_set_read_increment(&c0, true);                        // yes read incrementing
-    channel_config_set_write_increment(&c0, false);                      // no write incrementing
-    channel_config_set_dreq(&c0, DREQ_PIO0_TX2) ;                        // DREQ_PIO0_TX2 pacing (FIFO)
-    channel_config_set_chain_to(&c0, pxl_chan_1);                        // chain to other channel
-
-    dma_channel_configure(
-        pxl_chan_0,                 // Channel to be configured
-        &c0,                        // The configuration we just created
-        &pio->txf[pxl_sm],          // write address (RGB PIO TX FIFO)
-        &DLP_data_array,            // The initial read address (pixel color array)
-        TXCOUNT,                    // Number of transfers; in this case each is 1 byte.
-        false                       // Don't start immediately.
-    );
-
-    // Channel One (reconfigures the first channel)
-    dma_channel_config c1 = dma_channel_get_default_config(pxl_chan_1);   // default configs
-    channel_config_set_transfer_data_size(&c1, DMA_SIZE_32);              // 32-bit txfers
-    channel_config_set_read_increment(&c1, false);                        // no read incrementing
-    channel_config_set_write_increment(&c1, false);                       // no write incrementing
-    channel_config_set_chain_to(&c1, pxl_chan_0);                         // chain to other channel
-
-    dma_channel_configure(
-        pxl_chan_1,                         // Channel to be configured
-        &c1,                                // The configuration we just created
-        &dma_hw->ch[pxl_chan_0].read_addr,  // Write address (channel 0 read address)
-        &address_pointer,                   // Read address (POINTER TO AN ADDRESS)
-        1,                                  // Number of transfers, in this case each is 4 byte
-        false                               // Don't start immediately.
-    );
+    // DMA channels 0 and 1 feed the pxl state machine, see scanout.h
+#if DLP_LINE_RING
+    // no framebuffer; lines are rendered just in time into a small ring of line buffers
+    scanout_init_line_ring(pio, pxl_sm, mode->line_bytes, VIDEO_HEIGHT, line_ring_buffers,
+                           render_line, NULL);
+    usb_link_init(NULL, 0, upload_complete);
+    spi_link_init(SPI_MOSI, SPI_READY, SPI_NAK, NULL, 0, upload_complete);
+#else
+#if DLP_TILE_WIDTH
+    scanout_init_tile(pio, pxl_sm, mode->line_bytes, VIDEO_HEIGHT, &frame);
+#else
+    if (video_window_full(&window)) {
+        scanout_init_framebuffer(pio, pxl_sm, DLP_data_array, mode->line_bytes, VIDEO_HEIGHT);
+    } else {
+        // the lines around the window are blank (see scanout.h)
+        scanout_init_window(pio, pxl_sm, mode->line_bytes, VIDEO_HEIGHT, (uint32_t *)(DLP_data_array + frame_bytes),
+                            &frame, window.x, window.y);
+    }
+#endif
+    usb_link_init(DLP_data_array, frame_bytes, upload_complete);  // images can be pushed over USB
+    spi_link_init(SPI_MOSI, SPI_READY, SPI_NAK, DLP_data_array, frame_bytes, upload_complete);  // or SPI
+#endif
+    scanout_set_frame_callback(frame_end);  // layer updates and exposures start between frames
+    usb_link_set_command_handler(usb_command);
 
     /////////////////////////////////////////////////////////////////////////////////////////////////////
     /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -619,10 +739,9 @@ int main() {
     // Initialize PIO state machine counters. This passes the information to the state machines
     // that they retrieve in the first 'pull' instructions, before the .wrap_target directive
     // in the assembly. Each uses these values to initialize some counting registers.
-    pio_sm_put_blocking(pio, hsync_sm, H_ACTIVE);
-    pio_sm_put_blocking(pio, vsync_sm, V_ACTIVE);
-    pio_sm_put_blocking(pio, pxl_sm, DATAEM_CMD_ACTIVE);
-    pio_sm_put_blocking(pio, clk_sm, DATAEM_CMD_ACTIVE);
+    // (video_mode_load() has already given the pxl machine its pixel counter)
+    pio_sm_put_blocking(pio, hsync_sm, plan->h_counter);  // VIDEO_H_COUNTER, or a longer front porch
+    pio_sm_put_blocking(pio, vsync_sm, VIDEO_V_COUNTER);
 
 
     // Start the two pio machine IN SYNC
@@ -635,7 +754,11 @@ int main() {
     // will be continously DMA's to the PIO machines that are driving the screen.
     // To change the contents of the screen, we need only change the contents
     // of that array.
-    dma_start_channel_mask((1u << pxl_chan_0)) ;
+    scanout_start();
+    telemetry_init(pio, mode->bpp);  // always-on scan-out counters, see telemetry.h
+    bringup_mark("scan-out running");
+    uint32_t frames_begin;
+    uint64_t frames_begin_us = wait_frame(&frames_begin);  // the frame rate is measured over the bring-up
 
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -646,64 +769,90 @@ int main() {
     gpio_set_dir(LED_PIN_G, GPIO_OUT);
     gpio_init(LED_PIN_R);
     gpio_set_dir(LED_PIN_R, GPIO_OUT);
-    for (int i = 0; i < 5; i++) {
-        printf("Blinking!\r\n");
-        gpio_put(LED_PIN_G, 0);
-        sleep_ms(250);
-        gpio_put(LED_PIN_G, 1);
-        sleep_ms(1000);
+    gpio_put(LED_PIN_G, 1);
+
+    // frames in flash can be selected over USB (utils/usb_frame_upload.py --select)
+    int library_status = frame_library_init();
+    if (library_status >= 0) {
+        frame_library_report();
+#if DLP_BOOT_DIAGNOSTICS
+        frame_library_bandwidth(64 * 1024, pixel_bpp);  // claims a DMA channel, flushes the XIP cache
+#endif
+    } else {
+        printf("No frame library in flash (status %d)\n", library_status);
     }
-
-      printf("%x:%x:%x:%x:%x\n", DLP_data_array[0], DLP_data_array[1], DLP_data_array[2], DLP_data_array[3], DLP_data_array[115100]); // TODO: REMOVE
-    
-    initialise_DLPC();
-
-    configure_i2c();  // set up i2c hardware
-    check_i2c_communication();  // check that we can talk to DLPC1438
-
-    // optional test commands
-    intialise_DLP_test_pattern();
-    sleep_ms(500);  // just wait and check if test pattern appears
-    //curtain_flood_exposure(100, 3);  // flash at max brightness a few times (for testing)
-    switch_projector_mode(STANDBY); // stop illumination and be in long term stable mode
-    sleep_ms(300);
-
-    // prepare printer for external print mode
-
-    configure_external_print();
-    switch_projector_mode(EXTERNALPRINT);
-    set_illumination_PWM(0xB4);
-    set_image_orientation(false, false);
-
-    ///////// EXTERNAL PRINT MODE SECTION
-    // programming guide section 3.3.1 ("3D Print Procedure Without FPGA Front-End")
-
-
-    // -- setup phase -----------
-    printf("\n>> EXTERNAL PRINT SETUP <<\n\n");
-    configure_external_print(); 
-    switch_projector_mode(EXTERNALPRINT); 
-    sleep_ms(200); // For now just wait a bit. Ideally: detect SYSTEM_READY (GPIO_06; not connected)
-    set_illumination_PWM(0xB4);  
-    set_image_orientation(false, false);
-
-    printf("Checking light state...");
-    switch_light_state(ON);   // turn on the projector and show whatever is in image buffer
+    bringup_mark("frame library checked");
+
+#if DLP_LINE_RING
+    exposure_init(NULL);
+#else
+    exposure_init(&frame);  // exposure entries can carry layer deltas
+#endif
+
+    // the links and core1 are already up while the DLPC finishes booting and takes its setup
+    while (!bringup_poll()) {
+        usb_link_poll();
+        spi_link_poll();
+        render_poll();
+    }
+    gpio_put(LED_PIN_R, bringup_phase() == BRINGUP_READY);  // red LED: the DLPC is ours
+    bringup_report();
+    uint32_t frames_end;
+    uint64_t frames_us = wait_frame(&frames_end) - frames_begin_us;
+    uint32_t frame_mhz = (uint64_t)(frames_end - frames_begin) * 1000000000 / frames_us;
+    printf("Scan-out: %lu frames in %lu ms: %lu.%02lu frames/s (planned %lu.%02lu)\n", frames_end - frames_begin,
+           (uint32_t)(frames_us / 1000), frame_mhz / 1000, frame_mhz % 1000 / 10,
+           plan->frame_mhz / 1000, plan->frame_mhz % 1000 / 10);
+#if DLP_BOOT_DIAGNOSTICS
+    scanout_bus_report();  // what the scan-out DMA takes of the SRAM bus (busy waits two frames)
+#endif
+    i2c_queue_print_log();
 
     // -- loop phase ---------
     printf("\n>> EXTERNAL PRINT LOOP <<\n\n");
-    //checkerboard_PIO(); // send video data [A]
-    // // TODO: remove the sanity check below
-    printf("%x:%x:%x:%x:%x\n", DLP_data_array[0], DLP_data_array[12], DLP_data_array[6000], DLP_data_array[100000], DLP_data_array[72]);
-    // switch_light_state(ON);   // turn on the projector and show whatever is in image buffer
-    // // -> go to line above loop back to [A]
-    
-    sleep_ms(15000); // TODO: remove
-
-    switch_light_state(OFF);
+    // keep the light on for a while (timer driven, see exposure.h); images uploaded over USB or
+    // SPI are shown straight away (see utils/usb_frame_upload.py and utils/spi_frame_upload.py),
+    // bit-plane sequences are exposed after the current exposure, and job manifests
+    // (utils/job_manifest.py) run their layers. This goes on until the host ends the session
+    // (usb_frame_upload.py --end) and the last exposure is done.
+    exposure_entry_t exposure = { .duration_us = 15000000, .pwm = 0xB4 };
+    exposure_queue(&exposure);
+    stage_stats_t stages[] = {{.name = "exposure"}, {.name = "job"}, {.name = "usb"}, {.name = "spi"},
+                              {.name = "render"}};
+    uint64_t loop_begin = time_us_64();
+    while (!session_ended || exposure_busy() || job_busy()) {
+        stage_run(&stages[0], exposure_poll);
+        stage_run(&stages[1], job_poll);  // prepares the next layer while this one exposes
+        bitplane_poll();  // unlocks the staging area once a bit-plane sequence is done
+        stage_run(&stages[2], usb_link_poll);
+        stage_run(&stages[3], spi_link_poll);
+        stage_run(&stages[4], render_poll);  // finished core1 jobs
+    }
+    render_report(stages, count_of(stages), time_us_64() - loop_begin);
+    printf("USB uploads: %lu (%lu bytes, %lu CRC errors), last took %lu us\n", usb_link_stats.uploads,
+           usb_link_stats.bytes, usb_link_stats.crc_errors, usb_link_stats.last_upload_us);
+    printf("SPI uploads: %lu (%lu bytes, %lu CRC errors, %lu NAKs), last took %lu us\n", spi_link_stats.uploads,
+           spi_link_stats.bytes, spi_link_stats.crc_errors, spi_link_stats.naks, spi_link_stats.last_upload_us);
+
+    exposure_report();
+    if (job_stats.layers) {
+        job_report();
+    }
+    i2c_queue_print_log();
+    i2c_queue_report();
+    dlpc_regs_report();
     sleep_ms(1000);
     
     switch_projector_mode(STANDBY); // stop illumination and be in long term stable mode
+
+    telemetry_report();
+    bringup_report();
     
     printf("\ndone.");
+
+    // telemetry queries (utils/telemetry.py) are answered for as long as the firmware runs
+    while (true) {
+        usb_link_poll();
+        render_poll();
+    }
 }
@@ -0,0 +1,95 @@
+/**
+ * Bit-plane sequenced grayscale (see bitplane.h for the format)
+ */
+#include "pico/stdlib.h"
+#include "bitplane.h"
+#include "delta.h"
+#include "frame_codec.h"
+#include "exposure.h"
+#include "staging.h"
+
+static bool running;
+
+static inline uint16_t read_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t read_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool plane_fits(const exposure_entry_t *entry, const framebuffer_t *fb) {
+    if (entry->delta) {
+        return delta_validate(entry->delta, entry->delta_length, fb) == DELTA_OK;
+    }
+    frame_decoder_t decoder;
+    return frame_decoder_init(&decoder, entry->frame, entry->frame_length) == FRAME_OK &&
+           decoder.width == fb->width && decoder.bpp == fb->bpp && decoder.height <= fb->height;
+}
+
+// walk over the plane records; queues them for exposure if <queue> is set
+static int process(const uint8_t *data, framebuffer_t *fb, bool queue) {
+    const uint8_t *pos = data + BITPLANE_HEADER_SIZE;
+    const uint8_t *end = pos + read_u32(&data[12]);
+
+    for (uint plane = 0; plane < data[5]; plane++) {
+        if (end - pos < BITPLANE_RECORD_SIZE) { return BITPLANE_ERROR_TRUNCATED; }
+
+        exposure_entry_t entry = {
+            .duration_us = read_u32(&pos[0]),
+            .pwm = read_u16(&pos[4]),
+        };
+        uint8_t kind = pos[6];
+        uint32_t length = read_u32(&pos[8]);
+        uint32_t padded = (length + 3) & ~3u;
+        pos += BITPLANE_RECORD_SIZE;
+        if ((uint32_t)(end - pos) < padded) { return BITPLANE_ERROR_TRUNCATED; }
+
+        if (kind == BITPLANE_FRAME) {
+            entry.frame = pos;
+            entry.frame_length = length;
+        } else if (kind == BITPLANE_DELTA && plane > 0) {
+            entry.delta = pos;
+            entry.delta_length = length;
+        } else {
+            return BITPLANE_ERROR_PLANE;
+        }
+
+        if (!queue && !plane_fits(&entry, fb)) {
+            return BITPLANE_ERROR_PLANE;
+        }
+        if (queue) {
+            exposure_queue(&entry);  // room and planes have been checked before
+        }
+        pos += padded;
+    }
+    return BITPLANE_OK;
+}
+
+int bitplane_queue(const uint8_t *data, uint32_t length, framebuffer_t *fb) {
+    if (length < BITPLANE_HEADER_SIZE || ((uintptr_t)data & 3)) { return BITPLANE_ERROR_HEADER; }
+    if (data[0] != 'D' || data[1] != 'L' || data[2] != 'P' || data[3] != 'B') { return BITPLANE_ERROR_HEADER; }
+    if (data[4] != BITPLANE_VERSION) { return BITPLANE_ERROR_HEADER; }
+    if (read_u16(&data[8]) != fb->width || read_u16(&data[10]) != fb->height) { return BITPLANE_ERROR_HEADER; }
+    if (read_u32(&data[12]) > length - BITPLANE_HEADER_SIZE) { return BITPLANE_ERROR_TRUNCATED; }
+
+    // all or nothing: never start a sequence that can't be queued completely
+    if (running || exposure_queue_free() < data[5]) { return BITPLANE_ERROR_BUSY; }
+    int status = process(data, fb, false);
+    if (status != BITPLANE_OK) { return status; }
+
+    running = true;
+    staging_locked = true;  // the deltas are read from the staging area while exposing
+    return process(data, fb, true);
+}
+
+void bitplane_poll(void) {
+    if (running && !exposure_busy()) {
+        running = false;
+        staging_locked = false;
+    }
+}
+
+bool bitplane_busy(void) {
+    return running;
+}
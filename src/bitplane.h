@@ -0,0 +1,65 @@
+/**
+ * Bit-plane sequenced grayscale ("DLPB")
+ *
+ * More gray levels than the framebuffer holds: an 8-bit target image is split into binary
+ * bit-planes on the host (utils/bitplane_encoder.py), which are shown one after the other,
+ * each exposed for a dose proportional to its weight. The weight of a plane is given by its
+ * exposure time and LED PWM, so a 1-bit framebuffer gives 6-8 bits of dose control.
+ *
+ * Every plane is either a DLPF frame (see frame_codec.h) or a DLPD delta (see delta.h) on top of
+ * the previous plane, whichever is smaller; the first one is always a frame, so the sequence
+ * does not depend on what was shown before. The planes are played back by the exposure
+ * scheduler (exposure.h): one entry per plane.
+ *
+ * Layout (all multi-byte values little-endian, the buffer must be 32-bit aligned):
+ *
+ *  header (16 bytes)
+ *    'D' 'L' 'P' 'B'   magic
+ *    u8  version       BITPLANE_VERSION
+ *    u8  planes
+ *    u16 reserved
+ *    u16 width, u16 height
+ *    u32 payload length (bytes following the header)
+ *
+ *  payload: one record per plane, in exposure order
+ *    u32 duration_us
+ *    u16 pwm           LED PWM (10 bit) during this plane
+ *    u8  kind          BITPLANE_FRAME or BITPLANE_DELTA
+ *    u8  reserved
+ *    u32 length
+ *    DLPF frame or DLPD delta, padded with zeros to a multiple of 4 bytes
+ */
+#ifndef BITPLANE_H
+#define BITPLANE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "framebuffer.h"
+
+#define BITPLANE_VERSION        1
+#define BITPLANE_HEADER_SIZE    16
+#define BITPLANE_RECORD_SIZE    12
+
+#define BITPLANE_FRAME          0x00
+#define BITPLANE_DELTA          0x01
+
+enum BitplaneStatus {
+    BITPLANE_OK = 0,
+    BITPLANE_ERROR_HEADER = -1,     // bad magic, version, alignment or size
+    BITPLANE_ERROR_TRUNCATED = -2,  // a record runs past the end of the payload
+    BITPLANE_ERROR_PLANE = -3,      // a plane's frame or delta does not fit the framebuffer
+    BITPLANE_ERROR_BUSY = -4,       // not enough room in the exposure queue, or a sequence is running
+};
+
+// check a sequence and queue all of its planes for exposure. <data> has to stay untouched
+// until bitplane_busy() returns false (the staging area is locked until then).
+int bitplane_queue(const uint8_t *data, uint32_t length, framebuffer_t *fb);
+
+// call from the main loop: ends the sequence and releases the staging area once its last
+// plane has been exposed
+void bitplane_poll(void);
+
+// true while the planes of a sequence are being exposed
+bool bitplane_busy(void);
+
+#endif
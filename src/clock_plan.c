@@ -0,0 +1,138 @@
+/**
+ * Clock plan (see clock_plan.h)
+ */
+#include <stdio.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/vreg.h"
+#include "clock_plan.h"
+#include "video_mode.h"
+
+const clock_limits_t clock_limits_build = {
+    .pclk_max_hz = DLP_PCLK_MAX_HZ,
+    .sys_min_khz = DLP_SYS_CLOCK_KHZ,
+    .sys_max_khz = DLP_SYS_CLOCK_KHZ ? DLP_SYS_CLOCK_KHZ : DLP_SYS_CLOCK_MAX_KHZ,
+    .frame_rate_max = DLP_FRAME_RATE_MAX,
+};
+
+static clock_plan_t current;
+
+// core voltage for <sys_khz>: the default up to the rated clock, and what overclocked RP2040s
+// are commonly run at above it
+static uint16_t vreg_mv_for(uint32_t sys_khz) {
+    if (sys_khz <= CLOCK_PLAN_STOCK_KHZ) { return 1100; }
+    return sys_khz <= 200000 ? 1150 : 1200;
+}
+
+// the frame timing of <plan> for a PCLK of <sm_hz_256> / <div> (both in 1/256ths): the front
+// porch is stretched until the frame rate is within <frame_rate_max>
+static void plan_lines(clock_plan_t *plan, uint64_t sm_hz_256, uint32_t div, uint32_t frame_rate_max) {
+    plan->h_counter = VIDEO_H_COUNTER;
+    if (frame_rate_max) {
+        // shortest line that keeps the frame rate at or under the limit
+        uint64_t per_frame = (uint64_t)div * frame_rate_max * VIDEO_FRAME_LINES;
+        uint64_t line_pclk = (sm_hz_256 + per_frame - 1) / per_frame;
+        if (line_pclk > VIDEO_LINE_PCLK(VIDEO_H_COUNTER)) {
+            plan->h_counter = line_pclk - 1 - VIDEO_H_BLANK;
+        }
+    }
+    plan->line_pclk = VIDEO_LINE_PCLK(plan->h_counter);
+    plan->frame_mhz = sm_hz_256 * 1000 / ((uint64_t)div * plan->line_pclk * VIDEO_FRAME_LINES);
+}
+
+bool clock_plan_make(clock_plan_t *plan, const clock_limits_t *limits) {
+    // a pinned system clock leaves the divider as the only thing to tune
+    bool pinned = limits->sys_min_khz == limits->sys_max_khz;
+    bool found = false;
+    uint32_t best_div = 0;
+    uint64_t best_sm_hz_256 = 0;
+
+    // every setting of the PLL (reference divider 1) with a whole kHz output
+    for (uint fbdiv = CLOCK_PLAN_FBDIV_MIN; fbdiv <= CLOCK_PLAN_FBDIV_MAX; fbdiv++) {
+        uint32_t vco_khz = CLOCK_PLAN_XOSC_KHZ * fbdiv;
+        if (vco_khz < CLOCK_PLAN_VCO_MIN_KHZ || vco_khz > CLOCK_PLAN_VCO_MAX_KHZ) { continue; }
+
+        for (uint postdiv1 = 1; postdiv1 <= CLOCK_PLAN_POSTDIV_MAX; postdiv1++) {
+            for (uint postdiv2 = 1; postdiv2 <= postdiv1; postdiv2++) {
+                if (vco_khz % (postdiv1 * postdiv2)) { continue; }
+                uint32_t sys_khz = vco_khz / (postdiv1 * postdiv2);
+                if (sys_khz < limits->sys_min_khz || sys_khz > limits->sys_max_khz) { continue; }
+
+                // pxl and pxl_clk clock at divider 1, in 1/256 Hz; the divider is rounded up
+                // so that PCLK stays within the limit
+                uint64_t sm_hz_256 = (uint64_t)sys_khz * 1000 * 256 / VIDEO_PCLK_DIV;
+                uint64_t div = (sm_hz_256 + limits->pclk_max_hz - 1) / limits->pclk_max_hz;
+                if (!pinned) {
+                    div = (div + 255) & ~255ull;
+                }
+                div = MAX(div, 256);
+                if (div > (0xFFFFull << 8) / VIDEO_PCLK_DIV) { continue; }  // hsync's divider must fit too
+                uint32_t pclk_hz = sm_hz_256 / div;
+
+                // the highest PCLK; at the same PCLK the fastest system clock, and the fastest
+                // VCO of that (the least jitter)
+                if (found && (pclk_hz < plan->pclk_hz ||
+                              (pclk_hz == plan->pclk_hz && (sys_khz < plan->sys_khz ||
+                               (sys_khz == plan->sys_khz && vco_khz <= plan->vco_khz))))) {
+                    continue;
+                }
+                found = true;
+                plan->sys_khz = sys_khz;
+                plan->vco_khz = vco_khz;
+                plan->postdiv1 = postdiv1;
+                plan->postdiv2 = postdiv2;
+                plan->vreg_mv = vreg_mv_for(sys_khz);
+                plan->div_int = div >> 8;
+                plan->div_frac = div & 0xFF;
+                plan->pclk_hz = pclk_hz;
+                best_div = div;
+                best_sm_hz_256 = sm_hz_256;
+            }
+        }
+    }
+
+    if (found) {
+        plan_lines(plan, best_sm_hz_256, best_div, limits->frame_rate_max);
+    }
+    return found;
+}
+
+void clock_plan_sm_div(const clock_plan_t *plan, uint cycles, uint16_t *div_int, uint8_t *div_frac) {
+    uint32_t div = (((uint32_t)plan->div_int << 8) | plan->div_frac) * VIDEO_PCLK_DIV / cycles;
+    *div_int = div >> 8;
+    *div_frac = div & 0xFF;
+}
+
+const clock_plan_t *clock_plan_init(void) {
+    if (!clock_plan_make(&current, &clock_limits_build)) {
+        // nothing the PLL can make fits the build limits: plan around the clock we booted with
+        clock_limits_t limits = clock_limits_build;
+        limits.sys_min_khz = limits.sys_max_khz = clock_get_hz(clk_sys) / 1000;
+        clock_plan_make(&current, &limits);
+    }
+
+    if (current.vreg_mv > 1100) {
+        vreg_set_voltage(current.vreg_mv > 1150 ? VREG_VOLTAGE_1_20 : VREG_VOLTAGE_1_15);
+        sleep_us(1000);  // let the regulator settle before the clock goes up
+    }
+    // clk_peri follows clk_sys (the SDK moves it along), USB keeps its own PLL
+    set_sys_clock_pll(current.vco_khz * 1000, current.postdiv1, current.postdiv2);
+    return &current;
+}
+
+const clock_plan_t *clock_plan_current(void) {
+    return &current;
+}
+
+void clock_plan_report(const clock_plan_t *plan) {
+    printf("Clock plan: sys %" PRIu32 ".%03" PRIu32 " MHz (VCO %" PRIu32 " MHz / %u / %u, %u.%02u V), "
+           "video divider %u + %u/256\n",
+           plan->sys_khz / 1000, plan->sys_khz % 1000, plan->vco_khz / 1000, plan->postdiv1, plan->postdiv2,
+           plan->vreg_mv / 1000, plan->vreg_mv % 1000 / 10, plan->div_int, plan->div_frac);
+    printf("  PCLK %" PRIu32 ".%03" PRIu32 " MHz%s, line %" PRIu32 " PCLK (front porch +%" PRIu32 "), %u lines: "
+           "%" PRIu32 ".%02" PRIu32 " frames/s\n",
+           plan->pclk_hz / 1000000, plan->pclk_hz / 1000 % 1000,
+           plan->div_frac ? " (average: fractional divider)" : "", plan->line_pclk,
+           plan->h_counter - VIDEO_H_COUNTER, VIDEO_FRAME_LINES, plan->frame_mhz / 1000, plan->frame_mhz % 1000 / 10);
+}
@@ -0,0 +1,91 @@
+/**
+ * Clock plan: the system clock and video state machine dividers behind the pixel clock
+ *
+ * PCLK is the system clock divided by VIDEO_PCLK_DIV (the sys cycles per PCLK period of the
+ * video programs, see video_mode.h) and by the clock divider of the video state machines. At
+ * the stock 125 MHz that is 31.25 MHz and a 32.5 Hz frame rate, which the DMD shows with
+ * visible flicker. The plan picks the system clock out of what the PLL can make from the
+ * 12 MHz crystal, up to DLP_SYS_CLOCK_MAX_KHZ (above 133 MHz the core voltage is raised), and
+ * the divider, so that PCLK comes as close to DLP_PCLK_MAX_HZ as it can without going over.
+ * The state machine dividers stay whole numbers then: a fractional divider stretches every
+ * few PCLK periods by a sys cycle. Only when the system clock is pinned (DLP_SYS_CLOCK_KHZ)
+ * and nothing else can be tuned is a fractional divider used.
+ *
+ * If that gives more PCLK than DLP_FRAME_RATE_MAX needs, the hsync front porch is lengthened
+ * until the frame rate lands on it rather than above it: the counter that hsync.pio is
+ * started with comes from the plan, not from VIDEO_H_COUNTER.
+ *
+ * Everything but clock_plan_init() is arithmetic; the host build checks the plans for a
+ * range of limits (src/host/clock_check.c).
+ */
+#ifndef CLOCK_PLAN_H
+#define CLOCK_PLAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+
+// build settings (CMakeLists.txt)
+#ifndef DLP_PCLK_MAX_HZ
+#define DLP_PCLK_MAX_HZ         150000000   // the DLPC1438 parallel port's PCLK limit
+#endif
+#ifndef DLP_SYS_CLOCK_MAX_KHZ
+#define DLP_SYS_CLOCK_MAX_KHZ   200000      // highest system clock the plan may pick
+#endif
+#ifndef DLP_SYS_CLOCK_KHZ
+#define DLP_SYS_CLOCK_KHZ       0           // pin the system clock to this (0: leave it to the plan)
+#endif
+#ifndef DLP_FRAME_RATE_MAX
+#define DLP_FRAME_RATE_MAX      60          // Hz, 0 for no limit
+#endif
+
+// RP2040 datasheet, 2.18 (PLL): VCO 750-1600 MHz, feedback divider 16-320, post dividers 1-7
+#define CLOCK_PLAN_XOSC_KHZ      12000
+#define CLOCK_PLAN_VCO_MIN_KHZ   750000
+#define CLOCK_PLAN_VCO_MAX_KHZ   1600000
+#define CLOCK_PLAN_FBDIV_MIN     16
+#define CLOCK_PLAN_FBDIV_MAX     320
+#define CLOCK_PLAN_POSTDIV_MAX   7
+#define CLOCK_PLAN_STOCK_KHZ     133000     // the RP2040's rated clock at the default 1.10 V
+
+typedef struct {
+    uint32_t pclk_max_hz;
+    uint32_t sys_min_khz;      // sys_min_khz == sys_max_khz: a pinned system clock
+    uint32_t sys_max_khz;
+    uint32_t frame_rate_max;   // Hz, 0 for no limit
+} clock_limits_t;
+
+typedef struct {
+    uint32_t sys_khz;
+    uint32_t vco_khz;          // sys_khz = vco_khz / postdiv1 / postdiv2
+    uint8_t postdiv1;
+    uint8_t postdiv2;
+    uint16_t vreg_mv;          // core voltage
+    uint16_t div_int;          // clock divider of pxl and pxl_clk: div_int + div_frac / 256
+    uint8_t div_frac;          // (hsync and vsync get VIDEO_PCLK_DIV times that)
+    uint32_t pclk_hz;          // the average, with a fractional divider
+    uint32_t h_counter;        // what hsync.pio is started with, >= VIDEO_H_COUNTER
+    uint32_t line_pclk;        // PCLK periods per line
+    uint32_t frame_mhz;        // frame rate in mHz
+} clock_plan_t;
+
+// the limits from the build settings
+extern const clock_limits_t clock_limits_build;
+
+// the plan with the highest PCLK within <limits>; false if there is none
+bool clock_plan_make(clock_plan_t *plan, const clock_limits_t *limits);
+
+// the clock divider for a video state machine that takes <cycles> of its own cycles per PCLK
+// period (pxl, pxl_clk: VIDEO_PCLK_DIV; hsync, vsync: 1)
+void clock_plan_sm_div(const clock_plan_t *plan, uint cycles, uint16_t *div_int, uint8_t *div_frac);
+
+// plan with the build limits and switch the system clock over to it; before anything that
+// depends on clk_sys or clk_peri (stdio, I2C, timings) is set up
+const clock_plan_t *clock_plan_init(void);
+
+// the plan clock_plan_init() applied
+const clock_plan_t *clock_plan_current(void);
+
+void clock_plan_report(const clock_plan_t *plan);
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * Delta updates for successive exposure layers (see delta.h for the wire format)
+ */
+#include "pico/stdlib.h"
+#include "delta.h"
+#include "scanout.h"
+
+delta_stats_t delta_stats;
+
+// the delta waiting for the next frame end
+static const uint8_t *volatile queued_data;
+static uint32_t queued_length;
+static framebuffer_t *queued_fb;
+static volatile int last_status = DELTA_OK;
+
+static inline uint16_t read_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t read_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int check_header(const uint8_t *data, uint32_t length, const framebuffer_t *fb) {
+    if (length < DELTA_HEADER_SIZE || ((uintptr_t)data & 3)) { return DELTA_ERROR_HEADER; }
+    if (data[0] != 'D' || data[1] != 'L' || data[2] != 'P' || data[3] != 'D') { return DELTA_ERROR_HEADER; }
+    if (data[4] != DELTA_VERSION) { return DELTA_ERROR_HEADER; }
+    if (read_u32(&data[12]) > length - DELTA_HEADER_SIZE) { return DELTA_ERROR_TRUNCATED; }
+    if (data[5] != fb->bpp || read_u16(&data[8]) != fb->width || read_u16(&data[10]) != fb->height) {
+        return DELTA_ERROR_SIZE;
+    }
+    return DELTA_OK;
+}
+
+// walk over all records; only writes to fb if <write> is set
+static int process(const uint8_t *data, framebuffer_t *fb, bool write, bool race_beam) {
+    const uint8_t *pos = data + DELTA_HEADER_SIZE;
+    const uint8_t *end = pos + read_u32(&data[12]);
+
+    while (pos < end) {
+        if (end - pos < DELTA_RECORD_SIZE) { return DELTA_ERROR_TRUNCATED; }
+
+        uint8_t type = pos[0];
+        uint8_t value = pos[1];
+        uint16_t y = read_u16(&pos[2]);
+        uint16_t x = read_u16(&pos[4]);
+        uint16_t count = read_u16(&pos[6]);
+        pos += DELTA_RECORD_SIZE;
+
+        if (y >= fb->height || x >= fb->width || count > fb->width - x) { return DELTA_ERROR_SIZE; }
+
+        uint32_t data_bytes = 0;
+        if (type == DELTA_SPAN_DATA) {
+            data_bytes = (((uint32_t)count * fb->bpp + 31) / 32) * 4;
+            if ((uint32_t)(end - pos) < data_bytes) { return DELTA_ERROR_TRUNCATED; }
+        } else if (type != DELTA_SPAN_FILL) {
+            return DELTA_ERROR_CORRUPT;
+        }
+
+        if (write) {
+            // the beam has already fetched this row; it will only show up in the frame after
+            if (race_beam && scanout_beam_line() > y) {
+                delta_stats.late_spans++;
+            }
+
+            if (type == DELTA_SPAN_DATA) {
+                fb_copy_bits(fb_row(fb, y), (uint32_t)x * fb->bpp, (const uint32_t *)pos, 0,
+                             (uint32_t)count * fb->bpp);
+            } else {
+                fb_fill_span(fb, x, x + count, y, value);
+            }
+            delta_stats.spans++;
+            delta_stats.pixels += count;
+        }
+        pos += data_bytes;
+    }
+    return DELTA_OK;
+}
+
+int delta_validate(const uint8_t *data, uint32_t length, const framebuffer_t *fb) {
+    int status = check_header(data, length, fb);
+    if (status != DELTA_OK) { return status; }
+    return process(data, (framebuffer_t *)fb, false, false);  // read only
+}
+
+static int apply(const uint8_t *data, uint32_t length, framebuffer_t *fb, bool race_beam) {
+    // validate first, so a corrupt delta never leaves a half updated layer behind
+    int status = delta_validate(data, length, fb);
+    if (status != DELTA_OK) { return status; }
+
+    uint64_t begin_time = time_us_64();
+    process(data, fb, true, race_beam);
+    delta_stats.last_apply_us = time_us_64() - begin_time;
+    delta_stats.applied++;
+    return DELTA_OK;
+}
+
+int delta_apply(const uint8_t *data, uint32_t length, framebuffer_t *fb) {
+    return apply(data, length, fb, false);
+}
+
+int delta_queue(const uint8_t *data, uint32_t length, framebuffer_t *fb) {
+    if (queued_data) { return DELTA_ERROR_BUSY; }
+
+    // catch errors now rather than in the interrupt
+    int status = delta_validate(data, length, fb);
+    if (status != DELTA_OK) { return status; }
+
+    queued_length = length;
+    queued_fb = fb;
+    queued_data = data;  // publish last; delta_frame_end() may run at any moment
+    return DELTA_OK;
+}
+
+bool delta_pending(void) {
+    return queued_data != NULL;
+}
+
+int delta_last_status(void) {
+    return last_status;
+}
+
+void delta_frame_end(void) {
+    const uint8_t *data = queued_data;
+    if (!data) { return; }
+
+    // the DMA has just restarted at the top of the frame and spans are sorted by row, so
+    // applying them now keeps us ahead of the beam and the whole delta lands in one frame
+    last_status = apply(data, queued_length, queued_fb, true);
+    queued_data = NULL;
+}
@@ -0,0 +1,73 @@
+/**
+ * Delta updates ("DLPD") for successive exposure layers
+ *
+ * Only the row spans that changed between two layers are sent. A delta can be applied right
+ * away, or queued so that it is applied at the end of the next frame (from the scan-out
+ * interrupt), which avoids showing half of the old and half of the new layer.
+ * The host side encoder lives in utils/delta_encoder.py.
+ *
+ * Layout (all multi-byte values little-endian, the buffer must be 32-bit aligned):
+ *
+ *  header (16 bytes)
+ *    'D' 'L' 'P' 'D'   magic
+ *    u8  version       DELTA_VERSION
+ *    u8  bpp
+ *    u16 reserved
+ *    u16 width, u16 height
+ *    u32 payload length (bytes following the header)
+ *
+ *  payload: span records, sorted by row
+ *    u8  type          DELTA_SPAN_DATA or DELTA_SPAN_FILL
+ *    u8  value         fill value (DELTA_SPAN_FILL only)
+ *    u16 y, u16 x, u16 count (pixels)
+ *    DELTA_SPAN_DATA only: ceil(count * bpp / 8) packed bytes starting at pixel x, padded
+ *    with zeros to a multiple of 4 bytes so that the next record stays word aligned
+ */
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "framebuffer.h"
+
+#define DELTA_VERSION       1
+#define DELTA_HEADER_SIZE   16
+#define DELTA_RECORD_SIZE   8
+
+#define DELTA_SPAN_DATA     0x00
+#define DELTA_SPAN_FILL     0x01
+
+enum DeltaStatus {
+    DELTA_OK = 0,
+    DELTA_ERROR_HEADER = -1,      // bad magic, version or alignment
+    DELTA_ERROR_TRUNCATED = -2,   // a record runs past the end of the payload
+    DELTA_ERROR_CORRUPT = -3,     // unknown record type
+    DELTA_ERROR_SIZE = -4,        // delta does not match the framebuffer / span out of bounds
+    DELTA_ERROR_BUSY = -5,        // a queued delta has not been applied yet
+};
+
+typedef struct {
+    uint32_t applied;       // deltas applied
+    uint32_t spans;         // spans written
+    uint32_t pixels;        // pixels written
+    uint32_t late_spans;    // spans written after the beam had already passed their row
+    uint32_t last_apply_us; // duration of the most recent apply
+} delta_stats_t;
+
+extern delta_stats_t delta_stats;
+
+// check the header and every record without touching the framebuffer
+int delta_validate(const uint8_t *data, uint32_t length, const framebuffer_t *fb);
+
+// apply a delta right away
+int delta_apply(const uint8_t *data, uint32_t length, framebuffer_t *fb);
+
+// queue a delta to be applied at the end of the next frame. The data must stay valid until
+// delta_pending() returns false. Needs delta_frame_end() to be called at every frame end
+// (e.g. as the scan-out frame callback).
+int delta_queue(const uint8_t *data, uint32_t length, framebuffer_t *fb);
+bool delta_pending(void);
+int delta_last_status(void);
+void delta_frame_end(void);
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ * Event driven DLPC1438 bring-up (see dlpc_bringup.h)
+ */
+#include <stdio.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "dlpc_bringup.h"
+#include "dlpc_regs.h"
+#include "i2c_queue.h"
+
+static const char *const phase_names[] = {"off", "booting", "configuring", "ready", "failed"};
+
+static bringup_phase_t phase;
+static void (*configure_dlpc)(void);
+static uint host_irq;
+
+static uint64_t start_us;                    // PROJ_ON
+static uint64_t phase_us[BRINGUP_FAILED + 1]; // since PROJ_ON, when each phase was entered
+
+static struct {
+    const char *name;
+    uint64_t at_us;
+} marks[BRINGUP_MAX_MARKS];
+static uint mark_count;
+
+// status read in flight: a probe while booting, the end of the setup commands when configuring
+static i2c_handle_t status_read;
+static uint8_t status[2];                    // see i2c_read(): the first byte is not the status
+static uint64_t next_probe_us;
+static uint32_t backoff_us;
+static uint32_t probes;
+static uint32_t errors_before_setup;         // i2c_queue_stats.errors before the setup commands
+static uint32_t setup_errors;                // setup commands (or the status read) not acknowledged
+static bool host_irq_high;
+static bool host_irq_seen;                   // saw HOST_IRQ fall
+
+static void enter(bringup_phase_t next) {
+    phase = next;
+    phase_us[next] = time_us_64() - start_us;
+}
+
+void bringup_start(uint proj_on_gpio, uint host_irq_gpio, void (*configure)(void)) {
+    host_irq = host_irq_gpio;
+    configure_dlpc = configure;
+    gpio_init(host_irq);
+    gpio_set_dir(host_irq, GPIO_IN);
+    host_irq_high = gpio_get(host_irq);
+
+    // to signal to the DLPC1438 that we want to start up, we must set PROJ_ON high
+    gpio_init(proj_on_gpio);
+    gpio_set_dir(proj_on_gpio, GPIO_OUT);
+    gpio_put(proj_on_gpio, 1);
+    dlpc_shadow_invalidate();  // the DLPC starts from its defaults
+
+    start_us = time_us_64();
+    next_probe_us = start_us;
+    backoff_us = BRINGUP_BACKOFF_MIN_US;
+    enter(BRINGUP_BOOTING);
+}
+
+static void poll_booting(uint64_t now) {
+    if (now - start_us > BRINGUP_TIMEOUT_US) {
+        enter(BRINGUP_FAILED);  // also if a probe never finishes (bus stuck)
+        return;
+    }
+
+    // HOST_IRQ is pulled low by the DLPC once it is done; probe right away when we see that
+    bool high = gpio_get(host_irq);
+    if (host_irq_high && !high && !host_irq_seen) {
+        host_irq_seen = true;
+        next_probe_us = now;
+    }
+    host_irq_high = high;
+
+    if (status_read) {
+        int result = i2c_queue_status(status_read);
+        if (result == I2C_QUEUE_PENDING) { return; }
+        status_read = 0;
+        if (result == I2C_QUEUE_OK) {
+            enter(BRINGUP_CONFIGURING);
+            errors_before_setup = i2c_queue_stats.errors;  // nothing else is on the bus yet
+            configure_dlpc();
+            status_read = i2c_queue_read(BRINGUP_STATUS_REG, status, sizeof(status));  // after the setup
+            return;
+        }
+        // not answering yet: try again later, a little later every time
+        next_probe_us = now + (host_irq_seen ? BRINGUP_BACKOFF_MIN_US : backoff_us);
+        backoff_us = MIN(backoff_us * 2, BRINGUP_BACKOFF_MAX_US);
+    }
+
+    if (now >= next_probe_us) {
+        status_read = i2c_queue_read(BRINGUP_STATUS_REG, status, sizeof(status));
+        probes++;
+    }
+}
+
+bool bringup_poll(void) {
+    uint64_t now = time_us_64();
+
+    switch (phase) {
+        case BRINGUP_BOOTING:
+            poll_booting(now);
+            break;
+        case BRINGUP_CONFIGURING: {
+            int result = i2c_queue_status(status_read);
+            if (result != I2C_QUEUE_PENDING) {
+                // every setup command is on the bus by now; any NAK among them fails the bring-up
+                status_read = 0;
+                setup_errors = i2c_queue_stats.errors - errors_before_setup;
+                enter(result == I2C_QUEUE_OK && !setup_errors ? BRINGUP_READY : BRINGUP_FAILED);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return phase == BRINGUP_READY || phase == BRINGUP_FAILED;
+}
+
+bringup_phase_t bringup_phase(void) {
+    return phase;
+}
+
+void bringup_mark(const char *name) {
+    if (mark_count < BRINGUP_MAX_MARKS) {
+        marks[mark_count].name = name;
+        marks[mark_count].at_us = time_us_64() - start_us;
+        mark_count++;
+    }
+}
+
+void bringup_report(void) {
+    printf("DLPC bring-up %s: PROJ_ON %" PRIu64 " us after reset, %" PRIu32 " probes, HOST_IRQ %s, "
+           "short status 0x%02x, %" PRIu32 " setup errors\n", phase_names[phase], start_us, probes,
+           host_irq_seen ? "seen" : "not seen", status[1], setup_errors);
+    for (uint p = BRINGUP_BOOTING; p <= BRINGUP_FAILED; p++) {
+        if (phase_us[p] || p == BRINGUP_BOOTING) {
+            printf("  %8" PRIu64 " us  %s\n", phase_us[p], phase_names[p]);
+        }
+    }
+    for (uint i = 0; i < mark_count; i++) {
+        printf("  %8" PRIu64 " us  %s\n", marks[i].at_us, marks[i].name);
+    }
+}
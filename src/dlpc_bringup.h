@@ -0,0 +1,56 @@
+/**
+ * Event driven DLPC1438 bring-up
+ *
+ * Raising PROJ_ON starts the DLPC's own boot (~0.5-0.7 s). Instead of sleeping through it,
+ * bringup_start() raises PROJ_ON as early as possible and bringup_poll() is called from the main
+ * loop while the rest of the firmware (PIO, DMA, links) is set up and running:
+ *
+ *  - booting: the DLPC is probed over the I2C command queue with a Read Short Status (0xD0)
+ *    command. It doesn't answer while it boots, so failed probes are retried with an
+ *    exponential backoff (BRINGUP_BACKOFF_MIN_US to BRINGUP_BACKOFF_MAX_US). HOST_IRQ going low
+ *    (the DLPC's "boot done") triggers a probe straight away, but it is only 1.8 V and may not be
+ *    seen at all, so the probes never rely on it.
+ *  - configuring: the configure callback queues the setup commands; a status read queued after
+ *    them completes once they are all on the bus (the queue keeps the order).
+ *  - ready, or failed when the DLPC didn't answer within BRINGUP_TIMEOUT_US or a setup command
+ *    was not acknowledged.
+ *
+ * Every phase change is time stamped (from PROJ_ON), and so is any milestone marked with
+ * bringup_mark(); bringup_report() prints them.
+ */
+#ifndef DLPC_BRINGUP_H
+#define DLPC_BRINGUP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/types.h"
+
+#define BRINGUP_STATUS_REG      0xD0       // Read Short Status
+#define BRINGUP_TIMEOUT_US      3000000    // PROJ_ON until the DLPC has to answer
+#define BRINGUP_BACKOFF_MIN_US  5000       // between failed probes, doubling up to the max
+#define BRINGUP_BACKOFF_MAX_US  80000
+#define BRINGUP_MAX_MARKS       8
+
+typedef enum {
+    BRINGUP_OFF,
+    BRINGUP_BOOTING,
+    BRINGUP_CONFIGURING,
+    BRINGUP_READY,
+    BRINGUP_FAILED,
+} bringup_phase_t;
+
+// raise PROJ_ON (<proj_on_gpio>) and start waiting for the DLPC; <configure> queues the setup
+// commands once it answers. Needs the I2C command queue to be running.
+void bringup_start(uint proj_on_gpio, uint host_irq_gpio, void (*configure)(void));
+
+// advance the bring-up; never blocks. Returns true once it is over (ready or failed).
+bool bringup_poll(void);
+
+bringup_phase_t bringup_phase(void);
+
+// time stamp a milestone of the rest of the start-up for the report; <name> must stay valid
+void bringup_mark(const char *name);
+
+void bringup_report(void);
+
+#endif
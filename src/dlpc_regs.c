@@ -0,0 +1,103 @@
+/**
+ * Shadow copy of the DLPC1438 configuration registers (see dlpc_regs.h)
+ */
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "dlpc_regs.h"
+#include "i2c_queue.h"
+
+typedef struct {
+    uint8_t write_reg;
+    uint8_t read_reg;
+    uint8_t length;
+    bool valid;
+    uint8_t value[I2C_QUEUE_MAX_DATA];
+} shadow_t;
+
+dlpc_regs_stats_t dlpc_regs_stats;
+
+static bool verify;
+
+static shadow_t shadows[] = {
+    {0x05, 0x06, 1},   // operating mode
+    {0xA8, 0xA9, 2},   // gamma, LED select
+    {0x54, 0x55, 6},   // LED PWM (3x 16 bit)
+    {0x14, 0x15, 1},   // image orientation
+    {0x0B, 0x0C, 6},   // test pattern select and parameters
+    {0x16, 0x17, 1},   // display image curtain
+};
+
+static shadow_t *find_shadow(uint8_t reg, uint8_t length) {
+    for (uint i = 0; i < count_of(shadows); i++) {
+        if (shadows[i].write_reg == reg && shadows[i].length == length) {
+            return &shadows[i];
+        }
+    }
+    return NULL;
+}
+
+// read the register back and compare; on a mismatch the shadow is dropped. Like i2c_read(),
+// the DLPC answers with a byte that is not part of the value first, so one more is read.
+static int verify_write(shadow_t *shadow) {
+    uint8_t read_back[I2C_QUEUE_MAX_DATA + 1];
+
+    dlpc_regs_stats.verify_reads++;
+    if (i2c_queue_wait(i2c_queue_read(shadow->read_reg, read_back, shadow->length + 1)) != I2C_QUEUE_OK ||
+            memcmp(&read_back[1], shadow->value, shadow->length) != 0) {
+        dlpc_regs_stats.verify_failures++;
+        shadow->valid = false;
+        printf("DLPC register 0x%02x did not read back as written\n", shadow->write_reg);
+        return DLPC_WRITE_ERROR_VERIFY;
+    }
+    return DLPC_WRITE_QUEUED;
+}
+
+int dlpc_write(uint8_t reg, const uint8_t *data, uint8_t length) {
+    i2c_handle_t handle;
+    return dlpc_write_handle(reg, data, length, &handle);
+}
+
+int dlpc_write_handle(uint8_t reg, const uint8_t *data, uint8_t length, i2c_handle_t *handle) {
+    shadow_t *shadow = find_shadow(reg, length);
+    dlpc_regs_stats.writes++;
+    *handle = 0;
+
+    if (shadow && shadow->valid && memcmp(shadow->value, data, length) == 0) {
+        dlpc_regs_stats.skipped_writes++;
+        return DLPC_WRITE_SKIPPED;
+    }
+    if (!(*handle = i2c_queue_write(reg, data, length))) {
+        if (shadow) { shadow->valid = false; }  // no idea what the DLPC holds now
+        return DLPC_WRITE_ERROR_QUEUE;
+    }
+    if (!shadow) {
+        return DLPC_WRITE_QUEUED;
+    }
+
+    memcpy(shadow->value, data, length);
+    shadow->valid = true;
+    if (!verify) {
+        dlpc_regs_stats.skipped_reads++;
+        return DLPC_WRITE_QUEUED;
+    }
+    return verify_write(shadow);
+}
+
+void dlpc_set_verify(bool enable) {
+    verify = enable;
+}
+
+void dlpc_shadow_invalidate(void) {
+    for (uint i = 0; i < count_of(shadows); i++) {
+        shadows[i].valid = false;
+    }
+}
+
+void dlpc_regs_report(void) {
+    printf("DLPC registers: %" PRIu32 " writes, %" PRIu32 " I2C transactions avoided (%" PRIu32 " unchanged writes, "
+           "%" PRIu32 " read-backs), %" PRIu32 "/%" PRIu32 " verify failures\n", dlpc_regs_stats.writes,
+           dlpc_regs_stats.skipped_writes + dlpc_regs_stats.skipped_reads, dlpc_regs_stats.skipped_writes,
+           dlpc_regs_stats.skipped_reads, dlpc_regs_stats.verify_failures, dlpc_regs_stats.verify_reads);
+}
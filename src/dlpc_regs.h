@@ -0,0 +1,55 @@
+/**
+ * Shadow copy of the DLPC1438 configuration registers
+ *
+ * The DLPC1438 has separate write and read commands for each setting (write 0x05, read 0x06
+ * for the mode, 0xA8/0xA9 gamma and LED select, 0x54/0x55 LED PWM, 0x14/0x15 orientation,
+ * 0x0B/0x0C test pattern, 0x16/0x17 curtain). dlpc_write() remembers the last value written to
+ * each of these and drops writes that wouldn't change anything. Reading the value back after
+ * every write is off by default; with dlpc_set_verify(true) each write is followed by a
+ * (blocking) read of its read command and compared.
+ *
+ * Other registers (e.g. 0xC1 External Print Control, which is an action rather than a
+ * setting) pass straight through. All writes to the shadowed registers must go through
+ * dlpc_write(), and the shadow must be invalidated whenever the DLPC restarts.
+ */
+#ifndef DLPC_REGS_H
+#define DLPC_REGS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "i2c_queue.h"
+
+enum DlpcWriteStatus {
+    DLPC_WRITE_QUEUED = 0,
+    DLPC_WRITE_SKIPPED = 1,         // same value as last written
+    DLPC_WRITE_ERROR_QUEUE = -1,    // I2C queue full or too long
+    DLPC_WRITE_ERROR_VERIFY = -2,   // read back differs (verify mode only)
+};
+
+typedef struct {
+    uint32_t writes;             // dlpc_write() calls
+    uint32_t skipped_writes;     // transactions avoided: writes that changed nothing
+    uint32_t skipped_reads;      // transactions avoided: read-backs not done (verify off)
+    uint32_t verify_reads;
+    uint32_t verify_failures;
+} dlpc_regs_stats_t;
+
+extern dlpc_regs_stats_t dlpc_regs_stats;
+
+// queue a write of <length> bytes to <reg> (see i2c_queue.h), unless the shadow says the
+// register already holds exactly that. Thread context only when verifying.
+int dlpc_write(uint8_t reg, const uint8_t *data, uint8_t length);
+
+// dlpc_write(), and *handle is the queued command (0 if nothing was queued) for callers that
+// must know when the value is on the bus
+int dlpc_write_handle(uint8_t reg, const uint8_t *data, uint8_t length, i2c_handle_t *handle);
+
+// compare every shadowed write with what the DLPC reports back (blocks until read)
+void dlpc_set_verify(bool verify);
+
+// forget all shadowed values, e.g. after the DLPC has been (re)started
+void dlpc_shadow_invalidate(void);
+
+void dlpc_regs_report(void);
+
+#endif
@@ -0,0 +1,34 @@
+/**
+ * CRC-32 via the DMA sniffer (see dma_crc.h)
+ *
+ * One (claimed) DMA channel and the DMA sniffer
+ */
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "dma_crc.h"
+
+static int crc_chan = -1;
+
+// the channel reads the data into a dummy word while the sniffer watches
+uint32_t dma_crc32(const uint8_t *data, uint32_t count) {
+    static uint32_t sink;
+
+    if (crc_chan < 0) {
+        crc_chan = dma_claim_unused_channel(true);
+    }
+
+    dma_channel_config c = dma_channel_get_default_config(crc_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_sniff_enable(&c, true);
+
+    // bit reversed CRC-32 with reversed and inverted output is the standard (zlib) CRC-32
+    dma_sniffer_enable(crc_chan, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, true);
+    hw_set_bits(&dma_hw->sniff_ctrl, DMA_SNIFF_CTRL_OUT_REV_BITS | DMA_SNIFF_CTRL_OUT_INV_BITS);
+    dma_sniffer_set_data_accumulator(0xFFFFFFFF);
+
+    dma_channel_configure(crc_chan, &c, &sink, data, count, true);
+    dma_channel_wait_for_finish_blocking(crc_chan);
+    return dma_sniffer_get_data_accumulator();
+}
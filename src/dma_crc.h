@@ -0,0 +1,15 @@
+/**
+ * CRC-32 of data already in RAM, computed by the DMA sniffer
+ *
+ * Shared by the upload links (usb_link.h, spi_link.h). There is only one sniffer, so call it
+ * from thread context only, never from an interrupt handler.
+ */
+#ifndef DMA_CRC_H
+#define DMA_CRC_H
+
+#include <stdint.h>
+
+// standard (zlib) CRC-32; claims a DMA channel on first use
+uint32_t dma_crc32(const uint8_t *data, uint32_t count);
+
+#endif
@@ -0,0 +1,258 @@
+/**
+ * Exposure scheduler (see exposure.h)
+ *
+ * One hardware alarm; runs from the scan-out frame callback and the alarm interrupt.
+ */
+#include <stdio.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "hardware/timer.h"
+#include "exposure.h"
+#include "delta.h"
+#include "frame_codec.h"
+#include "i2c_queue.h"
+#include "dlpc_regs.h"
+#include "render_core.h"
+#include "scanout.h"
+
+// External Print Control (0xC1): control byte (0 START, 1 STOP), u16 dark frames, u16 exposed
+// frames. 0xFFFF exposed frames keeps the LED on until STOP; no dark frames so the LED comes
+// on with the frame the START lands in.
+#define PRINT_CONTROL 0xC1
+static const uint8_t print_start[] = {0x00, 0x00, 0x00, 0xFF, 0xFF};
+static const uint8_t print_stop[]  = {0x01, 0x00, 0x00, 0x00, 0x00};
+
+#define STOP_RETRY_US  50   // I2C queue full when the alarm fired: try again this much later
+
+enum ExposureState {
+    EXPOSURE_IDLE,
+    EXPOSURE_ARMED,      // light goes on at the next frame boundary (once the delta has landed)
+    EXPOSURE_EXPOSING,   // light is on, the alarm turns it off
+    EXPOSURE_STOPPING    // STOP is queued, the result is recorded once it is on the bus
+};
+
+exposure_stats_t exposure_stats;
+
+static framebuffer_t *frame;
+static uint alarm_num;
+
+static exposure_entry_t queue[EXPOSURE_QUEUE_LENGTH];
+static volatile uint32_t queue_head;   // next entry to run
+static volatile uint32_t queue_tail;   // next free slot
+static exposure_result_t results[EXPOSURE_QUEUE_LENGTH];
+
+static volatile uint8_t state;
+static exposure_entry_t current;
+static uint16_t frames_waited;
+static uint16_t dark_left;          // dark frames still to go before the START
+static uint64_t prepare_begin;
+static uint32_t prepare_us;
+static uint64_t last_stop_us;       // the previous STOP on the bus, for the gap before the next START
+static bool stopped_before;
+static i2c_handle_t pwm_handle;     // the last LED PWM write still to be waited for, 0 if none
+static bool pwm_issued;             // the PWM write of the entry at queue_head has been issued
+static i2c_handle_t start_handle;
+static i2c_handle_t stop_handle;
+static render_handle_t decode_handle;
+
+static void __not_in_flash_func(exposure_alarm)(uint alarm) {
+    stop_handle = i2c_queue_write(PRINT_CONTROL, print_stop, sizeof(print_stop));
+    if (!stop_handle) {
+        // the light must go off; the queue drains within milliseconds
+        hardware_alarm_set_target(alarm, make_timeout_time_us(STOP_RETRY_US));
+        return;
+    }
+    state = EXPOSURE_STOPPING;
+}
+
+void __not_in_flash_func(exposure_frame_end)(void) {
+    if (state != EXPOSURE_ARMED) {
+        return;
+    }
+    // the layer must be in place before the light goes on: the delta applied, the DMA on the new
+    // frame, and then shown with the light off for the dark frames
+    if (delta_pending() || (current.scanout && !scanout_showing(current.scanout))) {
+        frames_waited++;
+        return;
+    }
+    if (dark_left) {
+        dark_left--;
+        frames_waited++;
+        return;
+    }
+    // a START queued behind the PWM write would reach the bus ~0.6 ms late while the alarm
+    // below already runs, and the exposure would come out that much short
+    if (pwm_handle) {
+        int status = i2c_queue_status(pwm_handle);
+        if (status == I2C_QUEUE_PENDING) {
+            frames_waited++;
+            return;
+        }
+        if (status == I2C_QUEUE_ERROR_ABORT) {
+            exposure_stats.i2c_errors++;  // exposed at whatever the LED was set to before
+        }
+        pwm_handle = 0;
+    }
+    if (!(start_handle = i2c_queue_write(PRINT_CONTROL, print_start, sizeof(print_start)))) {
+        frames_waited++;
+        return;
+    }
+    state = EXPOSURE_EXPOSING;
+
+    // nothing is queued ahead of the START, so the STOP write (same length, queued by the
+    // alarm) takes as long to get onto the bus
+    if (hardware_alarm_set_target(alarm_num, make_timeout_time_us(current.duration_us))) {
+        exposure_alarm(alarm_num);  // already in the past (very short exposure)
+    }
+}
+
+// runs on core1 (see render_core.h)
+static int decode_entry_frame(void *ctx) {
+    const exposure_entry_t *entry = ctx;
+    return frame_decode(entry->frame, entry->frame_length, frame);
+}
+
+void exposure_init(framebuffer_t *fb) {
+    frame = fb;
+
+    alarm_num = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(alarm_num, exposure_alarm);
+
+    exposure_stats.min_error_us = INT32_MAX;
+    exposure_stats.max_error_us = INT32_MIN;
+}
+
+bool exposure_queue(const exposure_entry_t *entry) {
+    if (queue_tail - queue_head >= EXPOSURE_QUEUE_LENGTH) {
+        return false;
+    }
+    if (entry->delta && (!frame || delta_validate(entry->delta, entry->delta_length, frame) != DELTA_OK)) {
+        return false;
+    }
+    frame_decoder_t decoder;
+    if (entry->frame && (!frame || frame_decoder_init(&decoder, entry->frame, entry->frame_length) != FRAME_OK ||
+                         decoder.width != frame->width || decoder.bpp != frame->bpp ||
+                         decoder.height > frame->height)) {
+        return false;
+    }
+    queue[queue_tail % EXPOSURE_QUEUE_LENGTH] = *entry;
+    queue_tail++;
+    return true;
+}
+
+uint32_t exposure_queue_free(void) {
+    return EXPOSURE_QUEUE_LENGTH - (queue_tail - queue_head);
+}
+
+bool exposure_busy(void) {
+    return state != EXPOSURE_IDLE || queue_head != queue_tail;
+}
+
+// both writes are on the bus; record how long the light was on
+static void record_result(void) {
+    int start_status = i2c_queue_status(start_handle);
+    int stop_status = i2c_queue_status(stop_handle);
+    if (start_status != I2C_QUEUE_OK) { exposure_stats.i2c_errors++; }
+    if (stop_status != I2C_QUEUE_OK) { exposure_stats.i2c_errors++; }
+
+    exposure_result_t *result = &results[exposure_stats.completed % EXPOSURE_QUEUE_LENGTH];
+    result->requested_us = current.duration_us;
+    result->actual_us = i2c_queue_completed_us(stop_handle) - i2c_queue_completed_us(start_handle);
+    result->error_us = (int32_t)(result->actual_us - result->requested_us);
+    result->frames_waited = frames_waited;
+    result->prepare_us = prepare_us;
+    result->gap_us = stopped_before ? i2c_queue_completed_us(start_handle) - last_stop_us : 0;
+    last_stop_us = i2c_queue_completed_us(stop_handle);
+    stopped_before = true;
+
+    if (result->error_us < exposure_stats.min_error_us) { exposure_stats.min_error_us = result->error_us; }
+    if (result->error_us > exposure_stats.max_error_us) { exposure_stats.max_error_us = result->error_us; }
+    exposure_stats.completed++;
+    if (current.done) { current.done(current.ctx, result); }
+}
+
+void exposure_poll(void) {
+    if (state == EXPOSURE_STOPPING && i2c_queue_status(stop_handle) != I2C_QUEUE_PENDING) {
+        record_result();
+        state = EXPOSURE_IDLE;
+    }
+    if (state != EXPOSURE_IDLE || queue_head == queue_tail) {
+        return;
+    }
+    const exposure_entry_t *entry = &queue[queue_head % EXPOSURE_QUEUE_LENGTH];
+
+    // the previous layer's delta (e.g. from a USB upload) may still be waiting for its frame
+    if ((entry->delta || entry->frame) && delta_pending()) {
+        return;
+    }
+    if (entry->pwm && !pwm_issued) {
+        // LED 3 only (see set_illumination_PWM); skipped if unchanged. Issued once per entry,
+        // before anything else so a full I2C queue can be retried on the next poll; the START
+        // waits for it
+        uint8_t pwm[] = {0, 0, 0, 0, entry->pwm & 0xFF, entry->pwm >> 8};
+        i2c_handle_t handle;
+        if (dlpc_write_handle(0x54, pwm, sizeof(pwm), &handle) == DLPC_WRITE_ERROR_QUEUE) {
+            return;
+        }
+        if (handle) {
+            pwm_handle = handle;  // if skipped, an earlier write of the same value may still be pending
+        }
+        pwm_issued = true;
+    }
+    if (entry->frame) {
+        // decoded on core1, the links and the I2C queue keep running in the meantime
+        if (!decode_handle) {
+            prepare_begin = time_us_64();
+            decode_handle = render_submit(decode_entry_frame, NULL, (void *)entry);
+            return;
+        }
+        int status = render_status(decode_handle);
+        if (status == RENDER_PENDING) {
+            return;
+        }
+        decode_handle = 0;
+        if (status != FRAME_OK) {
+            exposure_stats.frame_errors++;  // the light is off; don't expose half a layer
+            exposure_entry_t skipped = *entry;
+            queue_head++;
+            pwm_issued = false;
+            if (skipped.done) { skipped.done(skipped.ctx, NULL); }
+            return;
+        }
+    }
+    if (entry->delta && delta_queue(entry->delta, entry->delta_length, frame) != DELTA_OK) {
+        return;
+    }
+
+    if (entry->scanout) {
+        scanout_set_framebuffer(entry->scanout);  // from the next frame on; the START waits for it
+    }
+
+    current = *entry;
+    queue_head++;
+    pwm_issued = false;
+    frames_waited = 0;
+    dark_left = entry->dark_frames;
+    prepare_us = entry->frame ? time_us_64() - prepare_begin : 0;
+    __compiler_memory_barrier();  // entry in place before the interrupt can see it armed
+    state = EXPOSURE_ARMED;  // picked up by the next frame end
+}
+
+void exposure_report(void) {
+    uint32_t completed = exposure_stats.completed;
+    uint32_t first = completed > EXPOSURE_QUEUE_LENGTH ? completed - EXPOSURE_QUEUE_LENGTH : 0;
+
+    printf("Exposures: %" PRIu32 " completed, %" PRIu32 " I2C errors, %" PRIu32 " bad frames\n", completed,
+           exposure_stats.i2c_errors, exposure_stats.frame_errors);
+    for (uint32_t i = first; i < completed; i++) {
+        const exposure_result_t *result = &results[i % EXPOSURE_QUEUE_LENGTH];
+        printf("  #%" PRIu32 ": requested %" PRIu32 " us, actual %" PRIu32 " us (%+" PRId32 " us), "
+               "started after %u frames, %" PRIu32 " us dark before\n", i, result->requested_us, result->actual_us,
+               result->error_us, result->frames_waited, result->gap_us);
+    }
+    if (completed) {
+        printf("  error %+" PRId32 " to %+" PRId32 " us, jitter %" PRId32 " us peak to peak\n",
+               exposure_stats.min_error_us, exposure_stats.max_error_us,
+               exposure_stats.max_error_us - exposure_stats.min_error_us);
+    }
+}
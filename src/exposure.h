@@ -0,0 +1,86 @@
+/**
+ * Exposure scheduler: timer driven light on/off for accurate doses
+ *
+ * Entries are queued from thread context and played back in order. For each entry the
+ * scheduler (optionally) decodes a full frame or queues a layer delta and writes the LED PWM,
+ * then at the first frame boundary after the layer has landed it writes External Print Control
+ * (0xC1) START from the scan-out frame interrupt and arms a hardware alarm; the alarm interrupt
+ * writes STOP after the requested duration. No sleeps and no printf anywhere between START and
+ * STOP. Frames are decoded straight into the framebuffer while the light is off, on core1 (see
+ * render_core.h); an entry can also switch the scan-out over to a raw frame (e.g. in flash), in
+ * which case the START waits for the frame boundary the DMA starts streaming it from.
+ *
+ * The 0xC1 writes go through the I2C command queue (i2c_queue.h), so nothing waits on the bus
+ * in interrupt context. For every entry the actual time between the START and STOP writes
+ * completing on the bus is recorded next to the requested duration; exposure_report() prints
+ * them along with the jitter over all entries. Both writes are the same length, so the bus
+ * time cancels out, but other commands queued in between delay the STOP: keep the I2C queue
+ * quiet while exposure_busy().
+ */
+#ifndef EXPOSURE_H
+#define EXPOSURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "framebuffer.h"
+
+#define EXPOSURE_QUEUE_LENGTH  16   // entries waiting, and results kept for the report
+
+typedef struct {
+    uint32_t requested_us;
+    uint32_t actual_us;      // START write to STOP write (completed on the bus)
+    int32_t error_us;        // actual - requested
+    uint16_t frames_waited;  // frame boundaries between being armed and the START write
+    uint32_t prepare_us;     // taking the entry to arming it: decoding its frame
+    uint32_t gap_us;         // light off before the START: from the previous entry's STOP (0: first)
+} exposure_result_t;
+
+typedef struct {
+    const uint8_t *delta;    // DLPD layer update applied before the exposure, or NULL
+    uint32_t delta_length;
+    const uint8_t *frame;    // DLPF frame decoded before the exposure (light off), or NULL
+    uint32_t frame_length;
+    const void *scanout;     // raw frame the scan-out switches to before the exposure (framebuffer
+                             // mode, see scanout_set_framebuffer()), or NULL to keep the current one
+    uint32_t duration_us;    // light on time
+    uint16_t pwm;            // LED PWM (10 bit) for this exposure, 0 keeps the current one
+    uint16_t dark_frames;    // whole frames the layer is shown with the light off before the START
+    // called from exposure_poll() once the entry is over (result NULL: skipped because its
+    // frame did not decode), or NULL
+    void (*done)(void *ctx, const exposure_result_t *result);
+    void *ctx;
+} exposure_entry_t;
+
+typedef struct {
+    volatile uint32_t completed;
+    volatile uint32_t i2c_errors;   // failed START/STOP writes
+    uint32_t frame_errors;          // entries skipped because their frame did not decode
+    int32_t min_error_us;
+    int32_t max_error_us;
+} exposure_stats_t;
+
+extern exposure_stats_t exposure_stats;
+
+// <fb> receives the entries' deltas; NULL in builds without a framebuffer (no deltas then).
+// Needs the I2C command queue to be running.
+void exposure_init(framebuffer_t *fb);
+
+// add an entry to the end of the queue; false if the queue is full or the delta is no good
+bool exposure_queue(const exposure_entry_t *entry);
+
+// entries that can still be queued
+uint32_t exposure_queue_free(void);
+
+// true while entries are queued or an exposure is running
+bool exposure_busy(void);
+
+// records the result of the finished entry and starts the next one; call as often as possible
+void exposure_poll(void);
+
+// call from the scan-out frame callback (see scanout_set_frame_callback), after delta_frame_end()
+void exposure_frame_end(void);
+
+// print requested vs actual time of the most recent entries and the jitter
+void exposure_report(void);
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * Streaming decoder for the DLPF frame format (see frame_codec.h for the layout)
+ *
+ * Runs are written with the word-wide span fill from framebuffer.c and repeated rows are a
+ * plain memcpy, so decoding a typical mask costs little more than writing the output once.
+ */
+#include <string.h>
+#include "frame_codec.h"
+
+static inline uint16_t read_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t read_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// LEB128 varint. Returns false if the input ends halfway through the number.
+static inline bool read_varint(frame_decoder_t *dec, uint32_t *value) {
+    uint32_t result = 0;
+    uint32_t shift = 0;
+
+    while (dec->pos < dec->end && shift < 32) {
+        uint8_t byte = *dec->pos++;
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+int frame_decoder_init(frame_decoder_t *dec, const uint8_t *data, uint32_t length) {
+    if (length < FRAME_HEADER_SIZE) { return FRAME_ERROR_TRUNCATED; }
+    if (data[0] != 'D' || data[1] != 'L' || data[2] != 'P' || data[3] != 'F') { return FRAME_ERROR_HEADER; }
+    if (data[4] != FRAME_VERSION) { return FRAME_ERROR_HEADER; }
+
+    uint8_t bpp = data[5];
+    if (bpp != 1 && bpp != 2 && bpp != 4 && bpp != 8) { return FRAME_ERROR_HEADER; }
+
+    uint32_t payload = read_u32(&data[12]);
+    if (payload > length - FRAME_HEADER_SIZE) { return FRAME_ERROR_TRUNCATED; }
+
+    dec->bpp = bpp;
+    dec->width = read_u16(&data[8]);
+    dec->height = read_u16(&data[10]);
+    dec->pos = data + FRAME_HEADER_SIZE;
+    dec->end = dec->pos + payload;
+    dec->row = 0;
+    dec->repeat = 0;
+    return FRAME_OK;
+}
+
+static int decode_rle_row(frame_decoder_t *dec, uint32_t *row) {
+    framebuffer_t line;  // single row view, so we can use the word-wide span fill
+    fb_init(&line, row, dec->width, 1, dec->bpp);
+
+    uint32_t value_mask = (1u << dec->bpp) - 1;
+    uint32_t x = 0;
+
+    while (x < dec->width) {
+        uint32_t run;
+        if (!read_varint(dec, &run)) { return FRAME_ERROR_TRUNCATED; }
+
+        uint32_t length = (run >> dec->bpp) + 1;
+        if (x + length > dec->width) { return FRAME_ERROR_CORRUPT; }
+
+        fb_fill_span(&line, x, x + length, 0, run & value_mask);
+        x += length;
+    }
+    return FRAME_OK;
+}
+
+int frame_decode_row(frame_decoder_t *dec, uint32_t *row, uint32_t row_bytes, const uint32_t *prev_row) {
+    if (FB_ROW_BYTES(dec->width, dec->bpp) > row_bytes) { return FRAME_ERROR_SIZE; }
+    row_bytes = FB_ROW_BYTES(dec->width, dec->bpp);
+
+    if (dec->row >= dec->height) { return FRAME_ERROR_CORRUPT; }
+
+    // a pending repeat record takes precedence over reading a new record
+    if (dec->repeat == 0) {
+        if (dec->pos >= dec->end) { return FRAME_ERROR_TRUNCATED; }
+
+        uint8_t record = *dec->pos++;
+        switch (record) {
+            case FRAME_ROW_RLE: {
+                int status = decode_rle_row(dec, row);
+                if (status != FRAME_OK) { return status; }
+                dec->row++;
+                return FRAME_OK;
+            }
+            case FRAME_ROW_LITERAL: {
+                uint32_t packed = ((uint32_t)dec->width * dec->bpp + 7) / 8;
+                if ((uint32_t)(dec->end - dec->pos) < packed) { return FRAME_ERROR_TRUNCATED; }
+                memcpy(row, dec->pos, packed);
+                dec->pos += packed;
+                dec->row++;
+                return FRAME_OK;
+            }
+            case FRAME_ROW_REPEAT:
+                if (!read_varint(dec, &dec->repeat)) { return FRAME_ERROR_TRUNCATED; }
+                if (dec->repeat == 0 || dec->row == 0) { return FRAME_ERROR_CORRUPT; }
+                break;
+            default:
+                return FRAME_ERROR_CORRUPT;
+        }
+    }
+
+    if (row != prev_row) {
+        memcpy(row, prev_row, row_bytes);
+    }
+    dec->repeat--;
+    dec->row++;
+    return FRAME_OK;
+}
+
+int frame_decode(const uint8_t *data, uint32_t length, framebuffer_t *fb) {
+    frame_decoder_t dec;
+    int status = frame_decoder_init(&dec, data, length);
+    if (status != FRAME_OK) { return status; }
+
+    if (dec.width != fb->width || dec.bpp != fb->bpp || dec.height > fb->height) {
+        return FRAME_ERROR_SIZE;
+    }
+
+    for (uint16_t y = 0; y < dec.height; y++) {
+        status = frame_decode_row(&dec, fb_row(fb, y), fb->stride * 4, fb_row(fb, y ? y - 1 : 0));
+        if (status != FRAME_OK) { return status; }
+    }
+    return FRAME_OK;
+}
@@ -0,0 +1,70 @@
+/**
+ * Compact binary frame format ("DLPF") and its streaming decoder
+ *
+ * Lithography masks are mostly large areas of a single value, so instead of shipping the
+ * full 230.4 kB packed array we run-length encode every row and collapse identical rows.
+ * The host side encoder lives in utils/frame_encoder.py.
+ *
+ * Layout (all multi-byte values little-endian):
+ *
+ *  header (16 bytes)
+ *    'D' 'L' 'P' 'F'   magic
+ *    u8  version       FRAME_VERSION
+ *    u8  bpp           bits per pixel of the decoded frame (1, 2, 4 or 8)
+ *    u16 reserved
+ *    u16 width, u16 height
+ *    u32 payload length (bytes following the header)
+ *
+ *  payload: a sequence of row records
+ *    0x00 <run>...     RLE row; runs until the row is complete. Each run is a varint holding
+ *                      ((length - 1) << bpp) | value
+ *    0x01 <varint n>   repeat the previous row n times
+ *    0x02 <bytes>      literal row, ceil(width * bpp / 8) packed bytes (same order as the
+ *                      framebuffer, see framebuffer.h)
+ *
+ * Varints are LEB128: 7 bits per byte, least significant group first, bit 7 set if more follow.
+ */
+#ifndef FRAME_CODEC_H
+#define FRAME_CODEC_H
+
+#include <stdint.h>
+#include "framebuffer.h"
+
+#define FRAME_VERSION       1
+#define FRAME_HEADER_SIZE   16
+
+#define FRAME_ROW_RLE       0x00
+#define FRAME_ROW_REPEAT    0x01
+#define FRAME_ROW_LITERAL   0x02
+
+enum FrameStatus {
+    FRAME_OK = 0,
+    FRAME_ERROR_HEADER = -1,     // bad magic, version or bit depth
+    FRAME_ERROR_TRUNCATED = -2,  // ran out of input before the row/frame was complete
+    FRAME_ERROR_CORRUPT = -3,    // unknown record or a run overflowing the row
+    FRAME_ERROR_SIZE = -4,       // frame does not fit the target framebuffer
+};
+
+typedef struct {
+    const uint8_t *pos;     // next unread payload byte
+    const uint8_t *end;     // one past the last payload byte
+    uint16_t width;
+    uint16_t height;
+    uint8_t bpp;
+    uint16_t row;           // index of the next row to be produced
+    uint32_t repeat;        // rows still to be copied from the previous row
+} frame_decoder_t;
+
+// parse the header and prepare to decode rows. Returns FRAME_OK or a negative FrameStatus
+int frame_decoder_init(frame_decoder_t *dec, const uint8_t *data, uint32_t length);
+
+// decode the next row into <row> (word aligned, <row_bytes> long; FRAME_ERROR_SIZE if that is
+// less than FB_ROW_BYTES(width, bpp)). <prev_row> must hold the previously decoded row (it is
+// only read for repeat records), which lets the decoder feed scanline buffers as well as a full
+// framebuffer.
+int frame_decode_row(frame_decoder_t *dec, uint32_t *row, uint32_t row_bytes, const uint32_t *prev_row);
+
+// decode a complete frame into fb (rows beyond the frame height are left untouched)
+int frame_decode(const uint8_t *data, uint32_t length, framebuffer_t *fb);
+
+#endif
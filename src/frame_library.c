@@ -0,0 +1,145 @@
+/**
+ * Frame library in flash (see frame_library.h)
+ *
+ * One DMA channel (claimed while measuring the bandwidth), the DMA sniffer (CRC checks)
+ */
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/regs/addressmap.h"
+#include "hardware/structs/xip_ctrl.h"
+#include "frame_library.h"
+#include "clock_plan.h"
+#include "dma_crc.h"
+
+#define LIBRARY_BASE  ((const uint8_t *)(XIP_BASE + FRAME_LIBRARY_OFFSET))
+
+extern char __flash_binary_end;  // linker script: end of the firmware image in flash
+
+static uint16_t entry_count;
+static const frame_library_entry_t *entries;
+
+static inline uint16_t read_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t read_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int frame_library_init(void) {
+    entry_count = 0;
+    if ((uintptr_t)&__flash_binary_end > (uintptr_t)LIBRARY_BASE) {
+        return FRAME_LIBRARY_ERROR_OVERLAP;  // flashing a library would overwrite the firmware
+    }
+
+    const uint8_t *header = LIBRARY_BASE;
+    if (memcmp(header, "DLPL", 4) != 0) { return FRAME_LIBRARY_ERROR_MISSING; }
+
+    uint16_t count = read_u16(&header[6]);
+    uint32_t table_bytes = count * sizeof(frame_library_entry_t);
+    if (header[4] != FRAME_LIBRARY_VERSION || FRAME_LIBRARY_HEADER_SIZE + table_bytes > FRAME_LIBRARY_SIZE) {
+        return FRAME_LIBRARY_ERROR_HEADER;
+    }
+    const frame_library_entry_t *table = (const frame_library_entry_t *)(header + FRAME_LIBRARY_HEADER_SIZE);
+    if (dma_crc32((const uint8_t *)table, table_bytes) != read_u32(&header[8])) {
+        return FRAME_LIBRARY_ERROR_HEADER;
+    }
+
+    for (uint i = 0; i < count; i++) {
+        const frame_library_entry_t *entry = &table[i];
+        if ((entry->offset & 3) || entry->offset > FRAME_LIBRARY_SIZE ||
+            entry->length > FRAME_LIBRARY_SIZE - entry->offset ||
+            entry->offset < FRAME_LIBRARY_HEADER_SIZE + table_bytes) {
+            return FRAME_LIBRARY_ERROR_ENTRY;
+        }
+    }
+
+    entries = table;
+    entry_count = count;
+    return count;
+}
+
+const frame_library_entry_t *frame_library_entry(uint32_t index) {
+    return index < entry_count ? &entries[index] : NULL;
+}
+
+const uint8_t *frame_library_data(const frame_library_entry_t *entry) {
+    return LIBRARY_BASE + entry->offset;
+}
+
+int frame_library_verify(uint32_t index) {
+    const frame_library_entry_t *entry = frame_library_entry(index);
+    if (!entry) { return FRAME_LIBRARY_ERROR_ENTRY; }
+    return dma_crc32(frame_library_data(entry), entry->length) == entry->crc ? FRAME_LIBRARY_OK
+                                                                               : FRAME_LIBRARY_ERROR_CRC;
+}
+
+void frame_library_report(void) {
+    printf("frame library at flash offset 0x%x: %u frames\n", FRAME_LIBRARY_OFFSET, entry_count);
+    for (uint i = 0; i < entry_count; i++) {
+        const frame_library_entry_t *entry = &entries[i];
+        printf("  %2u %-16.16s %s %u bit, %u rows, %lu bytes%s\n", i, entry->name,
+               entry->format == FRAME_LIBRARY_RAW ? "raw " : "DLPF", entry->bpp, entry->height, entry->length,
+               frame_library_verify(i) == FRAME_LIBRARY_OK ? "" : ", CRC mismatch!");
+    }
+}
+
+// DMA <count> transfers from <src> into a dummy word; returns the time it took in us
+static uint32_t timed_read(uint chan, const volatile void *src, uint32_t count, enum dma_channel_transfer_size size,
+                           bool increment, uint dreq) {
+    static uint32_t sink;
+
+    dma_channel_config c = dma_channel_get_default_config(chan);
+    channel_config_set_transfer_data_size(&c, size);
+    channel_config_set_read_increment(&c, increment);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, dreq);
+
+    uint64_t begin_time = time_us_64();
+    dma_channel_configure(chan, &c, &sink, src, count, true);
+    dma_channel_wait_for_finish_blocking(chan);
+    return time_us_64() - begin_time;
+}
+
+// bytes per us = MB/s, with two decimals
+static void print_rate(const char *path, uint32_t bytes, uint32_t elapsed_us, uint32_t needed) {
+    uint32_t rate = elapsed_us ? (uint64_t)bytes * 100 / elapsed_us : 0;
+    printf("  %-24s %3lu.%02lu MB/s (%lu%% of what the scan-out needs)\n", path, rate / 100, rate % 100,
+           needed ? rate * 100 / needed : 0);
+}
+
+void frame_library_bandwidth(uint32_t bytes, uint8_t bpp) {
+    bytes = MIN(bytes, FRAME_LIBRARY_SIZE) & ~3u;
+    uint chan = dma_claim_unused_channel(true);
+
+    // the pxl state machine takes <bpp> bits per PCLK period during the active part of a line
+    uint32_t pclk = clock_plan_current()->pclk_hz;
+    uint32_t needed = (uint64_t)pclk * bpp / 8 / 10000;  // MB/s * 100
+
+    printf("XIP read bandwidth (%lu kB, with the scan-out running); %u bit pixels at %lu kHz PCLK need %lu.%02lu MB/s\n",
+           bytes / 1024, bpp, pclk / 1000, needed / 100, needed % 100);
+
+    // what the scan-out does: words through the cache, which starts out empty
+    xip_ctrl_hw->flush = 1;
+    (void)xip_ctrl_hw->flush;  // reading blocks until the flush is done
+    print_rate("cached, 32-bit", bytes,
+               timed_read(chan, LIBRARY_BASE, bytes / 4, DMA_SIZE_32, true, DREQ_FORCE), needed);
+
+    // every word is a separate flash read, but the cache is left alone
+    print_rate("uncached, 32-bit", bytes,
+               timed_read(chan, (const void *)(XIP_NOCACHE_NOALLOC_BASE + FRAME_LIBRARY_OFFSET), bytes / 4,
+                          DMA_SIZE_32, true, DREQ_FORCE), needed);
+
+    // the stream reads sequential words in the background while the cores keep using the cache
+    while (!(xip_ctrl_hw->stat & XIP_STAT_FIFO_EMPTY_BITS)) {
+        (void)xip_ctrl_hw->stream_fifo;
+    }
+    xip_ctrl_hw->stream_addr = (uintptr_t)LIBRARY_BASE;
+    xip_ctrl_hw->stream_ctr = bytes / 4;
+    print_rate("stream, 32-bit", bytes,
+               timed_read(chan, (const void *)XIP_AUX_BASE, bytes / 4, DMA_SIZE_32, false, DREQ_XIP_STREAM), needed);
+
+    dma_channel_unclaim(chan);
+}
@@ -0,0 +1,90 @@
+/**
+ * Frame library: many frames in a flash partition, selected by index
+ *
+ * The top of the flash (from FRAME_LIBRARY_OFFSET on) holds a small table followed by the
+ * frames, written by flashing a UF2 made with utils/frame_library.py next to the firmware. The
+ * frames are read straight from XIP flash, nothing is copied into RAM:
+ *
+ *  - raw frames (packed pixels at the scan-out bit depth, see framebuffer.h) are scanned out of
+ *    flash directly: the scan-out DMA is pointed at the frame (scanout_set_framebuffer()), or
+ *    in line ring builds the lines are copied out of flash as they are rendered.
+ *  - DLPF frames (see frame_codec.h) are decoded from flash like an uploaded frame.
+ *
+ * The scan-out DMA reads the raw frames through the cached XIP alias with 32-bit transfers, so
+ * the frame runs through the 16 kB XIP cache and evicts code that the cores run from flash
+ * (the scan-out and I2C interrupt handlers are in RAM). frame_library_bandwidth() measures what
+ * the flash delivers over each XIP path while the scan-out is running and compares it with what
+ * the pixel clock needs, along with the XIP stream path (32-bit transfers too, but it needs
+ * its own DMA channel to feed it).
+ *
+ * Layout (all multi-byte values little-endian):
+ *
+ *  header (16 bytes) at FRAME_LIBRARY_OFFSET
+ *    'D' 'L' 'P' 'L'   magic
+ *    u8  version       FRAME_LIBRARY_VERSION
+ *    u8  reserved
+ *    u16 count         number of entries
+ *    u32 table_crc     CRC-32 (zlib) of the entries
+ *    u32 reserved
+ *
+ *  count entries of 32 bytes (frame_library_entry_t), then the frame data. Entry offsets are
+ *  counted from the start of the header and 256-byte aligned (a flash page).
+ */
+#ifndef FRAME_LIBRARY_H
+#define FRAME_LIBRARY_H
+
+#include <stdint.h>
+
+// offset of the partition in flash; has to match utils/frame_library.py --offset
+#ifndef FRAME_LIBRARY_OFFSET
+#define FRAME_LIBRARY_OFFSET  (1024 * 1024)
+#endif
+#define FRAME_LIBRARY_SIZE    (PICO_FLASH_SIZE_BYTES - FRAME_LIBRARY_OFFSET)
+
+#define FRAME_LIBRARY_VERSION      1
+#define FRAME_LIBRARY_HEADER_SIZE  16
+
+#define FRAME_LIBRARY_RAW   0x00   // packed pixels, scanned out as they are
+#define FRAME_LIBRARY_DLPF  0x01   // DLPF compressed frame
+
+enum FrameLibraryStatus {
+    FRAME_LIBRARY_OK = 0,
+    FRAME_LIBRARY_ERROR_MISSING = -1,   // no library in flash
+    FRAME_LIBRARY_ERROR_HEADER = -2,    // bad version, count or table CRC
+    FRAME_LIBRARY_ERROR_ENTRY = -3,     // an entry points outside the partition, or no such entry
+    FRAME_LIBRARY_ERROR_CRC = -4,       // frame data does not match its CRC
+    FRAME_LIBRARY_ERROR_OVERLAP = -5,   // the firmware runs into the partition
+};
+
+typedef struct {
+    uint32_t offset;      // from the start of the library
+    uint32_t length;      // bytes
+    uint8_t format;       // FRAME_LIBRARY_RAW or FRAME_LIBRARY_DLPF
+    uint8_t bpp;          // bits per pixel
+    uint16_t height;      // rows
+    uint32_t crc;         // CRC-32 (zlib) of the frame data
+    char name[16];        // zero padded, not necessarily terminated
+} frame_library_entry_t;
+
+// check the table in flash; returns the number of entries or a negative FrameLibraryStatus
+int frame_library_init(void);
+
+// entry <index>, NULL if there is no such entry
+const frame_library_entry_t *frame_library_entry(uint32_t index);
+
+// frame data of <entry> (cached XIP alias)
+const uint8_t *frame_library_data(const frame_library_entry_t *entry);
+
+// check the CRC of entry <index> (DMA sniffer, thread context only)
+int frame_library_verify(uint32_t index);
+
+// list the entries
+void frame_library_report(void);
+
+// time 32-bit DMA reads of <bytes> from the partition over the cached XIP alias (like the
+// scan-out), the uncached alias and the XIP stream, and print them next to the bandwidth the
+// scan-out needs at <bpp> bits per pixel. Claims a DMA channel and flushes the XIP cache, so
+// the firmware only calls it at boot in a DLP_BOOT_DIAGNOSTICS build.
+void frame_library_bandwidth(uint32_t bytes, uint8_t bpp);
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * Packed framebuffer for the DLP scan-out buffer (see framebuffer.h for the pixel order)
+ *
+ * All operations work on whole 32-bit words where possible and only fall back to masking
+ * for the partial words at the start and end of a span.
+ */
+#include <string.h>
+#include "framebuffer.h"
+
+void fb_init(framebuffer_t *fb, void *buffer, uint16_t width, uint16_t height, uint8_t bpp) {
+    fb->words = (uint32_t *)buffer;
+    fb->width = width;
+    fb->height = height;
+    fb->bpp = bpp;
+    fb->stride = FB_ROW_BYTES(width, bpp) / 4;
+}
+
+void fb_fill_span(framebuffer_t *fb, uint16_t x0, uint16_t x1, uint16_t y, uint8_t value) {
+    if (x1 > fb->width) { x1 = fb->width; }
+    if (x0 >= x1 || y >= fb->height) { return; }
+
+    uint32_t *row = fb_row(fb, y);
+    uint32_t pattern = fb_pattern(fb, value);
+    uint32_t b0 = (uint32_t)x0 * fb->bpp;  // first bit of the span
+    uint32_t b1 = (uint32_t)x1 * fb->bpp;  // one past the last bit of the span
+    uint32_t w0 = b0 >> 5;
+    uint32_t w1 = b1 >> 5;
+
+    uint32_t head_mask = ~0u << (b0 & 31);                             // bits >= b0 in word w0
+    uint32_t tail_mask = (b1 & 31) ? (~0u >> (32 - (b1 & 31))) : 0;    // bits < b1 in word w1
+
+    if (w0 == w1) {  // span starts and ends within a single word
+        uint32_t mask = head_mask & tail_mask;
+        row[w0] = (row[w0] & ~mask) | (pattern & mask);
+        return;
+    }
+
+    row[w0] = (row[w0] & ~head_mask) | (pattern & head_mask);
+    for (uint32_t w = w0 + 1; w < w1; w++) {
+        row[w] = pattern;
+    }
+    if (tail_mask) {
+        row[w1] = (row[w1] & ~tail_mask) | (pattern & tail_mask);
+    }
+}
+
+void fb_fill_rect(framebuffer_t *fb, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t value) {
+    uint32_t y_end = (uint32_t)y + h;
+    uint32_t x_end = (uint32_t)x + w;
+    if (y_end > fb->height) { y_end = fb->height; }
+    if (x_end > fb->width) { x_end = fb->width; }
+
+    for (uint32_t row = y; row < y_end; row++) {
+        fb_fill_span(fb, x, x_end, row, value);
+    }
+}
+
+void fb_clear(framebuffer_t *fb, uint8_t value) {
+    uint32_t pattern = fb_pattern(fb, value);
+    uint32_t count = (uint32_t)fb->stride * fb->height;
+
+    if (pattern == 0) {
+        memset(fb->words, 0, count * 4);
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        fb->words[i] = pattern;
+    }
+}
+
+void fb_copy_row(framebuffer_t *fb, uint16_t dst_y, uint16_t src_y) {
+    if (dst_y >= fb->height || src_y >= fb->height || dst_y == src_y) { return; }
+    memcpy(fb_row(fb, dst_y), fb_row(fb, src_y), (uint32_t)fb->stride * 4);
+}
+
+// fetch n (1..32) bits starting at bit pos, right aligned. Only touches the second word
+// if the requested bits actually extend into it (so we never read past the source).
+static inline uint32_t get_bits(const uint32_t *src, uint32_t pos, uint32_t n) {
+    uint32_t w = pos >> 5;
+    uint32_t shift = pos & 31;
+    uint32_t bits = src[w] >> shift;
+
+    if (shift + n > 32) {
+        bits |= src[w + 1] << (32 - shift);
+    }
+    return bits;
+}
+
+void fb_copy_bits(uint32_t *dst, uint32_t dbit, const uint32_t *src, uint32_t sbit, uint32_t nbits) {
+    while (nbits) {
+        uint32_t offset = dbit & 31;
+        uint32_t n = 32 - offset;  // after the first word, offset is 0 and we move whole words
+        if (n > nbits) { n = nbits; }
+
+        uint32_t mask = (n == 32) ? ~0u : (((1u << n) - 1) << offset);
+        uint32_t *word = &dst[dbit >> 5];
+        *word = (*word & ~mask) | ((get_bits(src, sbit, n) << offset) & mask);
+
+        dbit += n;
+        sbit += n;
+        nbits -= n;
+    }
+}
+
+void fb_blit(framebuffer_t *dst, uint16_t dst_x, uint16_t dst_y,
+             const framebuffer_t *src, uint16_t src_x, uint16_t src_y, uint16_t w, uint16_t h) {
+    if (dst->bpp != src->bpp) { return; }  // no depth conversion (yet)
+
+    // clip against both the source and the destination
+    if (src_x >= src->width || src_y >= src->height) { return; }
+    if (dst_x >= dst->width || dst_y >= dst->height) { return; }
+    if (w > src->width - src_x) { w = src->width - src_x; }
+    if (w > dst->width - dst_x) { w = dst->width - dst_x; }
+    if (h > src->height - src_y) { h = src->height - src_y; }
+    if (h > dst->height - dst_y) { h = dst->height - dst_y; }
+
+    uint32_t nbits = (uint32_t)w * dst->bpp;
+    uint32_t dbit = (uint32_t)dst_x * dst->bpp;
+    uint32_t sbit = (uint32_t)src_x * src->bpp;
+
+    for (uint16_t row = 0; row < h; row++) {
+        fb_copy_bits(fb_row(dst, dst_y + row), dbit, fb_row(src, src_y + row), sbit, nbits);
+    }
+}
@@ -0,0 +1,77 @@
+/**
+ * Packed framebuffer for the DLP scan-out buffer
+ *
+ * Pixels are stored LSB-first: pixel x of a row occupies bits [x*bpp, (x+1)*bpp) counted
+ * from bit 0 of the first byte of that row. This is the order in which the pxl state machine
+ * shifts the OSR out to the pixel pins (right shift), and the order that
+ * utils/grayscale_tiff_to_bytes.py packs pixels in. Because the RP2040 is little-endian we
+ * can therefore treat every row as an array of 32-bit words and touch 32/bpp pixels at once.
+ */
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FB_WIDTH   1280   // DMD resolution (pixels per line)
+#define FB_HEIGHT  720    // DMD resolution (lines)
+
+typedef struct {
+    uint32_t *words;   // start of the pixel data, must be 32-bit aligned
+    uint16_t width;    // pixels per row
+    uint16_t height;   // number of rows
+    uint16_t stride;   // 32-bit words per row
+    uint8_t bpp;       // bits per pixel: 1, 2, 4 or 8
+} framebuffer_t;
+
+// bytes needed to store a single row of <width> pixels at <bpp> bits each (word padded)
+#define FB_ROW_BYTES(width, bpp)  ((((width) * (bpp) + 31) / 32) * 4)
+
+void fb_init(framebuffer_t *fb, void *buffer, uint16_t width, uint16_t height, uint8_t bpp);
+
+// a 32-bit word in which every pixel slot holds <value>
+static inline uint32_t fb_pattern(const framebuffer_t *fb, uint8_t value) {
+    uint32_t max_value = (1u << fb->bpp) - 1;
+    return (value & max_value) * (0xFFFFFFFFu / max_value);
+}
+
+static inline uint32_t *fb_row(const framebuffer_t *fb, uint16_t y) {
+    return fb->words + (uint32_t)y * fb->stride;
+}
+
+// single pixels, inline so that a loop over them keeps bpp and stride in registers instead of
+// paying a call (from flash) per pixel. Use the span functions below for anything wider.
+static inline void fb_set_pixel(framebuffer_t *fb, uint16_t x, uint16_t y, uint8_t value) {
+    if (x >= fb->width || y >= fb->height) { return; }
+
+    uint32_t bit = (uint32_t)x * fb->bpp;
+    uint32_t mask = ((1u << fb->bpp) - 1) << (bit & 31);
+    uint32_t *word = &fb_row(fb, y)[bit >> 5];
+
+    *word = (*word & ~mask) | (((uint32_t)value << (bit & 31)) & mask);
+}
+
+static inline uint8_t fb_get_pixel(const framebuffer_t *fb, uint16_t x, uint16_t y) {
+    if (x >= fb->width || y >= fb->height) { return 0; }
+
+    uint32_t bit = (uint32_t)x * fb->bpp;
+    return (fb_row(fb, y)[bit >> 5] >> (bit & 31)) & ((1u << fb->bpp) - 1);
+}
+
+// fill pixels [x0, x1) of row y with value (both set and clear, unlike the old drawPixel)
+void fb_fill_span(framebuffer_t *fb, uint16_t x0, uint16_t x1, uint16_t y, uint8_t value);
+void fb_fill_rect(framebuffer_t *fb, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t value);
+void fb_clear(framebuffer_t *fb, uint8_t value);
+
+// copy a full row within the framebuffer
+void fb_copy_row(framebuffer_t *fb, uint16_t dst_y, uint16_t src_y);
+
+// copy a w*h block of pixels from src (same bpp, any bit alignment) into dst
+void fb_blit(framebuffer_t *dst, uint16_t dst_x, uint16_t dst_y,
+             const framebuffer_t *src, uint16_t src_x, uint16_t src_y, uint16_t w, uint16_t h);
+
+// low level helper also used by the decoders: copy nbits from src (starting at bit sbit) into
+// dst (starting at bit dbit), one destination word at a time
+void fb_copy_bits(uint32_t *dst, uint32_t dbit, const uint32_t *src, uint32_t sbit, uint32_t nbits);
+
+#endif
@@ -0,0 +1,846 @@
+/**
+ * Host benchmark of the firmware's hot paths
+ *
+ * Runs the portable modules, compiled unchanged against the simulated peripherals (mock.h),
+ * on synthetic but realistic data:
+ *
+ *  - framebuffer packing: clear, filled rectangles, single pixels, unaligned blits, and the old
+ *    per-pixel drawPixel() as a baseline
+ *  - decoding: DLPF frames (RLE and literal rows), DLPD deltas, DLPV display lists
+ *  - I2C command sequencing: the interrupt driven command queue, the register shadow and the
+ *    setup writes as one batch
+ *  - exposure scheduling: START/STOP timing against the frame boundaries, DLPC bring-up
+ *  - the job pipeline: how long the light is off between layers of a job (see job.h)
+ *
+ * Every CPU benchmark is sampled --repeat times and the best and median time per operation
+ * are printed, along with the instructions per operation where Linux lets us count them
+ * (perf_event_open). --save/--compare use the instruction count if there is one, as it is
+ * nearly the same on every run, and the best time otherwise, as that is the least disturbed
+ * by whatever else the machine is doing. The I2C, exposure and bring-up figures are in
+ * simulated time and do not depend on the machine at all. Absolute numbers are the host's,
+ * not the RP2040's: compare runs on the same build machine against each other, e.g.
+ *
+ *   ./dlp_bench --save baseline.txt
+ *   (change something)
+ *   ./dlp_bench --compare baseline.txt --tolerance 10
+ *
+ * which exits with 1 if anything got slower than the tolerance (percent) allows.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "mock.h"
+#include "framebuffer.h"
+#include "frame_codec.h"
+#include "delta.h"
+#include "vector.h"
+#include "i2c_queue.h"
+#include "dlpc_regs.h"
+#include "exposure.h"
+#include "dlpc_bringup.h"
+#include "scanout.h"
+#include "render_core.h"
+#include "job.h"
+#include "staging.h"
+#include "video_mode.h"
+
+#define BPP              2
+#define FRAME_PERIOD_US  16667   // 60 Hz
+#define DLPC_ADDR        0x1B
+#define PROJ_ON_GPIO     20
+#define HOST_IRQ_GPIO    21
+
+#define SAMPLE_NS        20000000   // 20 ms
+#define MAX_RESULTS      64
+#define ENCODED_BYTES    (512 * 1024)
+
+typedef struct {
+    const char *name;
+    const char *unit;            // what one operation is
+    void (*setup)(void);         // once, untimed (may be NULL)
+    uint32_t (*run)(void);       // one timed run; returns the operations done
+} bench_t;
+
+typedef struct {
+    char name[48];
+    double value;                // lower is better
+} result_t;
+
+static result_t results[MAX_RESULTS];
+static uint result_count;
+
+static uint32_t fb_words[FB_WIDTH * FB_HEIGHT * BPP / 32];
+static uint32_t src_words[FB_WIDTH * FB_HEIGHT * BPP / 32];
+static framebuffer_t fb;
+static framebuffer_t src;
+
+static uint32_t rle_frame[ENCODED_BYTES / 4];
+static uint32_t rle_frame_length;
+static uint32_t literal_frame[ENCODED_BYTES / 4];
+static uint32_t literal_frame_length;
+static uint32_t delta_data[ENCODED_BYTES / 4];
+static uint32_t delta_length;
+static uint32_t vector_data[ENCODED_BYTES / 4];
+static uint32_t vector_length;
+static vector_raster_t raster;
+
+static uint32_t lcg_state = 1;
+
+// the same pseudo random numbers on every run
+static uint32_t lcg(void) {
+    lcg_state = lcg_state * 1664525u + 1013904223u;
+    return lcg_state >> 8;
+}
+
+static void record(const char *name, double value) {
+    if (result_count < MAX_RESULTS) {
+        snprintf(results[result_count].name, sizeof(results[result_count].name), "%s", name);
+        results[result_count].value = value;
+        result_count++;
+    }
+}
+
+// CPU time of this thread: time spent in other processes doesn't count
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// user space instructions retired by this thread, if the kernel has a counter for us
+static int counter_fd = -1;
+
+static bool counter_open(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    counter_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    return counter_fd >= 0;
+}
+
+static uint64_t counter_read(void) {
+    uint64_t count = 0;
+    if (counter_fd < 0 || read(counter_fd, &count, sizeof(count)) != sizeof(count)) {
+        return 0;
+    }
+    return count;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// test data
+
+static void put_u16(uint8_t *p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t value) {
+    put_u16(p, value & 0xFFFF);
+    put_u16(p + 2, value >> 16);
+}
+
+static uint8_t *put_varint(uint8_t *p, uint32_t value) {
+    while (value >= 0x80) {
+        *p++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+static void put_header(uint8_t *p, char kind, uint8_t version, uint8_t bpp, uint16_t count, uint32_t payload) {
+    p[0] = 'D'; p[1] = 'L'; p[2] = 'P'; p[3] = kind;
+    p[4] = version;
+    p[5] = bpp;
+    put_u16(&p[6], count);
+    put_u16(&p[8], FB_WIDTH);
+    put_u16(&p[10], FB_HEIGHT);
+    put_u32(&p[12], payload);
+}
+
+// a mask-like image: a few hundred overlapping rectangles of all values
+static void draw_source(void) {
+    fb_init(&src, src_words, FB_WIDTH, FB_HEIGHT, BPP);
+    fb_clear(&src, 0);
+    lcg_state = 1;
+    for (uint i = 0; i < 300; i++) {
+        uint16_t x = lcg() % FB_WIDTH, y = lcg() % FB_HEIGHT;
+        uint16_t w = 1 + lcg() % 200, h = 1 + lcg() % 120;
+        fb_fill_rect(&src, x, y, MIN(w, FB_WIDTH - x), MIN(h, FB_HEIGHT - y), 1 + lcg() % 3);
+    }
+}
+
+// DLPF of the source image, like utils/frame_encoder.py: RLE rows, repeats for identical rows
+static uint32_t encode_rle(uint8_t *out) {
+    uint8_t *p = out + FRAME_HEADER_SIZE;
+    uint32_t row_bytes = FB_ROW_BYTES(FB_WIDTH, BPP);
+    for (uint16_t y = 0; y < FB_HEIGHT; y++) {
+        uint32_t repeat = 0;
+        while (y > 0 && y + repeat < FB_HEIGHT && !memcmp(fb_row(&src, y - 1), fb_row(&src, y + repeat), row_bytes)) {
+            repeat++;
+        }
+        if (repeat) {
+            *p++ = FRAME_ROW_REPEAT;
+            p = put_varint(p, repeat);
+            y += repeat - 1;
+            continue;
+        }
+        *p++ = FRAME_ROW_RLE;
+        uint16_t x = 0;
+        while (x < FB_WIDTH) {
+            uint8_t value = fb_get_pixel(&src, x, y);
+            uint16_t run = 1;
+            while (x + run < FB_WIDTH && fb_get_pixel(&src, x + run, y) == value) { run++; }
+            p = put_varint(p, ((uint32_t)(run - 1) << BPP) | value);
+            x += run;
+        }
+    }
+    uint32_t payload = p - out - FRAME_HEADER_SIZE;
+    put_header(out, 'F', FRAME_VERSION, BPP, 0, payload);
+    return FRAME_HEADER_SIZE + payload;
+}
+
+// DLPF of noise: literal rows only
+static uint32_t encode_literal(uint8_t *out) {
+    uint8_t *p = out + FRAME_HEADER_SIZE;
+    uint32_t row_bytes = (FB_WIDTH * BPP + 7) / 8;
+    for (uint16_t y = 0; y < FB_HEIGHT; y++) {
+        *p++ = FRAME_ROW_LITERAL;
+        for (uint32_t i = 0; i < row_bytes; i++) { *p++ = lcg(); }
+    }
+    uint32_t payload = p - out - FRAME_HEADER_SIZE;
+    put_header(out, 'F', FRAME_VERSION, BPP, 0, payload);
+    return FRAME_HEADER_SIZE + payload;
+}
+
+// DLPD changing a block in the middle of the frame: a data span and a fill span per row
+static uint32_t encode_delta(uint8_t *out) {
+    uint8_t *p = out + DELTA_HEADER_SIZE;
+    for (uint16_t y = 100; y < 620; y++) {
+        uint16_t count = 333;
+        p[0] = DELTA_SPAN_DATA; p[1] = 0;
+        put_u16(&p[2], y); put_u16(&p[4], 101); put_u16(&p[6], count);
+        p += DELTA_RECORD_SIZE;
+        uint32_t bytes = (count * BPP + 7) / 8;
+        for (uint32_t i = 0; i < bytes; i++) { p[i] = lcg(); }
+        memset(p + bytes, 0, (4 - bytes % 4) % 4);
+        p += (bytes + 3) & ~3u;
+
+        p[0] = DELTA_SPAN_FILL; p[1] = 2;
+        put_u16(&p[2], y); put_u16(&p[4], 700); put_u16(&p[6], 200);
+        p += DELTA_RECORD_SIZE;
+    }
+    uint32_t payload = p - out - DELTA_HEADER_SIZE;
+    put_header(out, 'D', DELTA_VERSION, BPP, 0, payload);
+    return DELTA_HEADER_SIZE + payload;
+}
+
+typedef struct {
+    int32_t top;
+    uint32_t size;
+    uint8_t bytes[16];
+} primitive_t;
+
+static int compare_top(const void *a, const void *b) {
+    const primitive_t *x = a, *y = b;
+    return (x->top > y->top) - (x->top < y->top);
+}
+
+static primitive_t primitives[1024];
+
+static void primitive(uint count, uint8_t kind, int16_t top, const int16_t *coords, uint n) {
+    primitive_t *prim = &primitives[count];
+    memset(prim, 0, sizeof(*prim));
+    prim->bytes[0] = kind;
+    prim->top = top;
+    prim->size = 4 + 2 * n;
+    if (kind == VECTOR_CIRCLE || kind == VECTOR_RECT) { prim->size = 12; }
+    for (uint i = 0; i < n; i++) { put_u16(&prim->bytes[4 + 2 * i], coords[i]); }
+}
+
+static uint8_t *put_layer(uint8_t *p, bool clear, uint count) {
+    qsort(primitives, count, sizeof(primitive_t), compare_top);
+    uint8_t *layer = p;
+    p += 8;
+    for (uint i = 0; i < count; i++) {
+        memcpy(p, primitives[i].bytes, primitives[i].size);
+        p += primitives[i].size;
+    }
+    layer[0] = VECTOR_LAYER;
+    layer[1] = clear ? VECTOR_LAYER_CLEAR : 0;
+    put_u16(&layer[2], count);
+    put_u32(&layer[4], p - layer - 8);
+    return p;
+}
+
+// DLPV of a board: copper pour (an octagon) with clearances, a grid of pads with traces
+// between them, and drill holes
+static uint32_t encode_vector(uint8_t *out) {
+    const int s = 1 << VECTOR_SUBPIXEL_BITS;
+    uint8_t *p = out + VECTOR_HEADER_SIZE;
+
+    // pour
+    uint8_t *pour = p;
+    int16_t octagon[] = {50 * s, 670 * s,
+                         1180 * s, 50 * s, 1230 * s, 100 * s,   100 * s, 50 * s, 50 * s, 100 * s,
+                         1230 * s, 100 * s, 1230 * s, 620 * s,  50 * s, 100 * s, 50 * s, 620 * s,
+                         1230 * s, 620 * s, 1180 * s, 670 * s,  50 * s, 620 * s, 100 * s, 670 * s};
+    pour[0] = VECTOR_LAYER;
+    pour[1] = 0;
+    put_u16(&pour[2], 1);
+    put_u32(&pour[4], sizeof(octagon) + 4);
+    pour[8] = VECTOR_POLYGON;
+    pour[9] = 0;
+    put_u16(&pour[10], 6);
+    for (uint i = 0; i < count_of(octagon); i++) { put_u16(&pour[12 + 2 * i], octagon[i]); }
+    p += 8 + 4 + sizeof(octagon);
+
+    for (uint layer = 0; layer < 3; layer++) {
+        uint count = 0;
+        for (int row = 0; row < 17; row++) {
+            for (int col = 0; col < 30; col++) {
+                int16_t cx = (80 + col * 38) * s, cy = (60 + row * 37) * s;
+                if (layer == 0) {         // clearance
+                    int16_t c[] = {cx, cy, 14 * s, 0};
+                    primitive(count++, VECTOR_CIRCLE, cy - 14 * s, c, 4);
+                } else if (layer == 1) {  // pads and traces
+                    if ((row + col) % 2) {
+                        int16_t c[] = {cx, cy, 9 * s, 0};
+                        primitive(count++, VECTOR_CIRCLE, cy - 9 * s, c, 4);
+                    } else {
+                        int16_t c[] = {cx - 8 * s, cy - 8 * s, cx + 8 * s, cy + 8 * s};
+                        primitive(count++, VECTOR_RECT, cy - 8 * s, c, 4);
+                    }
+                    if (col < 29 && row % 2 == 0) {
+                        int16_t c[] = {cx, cy, cx + 38 * s, cy + (col % 3 - 1) * 12 * s, 3 * s, 0};
+                        primitive(count++, VECTOR_TRACE, MIN(c[1], c[3]) - c[4], c, 6);
+                    }
+                } else {                  // drills
+                    int16_t c[] = {cx, cy, 3 * s, 0};
+                    primitive(count++, VECTOR_CIRCLE, cy - 3 * s, c, 4);
+                }
+            }
+        }
+        p = put_layer(p, layer != 1, count);
+    }
+    uint32_t payload = p - out - VECTOR_HEADER_SIZE;
+    put_header(out, 'V', VECTOR_VERSION, 0, 4, payload);
+    return VECTOR_HEADER_SIZE + payload;
+}
+
+// framebuffer packing
+
+static void setup_fb(void) {
+    fb_init(&fb, fb_words, FB_WIDTH, FB_HEIGHT, BPP);
+    draw_source();
+}
+
+static uint32_t run_clear(void) {
+    fb_clear(&fb, 1);
+    return 1;
+}
+
+static uint32_t run_fill_rect(void) {
+    lcg_state = 7;
+    for (uint i = 0; i < 2000; i++) {
+        uint16_t x = lcg() % FB_WIDTH, y = lcg() % FB_HEIGHT;
+        uint16_t w = MIN(1 + lcg() % 100, FB_WIDTH - x), h = MIN(1 + lcg() % 60, FB_HEIGHT - y);
+        fb_fill_rect(&fb, x, y, w, h, lcg() % 4);
+    }
+    return 2000;
+}
+
+static uint32_t run_set_pixel(void) {
+    for (uint16_t y = 0; y < 256; y++) {
+        for (uint16_t x = 0; x < 256; x++) {
+            fb_set_pixel(&fb, x + 3, y, (x ^ y) & 3);
+        }
+    }
+    return 256 * 256;
+}
+
+// baseline: the drawPixel() the fb_* functions replaced, 1 bit per pixel in a 1280 wide byte
+// array and only able to set bits. Same pixels as run_set_pixel(), and a whole frame like
+// run_clear(), so the pixels/s of both can be compared.
+static uint8_t draw_pixel_bytes[1280 * 720 / 8];
+
+static void draw_pixel(int x, int y, int lit) {
+    long pixel_idx = ((1280 * y) + x);
+    draw_pixel_bytes[pixel_idx >> 3] |= lit << (7 - (pixel_idx % 8));
+}
+
+static uint32_t run_draw_pixel(void) {
+    for (uint16_t y = 0; y < 256; y++) {
+        for (uint16_t x = 0; x < 256; x++) {
+            draw_pixel(x + 3, y, (x ^ y) & 1);
+        }
+    }
+    return 256 * 256;
+}
+
+static uint32_t run_draw_pixel_frame(void) {
+    for (int y = 0; y < 720; y++) {
+        for (int x = 0; x < 1280; x++) {
+            draw_pixel(x, y, 1);
+        }
+    }
+    return 1;
+}
+
+static uint32_t run_blit(void) {
+    fb_blit(&fb, 5, 7, &src, 3, 11, 640, 360);
+    return 1;
+}
+
+// decoding
+
+static void setup_frames(void) {
+    setup_fb();
+    rle_frame_length = encode_rle((uint8_t *)rle_frame);
+    literal_frame_length = encode_literal((uint8_t *)literal_frame);
+    if (frame_decode((uint8_t *)rle_frame, rle_frame_length, &fb) != FRAME_OK ||
+        memcmp(fb_words, src_words, sizeof(fb_words)) ||
+        frame_decode((uint8_t *)literal_frame, literal_frame_length, &fb) != FRAME_OK) {
+        printf("error: the synthetic DLPF frames do not decode (to their source)\n");
+        exit(2);
+    }
+}
+
+static uint32_t run_decode_rle(void) {
+    frame_decode((uint8_t *)rle_frame, rle_frame_length, &fb);
+    return 1;
+}
+
+static uint32_t run_decode_literal(void) {
+    frame_decode((uint8_t *)literal_frame, literal_frame_length, &fb);
+    return 1;
+}
+
+static void setup_delta(void) {
+    setup_fb();
+    delta_length = encode_delta((uint8_t *)delta_data);
+    if (delta_validate((uint8_t *)delta_data, delta_length, &fb) != DELTA_OK) {
+        printf("error: the synthetic DLPD delta does not validate\n");
+        exit(2);
+    }
+}
+
+static uint32_t run_delta(void) {
+    delta_apply((uint8_t *)delta_data, delta_length, &fb);
+    return 1;
+}
+
+static void setup_vector(void) {
+    setup_fb();
+    vector_length = encode_vector((uint8_t *)vector_data);
+    int status = vector_validate((uint8_t *)vector_data, vector_length, FB_WIDTH, FB_HEIGHT);
+    if (status != VECTOR_OK) {
+        printf("error: the synthetic DLPV list does not validate (%d)\n", status);
+        exit(2);
+    }
+}
+
+static uint32_t run_vector(void) {
+    vector_start(&raster, (uint8_t *)vector_data);
+    vector_render(&raster, &fb);
+    return 1;
+}
+
+// I2C command sequencing
+
+#define I2C_BATCH  I2C_QUEUE_LENGTH
+
+static uint32_t batch_target;
+static uint64_t batch_sim_ns;
+
+static bool batch_done(void) {
+    return i2c_queue_stats.commands >= batch_target;
+}
+
+static void setup_i2c(void) {
+    static bool started;
+    if (!started) {
+        i2c_queue_init(i2c1, DLPC_ADDR, 100 * 1000);
+        started = true;
+    }
+}
+
+static uint32_t run_i2c_queue(void) {
+    static const uint8_t pwm[] = {0, 0, 0, 0, 0x80, 0x01};
+    batch_target = i2c_queue_stats.commands + I2C_BATCH;
+    uint64_t begin = mock_time_ns();
+    for (uint i = 0; i < I2C_BATCH; i++) {
+        i2c_queue_write(0x54, pwm, sizeof(pwm));
+    }
+    mock_run_until(batch_done, 1000000);
+    batch_sim_ns = mock_time_ns() - begin;
+    return I2C_BATCH;
+}
+
+// the gamma/LED select, PWM and orientation writes of the external print setup, queued as one
+// batch through the shadow just after a DLPC (re)start
+static uint32_t run_setup_batch(void) {
+    static const uint8_t gamma_led[] = {0x00, 0b00000100};
+    static const uint8_t pwm[] = {0, 0, 0, 0, 0xB4, 0x00};
+    static const uint8_t orientation[] = {0x00};
+    i2c_queue_flush();
+    dlpc_shadow_invalidate();
+    uint64_t begin = mock_time_ns();
+    dlpc_write(0xA8, gamma_led, sizeof(gamma_led));
+    dlpc_write(0x54, pwm, sizeof(pwm));
+    dlpc_write(0x14, orientation, sizeof(orientation));
+    i2c_queue_flush();
+    batch_sim_ns = mock_time_ns() - begin;
+    return 3;
+}
+
+static uint32_t run_dlpc_write(void) {
+    // the shadow turns repeated writes of the same value into no transaction at all
+    static const uint8_t pwm[] = {0, 0, 0, 0, 0x80, 0x01};
+    for (uint i = 0; i < 1000; i++) {
+        dlpc_write(0x54, pwm, sizeof(pwm));
+    }
+    i2c_queue_flush();
+    return 1000;
+}
+
+// exposure scheduling
+
+#define EXPOSURES  EXPOSURE_QUEUE_LENGTH
+
+static void frame_end(void) {
+    delta_frame_end();
+    exposure_frame_end();
+}
+
+static void setup_exposure(void) {
+    static bool started;
+    setup_delta();
+    setup_frames();
+    setup_i2c();
+    if (!started) {
+        exposure_init(&fb);
+        scanout_set_frame_callback(frame_end);
+        mock_scanout_start(FRAME_PERIOD_US, FB_HEIGHT);
+        started = true;
+    }
+}
+
+static bool exposures_done(void) {
+    exposure_poll();
+    return !exposure_busy();
+}
+
+static uint32_t run_exposure(void) {
+    for (uint i = 0; i < EXPOSURES; i++) {
+        exposure_entry_t entry = {
+            .duration_us = 2000 + i * 1000,
+            .pwm = 300 + (i % 4) * 100,
+        };
+        if (i % 3 == 1) {
+            entry.frame = (uint8_t *)rle_frame;
+            entry.frame_length = rle_frame_length;
+        } else if (i % 3 == 2) {
+            entry.delta = (uint8_t *)delta_data;
+            entry.delta_length = delta_length;
+        }
+        exposure_queue(&entry);
+    }
+    mock_run_until(exposures_done, 10000000);
+    return EXPOSURES;
+}
+
+// job pipeline: layers from a frame library in host memory, with core1 taking a nominal
+// JOB_CORE1_US for every frame it copies or decodes
+
+#define JOB_LAYERS    48
+#define JOB_CORE1_US  3000
+
+static uint8_t library_data[2 * VIDEO_FRAME_BYTES(BPP) + ENCODED_BYTES] __attribute__((aligned(4)));
+static frame_library_entry_t library[3];
+
+static bool job_done(void) {
+    exposure_poll();
+    job_poll();
+    render_poll();
+    return !job_busy();
+}
+
+// two raw frames (scanned out of the library) and a DLPF frame (decoded into the framebuffer),
+// in an order that has every transition: raw to raw, raw to DLPF (decoded ahead), DLPF to DLPF
+// (decoded after the STOP) and DLPF to raw, and a few dark frames
+static int run_job(void) {
+    static const uint8_t order[] = {0, 1, 2, 2, 0, 2};
+    setup_exposure();
+    memcpy(library_data, src_words, VIDEO_FRAME_BYTES(BPP));
+    memcpy(library_data + VIDEO_FRAME_BYTES(BPP), fb_words, VIDEO_FRAME_BYTES(BPP));
+    memcpy(library_data + 2 * VIDEO_FRAME_BYTES(BPP), rle_frame, rle_frame_length);
+    for (uint i = 0; i < count_of(library); i++) {
+        library[i] = (frame_library_entry_t){
+            .offset = i * VIDEO_FRAME_BYTES(BPP),
+            .length = i < 2 ? VIDEO_FRAME_BYTES(BPP) : rle_frame_length,
+            .format = i < 2 ? FRAME_LIBRARY_RAW : FRAME_LIBRARY_DLPF,
+            .bpp = BPP,
+            .height = FB_HEIGHT,
+        };
+    }
+    mock_frame_library(library, count_of(library), library_data);
+
+    uint8_t *p = staging_buffer;
+    memcpy(p, "DLPJ", 4);
+    p[4] = JOB_VERSION;
+    put_u16(&p[6], JOB_LAYERS);
+    put_u32(&p[12], JOB_LAYERS * JOB_RECORD_SIZE);
+    p += JOB_HEADER_SIZE;
+    for (uint i = 0; i < JOB_LAYERS; i++, p += JOB_RECORD_SIZE) {
+        put_u16(&p[0], order[i % count_of(order)]);
+        put_u16(&p[2], 400);
+        put_u32(&p[4], 20000);
+        put_u16(&p[8], i % 8 == 7 ? 2 : 0);
+        put_u16(&p[10], 0);
+    }
+
+    mock_render_job_us(JOB_CORE1_US);
+    int status = job_start(staging_buffer, p - staging_buffer, &fb);
+    if (status == JOB_OK) {
+        mock_run_until(job_done, 10000000);
+    }
+    mock_render_job_us(0);
+    return status;
+}
+
+// --filter NAME runs what has NAME in its name
+static bool selected(const char *name, const char *filter) {
+    return !filter || strstr(name, filter);
+}
+
+// CPU time per operation of every benchmark, best and median of <repeat> samples. Each sample
+// runs the benchmark often enough to take SAMPLE_NS, so that the clock resolution doesn't
+// show. Where the kernel lets us count instructions, the instructions per operation are what
+// gets recorded: unlike the time they hardly move between runs, or between a quiet and a busy
+// machine.
+static void run_benchmarks(const bench_t *benches, uint count, uint repeat, const char *filter) {
+    bool counting = counter_open();
+    printf("%-22s %8s  %-8s %14s %14s %12s %14s\n", "benchmark", "ops/run", "op", "best ns/op", "median",
+           "ops/s (best)", "instr/op");
+    double *ns = malloc(repeat * sizeof(double));
+    for (uint b = 0; b < count; b++) {
+        const bench_t *bench = &benches[b];
+        if (!selected(bench->name, filter)) { continue; }
+        if (bench->setup) { bench->setup(); }
+
+        uint64_t begin = now_ns();
+        uint32_t ops = bench->run();  // warm up, and see how many runs make a sample
+        uint64_t elapsed = now_ns() - begin;
+        uint32_t runs = elapsed >= SAMPLE_NS ? 1 : SAMPLE_NS / (elapsed + 1) + 1;
+
+        double instructions = 0;
+        for (uint r = 0; r < repeat; r++) {
+            uint64_t total_ops = 0;
+            uint64_t first = counter_read();
+            begin = now_ns();
+            for (uint32_t i = 0; i < runs; i++) { total_ops += bench->run(); }
+            ns[r] = (double)(now_ns() - begin) / total_ops;
+            double per_op = (double)(counter_read() - first) / total_ops;
+            if (r == 0 || per_op < instructions) { instructions = per_op; }
+        }
+        qsort(ns, repeat, sizeof(double), compare_double);
+        printf("%-22s %8u  %-8s %14.1f %14.1f %12.0f", bench->name, ops, bench->unit, ns[0], ns[repeat / 2],
+               1e9 / ns[0]);
+
+        char name[48];
+        if (counting) {
+            printf(" %14.0f\n", instructions);
+            snprintf(name, sizeof(name), "%s.instr", bench->name);
+            record(name, instructions);
+        } else {
+            printf(" %14s\n", "-");
+            snprintf(name, sizeof(name), "%s.ns", bench->name);
+            record(name, ns[0]);
+        }
+    }
+    free(ns);
+    if (!counting) {
+        printf("(no instruction counter: times only, which move with the load of the machine)\n");
+    }
+}
+
+// the setup of DLP_pico.c's setup_external_print(), as far as the bus is concerned
+static void configure_dlpc(void) {
+    static const uint8_t print_mode[] = {0x00};
+    static const uint8_t pwm[] = {0, 0, 0, 0, 0x80, 0x01};
+    dlpc_shadow_invalidate();
+    dlpc_write(0x05, print_mode, sizeof(print_mode));
+    dlpc_write(0x54, pwm, sizeof(pwm));
+}
+
+// the same on every machine: simulated bus and frame timing
+static void run_simulated(const char *filter) {
+    if (selected("i2c_queue", filter)) {
+        setup_i2c();
+        mock_i2c_stats_t before = mock_i2c_stats;
+        run_i2c_queue();
+        double per_command = batch_sim_ns / 1000.0 / I2C_BATCH;
+        double interrupts = (double)(mock_i2c_stats.interrupts - before.interrupts) / I2C_BATCH;
+        printf("\nI2C: %u queued 6 byte writes on the bus in %.0f us: %.1f us each, %.2f interrupts each, "
+               "bus %.0f%% busy\n", I2C_BATCH, batch_sim_ns / 1000.0, per_command, interrupts,
+               100.0 * (mock_i2c_stats.busy_ns - before.busy_ns) / batch_sim_ns);
+        record("sim.i2c_us_per_write", per_command);
+        record("sim.i2c_irqs_per_write", interrupts);
+
+        run_setup_batch();
+        printf("I2C setup batch of 3 writes on the bus in %.0f us\n", batch_sim_ns / 1000.0);
+        record("sim.i2c_setup_batch_us", batch_sim_ns / 1000.0);
+    }
+
+    if (selected("exposure", filter)) {
+        setup_exposure();
+        mock_scanout_start(FRAME_PERIOD_US, FB_HEIGHT);  // the same frame phase whatever ran before
+        exposure_stats.min_error_us = INT32_MAX;
+        exposure_stats.max_error_us = INT32_MIN;
+        uint32_t completed = exposure_stats.completed;
+        uint64_t begin = mock_time_ns();
+        run_exposure();
+        printf("Exposures: %lu in %.1f ms, error %+ld to %+ld us (jitter %ld us), %lu I2C errors, %lu bad frames\n",
+               (unsigned long)(exposure_stats.completed - completed), (mock_time_ns() - begin) / 1e6,
+               (long)exposure_stats.min_error_us, (long)exposure_stats.max_error_us,
+               (long)(exposure_stats.max_error_us - exposure_stats.min_error_us),
+               (unsigned long)exposure_stats.i2c_errors, (unsigned long)exposure_stats.frame_errors);
+        record("sim.exposure_jitter_us", exposure_stats.max_error_us - exposure_stats.min_error_us);
+        record("sim.exposure_errors", exposure_stats.i2c_errors + exposure_stats.frame_errors);
+    }
+
+    if (selected("job", filter)) {
+        mock_scanout_start(FRAME_PERIOD_US, FB_HEIGHT);
+        int status = run_job();
+        uint32_t gaps = job_stats.done - job_stats.skipped - 1;
+        double gap_us = status == JOB_OK && gaps ? (double)job_stats.gap_us / gaps : 0;
+        printf("Job: %lu of %u layers in %.1f ms (status %d), %lu skipped; dark between layers %.0f us on "
+               "average, %lu us at most, %lu stalls\n", (unsigned long)job_stats.done, JOB_LAYERS,
+               (job_stats.end_us - job_stats.begin_us) / 1e3, status, (unsigned long)job_stats.skipped, gap_us,
+               (unsigned long)job_stats.max_gap_us, (unsigned long)job_stats.stalls);
+        record("sim.job_gap_us", gap_us);
+        record("sim.job_stalls", job_stats.stalls + job_stats.skipped + (job_stats.done != JOB_LAYERS));
+    }
+
+    if (selected("bringup", filter)) {
+        // the DLPC does not answer for 650 ms and then pulls HOST_IRQ low
+        setup_i2c();
+        mock_gpio_set_input(HOST_IRQ_GPIO, true);
+        mock_i2c_set_nak(true);
+        uint64_t begin = mock_time_ns();
+        bringup_start(PROJ_ON_GPIO, HOST_IRQ_GPIO, configure_dlpc);
+        while (!bringup_poll()) {
+            if (mock_time_ns() - begin >= 650000000u && mock_gpio_output(PROJ_ON_GPIO)) {
+                mock_i2c_set_nak(false);
+                mock_gpio_set_input(HOST_IRQ_GPIO, false);
+            }
+            mock_advance_us(50);
+        }
+        double ready_ms = (mock_time_ns() - begin) / 1e6;
+        printf("Bring-up: DLPC answering after 650 ms, %s after %.2f ms\n",
+               bringup_phase() == BRINGUP_READY ? "ready" : "FAILED", ready_ms);
+        record("sim.bringup_ms", ready_ms);
+    }
+}
+
+
+static int save(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return 2;
+    }
+    for (uint i = 0; i < result_count; i++) {
+        fprintf(file, "%s %.3f\n", results[i].name, results[i].value);
+    }
+    fclose(file);
+    printf("\nsaved %u results to %s\n", result_count, path);
+    return 0;
+}
+
+static int compare(const char *path, double tolerance) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return 2;
+    }
+    char name[48];
+    double baseline;
+    uint regressions = 0;
+    printf("\n%-26s %12s %12s %8s\n", "against baseline", "baseline", "now", "change");
+    while (fscanf(file, "%47s %lf", name, &baseline) == 2) {
+        for (uint i = 0; i < result_count; i++) {
+            if (strcmp(results[i].name, name)) { continue; }
+            double change = baseline ? (results[i].value - baseline) / baseline * 100 : 0;
+            bool regressed = results[i].value > baseline * (1 + tolerance / 100) + 1e-9;
+            printf("%-26s %12.2f %12.2f %+7.1f%%%s\n", name, baseline, results[i].value, change,
+                   regressed ? "  REGRESSION" : "");
+            regressions += regressed;
+        }
+    }
+    fclose(file);
+    printf("%u regressions (tolerance %.0f%%)\n", regressions, tolerance);
+    return regressions ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    const bench_t benches[] = {
+        {"fb_clear", "frame", setup_fb, run_clear},
+        {"fb_fill_rect", "rect", setup_fb, run_fill_rect},
+        {"fb_set_pixel", "pixel", setup_fb, run_set_pixel},
+        {"drawPixel", "pixel", setup_fb, run_draw_pixel},
+        {"drawPixel_frame", "frame", setup_fb, run_draw_pixel_frame},
+        {"fb_blit", "640x360", setup_fb, run_blit},
+        {"frame_decode_rle", "frame", setup_frames, run_decode_rle},
+        {"frame_decode_literal", "frame", setup_frames, run_decode_literal},
+        {"delta_apply", "delta", setup_delta, run_delta},
+        {"vector_render", "frame", setup_vector, run_vector},
+        {"i2c_queue", "command", setup_i2c, run_i2c_queue},
+        {"dlpc_write_shadowed", "write", setup_i2c, run_dlpc_write},
+        {"exposure", "entry", setup_exposure, run_exposure},
+    };
+    uint repeat = 15;
+    double tolerance = 10;
+    const char *filter = NULL, *save_path = NULL, *compare_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+            int runs = atoi(argv[++i]);
+            repeat = MAX(runs, 1);
+        } else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (!strcmp(argv[i], "--save") && i + 1 < argc) {
+            save_path = argv[++i];
+        } else if (!strcmp(argv[i], "--compare") && i + 1 < argc) {
+            compare_path = argv[++i];
+        } else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else {
+            printf("usage: %s [--repeat N] [--filter NAME] [--save FILE] [--compare FILE [--tolerance PERCENT]]\n",
+                   argv[0]);
+            return 2;
+        }
+    }
+    run_benchmarks(benches, count_of(benches), repeat, filter);
+    run_simulated(filter);
+
+    int status = 0;
+    if (save_path) { status = save(save_path); }
+    if (compare_path && !status) { status = compare(compare_path, tolerance); }
+    return status;
+}
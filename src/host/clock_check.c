@@ -0,0 +1,198 @@
+/**
+ * Host check of the clock plans (clock_plan.h)
+ *
+ * Plans the system clock and PCLK for a grid of limits (PCLK ceilings from well under the
+ * stock 31.25 MHz to the DLPC's limit, system clock ceilings from stock to 266 MHz, pinned
+ * system clocks, frame rate ceilings) and checks every plan against the RP2040 and the
+ * limits, working things out independently of clock_plan_make() where it can:
+ *
+ *  - the PLL setting exists: VCO a multiple of the crystal within 750-1600 MHz, post
+ *    dividers 1-7, and the system clock within the limits
+ *  - PCLK is what the divider makes of the system clock, within the limit, and the divider
+ *    is whole unless the system clock is pinned
+ *  - nothing is left on the table: no whole divider of any PLL output within the limits
+ *    gives a higher PCLK (found by scanning the system clock kHz by kHz), and a pinned clock's
+ *    fractional divider is the smallest that keeps to the limit
+ *  - the frame rate is what the line and frame length make of PCLK, within the limit, and a
+ *    stretched front porch is the shortest that keeps to it
+ *  - hsync and vsync get VIDEO_PCLK_DIV times the divider of pxl and pxl_clk
+ *
+ * and then applies the build's own plan (clock_plan_init()) to the simulated clocks. Prints
+ * the build's plan (-v: every plan) and exits with 1 if a check failed:
+ *
+ *   ./dlp_clock_check -v
+ */
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "mock.h"
+#include "clock_plan.h"
+#include "video_mode.h"
+
+static uint failures;
+
+#define CHECK(cond, ...)  do { if (!(cond)) { failures++; printf("  FAIL: " __VA_ARGS__); printf("\n"); } } while (0)
+
+// true if the PLL can make exactly <sys_khz> from the crystal
+static bool pll_can_make(uint32_t sys_khz) {
+    for (uint postdiv = 1; postdiv <= 49; postdiv++) {
+        uint64_t vco_khz = (uint64_t)sys_khz * postdiv;
+        bool factors = false;
+        for (uint a = 1; a <= 7; a++) {
+            factors |= postdiv % a == 0 && postdiv / a <= 7;
+        }
+        if (factors && vco_khz % CLOCK_PLAN_XOSC_KHZ == 0 &&
+            vco_khz >= CLOCK_PLAN_VCO_MIN_KHZ && vco_khz <= CLOCK_PLAN_VCO_MAX_KHZ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// the highest PCLK any whole divider of any PLL output within <limits> gives (0: none)
+static uint32_t best_whole_pclk(const clock_limits_t *limits) {
+    uint32_t best = 0;
+    for (uint32_t div = 1; div <= 0xFFFF / VIDEO_PCLK_DIV; div++) {
+        uint64_t top_khz = (uint64_t)limits->pclk_max_hz * VIDEO_PCLK_DIV * div / 1000;
+        uint32_t sys_khz = MIN(top_khz, limits->sys_max_khz);
+        if ((uint64_t)sys_khz * 1000 / (VIDEO_PCLK_DIV * div) <= best) {
+            break;  // and only less from here on
+        }
+        while (sys_khz >= MAX(limits->sys_min_khz, 1) && !pll_can_make(sys_khz)) {
+            sys_khz--;
+        }
+        if (sys_khz >= MAX(limits->sys_min_khz, 1) && pll_can_make(sys_khz)) {
+            best = MAX(best, (uint64_t)sys_khz * 1000 / (VIDEO_PCLK_DIV * div));
+        }
+    }
+    return best;
+}
+
+// PCLK in 1/256 Hz for <sys_khz> and a divider of <div> 1/256ths
+static uint64_t pclk_256(uint32_t sys_khz, uint32_t div) {
+    return (uint64_t)sys_khz * 1000 * 256 * 256 / VIDEO_PCLK_DIV / div;
+}
+
+// frame rate in 1/256 mHz with <line_pclk> periods per line
+static uint64_t frame_rate_256(uint32_t sys_khz, uint32_t div, uint32_t line_pclk) {
+    return pclk_256(sys_khz, div) * 1000 / ((uint64_t)line_pclk * VIDEO_FRAME_LINES);
+}
+
+static void check_plan(const clock_limits_t *limits, bool verbose) {
+    clock_plan_t plan;
+    bool pinned = limits->sys_min_khz == limits->sys_max_khz;
+    bool found = clock_plan_make(&plan, limits);
+    uint failed = failures;
+
+    if (!found) {
+        CHECK(pinned ? !pll_can_make(limits->sys_min_khz) : best_whole_pclk(limits) == 0,
+              "no plan, but the PLL can make a clock within the limits");
+    } else {
+        uint32_t div = ((uint32_t)plan.div_int << 8) | plan.div_frac;
+
+        // PLL
+        CHECK(plan.vco_khz % CLOCK_PLAN_XOSC_KHZ == 0 && plan.vco_khz / CLOCK_PLAN_XOSC_KHZ >= CLOCK_PLAN_FBDIV_MIN &&
+              plan.vco_khz / CLOCK_PLAN_XOSC_KHZ <= CLOCK_PLAN_FBDIV_MAX, "VCO %" PRIu32 " kHz", plan.vco_khz);
+        CHECK(plan.vco_khz >= CLOCK_PLAN_VCO_MIN_KHZ && plan.vco_khz <= CLOCK_PLAN_VCO_MAX_KHZ, "VCO %" PRIu32 " kHz",
+              plan.vco_khz);
+        CHECK(plan.postdiv1 >= 1 && plan.postdiv1 <= 7 && plan.postdiv2 >= 1 && plan.postdiv2 <= 7,
+              "post dividers %u, %u", plan.postdiv1, plan.postdiv2);
+        CHECK(plan.sys_khz * plan.postdiv1 * plan.postdiv2 == plan.vco_khz, "sys %" PRIu32 " kHz", plan.sys_khz);
+        CHECK(plan.sys_khz >= limits->sys_min_khz && plan.sys_khz <= limits->sys_max_khz, "sys %" PRIu32 " kHz",
+              plan.sys_khz);
+        CHECK(plan.vreg_mv >= (plan.sys_khz > CLOCK_PLAN_STOCK_KHZ ? 1150 : 1100), "%u mV at %" PRIu32 " kHz",
+              plan.vreg_mv, plan.sys_khz);
+
+        // PCLK
+        CHECK(div >= 256, "divider below 1");
+        CHECK(pinned || plan.div_frac == 0, "fractional divider without a pinned system clock");
+        CHECK(plan.pclk_hz == pclk_256(plan.sys_khz, div) / 256, "PCLK %" PRIu32 " Hz", plan.pclk_hz);
+        CHECK(pclk_256(plan.sys_khz, div) <= (uint64_t)limits->pclk_max_hz * 256, "PCLK %" PRIu32 " Hz over the limit",
+              plan.pclk_hz);
+        if (pinned) {
+            CHECK(div == 256 || pclk_256(plan.sys_khz, div - 1) > (uint64_t)limits->pclk_max_hz * 256,
+                  "divider %" PRIu32 "/256 is larger than it needs to be", div);
+        } else {
+            uint32_t best = best_whole_pclk(limits);
+            CHECK(plan.pclk_hz == best, "PCLK %" PRIu32 " Hz, %" PRIu32 " Hz is possible", plan.pclk_hz, best);
+        }
+
+        // frame timing
+        CHECK(plan.h_counter >= VIDEO_H_COUNTER, "hsync counter %" PRIu32, plan.h_counter);
+        CHECK(plan.line_pclk == plan.h_counter + 1 + VIDEO_H_BLANK, "line %" PRIu32 " PCLK", plan.line_pclk);
+        uint64_t rate = frame_rate_256(plan.sys_khz, div, plan.line_pclk);
+        CHECK(plan.frame_mhz == rate / 256, "frame rate %" PRIu32 " mHz", plan.frame_mhz);
+        if (limits->frame_rate_max) {
+            CHECK(rate <= (uint64_t)limits->frame_rate_max * 1000 * 256, "frame rate %" PRIu32 " mHz over the limit",
+                  plan.frame_mhz);
+        }
+        if (plan.h_counter > VIDEO_H_COUNTER) {
+            CHECK(frame_rate_256(plan.sys_khz, div, plan.line_pclk - 1) > (uint64_t)limits->frame_rate_max * 1000 * 256,
+                  "front porch stretched further than it needs to be");
+        }
+
+        // state machine dividers
+        uint16_t sync_int, pxl_int;
+        uint8_t sync_frac, pxl_frac;
+        clock_plan_sm_div(&plan, 1, &sync_int, &sync_frac);
+        clock_plan_sm_div(&plan, VIDEO_PCLK_DIV, &pxl_int, &pxl_frac);
+        CHECK(pxl_int == plan.div_int && pxl_frac == plan.div_frac, "pxl divider %u + %u/256", pxl_int, pxl_frac);
+        CHECK((((uint32_t)sync_int << 8) | sync_frac) == div * VIDEO_PCLK_DIV, "hsync divider %u + %u/256",
+              sync_int, sync_frac);
+    }
+
+    if (verbose || failures != failed) {
+        printf("limits: PCLK %9" PRIu32 " Hz, sys %6" PRIu32 "-%6" PRIu32 " kHz, %3" PRIu32 " Hz: ",
+               limits->pclk_max_hz, limits->sys_min_khz, limits->sys_max_khz, limits->frame_rate_max);
+        if (found) {
+            printf("sys %6" PRIu32 " kHz (%4" PRIu32 "/%u/%u), div %3u+%3u/256, PCLK %9" PRIu32 " Hz, "
+                   "front porch +%4" PRIu32 ", %3" PRIu32 ".%02" PRIu32 " fps\n",
+                   plan.sys_khz, plan.vco_khz / 1000, plan.postdiv1, plan.postdiv2, plan.div_int, plan.div_frac,
+                   plan.pclk_hz, plan.h_counter - VIDEO_H_COUNTER, plan.frame_mhz / 1000, plan.frame_mhz % 1000 / 10);
+        } else {
+            printf("no plan\n");
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    bool verbose = argc > 1 && !strcmp(argv[1], "-v");
+    const uint32_t pclk_max_hz[] = {12000000, 25000000, 31250000, 33000000, 40000000, 50000000, 60000000,
+                                    74250000, DLP_PCLK_MAX_HZ};
+    const uint32_t sys_max_khz[] = {125000, 133000, 200000, 250000, 266000};
+    const uint32_t sys_pinned_khz[] = {48000, 125000, 133000, 200000, 250000, 123457};
+    const uint32_t frame_rate_max[] = {0, 30, 60, 120};
+    uint plans = 0;
+
+    for (uint p = 0; p < count_of(pclk_max_hz); p++) {
+        for (uint f = 0; f < count_of(frame_rate_max); f++) {
+            for (uint s = 0; s < count_of(sys_max_khz); s++) {
+                clock_limits_t limits = {pclk_max_hz[p], 0, sys_max_khz[s], frame_rate_max[f]};
+                check_plan(&limits, verbose);
+                plans++;
+            }
+            for (uint s = 0; s < count_of(sys_pinned_khz); s++) {
+                clock_limits_t limits = {pclk_max_hz[p], sys_pinned_khz[s], sys_pinned_khz[s], frame_rate_max[f]};
+                check_plan(&limits, verbose);
+                plans++;
+            }
+        }
+    }
+
+    // the build's plan, applied to the simulated clocks
+    printf("build limits: PCLK %" PRIu32 " Hz, sys up to %" PRIu32 " kHz (pinned: %" PRIu32 "), %" PRIu32 " Hz\n",
+           clock_limits_build.pclk_max_hz, clock_limits_build.sys_max_khz, (uint32_t)DLP_SYS_CLOCK_KHZ,
+           clock_limits_build.frame_rate_max);
+    const clock_plan_t *plan = clock_plan_init();
+    clock_plan_report(plan);
+    CHECK(clock_get_hz(clk_sys) == plan->sys_khz * 1000, "system clock %" PRIu32 " Hz after clock_plan_init()",
+          clock_get_hz(clk_sys));
+    CHECK(mock_vreg_mv() == plan->vreg_mv, "core voltage %u mV after clock_plan_init()", mock_vreg_mv());
+    CHECK(clock_plan_current() == plan, "clock_plan_current()");
+    check_plan(&clock_limits_build, false);
+
+    printf("%u plans checked, %u failures\n", plans + 1, failures);
+    return failures ? 1 : 0;
+}
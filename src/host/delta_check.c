@@ -0,0 +1,114 @@
+/**
+ * Host check of the layer deltas (delta.h) written by utils/delta_encoder.py
+ *
+ * Applies a sequence of DLPD files with delta.c, starting from the empty frame the first one
+ * is relative to, and compares the framebuffer after each with the packed target layer the
+ * script wrote next to it (--reference: <name>_target.raw for <name>.dlpd):
+ *
+ *   python utils/delta_encoder.py layer_000.tif layer_001.tif layer_002.tif --reference
+ *   build-host/dlp_delta_check layer_000.dlpd layer_001.dlpd layer_002.dlpd
+ *
+ * Prints the spans and pixels each delta wrote and the host time delta_apply() took, and exits
+ * with 1 if a delta does not validate or the framebuffer differs from its target.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "delta.h"
+
+#define MAX_FILE     (512 * 1024)
+#define FRAME_BYTES  (FB_HEIGHT * FB_ROW_BYTES(FB_WIDTH, 8))
+
+static uint32_t delta[MAX_FILE / 4];
+static uint32_t frame[FRAME_BYTES / 4];
+static uint8_t target[FRAME_BYTES];
+
+// CPU time of this thread, as in bench.c (time_us_64() is the simulated clock)
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static long load(const char *path, void *buffer, long size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        printf("error: cannot open %s\n", path);
+        return -1;
+    }
+    long length = (long)fread(buffer, 1, size, file);
+    bool more = fgetc(file) != EOF;
+    fclose(file);
+    if (more) {
+        printf("error: %s is larger than %ld bytes\n", path, size);
+        return -1;
+    }
+    return length;
+}
+
+// <name>.dlpd -> <name>_target.raw
+static bool target_path(const char *path, char *out, size_t size) {
+    size_t length = strlen(path);
+    if (length < 5 || strcmp(path + length - 5, ".dlpd") || length - 5 + sizeof("_target.raw") > size) {
+        return false;
+    }
+    memcpy(out, path, length - 5);
+    strcpy(out + length - 5, "_target.raw");
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: %s LAYER.dlpd [LAYER.dlpd ...]\n", argv[0]);
+        return 2;
+    }
+
+    framebuffer_t fb;
+    uint8_t bpp = 0;
+    uint failures = 0;
+    for (int i = 1; i < argc; i++) {
+        char path[4096];
+        if (!target_path(argv[i], path, sizeof(path))) {
+            printf("error: %s is not a .dlpd file\n", argv[i]);
+            return 2;
+        }
+        long length = load(argv[i], delta, sizeof(delta));
+        long target_length = load(path, target, sizeof(target));
+        if (length < 0 || target_length < 0) { return 2; }
+
+        const uint8_t *data = (const uint8_t *)delta;
+        if (!bpp) {
+            // the whole sequence is at the bit depth of the first delta
+            bpp = length >= DELTA_HEADER_SIZE ? data[5] : 0;
+            if (bpp != 1 && bpp != 2 && bpp != 4 && bpp != 8) {
+                printf("error: %s has no valid header\n", argv[i]);
+                return 1;
+            }
+            fb_init(&fb, frame, FB_WIDTH, FB_HEIGHT, bpp);
+            memset(frame, 0, sizeof(frame));
+        }
+        if (target_length != (long)FB_HEIGHT * fb.stride * 4) {
+            printf("error: %s is not a %ux%u frame at %u bits per pixel\n", path, FB_WIDTH, FB_HEIGHT, bpp);
+            return 2;
+        }
+
+        uint32_t spans = delta_stats.spans, pixels = delta_stats.pixels;
+        uint64_t begin = now_ns();
+        int status = delta_apply(data, length, &fb);
+        uint64_t elapsed = now_ns() - begin;
+        if (status != DELTA_OK) {
+            printf("  FAIL: %s: does not apply (%d)\n", argv[i], status);
+            failures++;
+            continue;
+        }
+        bool same = memcmp(frame, target, target_length) == 0;
+        printf("%-40s %7u bytes, %6u spans, %7u pixels, applied in %.1f us%s\n", argv[i], (uint)length,
+               (uint)(delta_stats.spans - spans), (uint)(delta_stats.pixels - pixels),
+               elapsed / 1e3, same ? "" : ", differs from its target");
+        failures += !same;
+    }
+    printf("%d deltas, %u failures\n", argc - 1, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,566 @@
+/**
+ * Simulated RP2040 peripherals for the host build (see mock.h)
+ */
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "hardware/timer.h"
+#include "hardware/gpio.h"
+#include "hardware/clocks.h"
+#include "hardware/vreg.h"
+#include "mock.h"
+#include "scanout.h"
+#include "render_core.h"
+#include "frame_library.h"
+#include "dma_crc.h"
+#include "tusb.h"
+
+#define NEVER  UINT64_MAX
+
+static uint64_t now_ns;
+
+// I2C: the bus of one block (the firmware only ever drives one at a time)
+
+#define I2C_EDGE_BITS  (I2C_IC_INTR_STAT_R_STOP_DET_BITS | I2C_IC_INTR_STAT_R_TX_ABRT_BITS)
+#define PRESENTED      0x80000000u   // data_cmd holds a byte for the firmware, not a new entry
+
+static i2c_hw_t i2c_hw[2] = {{.data_cmd = PRESENTED}, {.data_cmd = PRESENTED}};
+static i2c_inst_t i2c_inst[2] = {{&i2c_hw[0], 0, 100000}, {&i2c_hw[1], 1, 100000}};
+i2c_inst_t *const i2c0 = &i2c_inst[0];
+i2c_inst_t *const i2c1 = &i2c_inst[1];
+
+mock_i2c_stats_t mock_i2c_stats;
+
+static i2c_inst_t *bus = &i2c_inst[0];
+static irq_handler_t i2c_handler[2];
+static bool i2c_irq_enabled[2];
+
+static uint32_t tx_fifo[I2C_FIFO_DEPTH];
+static uint tx_head, tx_count;
+static uint8_t rx_fifo[I2C_FIFO_DEPTH];
+static uint rx_head, rx_count;
+static uint32_t edge_status;      // STOP_DET / TX_ABRT until the handler has seen them
+
+static bool in_transfer;          // between START and STOP
+static bool shifting;             // an entry is on the wire
+static uint32_t shift_entry;
+static uint64_t shift_start_ns, shift_end_ns;
+static uint write_index;          // bytes written in this transfer (the first one is the register)
+static uint read_index;
+
+static bool device_nak;
+static uint8_t device_reg;
+static uint8_t device_regs[256][16];
+
+// pick up an entry the firmware stored into data_cmd since we last looked
+static void capture_tx(void) {
+    i2c_hw_t *hw = bus->hw;
+    if (hw->data_cmd & PRESENTED) {
+        return;
+    }
+    if (tx_count < I2C_FIFO_DEPTH) {
+        tx_fifo[(tx_head + tx_count) % I2C_FIFO_DEPTH] = hw->data_cmd;
+        tx_count++;
+    } else {
+        mock_i2c_stats.fifo_overflows++;
+    }
+    hw->data_cmd = PRESENTED;
+}
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+    bus = i2c;
+    return i2c_set_baudrate(i2c, baudrate);
+}
+
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate) {
+    i2c->baudrate = baudrate;
+    return baudrate;
+}
+
+size_t i2c_get_write_available(i2c_inst_t *i2c) {
+    bus = i2c;
+    capture_tx();
+    return I2C_FIFO_DEPTH - tx_count;
+}
+
+size_t i2c_get_read_available(i2c_inst_t *i2c) {
+    bus = i2c;
+    capture_tx();
+    if (!rx_count) {
+        return 0;
+    }
+    // the firmware reads data_cmd right after asking
+    uint available = rx_count;
+    bus->hw->data_cmd = PRESENTED | rx_fifo[rx_head];
+    rx_head = (rx_head + 1) % I2C_FIFO_DEPTH;
+    rx_count--;
+    return available;
+}
+
+void mock_i2c_set_nak(bool nak) {
+    device_nak = nak;
+}
+
+void mock_i2c_set_register(uint8_t reg, const uint8_t *data, uint8_t length) {
+    memcpy(device_regs[reg], data, MIN(length, sizeof(device_regs[reg])));
+}
+
+// call the handler for as long as it has something to handle
+static void i2c_dispatch(void) {
+    i2c_hw_t *hw = bus->hw;
+    irq_handler_t handler = i2c_handler[bus->index];
+    if (!handler || !i2c_irq_enabled[bus->index]) {
+        return;
+    }
+    for (uint round = 0; round < 4; round++) {
+        capture_tx();
+        hw->raw_intr_stat = edge_status | (tx_count ? 0 : I2C_IC_INTR_STAT_R_TX_EMPTY_BITS) |
+                            (rx_count ? I2C_IC_INTR_STAT_R_RX_FULL_BITS : 0);
+        hw->intr_stat = hw->raw_intr_stat & hw->intr_mask;
+        if (!hw->intr_stat) {
+            return;
+        }
+        uint32_t seen = hw->intr_stat;
+        mock_i2c_stats.interrupts++;
+        handler();
+        edge_status &= ~seen;  // cleared by the handler reading clr_stop_det / clr_tx_abrt
+    }
+}
+
+// bit times an entry takes: START or repeated START and the address first, STOP after
+static uint entry_bits(uint32_t entry) {
+    uint bits = 9;
+    if (!in_transfer || (entry & I2C_IC_DATA_CMD_RESTART_BITS)) {
+        bits += 10;
+    }
+    if (entry & I2C_IC_DATA_CMD_STOP_BITS) {
+        bits += 1;
+    }
+    return bits;
+}
+
+static void start_entry(void) {
+    shift_entry = tx_fifo[tx_head];
+    tx_head = (tx_head + 1) % I2C_FIFO_DEPTH;
+    tx_count--;
+    shifting = true;
+    shift_start_ns = now_ns;
+    shift_end_ns = now_ns + (uint64_t)entry_bits(shift_entry) * 1000000000u / bus->baudrate;
+}
+
+static void stop_transfer(void) {
+    in_transfer = false;
+    write_index = 0;
+    read_index = 0;
+    edge_status |= I2C_IC_INTR_STAT_R_STOP_DET_BITS;
+    mock_i2c_stats.transactions++;
+}
+
+static void finish_entry(void) {
+    uint32_t entry = shift_entry;
+    shifting = false;
+    mock_i2c_stats.busy_ns += shift_end_ns - shift_start_ns;
+
+    if (!in_transfer && device_nak) {
+        // address not acknowledged: the controller flushes the TX FIFO and sends a STOP
+        mock_i2c_stats.naks++;
+        tx_count = 0;
+        edge_status |= I2C_IC_INTR_STAT_R_TX_ABRT_BITS;
+        stop_transfer();
+        return;
+    }
+    in_transfer = true;
+    mock_i2c_stats.bytes++;
+
+    if (entry & I2C_IC_DATA_CMD_CMD_BITS) {
+        if (rx_count < I2C_FIFO_DEPTH) {
+            rx_fifo[(rx_head + rx_count) % I2C_FIFO_DEPTH] = device_regs[device_reg][read_index % 16];
+            rx_count++;
+        }
+        read_index++;
+    } else {
+        if (write_index == 0) {
+            device_reg = entry & 0xFF;
+        } else {
+            device_regs[device_reg][(write_index - 1) % 16] = entry & 0xFF;
+        }
+        write_index++;
+    }
+    if (entry & I2C_IC_DATA_CMD_STOP_BITS) {
+        stop_transfer();
+    }
+}
+
+// IRQ
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+    if (num == I2C0_IRQ || num == I2C1_IRQ) {
+        i2c_handler[num - I2C0_IRQ] = handler;
+    }
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+    if (num == I2C0_IRQ || num == I2C1_IRQ) {
+        i2c_irq_enabled[num - I2C0_IRQ] = enabled;
+    }
+}
+
+// timer
+
+#define ALARMS 4
+
+static hardware_alarm_callback_t alarm_callback[ALARMS];
+static uint64_t alarm_target_ns[ALARMS] = {NEVER, NEVER, NEVER, NEVER};
+static bool alarm_claimed[ALARMS];
+
+uint64_t time_us_64(void) {
+    return now_ns / 1000;
+}
+
+uint64_t mock_time_ns(void) {
+    return now_ns;
+}
+
+int hardware_alarm_claim_unused(bool required) {
+    (void)required;
+    for (uint i = 0; i < ALARMS; i++) {
+        if (!alarm_claimed[i]) {
+            alarm_claimed[i] = true;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback) {
+    alarm_callback[alarm_num] = callback;
+}
+
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t target) {
+    if (target * 1000 <= now_ns) {
+        alarm_target_ns[alarm_num] = NEVER;
+        return true;
+    }
+    alarm_target_ns[alarm_num] = target * 1000;
+    return false;
+}
+
+void hardware_alarm_cancel(uint alarm_num) {
+    alarm_target_ns[alarm_num] = NEVER;
+}
+
+// scan-out
+
+scanout_stats_t scanout_stats;
+
+static void (*frame_callback)(void);
+static uint64_t frame_period_ns;
+static uint64_t frame_start_ns;
+static uint64_t next_frame_ns = NEVER;
+static uint16_t frame_height = 1;
+static const void *next_buffer;     // scanout_set_framebuffer(), taken up at the next frame boundary
+static const void *shown_buffer;
+
+void mock_scanout_start(uint32_t period_us, uint16_t height) {
+    frame_period_ns = (uint64_t)period_us * 1000;
+    frame_start_ns = now_ns;
+    next_frame_ns = period_us ? now_ns + frame_period_ns : NEVER;
+    frame_height = height;
+}
+
+void scanout_set_framebuffer(const void *buffer) {
+    next_buffer = buffer;
+}
+
+bool scanout_showing(const void *buffer) {
+    return shown_buffer == buffer;
+}
+
+void scanout_set_frame_callback(void (*callback)(void)) {
+    frame_callback = callback;
+}
+
+uint16_t scanout_beam_line(void) {
+    if (!frame_period_ns) {
+        return 0;
+    }
+    return (now_ns - frame_start_ns) * frame_height / frame_period_ns;
+}
+
+// the clock
+
+static void run_events(void) {
+    i2c_dispatch();
+    if (!shifting && tx_count) {
+        start_entry();
+    }
+}
+
+void mock_advance_us(uint64_t us) {
+    uint64_t target_ns = now_ns + us * 1000;
+
+    for (;;) {
+        capture_tx();
+        run_events();
+
+        uint64_t next_ns = target_ns;
+        if (shifting && shift_end_ns < next_ns) { next_ns = shift_end_ns; }
+        for (uint i = 0; i < ALARMS; i++) {
+            if (alarm_target_ns[i] < next_ns) { next_ns = alarm_target_ns[i]; }
+        }
+        if (next_frame_ns < next_ns) { next_ns = next_frame_ns; }
+        if (next_ns > now_ns) { now_ns = next_ns; }
+
+        if (shifting && shift_end_ns <= now_ns) {
+            finish_entry();
+            continue;
+        }
+        bool fired = false;
+        for (uint i = 0; i < ALARMS; i++) {
+            if (alarm_target_ns[i] <= now_ns) {
+                alarm_target_ns[i] = NEVER;
+                if (alarm_callback[i]) { alarm_callback[i](i); }
+                fired = true;
+            }
+        }
+        if (fired) {
+            continue;
+        }
+        if (next_frame_ns <= now_ns) {
+            frame_start_ns = next_frame_ns;
+            next_frame_ns += frame_period_ns;
+            scanout_stats.frames++;
+            shown_buffer = next_buffer;
+            if (frame_callback) { frame_callback(); }
+            continue;
+        }
+        if (now_ns >= target_ns) {
+            return;
+        }
+    }
+}
+
+bool mock_run_until(bool (*done)(void), uint64_t limit_us) {
+    uint64_t limit_ns = now_ns + limit_us * 1000;
+    while (!done()) {
+        if (now_ns >= limit_ns) {
+            return false;
+        }
+        mock_advance_us(1);
+    }
+    return true;
+}
+
+void sleep_us(uint64_t us) {
+    mock_advance_us(us);
+}
+
+void sleep_ms(uint32_t ms) {
+    mock_advance_us((uint64_t)ms * 1000);
+}
+
+// busy waits (i2c_queue_wait() etc.) spin on this: let the peripherals get on with it
+void tight_loop_contents(void) {
+    mock_advance_us(1);
+}
+
+// GPIO
+
+static bool gpio_out[32];
+static bool gpio_in[32];
+static bool gpio_is_output[32];
+
+void gpio_init(uint gpio) {
+    gpio_is_output[gpio] = false;
+    gpio_out[gpio] = false;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    gpio_is_output[gpio] = out;
+}
+
+void gpio_put(uint gpio, bool value) {
+    gpio_out[gpio] = value;
+}
+
+bool gpio_get(uint gpio) {
+    return gpio_is_output[gpio] ? gpio_out[gpio] : gpio_in[gpio];
+}
+
+void mock_gpio_set_input(uint gpio, bool value) {
+    gpio_in[gpio] = value;
+}
+
+bool mock_gpio_output(uint gpio) {
+    return gpio_out[gpio];
+}
+
+// clocks: only the system clock, and the core voltage it runs at
+
+static uint32_t sys_hz = 125000000;
+static enum vreg_voltage vreg = VREG_VOLTAGE_DEFAULT;
+
+void set_sys_clock_pll(uint32_t vco_freq, uint post_div1, uint post_div2) {
+    // the SDK asserts these (RP2040 datasheet, 2.18): from the 12 MHz crystal, refdiv 1
+    if (vco_freq < 750000000 || vco_freq > 1600000000 || vco_freq % 12000000 ||
+        post_div1 < 1 || post_div1 > 7 || post_div2 < 1 || post_div2 > 7) {
+        sys_hz = 0;  // no clock, for clock_get_hz() to show
+        return;
+    }
+    sys_hz = vco_freq / (post_div1 * post_div2);
+}
+
+uint32_t clock_get_hz(enum clock_index clk_index) {
+    return clk_index == clk_sys || clk_index == clk_peri ? sys_hz : 12000000;
+}
+
+void vreg_set_voltage(enum vreg_voltage voltage) {
+    vreg = voltage;
+}
+
+uint mock_vreg_mv(void) {
+    return 800 + (vreg - 0b0101) * 50;  // 0b0101 is 0.80 V, in 50 mV steps
+}
+
+// render core: no second core, the jobs run when they are submitted; their result is there
+// once the simulated time they take has passed
+
+render_stats_t render_stats;
+
+static struct {
+    render_done_fn done;
+    void *ctx;
+    int result;
+    bool collected;
+    uint64_t finish_ns;
+} jobs[RENDER_QUEUE_LENGTH];
+static render_handle_t next_job = 1;
+static uint64_t job_ns;
+static uint64_t core1_free_ns;      // the last job queued is done
+
+void mock_render_job_us(uint32_t us) {
+    job_ns = (uint64_t)us * 1000;
+}
+
+void render_init(void) {
+}
+
+render_handle_t render_submit(render_job_fn fn, render_done_fn done, void *ctx) {
+    render_handle_t handle = next_job++;
+    uint64_t begin = time_us_64();
+    jobs[handle % RENDER_QUEUE_LENGTH].result = fn(ctx);
+    stage_account(&render_stats.stage, begin);
+    jobs[handle % RENDER_QUEUE_LENGTH].done = done;
+    jobs[handle % RENDER_QUEUE_LENGTH].ctx = ctx;
+    jobs[handle % RENDER_QUEUE_LENGTH].collected = false;
+    core1_free_ns = MAX(core1_free_ns, now_ns) + job_ns;  // in order, one after the other
+    jobs[handle % RENDER_QUEUE_LENGTH].finish_ns = core1_free_ns;
+    return handle;
+}
+
+int render_status(render_handle_t handle) {
+    if (handle == 0 || handle >= next_job || next_job - handle > RENDER_QUEUE_LENGTH) {
+        return RENDER_ERROR_EXPIRED;
+    }
+    if (jobs[handle % RENDER_QUEUE_LENGTH].finish_ns > now_ns) {
+        return RENDER_PENDING;
+    }
+    return jobs[handle % RENDER_QUEUE_LENGTH].result;
+}
+
+void render_poll(void) {
+    for (uint i = 0; i < RENDER_QUEUE_LENGTH; i++) {
+        if (!jobs[i].collected && jobs[i].done && jobs[i].finish_ns <= now_ns) {
+            jobs[i].collected = true;
+            jobs[i].done(jobs[i].ctx, jobs[i].result);
+        }
+    }
+}
+
+bool render_busy(void) {
+    return core1_free_ns > now_ns;
+}
+
+// frame library: entries and data in host memory
+
+static const frame_library_entry_t *library_entries;
+static uint library_count;
+static const uint8_t *library_base;
+
+void mock_frame_library(const frame_library_entry_t *entries, uint count, const uint8_t *base) {
+    library_entries = entries;
+    library_count = count;
+    library_base = base;
+}
+
+const frame_library_entry_t *frame_library_entry(uint32_t index) {
+    return index < library_count ? &library_entries[index] : NULL;
+}
+
+const uint8_t *frame_library_data(const frame_library_entry_t *entry) {
+    return library_base + entry->offset;
+}
+
+// USB CDC: one FIFO each way
+
+static uint8_t cdc_rx[256 * 1024];
+static uint32_t cdc_rx_head, cdc_rx_tail;
+static uint8_t cdc_tx[16 * 1024];
+static uint32_t cdc_tx_length;
+
+void mock_cdc_receive(const void *data, uint32_t length) {
+    if (cdc_rx_head == cdc_rx_tail) {
+        cdc_rx_head = cdc_rx_tail = 0;
+    }
+    length = MIN(length, sizeof(cdc_rx) - cdc_rx_tail);
+    memcpy(&cdc_rx[cdc_rx_tail], data, length);
+    cdc_rx_tail += length;
+}
+
+uint32_t mock_cdc_sent(void *data, uint32_t max) {
+    uint32_t count = MIN(max, cdc_tx_length);
+    memcpy(data, cdc_tx, count);
+    memmove(cdc_tx, &cdc_tx[count], cdc_tx_length - count);
+    cdc_tx_length -= count;
+    return count;
+}
+
+bool tud_cdc_connected(void) {
+    return true;
+}
+
+uint32_t tud_cdc_available(void) {
+    return cdc_rx_tail - cdc_rx_head;
+}
+
+uint32_t tud_cdc_read(void *buffer, uint32_t bufsize) {
+    uint32_t count = MIN(MIN(bufsize, MOCK_CDC_PACKET), cdc_rx_tail - cdc_rx_head);
+    memcpy(buffer, &cdc_rx[cdc_rx_head], count);
+    cdc_rx_head += count;
+    return count;
+}
+
+uint32_t tud_cdc_write(const void *buffer, uint32_t bufsize) {
+    uint32_t count = MIN(bufsize, sizeof(cdc_tx) - cdc_tx_length);
+    memcpy(&cdc_tx[cdc_tx_length], buffer, count);
+    cdc_tx_length += count;
+    return count;
+}
+
+uint32_t tud_cdc_write_flush(void) {
+    return 0;
+}
+
+// DMA sniffer: the same CRC-32 (zlib), bit by bit
+
+uint32_t dma_crc32(const uint8_t *data, uint32_t count) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < count; i++) {
+        crc ^= data[i];
+        for (uint bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,89 @@
+/**
+ * Simulated RP2040 peripherals for the host build
+ *
+ * The portable firmware modules are compiled unchanged against the pico-sdk headers in
+ * host/sdk, which are backed by this file instead of the hardware. Everything runs on one
+ * simulated clock that only moves when the bench calls mock_advance_us() (or the firmware
+ * busy waits, sleeps or spins in tight_loop_contents()), so bus timing, alarms and frame
+ * boundaries come out the same on every run and on every machine:
+ *
+ *  - I2C: the FIFO entries the firmware writes go over a simulated bus at the baud rate it
+ *    set, to a device at the target address that keeps whatever is written to a register (a
+ *    command's parameters) and returns it on a read. The interrupt is raised like on the
+ *    RP2040: STOP_DET, TX_ABRT, TX_EMPTY and RX_FULL.
+ *  - timer: hardware alarms, fired when the clock passes their target
+ *  - scan-out: frame boundaries every mock_scanout_start() period, which call the frame
+ *    callback (as the DMA interrupt does), move scanout_beam_line() and take up the buffer
+ *    passed to scanout_set_framebuffer()
+ *  - render core: jobs run straight away on the calling thread, but their results are only
+ *    there after mock_render_job_us() of simulated time each (one after the other, like core1)
+ *  - frame library: a table and frames in host memory
+ *  - GPIO: inputs are set by the bench
+ *  - clocks: clock_get_hz() returns what set_sys_clock_pll() made (0 for PLL settings out of
+ *    range), and the core voltage is remembered
+ *  - USB CDC: bytes from the host are queued with mock_cdc_receive() and handed out at most
+ *    MOCK_CDC_PACKET at a time (a USB full speed packet); what the firmware writes is collected
+ *    for mock_cdc_sent()
+ *  - DMA sniffer: dma_crc32() is computed in software
+ *
+ * Interrupt handlers run from within the mock, never in the middle of the firmware's own
+ * code, so the spin locks are no-ops.
+ */
+#ifndef HOST_MOCK_H
+#define HOST_MOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/types.h"
+#include "frame_library.h"
+
+typedef struct {
+    uint32_t transactions;     // START to STOP
+    uint32_t naks;             // address not acknowledged
+    uint32_t bytes;            // FIFO entries on the bus
+    uint32_t interrupts;       // calls of the I2C interrupt handler
+    uint32_t fifo_overflows;   // writes to a full TX FIFO (lost)
+    uint64_t busy_ns;          // time the bus was not idle
+} mock_i2c_stats_t;
+
+extern mock_i2c_stats_t mock_i2c_stats;
+
+// run the simulated clock <us> forward, with everything it triggers
+void mock_advance_us(uint64_t us);
+
+// run until <done>() returns true or <limit_us> has passed; false on the limit
+bool mock_run_until(bool (*done)(void), uint64_t limit_us);
+
+// simulated time in ns (time_us_64() is this / 1000)
+uint64_t mock_time_ns(void);
+
+// the I2C device does (not) acknowledge its address, e.g. while the DLPC boots
+void mock_i2c_set_nak(bool nak);
+
+// the parameters the device returns for <reg>
+void mock_i2c_set_register(uint8_t reg, const uint8_t *data, uint8_t length);
+
+// frame boundaries every <period_us> from now on (0 stops them)
+void mock_scanout_start(uint32_t period_us, uint16_t height);
+
+// every core1 job takes <us> of simulated time from now on (default 0)
+void mock_render_job_us(uint32_t us);
+
+// the frame library: <count> entries, frame_library_data() is <base> + the entry's offset
+void mock_frame_library(const frame_library_entry_t *entries, uint count, const uint8_t *base);
+
+void mock_gpio_set_input(uint gpio, bool value);
+bool mock_gpio_output(uint gpio);
+
+// the core voltage vreg_set_voltage() set, in mV
+uint mock_vreg_mv(void);
+
+#define MOCK_CDC_PACKET  64
+
+// bytes from the host, read by the firmware with tud_cdc_read()
+void mock_cdc_receive(const void *data, uint32_t length);
+
+// take up to <max> of the bytes the firmware has written since the last call; returns the count
+uint32_t mock_cdc_sent(void *data, uint32_t max);
+
+#endif
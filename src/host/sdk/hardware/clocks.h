@@ -0,0 +1,14 @@
+/**
+ * Host build: the system clock, as set_sys_clock_pll() (pico/stdlib.h) left it. It starts at
+ * the SDK's default 125 MHz.
+ */
+#ifndef HOST_HARDWARE_CLOCKS_H
+#define HOST_HARDWARE_CLOCKS_H
+
+#include "pico/types.h"
+
+enum clock_index { clk_gpout0, clk_gpout1, clk_gpout2, clk_gpout3, clk_ref, clk_sys, clk_peri, clk_usb, clk_adc, clk_rtc };
+
+uint32_t clock_get_hz(enum clock_index clk_index);
+
+#endif
@@ -0,0 +1,18 @@
+/**
+ * Host build: GPIOs. Outputs are only remembered; inputs read what the test bench set with
+ * mock_gpio_set_input().
+ */
+#ifndef HOST_HARDWARE_GPIO_H
+#define HOST_HARDWARE_GPIO_H
+
+#include "pico/types.h"
+
+#define GPIO_IN   false
+#define GPIO_OUT  true
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * Host build: an I2C block with the registers of the RP2040's DW_apb_i2c that the firmware
+ * touches. The mock (see host/mock.c) moves the FIFO entries over a simulated bus at the set
+ * baud rate and raises the interrupt like the hardware does.
+ *
+ * Plain memory can't see a register access, so the mock picks up a write to data_cmd the
+ * next time the firmware asks for FIFO room or data (the firmware always asks before every
+ * access), and clears the interrupt sources that the hardware clears on reading clr_*
+ * itself once the handler has returned.
+ */
+#ifndef HOST_HARDWARE_I2C_H
+#define HOST_HARDWARE_I2C_H
+
+#include <stddef.h>
+#include "pico/types.h"
+
+typedef struct {
+    volatile uint32_t tar;
+    volatile uint32_t data_cmd;
+    volatile uint32_t intr_stat;
+    volatile uint32_t intr_mask;
+    volatile uint32_t raw_intr_stat;
+    volatile uint32_t rx_tl;
+    volatile uint32_t tx_tl;
+    volatile uint32_t clr_intr;
+    volatile uint32_t clr_tx_abrt;
+    volatile uint32_t clr_stop_det;
+    volatile uint32_t enable;
+} i2c_hw_t;
+
+typedef struct i2c_inst {
+    i2c_hw_t *hw;
+    uint index;
+    uint baudrate;
+} i2c_inst_t;
+
+extern i2c_inst_t *const i2c0;
+extern i2c_inst_t *const i2c1;
+
+#define I2C_IC_DATA_CMD_CMD_BITS          0x00000100
+#define I2C_IC_DATA_CMD_STOP_BITS         0x00000200
+#define I2C_IC_DATA_CMD_RESTART_BITS      0x00000400
+
+#define I2C_IC_INTR_MASK_M_RX_FULL_BITS   0x00000004
+#define I2C_IC_INTR_MASK_M_TX_EMPTY_BITS  0x00000010
+#define I2C_IC_INTR_MASK_M_TX_ABRT_BITS   0x00000040
+#define I2C_IC_INTR_MASK_M_STOP_DET_BITS  0x00000200
+#define I2C_IC_INTR_STAT_R_RX_FULL_BITS   0x00000004
+#define I2C_IC_INTR_STAT_R_TX_EMPTY_BITS  0x00000010
+#define I2C_IC_INTR_STAT_R_TX_ABRT_BITS   0x00000040
+#define I2C_IC_INTR_STAT_R_STOP_DET_BITS  0x00000200
+
+#define I2C_FIFO_DEPTH  16
+
+static inline i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c) {
+    return i2c->hw;
+}
+
+static inline uint i2c_hw_index(i2c_inst_t *i2c) {
+    return i2c->index;
+}
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate);
+size_t i2c_get_write_available(i2c_inst_t *i2c);
+size_t i2c_get_read_available(i2c_inst_t *i2c);
+
+#endif
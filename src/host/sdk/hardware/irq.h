@@ -0,0 +1,17 @@
+/**
+ * Host build: interrupt handlers, called by the mocks when their peripheral raises the interrupt
+ */
+#ifndef HOST_HARDWARE_IRQ_H
+#define HOST_HARDWARE_IRQ_H
+
+#include "pico/types.h"
+
+#define I2C0_IRQ  23
+#define I2C1_IRQ  24
+
+typedef void (*irq_handler_t)(void);
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+
+#endif
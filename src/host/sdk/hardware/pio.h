@@ -0,0 +1,14 @@
+/**
+ * Host build: the PIO handle and program types, for the headers that pass them around. Nothing on the host
+ * drives a state machine; the scan-out is simulated by host/mock.c.
+ */
+#ifndef HOST_HARDWARE_PIO_H
+#define HOST_HARDWARE_PIO_H
+
+#include "pico/types.h"
+
+typedef struct pio_hw pio_hw_t;
+typedef pio_hw_t *PIO;
+typedef struct pio_program pio_program_t;
+
+#endif
@@ -0,0 +1,32 @@
+/**
+ * Host build: spin locks. Interrupts only run from within the mocks, never concurrently with
+ * the caller, so there is nothing to lock.
+ */
+#ifndef HOST_HARDWARE_SYNC_H
+#define HOST_HARDWARE_SYNC_H
+
+#include "pico/types.h"
+
+typedef volatile uint32_t spin_lock_t;
+
+static inline int spin_lock_claim_unused(bool required) {
+    (void)required;
+    return 0;
+}
+
+static inline spin_lock_t *spin_lock_init(uint lock_num) {
+    static spin_lock_t locks[32];
+    return &locks[lock_num];
+}
+
+static inline uint32_t spin_lock_blocking(spin_lock_t *lock) {
+    (void)lock;
+    return 0;
+}
+
+static inline void spin_unlock(spin_lock_t *lock, uint32_t saved_irq) {
+    (void)lock;
+    (void)saved_irq;
+}
+
+#endif
@@ -0,0 +1,34 @@
+/**
+ * Host build: the part of the pico-sdk's pico/stdlib.h the portable modules use
+ *
+ * Time is the simulated time of the mocks (see host/mock.h), not the wall clock.
+ */
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "pico/types.h"
+#include "pico/time.h"
+
+#define __not_in_flash_func(func)  func
+#define __time_critical_func(func) func
+
+#define count_of(a)  (sizeof(a) / sizeof((a)[0]))
+
+#ifndef MIN
+#define MIN(a, b)  ((b) > (a) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b)  ((a) > (b) ? (a) : (b))
+#endif
+
+// the system clock from the PLL (see hardware/clocks.h); the mock checks the PLL's limits
+void set_sys_clock_pll(uint32_t vco_freq, uint post_div1, uint post_div2);
+
+// busy waits spin on this; it moves the simulated clock on (see host/mock.c)
+void tight_loop_contents(void);
+static inline void __compiler_memory_barrier(void) { __asm__ volatile ("" : : : "memory"); }
+
+#endif
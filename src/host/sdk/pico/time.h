@@ -0,0 +1,23 @@
+/**
+ * Host build: pico-sdk time functions on the simulated clock (see host/mock.h)
+ */
+#ifndef HOST_PICO_TIME_H
+#define HOST_PICO_TIME_H
+
+#include "pico/types.h"
+
+uint64_t time_us_64(void);
+
+static inline uint32_t time_us_32(void) {
+    return (uint32_t)time_us_64();
+}
+
+static inline absolute_time_t make_timeout_time_us(uint64_t us) {
+    return time_us_64() + us;
+}
+
+// advances the simulated clock (and runs what it triggers), see mock_advance_us()
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+#endif
@@ -0,0 +1,248 @@
+/**
+ * Host check of the USB upload link (usb_link.h)
+ *
+ * Feeds packets to usb_link_poll() through the simulated CDC FIFO (see mock.h), which hands
+ * them out a USB packet at a time like TinyUSB does, and checks every ack and what ends up in
+ * the framebuffer or staging area:
+ *
+ *  - a clean upload into the framebuffer arrives complete
+ *  - a chunk with a bad CRC is NAKed and not written; its retransmit is
+ *  - a sequence gap is NAKed with the seq to resend from, the chunk after the gap is not
+ *    written, and a duplicate of a chunk already received is acked and dropped
+ *  - a BEGIN for the staging area is refused while it is locked, and accepted once it isn't
+ *  - a chunk outside the upload is refused
+ *
+ * It then times a whole 2-bit frame going through the link in 4 kB chunks, and how much of
+ * that is the copy from the chunk buffer into the framebuffer. The CRC is computed in software
+ * here rather than by the DMA sniffer, so the share of the copy is lower than on the pico.
+ *
+ * Prints each failed check and exits with 1 if there was one:
+ *
+ *   ./dlp_usb_link_check
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "mock.h"
+#include "framebuffer.h"
+#include "usb_link.h"
+#include "staging.h"
+#include "dma_crc.h"
+
+#define FB_BYTES     10000
+#define CHUNK        4096
+#define FRAME_BYTES  (FB_HEIGHT * FB_ROW_BYTES(FB_WIDTH, 2))
+
+static uint failures;
+
+#define CHECK(cond, ...)  do { if (!(cond)) { failures++; printf("  FAIL: " __VA_ARGS__); printf("\n"); } } while (0)
+
+static uint8_t fb[FB_BYTES] __attribute__((aligned(4)));
+static uint8_t data[FB_BYTES];
+static uint8_t frame[FRAME_BYTES] __attribute__((aligned(4)));
+static uint8_t frame_data[FRAME_BYTES];
+
+static uint64_t link_ns;    // spent in usb_link_poll()
+
+// CPU time of this thread, as in bench.c
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// the last upload handed over at USB_PKT_END
+static struct {
+    uint count;
+    uint8_t target;
+    uint8_t *data;
+    uint32_t length;
+} handled;
+
+static int upload_complete(uint8_t target, uint8_t *upload, uint32_t length) {
+    handled.count++;
+    handled.target = target;
+    handled.data = upload;
+    handled.length = length;
+    return 0;
+}
+
+static void put_u16(uint8_t *p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t value) {
+    put_u16(p, value & 0xFFFF);
+    put_u16(p + 2, value >> 16);
+}
+
+// send a packet (with a CRC that doesn't match if <corrupt>) and return the status of its ack;
+// *acked_seq is the seq the ack names
+static int send(uint8_t type, uint16_t seq, uint32_t offset, const uint8_t *payload, uint16_t length,
+                bool corrupt, uint16_t *acked_seq) {
+    static uint8_t packet[16 + USB_LINK_MAX_CHUNK];
+    packet[0] = 0xD1;
+    packet[1] = 0x50;
+    packet[2] = type;
+    packet[3] = 0;
+    put_u16(&packet[4], seq);
+    put_u16(&packet[6], length);
+    put_u32(&packet[8], offset);
+    put_u32(&packet[12], dma_crc32(payload, length) ^ (corrupt ? 1 : 0));
+    memcpy(&packet[16], payload, length);
+    mock_cdc_receive(packet, 16 + length);
+    uint64_t begin = now_ns();
+    usb_link_poll();
+    link_ns += now_ns() - begin;
+
+    uint8_t ack[12];
+    if (mock_cdc_sent(ack, sizeof(ack)) != sizeof(ack) || ack[0] != 0xD1 || ack[1] != 0x5A || ack[3] != type) {
+        CHECK(false, "no ack for packet type %u seq %u", type, seq);
+        return -1;
+    }
+    if (acked_seq) { *acked_seq = ack[4] | (ack[5] << 8); }
+    return ack[2];
+}
+
+static int begin(uint16_t seq, uint8_t target, uint32_t length) {
+    uint8_t payload[8] = {target};
+    put_u32(&payload[4], length);
+    return send(USB_PKT_BEGIN, seq, 0, payload, sizeof(payload), false, NULL);
+}
+
+// DATA packet <seq> of an upload that began with <first_seq>, carrying chunk <seq - first_seq - 1>
+static int chunk(uint16_t first_seq, uint16_t seq, uint32_t length, bool corrupt, uint16_t *acked_seq) {
+    uint32_t offset = (uint32_t)(uint16_t)(seq - first_seq - 1) * CHUNK;
+    return send(USB_PKT_DATA, seq, offset, &data[offset], MIN(CHUNK, length - offset), corrupt, acked_seq);
+}
+
+static int end(uint16_t seq) {
+    return send(USB_PKT_END, seq, 0, NULL, 0, false, NULL);
+}
+
+static void check_clean_upload(void) {
+    memset(fb, 0xEE, sizeof(fb));
+    uint before = handled.count;
+    CHECK(begin(1, USB_TARGET_FRAMEBUFFER, FB_BYTES) == USB_ACK_OK, "clean upload: BEGIN refused");
+    for (uint16_t seq = 2; seq <= 4; seq++) {
+        CHECK(chunk(1, seq, FB_BYTES, false, NULL) == USB_ACK_OK, "clean upload: DATA %u refused", seq);
+    }
+    CHECK(end(5) == USB_ACK_OK, "clean upload: END refused");
+    CHECK(handled.count == before + 1 && handled.target == USB_TARGET_FRAMEBUFFER && handled.data == fb &&
+          handled.length == FB_BYTES, "clean upload: not handed over");
+    CHECK(memcmp(fb, data, FB_BYTES) == 0, "clean upload: framebuffer differs");
+}
+
+static void check_crc_error(void) {
+    memset(fb, 0xEE, sizeof(fb));
+    uint32_t crc_errors = usb_link_stats.crc_errors;
+    CHECK(begin(100, USB_TARGET_FRAMEBUFFER, FB_BYTES) == USB_ACK_OK, "CRC error: BEGIN refused");
+    CHECK(chunk(100, 101, FB_BYTES, false, NULL) == USB_ACK_OK, "CRC error: first DATA refused");
+    CHECK(chunk(100, 102, FB_BYTES, true, NULL) == USB_ACK_CRC, "CRC error: corrupt DATA not NAKed");
+    CHECK(usb_link_stats.crc_errors == crc_errors + 1, "CRC error: not counted");
+    CHECK(fb[CHUNK] == 0xEE && fb[2 * CHUNK - 1] == 0xEE, "CRC error: corrupt chunk written to the framebuffer");
+    CHECK(chunk(100, 102, FB_BYTES, false, NULL) == USB_ACK_OK, "CRC error: retransmit refused");
+    CHECK(chunk(100, 103, FB_BYTES, false, NULL) == USB_ACK_OK, "CRC error: last DATA refused");
+    CHECK(end(104) == USB_ACK_OK, "CRC error: END refused");
+    CHECK(memcmp(fb, data, FB_BYTES) == 0, "CRC error: framebuffer differs after the retransmit");
+}
+
+static void check_sequence_gap(void) {
+    memset(fb, 0xEE, sizeof(fb));
+    uint32_t seq_errors = usb_link_stats.seq_errors;
+    uint16_t acked_seq;
+    // the seq wraps around in the middle of the upload
+    CHECK(begin(0xFFFE, USB_TARGET_FRAMEBUFFER, FB_BYTES) == USB_ACK_OK, "sequence gap: BEGIN refused");
+    CHECK(chunk(0xFFFE, 0xFFFF, FB_BYTES, false, NULL) == USB_ACK_OK, "sequence gap: first DATA refused");
+    CHECK(chunk(0xFFFE, 1, FB_BYTES, false, &acked_seq) == USB_ACK_SEQUENCE && acked_seq == 0,
+          "sequence gap: DATA after a lost packet not NAKed with seq 0 (got seq %u)", acked_seq);
+    CHECK(usb_link_stats.seq_errors == seq_errors + 1, "sequence gap: not counted");
+    CHECK(fb[2 * CHUNK] == 0xEE, "sequence gap: chunk after the gap written");
+    CHECK(chunk(0xFFFE, 0, FB_BYTES, false, NULL) == USB_ACK_OK, "sequence gap: resent DATA refused");
+    CHECK(chunk(0xFFFE, 0xFFFF, FB_BYTES, false, &acked_seq) == USB_ACK_OK && acked_seq == 0xFFFF,
+          "sequence gap: duplicate DATA not acked");
+    CHECK(chunk(0xFFFE, 1, FB_BYTES, false, NULL) == USB_ACK_OK, "sequence gap: resent DATA refused");
+    CHECK(usb_link_stats.seq_errors == seq_errors + 1, "sequence gap: duplicate counted as an error");
+    CHECK(end(2) == USB_ACK_OK, "sequence gap: END refused");
+    CHECK(memcmp(fb, data, FB_BYTES) == 0, "sequence gap: framebuffer differs after the resend");
+}
+
+static void check_refused_begin(void) {
+    uint before = handled.count;
+    staging_locked = true;  // e.g. a bit-plane sequence being exposed from it
+    CHECK(begin(200, USB_TARGET_FRAME, FB_BYTES) == USB_ACK_STATE, "refused BEGIN: accepted while staging is locked");
+    CHECK(chunk(200, 201, FB_BYTES, false, NULL) == USB_ACK_STATE, "refused BEGIN: DATA accepted without an upload");
+    CHECK(end(202) == USB_ACK_STATE, "refused BEGIN: END accepted without an upload");
+    CHECK(handled.count == before, "refused BEGIN: upload handed over");
+
+    staging_locked = false;
+    CHECK(begin(300, USB_TARGET_FRAME, FB_BYTES) == USB_ACK_OK, "refused BEGIN: retry refused once unlocked");
+    for (uint16_t seq = 301; seq <= 303; seq++) {
+        CHECK(chunk(300, seq, FB_BYTES, false, NULL) == USB_ACK_OK, "refused BEGIN: DATA %u refused", seq);
+    }
+    CHECK(end(304) == USB_ACK_OK, "refused BEGIN: END refused");
+    CHECK(handled.count == before + 1 && handled.target == USB_TARGET_FRAME && handled.data == staging_buffer,
+          "refused BEGIN: retried upload not handed over");
+    CHECK(memcmp(staging_buffer, data, FB_BYTES) == 0, "refused BEGIN: staging area differs");
+}
+
+static void check_range(void) {
+    CHECK(begin(400, USB_TARGET_FRAMEBUFFER, FB_BYTES + 1) == USB_ACK_RANGE, "range: BEGIN larger than the framebuffer");
+    CHECK(begin(500, USB_TARGET_FRAMEBUFFER, CHUNK) == USB_ACK_OK, "range: BEGIN refused");
+    CHECK(send(USB_PKT_DATA, 501, CHUNK - 8, data, 16, false, NULL) == USB_ACK_RANGE, "range: DATA past the end");
+    CHECK(end(501) == USB_ACK_OK, "range: END refused");
+}
+
+// a whole frame through the link, best of a few runs, next to the copies out of the chunk buffer
+static void time_frame_upload(void) {
+    for (uint i = 0; i < FRAME_BYTES; i++) {
+        frame_data[i] = (i * 13 + (i >> 9)) & 0xFF;
+    }
+    usb_link_init(frame, FRAME_BYTES, upload_complete);
+    uint64_t best = UINT64_MAX, best_copy = UINT64_MAX;
+    for (uint run = 0; run < 5; run++) {
+        memset(frame, 0, FRAME_BYTES);
+        uint16_t seq = 1000 + run * 100;
+        uint8_t payload[8] = {USB_TARGET_FRAMEBUFFER};
+        put_u32(&payload[4], FRAME_BYTES);
+        link_ns = 0;
+        CHECK(send(USB_PKT_BEGIN, seq, 0, payload, sizeof(payload), false, NULL) == USB_ACK_OK, "frame upload: BEGIN refused");
+        for (uint32_t offset = 0; offset < FRAME_BYTES; offset += CHUNK) {
+            seq++;
+            CHECK(send(USB_PKT_DATA, seq, offset, &frame_data[offset], MIN(CHUNK, FRAME_BYTES - offset), false, NULL) ==
+                  USB_ACK_OK, "frame upload: DATA %u refused", seq);
+        }
+        CHECK(end(seq + 1) == USB_ACK_OK, "frame upload: END refused");
+        best = MIN(best, link_ns);
+
+        uint64_t begin = now_ns();
+        for (uint32_t offset = 0; offset < FRAME_BYTES; offset += CHUNK) {
+            memcpy(&frame[offset], &frame_data[offset], MIN(CHUNK, FRAME_BYTES - offset));
+        }
+        best_copy = MIN(best_copy, now_ns() - begin);
+    }
+    CHECK(memcmp(frame, frame_data, FRAME_BYTES) == 0, "frame upload: framebuffer differs");
+    printf("frame upload: %u bytes in %.0f us on the host (%.0f MB/s), %.0f us (%.1f%%) of it copying out of the chunk buffer\n",
+           FRAME_BYTES, best / 1e3, FRAME_BYTES * 1e3 / best, best_copy / 1e3, 100.0 * best_copy / best);
+}
+
+int main(void) {
+    for (uint i = 0; i < FB_BYTES; i++) {
+        data[i] = (i * 7 + (i >> 8)) & 0xFF;
+    }
+    usb_link_init(fb, FB_BYTES, upload_complete);
+
+    check_clean_upload();
+    check_crc_error();
+    check_sequence_gap();
+    check_refused_begin();
+    check_range();
+    time_frame_upload();
+
+    printf("%" PRIu32 " packets, %" PRIu32 " CRC errors, %" PRIu32 " sequence errors, %u failures\n",
+           usb_link_stats.packets, usb_link_stats.crc_errors, usb_link_stats.seq_errors, failures);
+    return failures ? 1 : 0;
+}
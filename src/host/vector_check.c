@@ -0,0 +1,130 @@
+/**
+ * Host check of the display-list rasteriser (vector.h) on a real list
+ *
+ * Rasterises a DLPV file, e.g. the front copper layer compiled by utils/gerber_to_vector.py,
+ * with vector.c and compares the result with the per-pixel reference raster the script wrote
+ * next to it (--reference: the packed rows of the field, as in the framebuffer, at its --bpp):
+ *
+ *   python utils/gerber_to_vector.py PCB/production/micromirror-board-controller-F_Cu.gbr --reference
+ *   build-host/dlp_vector_check PCB/production/micromirror-board-controller-F_Cu.dlpv \
+ *       PCB/production/micromirror-board-controller-F_Cu_reference.raw
+ *
+ * The bit depth follows from the size of the reference. Prints how many covered pixels differ
+ * and the rasteriser's speed in lines/ms, and exits with 1 if the list does not validate, if a
+ * primitive or edge would be dropped, or if more than --tolerance of the covered pixels differ
+ * (only pixels whose centre sits right on an edge should).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "vector.h"
+
+#define MAX_FILE  (512 * 1024)
+
+static uint32_t list[MAX_FILE / 4];
+static uint32_t frame[FB_HEIGHT * FB_ROW_BYTES(FB_WIDTH, 8) / 4];
+static uint8_t reference[FB_HEIGHT * FB_ROW_BYTES(FB_WIDTH, 8)];
+static vector_raster_t raster;
+
+// CPU time of this thread, as in bench.c
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static long load(const char *path, void *buffer, long size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        printf("error: cannot open %s\n", path);
+        return -1;
+    }
+    long length = (long)fread(buffer, 1, size, file);
+    bool more = fgetc(file) != EOF;
+    fclose(file);
+    if (more) {
+        printf("error: %s is larger than %ld bytes\n", path, size);
+        return -1;
+    }
+    return length;
+}
+
+int main(int argc, char **argv) {
+    double tolerance = 0.001;
+    uint repeat = 20;
+    const char *paths[2];
+    uint path_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--tolerance") && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+            int runs = atoi(argv[++i]);
+            repeat = MAX(runs, 1);
+        } else if (argv[i][0] != '-' && path_count < 2) {
+            paths[path_count++] = argv[i];
+        } else {
+            path_count = 0;
+            break;
+        }
+    }
+    if (path_count != 2) {
+        printf("usage: %s LIST.dlpv REFERENCE.raw [--tolerance SHARE] [--repeat N]\n", argv[0]);
+        return 2;
+    }
+
+    long length = load(paths[0], list, sizeof(list));
+    long reference_length = load(paths[1], reference, sizeof(reference));
+    if (length < 0 || reference_length < 0) { return 2; }
+
+    const uint8_t *data = (const uint8_t *)list;
+    uint16_t width = length >= VECTOR_HEADER_SIZE ? data[8] | (data[9] << 8) : 0;
+    uint16_t height = length >= VECTOR_HEADER_SIZE ? data[10] | (data[11] << 8) : 0;
+    int status = vector_validate(data, length, FB_WIDTH, FB_HEIGHT);
+    if (status != VECTOR_OK) {
+        printf("error: %s does not validate (%d)\n", paths[0], status);
+        return 1;
+    }
+    uint8_t bpp = 0;
+    for (uint8_t b = 1; b <= 8; b *= 2) {
+        if (reference_length == (long)height * FB_ROW_BYTES(width, b)) { bpp = b; }
+    }
+    if (!bpp) {
+        printf("error: %s is not a %ux%u frame at 1, 2, 4 or 8 bits per pixel\n", paths[1], width, height);
+        return 2;
+    }
+
+    framebuffer_t fb;
+    fb_init(&fb, frame, width, height, bpp);
+    vector_start(&raster, data);
+    uint64_t best = UINT64_MAX;
+    for (uint r = 0; r < repeat; r++) {
+        uint64_t begin = now_ns();
+        vector_render(&raster, &fb);
+        best = MIN(best, now_ns() - begin);
+    }
+
+    framebuffer_t expected;
+    fb_init(&expected, reference, width, height, bpp);
+    uint32_t differ = 0, covered = 0;
+    for (uint16_t y = 0; y < height; y++) {
+        for (uint16_t x = 0; x < width; x++) {
+            uint8_t value = fb_get_pixel(&expected, x, y);
+            covered += value != 0;
+            differ += fb_get_pixel(&fb, x, y) != value;
+        }
+    }
+    covered = MAX(covered, 1);
+
+    printf("%s: %u primitives, %u bytes, %u-bit\n", paths[0], raster.primitives, (uint)length, bpp);
+    printf("vector.c: %.1f lines/ms (best of %u); up to %u primitives and %u polygon edges on a line (limits: %d, %d)\n",
+           height / (best / 1e6), repeat, raster.max_active, raster.max_edges, VECTOR_MAX_ACTIVE, VECTOR_MAX_EDGES);
+    printf("reference: %u of %u covered pixels differ (%.4f%%)\n", differ, covered, 100.0 * differ / covered);
+    bool ok = raster.dropped == 0 && differ <= tolerance * covered;
+    if (raster.dropped) {
+        printf("ERROR: %u primitives or edges dropped\n", (uint)raster.dropped);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,272 @@
+/**
+ * Interrupt driven I2C command queue (see i2c_queue.h)
+ *
+ * The I2C interrupt of the given block, and one spin lock
+ */
+#include <stdio.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "i2c_queue.h"
+
+// always wanted: end of a command, NAKs, and received bytes (the RX threshold is one byte)
+#define BASE_INTERRUPTS  (I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS | \
+                          I2C_IC_INTR_MASK_M_RX_FULL_BITS)
+
+typedef struct {
+    uint8_t reg;
+    uint8_t length;
+    bool read;
+    int8_t status;
+    uint8_t data[I2C_QUEUE_MAX_DATA];   // write data
+    uint8_t *dst;                       // read destination
+    uint64_t queued_us;
+    uint64_t completed_us;
+} command_t;
+
+i2c_queue_stats_t i2c_queue_stats;
+
+static i2c_inst_t *bus;
+static spin_lock_t *lock;
+
+// the command with handle h lives in commands[h % I2C_QUEUE_LENGTH]; handles up to and
+// including done_handle are complete, the ones after that up to next_handle are waiting
+static command_t commands[I2C_QUEUE_LENGTH];
+static volatile uint32_t next_handle = 1;
+static volatile uint32_t done_handle;
+static uint32_t logged_handle;
+
+// command on the bus
+static bool bus_active;
+static bool aborted;
+static uint32_t tx_index;   // FIFO entries written (register address included)
+static uint32_t rx_index;   // bytes received
+
+static inline command_t *current_command(void) {
+    return &commands[(done_handle + 1) % I2C_QUEUE_LENGTH];
+}
+
+// push as much of the current command into the TX FIFO as fits. Reads need one (CMD) entry
+// per byte to clock in.
+static void fill_tx(void) {
+    i2c_hw_t *hw = i2c_get_hw(bus);
+    command_t *cmd = current_command();
+    uint32_t total = 1 + cmd->length;
+
+    while (!aborted && tx_index < total && i2c_get_write_available(bus)) {
+        uint32_t entry;
+        if (tx_index == 0) {
+            entry = cmd->reg;
+        } else if (cmd->read) {
+            entry = I2C_IC_DATA_CMD_CMD_BITS | (tx_index == 1 ? I2C_IC_DATA_CMD_RESTART_BITS : 0);
+        } else {
+            entry = cmd->data[tx_index - 1];
+        }
+        if (tx_index == total - 1) {
+            entry |= I2C_IC_DATA_CMD_STOP_BITS;
+        }
+        hw->data_cmd = entry;
+        tx_index++;
+    }
+
+    // more to send: come back when the FIFO has run empty
+    hw->intr_mask = BASE_INTERRUPTS | (!aborted && tx_index < total ? I2C_IC_INTR_MASK_M_TX_EMPTY_BITS : 0);
+}
+
+static void start_next(void) {
+    bus_active = (done_handle + 1 != next_handle);
+    if (!bus_active) {
+        i2c_get_hw(bus)->intr_mask = BASE_INTERRUPTS;
+        return;
+    }
+    aborted = false;
+    tx_index = 0;
+    rx_index = 0;
+    fill_tx();
+}
+
+static void finish_command(void) {
+    command_t *cmd = current_command();
+    cmd->completed_us = time_us_64();
+    cmd->status = (aborted || (cmd->read && rx_index < cmd->length)) ? I2C_QUEUE_ERROR_ABORT : I2C_QUEUE_OK;
+
+    uint32_t latency = cmd->completed_us - cmd->queued_us;
+    i2c_queue_stats.commands++;
+    i2c_queue_stats.bytes += 1 + cmd->length;
+    i2c_queue_stats.total_latency_us += latency;
+    if (latency > i2c_queue_stats.max_latency_us) { i2c_queue_stats.max_latency_us = latency; }
+    if (cmd->status != I2C_QUEUE_OK) { i2c_queue_stats.errors++; }
+
+    done_handle++;
+}
+
+static void __not_in_flash_func(i2c_queue_irq)(void) {
+    i2c_hw_t *hw = i2c_get_hw(bus);
+    uint32_t save = spin_lock_blocking(lock);
+    uint32_t status = hw->intr_stat;
+
+    if (status & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        (void)hw->clr_tx_abrt;  // the controller flushes the FIFO and sends a STOP
+        aborted = true;
+    }
+
+    if (bus_active) {
+        command_t *cmd = current_command();
+        while (i2c_get_read_available(bus)) {
+            uint8_t byte = hw->data_cmd;
+            if (cmd->read && rx_index < cmd->length) {
+                cmd->dst[rx_index++] = byte;
+            }
+        }
+    }
+
+    if (status & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+        (void)hw->clr_stop_det;
+        if (bus_active) {
+            finish_command();
+            start_next();
+        }
+    } else if (bus_active && (status & I2C_IC_INTR_STAT_R_TX_EMPTY_BITS)) {
+        fill_tx();
+    }
+
+    spin_unlock(lock, save);
+}
+
+static i2c_handle_t enqueue(uint8_t reg, const uint8_t *data, uint8_t *dst, uint8_t length, bool read) {
+    if ((!read && length > I2C_QUEUE_MAX_DATA) || (read && length == 0)) {
+        return 0;
+    }
+
+    uint32_t save = spin_lock_blocking(lock);
+    uint32_t waiting = next_handle - done_handle - 1;
+    if (waiting >= I2C_QUEUE_LENGTH) {
+        spin_unlock(lock, save);
+        return 0;
+    }
+
+    i2c_handle_t handle = next_handle;
+    command_t *cmd = &commands[handle % I2C_QUEUE_LENGTH];
+    cmd->reg = reg;
+    cmd->length = length;
+    cmd->read = read;
+    cmd->status = I2C_QUEUE_PENDING;
+    cmd->dst = dst;
+    for (uint i = 0; !read && i < length; i++) {
+        cmd->data[i] = data[i];
+    }
+    cmd->queued_us = time_us_64();
+    cmd->completed_us = 0;
+    next_handle = handle + 1;
+
+    if (waiting + 1 > i2c_queue_stats.max_depth) { i2c_queue_stats.max_depth = waiting + 1; }
+    if (!bus_active) {
+        start_next();
+    }
+    spin_unlock(lock, save);
+    return handle;
+}
+
+void i2c_queue_init(i2c_inst_t *i2c, uint8_t addr, uint baudrate) {
+    bus = i2c;
+    lock = spin_lock_init(spin_lock_claim_unused(true));
+
+    i2c_set_baudrate(i2c, baudrate);
+
+    // fixed target; interrupt as soon as there is a byte to read or the TX FIFO is empty
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    hw->enable = 0;
+    hw->tar = addr;
+    hw->rx_tl = 0;
+    hw->tx_tl = 0;
+    hw->enable = 1;
+    (void)hw->clr_intr;  // whatever the blocking SDK calls left behind
+    hw->intr_mask = BASE_INTERRUPTS;
+
+    uint irq = I2C0_IRQ + i2c_hw_index(i2c);
+    irq_set_exclusive_handler(irq, i2c_queue_irq);
+    irq_set_enabled(irq, true);
+}
+
+i2c_handle_t i2c_queue_write(uint8_t reg, const uint8_t *data, uint8_t length) {
+    return enqueue(reg, data, NULL, length, false);
+}
+
+i2c_handle_t i2c_queue_read(uint8_t reg, uint8_t *dst, uint8_t length) {
+    return enqueue(reg, NULL, dst, length, true);
+}
+
+int i2c_queue_status(i2c_handle_t handle) {
+    uint32_t save = spin_lock_blocking(lock);
+    int status;
+    if (handle == 0 || handle >= next_handle || next_handle - handle > I2C_QUEUE_LENGTH) {
+        status = I2C_QUEUE_ERROR_EXPIRED;
+    } else if (handle > done_handle) {
+        status = I2C_QUEUE_PENDING;
+    } else {
+        status = commands[handle % I2C_QUEUE_LENGTH].status;
+    }
+    spin_unlock(lock, save);
+    return status;
+}
+
+uint64_t i2c_queue_completed_us(i2c_handle_t handle) {
+    uint32_t save = spin_lock_blocking(lock);
+    uint64_t completed = 0;
+    if (handle && handle <= done_handle && next_handle - handle <= I2C_QUEUE_LENGTH) {
+        completed = commands[handle % I2C_QUEUE_LENGTH].completed_us;
+    }
+    spin_unlock(lock, save);
+    return completed;
+}
+
+int i2c_queue_wait(i2c_handle_t handle) {
+    int status;
+    while ((status = i2c_queue_status(handle)) == I2C_QUEUE_PENDING) {
+        tight_loop_contents();
+    }
+    return status;
+}
+
+void i2c_queue_flush(void) {
+    i2c_queue_wait(next_handle - 1);
+}
+
+void i2c_queue_print_log(void) {
+    // only what has completed and has not been overwritten by newer commands since. Each slot is
+    // copied under the lock (the interrupt and core1 write them) and printed from the copy
+    for (uint32_t handle = logged_handle + 1;; handle++) {
+        uint32_t save = spin_lock_blocking(lock);
+        if (next_handle - handle > I2C_QUEUE_LENGTH) {
+            handle = next_handle - I2C_QUEUE_LENGTH;
+        }
+        bool done = handle <= done_handle;
+        command_t cmd;
+        if (done) {
+            cmd = commands[handle % I2C_QUEUE_LENGTH];
+        }
+        spin_unlock(lock, save);
+        if (!done) { break; }
+
+        printf("(i2c #%" PRIu32 ") %s 0x%02x:", handle, cmd.read ? "read " : "write", cmd.reg);
+        if (cmd.read) {
+            printf(" %u bytes", cmd.length);  // the destination may be long gone
+        }
+        for (uint i = 0; !cmd.read && i < cmd.length; i++) {
+            printf(" %02x", cmd.data[i]);
+        }
+        printf("%s (%" PRIu64 " us)\n", cmd.status == I2C_QUEUE_OK ? "" : " FAILED",
+               cmd.completed_us - cmd.queued_us);
+        logged_handle = handle;
+    }
+}
+
+void i2c_queue_report(void) {
+    printf("I2C: %" PRIu32 " commands (%" PRIu32 " bytes, %" PRIu32 " errors), latency %" PRIu32 " us average, "
+           "%" PRIu32 " us max, up to %" PRIu32 " queued\n", i2c_queue_stats.commands, i2c_queue_stats.bytes,
+           i2c_queue_stats.errors,
+           i2c_queue_stats.commands ? i2c_queue_stats.total_latency_us / i2c_queue_stats.commands : 0,
+           i2c_queue_stats.max_latency_us, i2c_queue_stats.max_depth);
+}
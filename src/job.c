@@ -0,0 +1,272 @@
+/**
+ * Job runner (see job.h for the format)
+ *
+ * Runs on core0 from job_poll(); copying and decoding ahead happen on core1 (render_core.h).
+ * At most one layer waits in the exposure queue behind the one being exposed: its frame may
+ * sit in the prefetch area, which takes the next layer's frame only once it has been decoded.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pico/stdlib.h"
+#include "job.h"
+#include "exposure.h"
+#include "frame_codec.h"
+#include "frame_library.h"
+#include "render_core.h"
+#include "staging.h"
+#include "video_mode.h"
+
+job_stats_t job_stats;
+
+static bool running;
+static const uint8_t *records;
+static framebuffer_t *frame;
+static bool full_frame;          // the scan-out streams the framebuffer (not a window of it)
+
+static uint8_t *prefetch_area;   // the staging area behind the manifest
+static uint32_t prefetch_size;
+
+static uint32_t next;            // next layer to queue
+static bool next_ready;          // its frame is in the prefetch area, or decoded ahead
+static bool previous_raw;        // the layer queued before it is scanned out of flash
+static uint64_t stall_begin;     // the scheduler ran dry waiting for the next layer (0: it did not)
+
+// a frame being copied or decoded on core1 while the previous layer exposes
+static struct {
+    const uint8_t *data;
+    uint32_t length;
+    uint32_t elapsed_us;
+} ahead;
+static render_handle_t ahead_handle;
+static bool ahead_decoded;       // into the framebuffer rather than the prefetch area
+
+static job_layer_result_t results[JOB_RESULTS];
+
+static inline uint16_t read_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t read_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static const frame_library_entry_t *layer_entry(uint32_t layer) {
+    return frame_library_entry(read_u16(&records[layer * JOB_RECORD_SIZE]));
+}
+
+static bool layer_fits(const frame_library_entry_t *entry) {
+    if (!entry || entry->bpp != frame->bpp) {
+        return false;
+    }
+    if (entry->format == FRAME_LIBRARY_RAW) {
+        // scanned out of flash directly, which only works on the whole frame (see scanout.h)
+        return full_frame && entry->length >= VIDEO_FRAME_BYTES(frame->bpp);
+    }
+    frame_decoder_t decoder;
+    return frame_decoder_init(&decoder, frame_library_data(entry), entry->length) == FRAME_OK &&
+           decoder.width == frame->width && decoder.bpp == frame->bpp && decoder.height <= frame->height;
+}
+
+// runs on core1 (see render_core.h)
+static int copy_ahead(void *ctx) {
+    uint64_t begin_time = time_us_64();
+    memcpy(prefetch_area, ahead.data, ahead.length);
+    ahead.elapsed_us = time_us_64() - begin_time;
+    return 0;
+}
+
+static int decode_ahead(void *ctx) {
+    uint64_t begin_time = time_us_64();
+    int status = frame_decode(ahead.data, ahead.length, frame);
+    ahead.elapsed_us = time_us_64() - begin_time;
+    return status;
+}
+
+// on to the next layer of the manifest
+static void advance(bool raw) {
+    next++;
+    previous_raw = raw;
+    next_ready = false;
+    ahead_decoded = false;
+    stall_begin = 0;
+    if (next < job_stats.layers) {
+        memset(&results[next % JOB_RESULTS], 0, sizeof(job_layer_result_t));
+        results[next % JOB_RESULTS].layer = next;
+    }
+}
+
+static void layer_done(void *ctx, const exposure_result_t *result) {
+    uint32_t layer = (uintptr_t)ctx;
+    job_layer_result_t *record = &results[layer % JOB_RESULTS];
+
+    if (!result) {
+        record->skipped = true;
+        job_stats.skipped++;
+    } else {
+        record->frames_waited = result->frames_waited;
+        record->gap_us = result->gap_us;
+        record->decode_us = result->prepare_us;
+        // the first layer's gap is whatever came before the job
+        if (layer > 0) {
+            job_stats.gap_us += result->gap_us;
+            if (result->gap_us > job_stats.max_gap_us) { job_stats.max_gap_us = result->gap_us; }
+        }
+    }
+    if (++job_stats.done == job_stats.layers) {
+        job_stats.end_us = time_us_64();
+    }
+}
+
+int job_start(const uint8_t *data, uint32_t length, framebuffer_t *fb) {
+    if (length < JOB_HEADER_SIZE || ((uintptr_t)data & 3)) { return JOB_ERROR_HEADER; }
+    if (data[0] != 'D' || data[1] != 'L' || data[2] != 'P' || data[3] != 'J') { return JOB_ERROR_HEADER; }
+    if (data[4] != JOB_VERSION) { return JOB_ERROR_HEADER; }
+    uint32_t payload = read_u32(&data[12]);
+    uint16_t layers = read_u16(&data[6]);
+    if (payload > length - JOB_HEADER_SIZE || (uint32_t)layers * JOB_RECORD_SIZE > payload) {
+        return JOB_ERROR_TRUNCATED;
+    }
+    if (running) { return JOB_ERROR_BUSY; }
+
+    frame = fb;
+    full_frame = fb->width == VIDEO_WIDTH && fb->height == VIDEO_HEIGHT;
+    records = data + JOB_HEADER_SIZE;
+    for (uint32_t layer = 0; layer < layers; layer++) {
+        if (!layer_fits(layer_entry(layer))) {
+            return JOB_ERROR_LAYER;
+        }
+    }
+
+    // the rest of the staging area takes the frames read ahead
+    uintptr_t end = ((uintptr_t)data + JOB_HEADER_SIZE + payload + 3) & ~(uintptr_t)3;
+    uintptr_t staging_end = (uintptr_t)staging_buffer + STAGING_SIZE;
+    prefetch_area = (uint8_t *)end;
+    prefetch_size = data >= staging_buffer && end < staging_end ? staging_end - end : 0;
+
+    memset(&job_stats, 0, sizeof(job_stats));
+    memset(results, 0, sizeof(results));
+    job_stats.layers = layers;
+    job_stats.begin_us = time_us_64();
+    next = 0;
+    next_ready = false;
+    previous_raw = false;
+    ahead_decoded = false;
+    stall_begin = 0;
+    running = true;
+    staging_locked = true;  // the manifest and the prefetch area are read while exposing
+    return JOB_OK;
+}
+
+void job_poll(void) {
+    if (!running || next == job_stats.layers) {
+        return;
+    }
+    // a job starts behind whatever else is queued; one of its layers waits in the queue at most
+    bool queue_empty = exposure_queue_free() == EXPOSURE_QUEUE_LENGTH;
+    if (!exposure_busy() && !stall_begin) {
+        stall_begin = time_us_64();
+    }
+
+    const uint8_t *record = &records[next * JOB_RECORD_SIZE];
+    const frame_library_entry_t *entry = layer_entry(next);
+    bool raw = entry->format == FRAME_LIBRARY_RAW;
+
+    if (!raw && !next_ready) {
+        // the framebuffer is free while the layer before is scanned out of flash: decode into it
+        // ahead, otherwise copy the frame into RAM if it fits
+        bool decode = previous_raw && full_frame;
+        if (!decode && entry->length > prefetch_size) {
+            next_ready = true;  // decoded from flash after the STOP
+        } else if (!ahead_handle) {
+            // the previous layer must be out of the queue: its frame has been decoded (and it
+            // is on, or going to, the light with its own frame)
+            if (!queue_empty) { return; }
+            ahead.data = frame_library_data(entry);
+            ahead.length = entry->length;
+            ahead_decoded = decode;
+            ahead_handle = render_submit(decode ? decode_ahead : copy_ahead, NULL, NULL);
+            return;
+        } else {
+            int status = render_status(ahead_handle);
+            if (status == RENDER_PENDING) { return; }
+            ahead_handle = 0;
+            results[next % JOB_RESULTS].prefetch_us = ahead.elapsed_us;
+            if (status != 0) {
+                // a bad frame: skipped, like the exposure scheduler does
+                layer_done((void *)(uintptr_t)next, NULL);
+                advance(false);
+                return;
+            }
+            job_stats.prefetched += !ahead_decoded;
+            next_ready = true;
+        }
+    }
+    if (!queue_empty) {
+        return;
+    }
+
+    exposure_entry_t layer = {
+        .duration_us = read_u32(&record[4]),
+        .pwm = read_u16(&record[2]),
+        .dark_frames = read_u16(&record[8]),
+        .done = layer_done,
+        .ctx = (void *)(uintptr_t)next,
+    };
+    if (raw) {
+        layer.scanout = frame_library_data(entry);
+    } else if (ahead_decoded) {
+        layer.scanout = frame->words;  // already in the framebuffer, just switch back to it
+    } else {
+        layer.frame = entry->length <= prefetch_size ? prefetch_area : frame_library_data(entry);
+        layer.frame_length = entry->length;
+        layer.scanout = full_frame ? frame->words : NULL;
+    }
+    if (!exposure_queue(&layer)) {
+        return;  // checked in job_start(), but the queue may have filled up since
+    }
+
+    job_layer_result_t *result = &results[next % JOB_RESULTS];
+    result->stall_us = stall_begin ? time_us_64() - stall_begin : 0;
+    if (next > 0 && result->stall_us) {
+        job_stats.stalls++;
+        job_stats.stall_us += result->stall_us;
+    }
+    advance(raw);
+}
+
+bool job_busy(void) {
+    if (running && job_stats.done == job_stats.layers) {
+        running = false;
+        staging_locked = false;
+    }
+    return running;
+}
+
+void job_report(void) {
+    uint32_t done = job_stats.done;
+    uint32_t first = done > JOB_RESULTS ? done - JOB_RESULTS : 0;
+    uint64_t end_us = job_stats.end_us ? job_stats.end_us : time_us_64();
+
+    printf("Job: %" PRIu32 " of %" PRIu32 " layers in %" PRIu64 " ms, %" PRIu32 " skipped, %" PRIu32 " prefetched "
+           "into RAM (%" PRIu32 " bytes of room)\n",
+           done, job_stats.layers, (end_us - job_stats.begin_us) / 1000, job_stats.skipped, job_stats.prefetched,
+           prefetch_size);
+    for (uint32_t i = first; i < done; i++) {
+        const job_layer_result_t *result = &results[i % JOB_RESULTS];
+        if (result->skipped) {
+            printf("  layer %u: skipped, the frame did not decode\n", result->layer);
+            continue;
+        }
+        printf("  layer %u: dark %" PRIu32 " us (stalled %" PRIu32 ", decoding %" PRIu32 ", %u frames), "
+               "prepared ahead in %" PRIu32 " us\n",
+               result->layer, result->gap_us, result->stall_us, result->decode_us, result->frames_waited,
+               result->prefetch_us);
+    }
+    uint32_t gaps = done - job_stats.skipped > 1 ? done - job_stats.skipped - 1 : 0;
+    if (gaps) {
+        printf("  between layers: dark %" PRIu64 " us on average, %" PRIu32 " us at most; "
+               "%" PRIu32 " stalls (%" PRIu64 " us)\n",
+               job_stats.gap_us / gaps, job_stats.max_gap_us, job_stats.stalls, job_stats.stall_us);
+    }
+}
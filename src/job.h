@@ -0,0 +1,102 @@
+/**
+ * Job runner: many layers from the flash frame library exposed back to back ("DLPJ")
+ *
+ * A job is a manifest of layers, each a frame of the flash frame library (frame_library.h)
+ * with its own exposure time, LED PWM and dark frames (frames the layer is shown with the
+ * light off before the exposure, e.g. for the resin to settle). The layers are played back by
+ * the exposure scheduler (exposure.h), one entry at a time, and the next layer is prepared
+ * while the current one is being exposed, so that the light is off for as little as possible
+ * between two layers:
+ *
+ *  - raw frames are scanned out of flash directly: the scan-out is switched over to the next
+ *    layer at the first frame boundary after the STOP (nothing to copy or decode).
+ *  - DLPF frames are copied out of flash into the staging area behind the manifest on core1
+ *    while the previous layer is exposing (prefetch). With a single framebuffer there is
+ *    nowhere to decode them ahead of time, so they are decoded into the framebuffer after the
+ *    STOP as before, but from RAM, without waiting on flash. Frames larger than the prefetch
+ *    area are decoded from flash.
+ *
+ * For every layer the time the light was off before it (previous STOP to its START, both on
+ * the bus) is recorded along with what it was made up of: the scheduler running dry because
+ * the layer was not prepared yet (stall), decoding, and frame boundaries waited for.
+ * job_report() prints them; a pipeline that keeps up shows no stalls and gaps of about a frame.
+ *
+ * Framebuffer builds only; the scan-out has to show the whole frame for raw layers.
+ *
+ * Layout (all multi-byte values little-endian, the buffer must be 32-bit aligned):
+ *
+ *  header (16 bytes)
+ *    'D' 'L' 'P' 'J'   magic
+ *    u8  version       JOB_VERSION
+ *    u8  reserved
+ *    u16 layers
+ *    u32 reserved
+ *    u32 payload length (bytes following the header)
+ *
+ *  payload: one record per layer, in exposure order
+ *    u16 frame         index in the frame library
+ *    u16 pwm           LED PWM (10 bit), 0 keeps the current one
+ *    u32 duration_us
+ *    u16 dark_frames
+ *    u16 reserved
+ */
+#ifndef JOB_H
+#define JOB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "framebuffer.h"
+
+#define JOB_VERSION        1
+#define JOB_HEADER_SIZE    16
+#define JOB_RECORD_SIZE    12
+
+#define JOB_RESULTS        32   // most recent layers kept for the report
+
+enum JobStatus {
+    JOB_OK = 0,
+    JOB_ERROR_HEADER = -1,      // bad magic, version, alignment or size
+    JOB_ERROR_TRUNCATED = -2,   // the records run past the end of the payload
+    JOB_ERROR_LAYER = -3,       // a layer's frame is missing or does not fit the scan-out
+    JOB_ERROR_BUSY = -4,        // a job is running
+};
+
+typedef struct {
+    uint16_t layer;
+    uint16_t frames_waited;  // frame boundaries between arming and the START (incl. dark frames)
+    uint32_t gap_us;         // light off before the layer: previous STOP to this START
+    uint32_t stall_us;       // of which the scheduler was idle waiting for the layer
+    uint32_t decode_us;      // of which its frame was being decoded (DLPF layers)
+    uint32_t prefetch_us;    // copying the frame into RAM, behind the previous layer's exposure
+    bool skipped;            // the frame did not decode, nothing was exposed
+} job_layer_result_t;
+
+typedef struct {
+    uint32_t layers;         // in the job
+    uint32_t done;           // exposed or skipped
+    uint32_t skipped;
+    uint32_t prefetched;     // DLPF layers copied into RAM ahead
+    uint32_t stalls;         // layers the scheduler had to wait for
+    uint64_t gap_us;         // sum, from the second layer on
+    uint32_t max_gap_us;
+    uint64_t stall_us;
+    uint64_t begin_us;
+    uint64_t end_us;
+} job_stats_t;
+
+extern job_stats_t job_stats;
+
+// check a manifest and start exposing its layers. <data> has to stay untouched until
+// job_busy() returns false (the staging area is locked until then).
+int job_start(const uint8_t *data, uint32_t length, framebuffer_t *fb);
+
+// prepares and queues the next layer; call as often as possible (next to exposure_poll())
+void job_poll(void);
+
+// true while a job is running; releases the staging area after
+bool job_busy(void);
+
+// totals and the idle gaps of the most recent layers
+void job_report(void);
+
+#endif
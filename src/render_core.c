@@ -0,0 +1,105 @@
+/**
+ * Core1 render worker (see render_core.h)
+ *
+ * Core1 and both directions of the inter-core FIFO
+ */
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "render_core.h"
+
+typedef struct {
+    render_job_fn fn;
+    render_done_fn done;
+    void *ctx;
+    int result;
+} job_t;
+
+render_stats_t render_stats = { .stage = { .name = "core1 jobs" } };
+
+// the job with handle h lives in jobs[h % RENDER_QUEUE_LENGTH]. Core0 writes next_handle and
+// done_handle, core1 only ever touches the slot whose handle it popped from the FIFO.
+static job_t jobs[RENDER_QUEUE_LENGTH];
+static uint32_t next_handle = 1;
+static uint32_t done_handle;
+
+static void core1_main(void) {
+    while (true) {
+        uint64_t idle_begin = time_us_64();
+        uint32_t handle = multicore_fifo_pop_blocking();
+        uint64_t begin = time_us_64();
+        render_stats.idle_us += begin - idle_begin;
+
+        job_t *job = &jobs[handle % RENDER_QUEUE_LENGTH];
+        job->result = job->fn(job->ctx);
+        stage_account(&render_stats.stage, begin);
+
+        __dmb();  // result in memory before core0 can see the handle
+        multicore_fifo_push_blocking(handle);  // never blocks: at most RENDER_QUEUE_LENGTH in flight
+    }
+}
+
+void render_init(void) {
+    multicore_launch_core1(core1_main);
+}
+
+render_handle_t render_submit(render_job_fn fn, render_done_fn done, void *ctx) {
+    render_poll();  // frees the slots of finished jobs
+    uint32_t waiting = next_handle - done_handle - 1;
+    if (waiting >= RENDER_QUEUE_LENGTH) {
+        return 0;
+    }
+
+    render_handle_t handle = next_handle++;
+    job_t *job = &jobs[handle % RENDER_QUEUE_LENGTH];
+    job->fn = fn;
+    job->done = done;
+    job->ctx = ctx;
+    job->result = RENDER_PENDING;
+    if (waiting + 1 > render_stats.max_depth) { render_stats.max_depth = waiting + 1; }
+
+    __dmb();  // slot in memory before core1 can see the handle
+    multicore_fifo_push_blocking(handle);
+    return handle;
+}
+
+void render_poll(void) {
+    while (multicore_fifo_rvalid()) {
+        done_handle = multicore_fifo_pop_blocking();  // jobs finish in order
+        job_t *job = &jobs[done_handle % RENDER_QUEUE_LENGTH];
+        if (job->done) {
+            job->done(job->ctx, job->result);
+        }
+    }
+}
+
+int render_status(render_handle_t handle) {
+    render_poll();
+    if (handle == 0 || handle >= next_handle || next_handle - handle > RENDER_QUEUE_LENGTH) {
+        return RENDER_ERROR_EXPIRED;
+    }
+    if (handle > done_handle) {
+        return RENDER_PENDING;
+    }
+    return jobs[handle % RENDER_QUEUE_LENGTH].result;
+}
+
+bool render_busy(void) {
+    render_poll();
+    return done_handle + 1 != next_handle;
+}
+
+void render_report(const stage_stats_t *stages, uint count, uint64_t wall_us) {
+    printf("Pipeline over %llu ms:\n", wall_us / 1000);
+    uint64_t core0_busy = 0;
+    for (uint i = 0; i < count; i++) {
+        printf("  core0 %-10s %3llu%% busy, %lu runs, longest %lu us\n", stages[i].name,
+               wall_us ? stages[i].busy_us * 100 / wall_us : 0, stages[i].runs, stages[i].max_us);
+        core0_busy += stages[i].busy_us;
+    }
+    printf("  core0 idle       %3llu%%\n", wall_us && core0_busy < wall_us ? (wall_us - core0_busy) * 100 / wall_us : 0);
+    printf("  %-16s %3llu%% busy, %lu jobs, longest %lu us, up to %lu queued (idle %llu ms)\n",
+           render_stats.stage.name, wall_us ? render_stats.stage.busy_us * 100 / wall_us : 0,
+           render_stats.stage.runs, render_stats.stage.max_us, render_stats.max_depth,
+           render_stats.idle_us / 1000);
+}
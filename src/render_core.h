@@ -0,0 +1,82 @@
+/**
+ * Core1 render worker: framebuffer production off the main core
+ *
+ * Core0 owns the USB/SPI links, the I2C queue and the exposure scheduler; anything that takes
+ * long to produce pixels (decoding a DLPF frame, drawing a pattern, rasterising) is handed to
+ * core1 as a job, so a long decode no longer holds up I2C commands, exposures or uploads.
+ *
+ * Jobs go through a single producer/single consumer ring in RAM: core0 fills a slot and pushes
+ * its handle into the inter-core FIFO, core1 pops it, runs the job and pushes the handle back.
+ * No locks are involved; the FIFO is the only synchronisation. The ring is no deeper than the
+ * FIFO (8 words), so neither core ever blocks on a push. Jobs run in order.
+ *
+ * The job function runs on core1 and returns 0 or a negative error; the optional done
+ * function runs on core0 from render_poll() once the job has finished.
+ */
+#ifndef RENDER_CORE_H
+#define RENDER_CORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/types.h"
+#include "pico/time.h"
+
+#define RENDER_QUEUE_LENGTH  8   // jobs in flight; at most the depth of the inter-core FIFO
+
+typedef uint32_t render_handle_t;   // 0: not queued (queue full)
+
+#define RENDER_PENDING        1      // render_status() of a job that has not finished yet
+#define RENDER_ERROR_EXPIRED  -100   // unknown handle, or its result has been overwritten
+
+typedef int (*render_job_fn)(void *ctx);
+typedef void (*render_done_fn)(void *ctx, int result);
+
+// busy time of one stage of the pipeline (one polled function on core0, or core1's jobs)
+typedef struct {
+    const char *name;
+    uint32_t runs;
+    uint64_t busy_us;
+    uint32_t max_us;
+} stage_stats_t;
+
+static inline void stage_account(stage_stats_t *stage, uint64_t begin_us) {
+    uint32_t elapsed = time_us_64() - begin_us;
+    stage->runs++;
+    stage->busy_us += elapsed;
+    if (elapsed > stage->max_us) { stage->max_us = elapsed; }
+}
+
+// run <fn> and count its time towards <stage>
+static inline void stage_run(stage_stats_t *stage, void (*fn)(void)) {
+    uint64_t begin = time_us_64();
+    fn();
+    stage_account(stage, begin);
+}
+
+typedef struct {
+    stage_stats_t stage;          // core1 busy with jobs
+    volatile uint64_t idle_us;    // core1 waiting for work
+    uint32_t max_depth;           // most jobs queued at once
+} render_stats_t;
+
+extern render_stats_t render_stats;
+
+// start core1
+void render_init(void);
+
+// queue <fn>(<ctx>) for core1; <done>(<ctx>, result) is called on core0 afterwards (may be NULL)
+render_handle_t render_submit(render_job_fn fn, render_done_fn done, void *ctx);
+
+// RENDER_PENDING, the job's result, or RENDER_ERROR_EXPIRED (core0 only)
+int render_status(render_handle_t handle);
+
+// collect finished jobs and run their done functions; call from the core0 main loop
+void render_poll(void);
+
+// true while jobs are queued or running
+bool render_busy(void);
+
+// busy/idle share of each stage over <wall_us>, and of core1
+void render_report(const stage_stats_t *stages, uint count, uint64_t wall_us);
+
+#endif
@@ -0,0 +1,387 @@
+/**
+ * Pixel data scan-out DMA (see scanout.h)
+ *
+ * DMA channels 0 and 1, DMA_IRQ_0
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/timer.h"
+#include "hardware/regs/addressmap.h"
+#include "hardware/structs/bus_ctrl.h"
+#include "clock_plan.h"
+#include "scanout.h"
+
+// DMA channels - 0 sends pixel data, 1 reconfigures and restarts 0
+#define PXL_CHAN_0  0
+#define PXL_CHAN_1  1
+
+scanout_stats_t scanout_stats;
+
+static void (*frame_callback)(void);
+
+// framebuffer mode: pointer to the ADDRESS of the pixel array, read by channel 1
+static const void *volatile address_pointer;
+static const void *first_buffer;           // the buffer the DMA started on (line ring: slot 0)
+
+static bool running;
+static uint32_t line_bytes_per_transfer;  // bytes per line
+static uint32_t transfer_length;           // words per transfer of channel 0 (a frame or a line)
+static uint16_t frame_height;
+
+// line ring mode
+static bool line_ring;
+static scanout_render_fn render_line;
+static void *render_ctx;
+static uint32_t rendered;                  // number of lines rendered so far
+static const uint32_t *last_line;          // most recently rendered line (for repeat records)
+
+static uint32_t *line_buffers[SCANOUT_RING_LINES];
+static uint32_t *late_line;                // target for lines we are too late for
+// channel 1 cycles through this table; the ring wrap requires natural alignment
+static uint32_t *slot_pointers[SCANOUT_RING_LINES] __attribute__((aligned(SCANOUT_RING_LINES * 4)));
+
+// window mode (a line ring that renders from the window itself)
+static const framebuffer_t *window;
+static uint16_t window_x_words;            // words of margin left of the window
+static uint16_t window_y;
+static bool window_direct;                 // the window's rows are whole lines: no copying
+static uint32_t *zero_line;
+
+// tile mode: channel 1 walks the tile's row pointers instead of the slots (no rendering)
+static uint32_t tile_height;               // rows of the tile, 0 when not in tile mode
+static const uint32_t *tile_rows[SCANOUT_TILE_MAX_HEIGHT] __attribute__((aligned(SCANOUT_TILE_MAX_HEIGHT * 4)));
+
+// point <slot> at the line source for line <y>: the zero line outside the window, the row
+// itself if it is a whole line, otherwise the line buffer with the row copied in
+static void window_line(uint16_t y, uint32_t slot) {
+    uint32_t *source = zero_line;
+    if (y >= window_y && y - window_y < window->height) {
+        const uint32_t *row = fb_row(window, y - window_y);
+        if (window_direct) {
+            source = (uint32_t *)row;
+        } else {
+            source = line_buffers[slot];
+            memcpy(source + window_x_words, row, window->stride * 4);
+        }
+    }
+    slot_pointers[slot] = source;
+}
+
+static void render_next_line(void) {
+    uint32_t line = rendered;
+    uint32_t *target = line_buffers[line % SCANOUT_RING_LINES];
+    bool late = running && line <= scanout_stats.lines;
+
+    if (window) {
+        // nothing to keep in step with: a line we are late for is skipped (channel 1 has
+        // already read its slot pointer)
+        if (!late) {
+            window_line(line % frame_height, line % SCANOUT_RING_LINES);
+        }
+        rendered++;
+        return;
+    }
+
+    // the DMA is already reading (or past) this line; still render it so that sequential
+    // sources like the frame decoder stay in step, but don't touch the line in flight
+    if (late) {
+        target = late_line;
+    }
+
+    render_line(line % frame_height, target, last_line, render_ctx);
+    last_line = target;
+    rendered++;
+}
+
+// tile mode, while the last line of the frame goes out: channel 1 has to restart channel 0 on
+// the tile's first row for the next frame, but its ring is frame_height % tile_height rows on
+// from there when the frame is not a whole number of tiles high. Pointing it back keeps the
+// pattern still from frame to frame; if channel 1 has already moved on, the next frame starts
+// on the wrong row (counted as an underrun) and the frame after it is back in step.
+static void __not_in_flash_func(rewind_tile)(void) {
+    uint32_t skip = frame_height % tile_height;
+    uint32_t next = (dma_hw->ch[PXL_CHAN_1].read_addr - (uintptr_t)tile_rows) / 4;
+    if (next != skip) {
+        scanout_stats.underruns++;
+    }
+    dma_hw->ch[PXL_CHAN_1].read_addr = (uintptr_t)&tile_rows[(next - skip) % tile_height];
+}
+
+static void __not_in_flash_func(scanout_dma_irq)(void) {
+    dma_channel_acknowledge_irq0(PXL_CHAN_0);
+
+    // channel 1 restarts channel 0 as soon as it finishes, which reloads its transfer count
+    if (dma_hw->ch[PXL_CHAN_0].ctrl_trig & DMA_CH0_CTRL_TRIG_BUSY_BITS) {
+        uint32_t lag = (transfer_length - dma_hw->ch[PXL_CHAN_0].transfer_count) * 4;
+        scanout_stats.reload_lag_last = lag;
+        if (lag > scanout_stats.reload_lag_max) { scanout_stats.reload_lag_max = lag; }
+    } else {
+        scanout_stats.late_reloads++;
+    }
+
+    if (!line_ring) {
+        scanout_stats.frames++;
+        if (frame_callback) { frame_callback(); }
+        return;
+    }
+
+    // channel 0 finished a line and channel 1 has already restarted it on the next slot,
+    // which therefore must have been rendered by now (a tile is always ready)
+    uint32_t in_flight = ++scanout_stats.lines;
+    if (tile_height) {
+        if (in_flight % frame_height == frame_height - 1 && frame_height % tile_height) {
+            rewind_tile();
+        }
+    } else if (rendered <= in_flight) {
+        scanout_stats.underruns++;
+    }
+
+    if (in_flight % frame_height == 0) {
+        scanout_stats.frames++;
+        if (frame_callback) { frame_callback(); }
+    }
+
+    // refill every slot that is no longer needed by the DMA
+    while (!tile_height && rendered < in_flight + SCANOUT_RING_LINES) {
+        render_next_line();
+    }
+}
+
+// <reload_ring_bits>: size of channel 1's table of read addresses (0: a single fixed one),
+// <read_ring_bits>: size of the ring channel 0 reads from (0: straight through), both log2 bytes
+static void configure_channels(PIO pio, uint sm, const volatile void *first_line, uint32_t transfer_count,
+                               const void *reload_table, uint reload_ring_bits, uint read_ring_bits) {
+    assert(((uintptr_t)first_line & 3) == 0);
+    transfer_length = transfer_count;
+    first_buffer = (const void *)first_line;
+
+    // claim the channels, so that dma_claim_unused_channel() never hands them out elsewhere
+    dma_channel_claim(PXL_CHAN_0);
+    dma_channel_claim(PXL_CHAN_1);
+
+    // Channel Zero (sends pixel data to PIO pxl machine)
+    dma_channel_config c0 = dma_channel_get_default_config(PXL_CHAN_0);  // default configs
+    channel_config_set_transfer_data_size(&c0, DMA_SIZE_32);             // 32-bit txfers (autopull)
+    channel_config_set_read_increment(&c0, true);                        // yes read incrementing
+    channel_config_set_write_increment(&c0, false);                      // no write incrementing
+    channel_config_set_dreq(&c0, pio_get_dreq(pio, sm, true));           // pxl TX FIFO pacing
+    channel_config_set_chain_to(&c0, PXL_CHAN_1);                        // chain to other channel
+    channel_config_set_high_priority(&c0, true);                         // ahead of upload DMA
+    if (read_ring_bits) {
+        channel_config_set_ring(&c0, false, read_ring_bits);             // repeat a tile row
+    }
+
+    dma_channel_configure(
+        PXL_CHAN_0,                 // Channel to be configured
+        &c0,                        // The configuration we just created
+        &pio->txf[sm],              // write address (pxl PIO TX FIFO)
+        first_line,                 // The initial read address
+        transfer_count,             // Number of transfers; in this case each is 4 bytes.
+        false                       // Don't start immediately.
+    );
+
+    // Channel One (reconfigures the first channel)
+    dma_channel_config c1 = dma_channel_get_default_config(PXL_CHAN_1);   // default configs
+    channel_config_set_transfer_data_size(&c1, DMA_SIZE_32);              // 32-bit txfers
+    channel_config_set_read_increment(&c1, reload_ring_bits != 0);        // walk the table
+    channel_config_set_write_increment(&c1, false);                       // no write incrementing
+    channel_config_set_chain_to(&c1, PXL_CHAN_0);                         // chain to other channel
+    channel_config_set_high_priority(&c1, true);                          // ahead of upload DMA
+    if (reload_ring_bits) {
+        // wrap the read address around the table of line pointers
+        channel_config_set_ring(&c1, false, reload_ring_bits);
+    }
+
+    dma_channel_configure(
+        PXL_CHAN_1,                         // Channel to be configured
+        &c1,                                // The configuration we just created
+        &dma_hw->ch[PXL_CHAN_0].read_addr,  // Write address (channel 0 read address)
+        reload_table,                       // Read address (POINTER TO AN ADDRESS)
+        1,                                  // Number of transfers, in this case each is 4 byte
+        false                               // Don't start immediately.
+    );
+
+    // every completed transfer of channel 0 (a frame, or a line) raises DMA_IRQ_0
+    dma_channel_set_irq0_enabled(PXL_CHAN_0, true);
+    irq_set_exclusive_handler(DMA_IRQ_0, scanout_dma_irq);
+    irq_set_priority(DMA_IRQ_0, 0);  // highest; in line ring mode we race the beam
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+void scanout_init_framebuffer(PIO pio, uint sm, const void *buffer, uint32_t line_bytes, uint16_t height) {
+    line_ring = false;
+    line_bytes_per_transfer = line_bytes;
+    frame_height = height;
+    address_pointer = buffer;
+    configure_channels(pio, sm, buffer, line_bytes * height / 4, (const void *)&address_pointer, 0, 0);
+}
+
+void scanout_init_line_ring(PIO pio, uint sm, uint32_t line_bytes, uint16_t height, uint32_t *buffers,
+                            scanout_render_fn render, void *ctx) {
+    assert((line_bytes & 3) == 0);
+
+    line_ring = true;
+    window = NULL;
+    tile_height = 0;
+    line_bytes_per_transfer = line_bytes;
+    frame_height = height;
+    render_line = render;
+    render_ctx = ctx;
+    rendered = 0;
+    last_line = line_buffers[SCANOUT_RING_LINES - 1];
+
+    for (int i = 0; i < SCANOUT_RING_LINES; i++) {
+        line_buffers[i] = buffers + i * (line_bytes / 4);
+        slot_pointers[i] = line_buffers[i];
+    }
+    late_line = buffers + SCANOUT_RING_LINES * (line_bytes / 4);
+
+    // channel 0 starts on slot 0, so the first reload must come from slot 1
+    configure_channels(pio, sm, line_buffers[0], line_bytes / 4, &slot_pointers[1],
+                       __builtin_ctz(SCANOUT_RING_LINES * 4), 0);
+}
+
+void scanout_init_window(PIO pio, uint sm, uint32_t line_bytes, uint16_t height, uint32_t *buffers,
+                         const framebuffer_t *fb, uint16_t x, uint16_t y) {
+    assert(x * fb->bpp % 32 == 0 && x + fb->stride * 32 / fb->bpp <= line_bytes * 8 / fb->bpp);
+
+    // the line buffers' margins and the zero line are never written after this
+    memset(buffers, 0, SCANOUT_WINDOW_WORDS(line_bytes) * 4);
+    scanout_init_line_ring(pio, sm, line_bytes, height, buffers, NULL, NULL);
+    window = fb;
+    window_x_words = x * fb->bpp / 32;
+    window_y = y;
+    window_direct = fb->stride * 4 == line_bytes;
+    zero_line = buffers + (SCANOUT_RING_LINES + 1) * (line_bytes / 4);
+}
+
+void scanout_init_tile(PIO pio, uint sm, uint32_t line_bytes, uint16_t height, const framebuffer_t *tile) {
+    uint32_t row_bytes = tile->stride * 4;
+    assert((row_bytes & (row_bytes - 1)) == 0 && row_bytes <= line_bytes && tile->width * tile->bpp == row_bytes * 8);
+    assert((tile->height & (tile->height - 1)) == 0 && tile->height && tile->height <= SCANOUT_TILE_MAX_HEIGHT);
+    assert(((uintptr_t)tile->words & (row_bytes - 1)) == 0);  // channel 0's ring wraps on the row
+
+    line_ring = true;
+    window = NULL;
+    tile_height = tile->height;
+    line_bytes_per_transfer = line_bytes;
+    frame_height = height;
+    for (uint32_t i = 0; i < tile_height; i++) {
+        tile_rows[i] = fb_row(tile, i);
+    }
+
+    // channel 0 starts on row 0, so the first reload must come from row 1 (row 0 again for a
+    // tile of a single row)
+    configure_channels(pio, sm, tile_rows[0], line_bytes / 4, &tile_rows[1 % tile_height],
+                       __builtin_ctz(tile_height * 4), __builtin_ctz(row_bytes));
+}
+
+void scanout_start(void) {
+    // in line ring mode, fill the ring before the first line goes out
+    while (line_ring && !tile_height && rendered < SCANOUT_RING_LINES) {
+        render_next_line();
+    }
+    if (window) {
+        // the first line may not come from slot 0's line buffer
+        first_buffer = slot_pointers[0];
+        dma_channel_set_read_addr(PXL_CHAN_0, slot_pointers[0], false);
+    }
+
+    // Start DMA channel 0. Once started, the contents of the pixel data array (or line ring)
+    // will be continously DMA's to the PIO machines that are driving the screen.
+    // The DMA also wins bus contention against the cores, so the scan-out never waits on them.
+    running = true;
+    bus_ctrl_hw->priority = BUSCTRL_BUS_PRIORITY_DMA_R_BITS | BUSCTRL_BUS_PRIORITY_DMA_W_BITS;
+    dma_start_channel_mask(1u << PXL_CHAN_0);
+}
+
+void scanout_set_framebuffer(const void *buffer) {
+    assert(((uintptr_t)buffer & 3) == 0);
+    address_pointer = buffer;  // channel 1 reloads channel 0 from here at the end of the frame
+}
+
+bool __not_in_flash_func(scanout_showing)(const void *buffer) {
+    // channel 0's read address is somewhere in the frame it is streaming (at its end once done)
+    uintptr_t read = dma_hw->ch[PXL_CHAN_0].read_addr;
+    return !line_ring && read - (uintptr_t)buffer <= transfer_length * 4;
+}
+
+void scanout_set_frame_callback(void (*callback)(void)) {
+    frame_callback = callback;
+}
+
+uint16_t scanout_beam_line(void) {
+    if (line_ring) {
+        return scanout_stats.lines % frame_height;
+    }
+    uint32_t remaining = dma_hw->ch[PXL_CHAN_0].transfer_count * 4;
+    uint32_t sent = line_bytes_per_transfer * frame_height - remaining;
+    return (sent / line_bytes_per_transfer) % frame_height;  // 0 while channel 1 reloads
+}
+
+// counts of <events> over one frame period, on the four bus performance counters
+static void count_frame(const bus_ctrl_perf_counter_t events[4], uint32_t counts[4]) {
+    const clock_plan_t *plan = clock_plan_current();
+    uint32_t frame_us = 1000000000ull / plan->frame_mhz;
+
+    for (uint i = 0; i < 4; i++) {
+        bus_ctrl_hw->counter[i].sel = events[i];
+    }
+    // start at a frame boundary, then wait on the timer (APB) rather than on scanout_stats,
+    // which would put our own polling into the SRAM counts
+    uint32_t frames = scanout_stats.frames;
+    while (scanout_stats.frames == frames) {
+        tight_loop_contents();
+    }
+    for (uint i = 0; i < 4; i++) {
+        bus_ctrl_hw->counter[i].value = 0;  // any write clears
+    }
+    busy_wait_us_32(frame_us);
+    for (uint i = 0; i < 4; i++) {
+        counts[i] = bus_ctrl_hw->counter[i].value;
+    }
+}
+
+void scanout_bus_report(void) {
+    static const bus_ctrl_perf_counter_t accesses[4] = {
+        arbiter_sram0_perf_event_access, arbiter_sram1_perf_event_access,
+        arbiter_sram2_perf_event_access, arbiter_sram3_perf_event_access,
+    };
+    static const bus_ctrl_perf_counter_t contested[4] = {
+        arbiter_sram0_perf_event_access_contested, arbiter_sram1_perf_event_access_contested,
+        arbiter_sram2_perf_event_access_contested, arbiter_sram3_perf_event_access_contested,
+    };
+    uint32_t access_counts[4], contested_counts[4];
+    count_frame(accesses, access_counts);
+    count_frame(contested, contested_counts);
+
+    uint32_t words = line_bytes_per_transfer * frame_height / 4;
+    uintptr_t buffer = (uintptr_t)first_buffer;
+    printf("SRAM bank accesses over a frame: %lu %lu %lu %lu (contested %lu %lu %lu %lu)\n",
+           access_counts[0], access_counts[1], access_counts[2], access_counts[3],
+           contested_counts[0], contested_counts[1], contested_counts[2], contested_counts[3]);
+    printf("  scan-out DMA: %lu word reads per frame (%lu with byte transfers)%s\n", words, words * 4,
+           buffer >= SRAM_STRIPED_BASE && buffer < SRAM_STRIPED_END ? ", a quarter on each bank" :
+           buffer < SRAM_BASE ? " from flash" : ", NOT striped over the banks");
+}
+
+void scanout_report(void) {
+    printf("scan-out: %lu frames, %lu lines, %lu underruns, %lu late reloads, reload lag up to %lu bytes\n",
+           scanout_stats.frames, scanout_stats.lines, scanout_stats.underruns, scanout_stats.late_reloads,
+           scanout_stats.reload_lag_max);
+}
+
+void scanout_render_frame(uint16_t y, uint32_t *line, const uint32_t *prev_line, void *ctx) {
+    scanout_frame_source_t *source = (scanout_frame_source_t *)ctx;
+
+    if (y == 0 && frame_decoder_init(&source->decoder, source->data, source->length) != FRAME_OK) {
+        source->decoder.height = 0;  // makes every row below fail, so the frame stays blank
+    }
+    if (frame_decode_row(&source->decoder, line, line_bytes_per_transfer, prev_line) != FRAME_OK) {
+        memset(line, 0, line_bytes_per_transfer);  // blank anything we can't decode
+    }
+}
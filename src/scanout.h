@@ -0,0 +1,134 @@
+/**
+ * Pixel data scan-out: the DMA pair that feeds the pxl state machine
+ *
+ * Four modes are supported:
+ *
+ *  - framebuffer: channel 0 streams a whole frame (DLP_data_array, or a frame in flash, see
+ *    scanout_set_framebuffer()) to the pxl TX FIFO and channel 1 reloads channel 0's read
+ *    address once per frame (the original setup). DMA_IRQ_0 fires once per frame.
+ *
+ *  - line ring ("racing the beam"): channel 0 sends a single line per transfer and channel 1
+ *    reloads its read address from a small ring of line pointers (DMA read ring wrap), so the
+ *    DMA endlessly cycles through SCANOUT_RING_LINES line buffers. Every finished line raises
+ *    DMA_IRQ_0, in which the line buffers that have just been released are re-rendered by a
+ *    user callback. No full framebuffer is needed, which frees ~225 kB of RAM. A line that was
+ *    not rendered in time (an underrun) goes out with the stale contents of its buffer.
+ *
+ *  - window: a line ring for frames of which only a window holds pixel data (a region of
+ *    interest, see video_mode_fit_window()). The slot pointers of lines above and below the
+ *    window all point at a single zero line, rows of the window that span the whole line are
+ *    streamed straight out of the window's framebuffer, and narrower rows are copied into line
+ *    buffers whose margins stay zero. Only the window takes RAM, and the blank lines and full
+ *    width rows take no CPU time either. A line the interrupt is too late for is skipped and
+ *    counted as an underrun (the slot still holds the line from SCANOUT_RING_LINES before).
+ *
+ *  - tile (step and repeat): channel 0 sends a line per transfer from a row of a small tile
+ *    and wraps its read address around that row (DMA read ring wrap), which repeats the row
+ *    across the line. Channel 1 reloads it for every line from a table of the tile's row
+ *    pointers with a ring wrap of its own, which repeats the rows down the frame. Periodic
+ *    patterns (gratings, grids, test arrays) cover the whole field from a few hundred bytes of
+ *    RAM, and nothing is rendered while they are shown. DMA_IRQ_0 fires every line but only
+ *    counts it, and rewinds tiles that don't fit the frame a whole number of times; a late
+ *    rewind counts as an underrun.
+ *
+ * In every mode DMA_IRQ_0 keeps the frame counter and calls the frame callback, and the line
+ * counter in the three line based modes. It also checks that channel 1 has already restarted
+ * channel 0 (a late reload starves the pxl state machine) and how many bytes channel 0 has sent
+ * since the restart by the time the interrupt runs: the reload lag, i.e. how much of the slack
+ * the interrupt itself eats up.
+ *
+ * Channel 0 moves 32-bit words and the pxl state machine autopulls a word at a time, so a
+ * 2-bit frame takes 57,600 bus transfers instead of 230,400. Buffers must be word aligned and
+ * lines whole words (every mode in video_mode.h is). The RAM the linker places them in
+ * (0x20000000 up) is striped by word over SRAM banks 0-3, so the scan-out reads go to the four
+ * banks in turn and a core working in RAM meets the DMA on a bank a quarter as often as it
+ * would if the buffer sat in one bank (the 0x21000000 aliases); scanout_bus_report() shows
+ * both with the bus performance counters.
+ */
+#ifndef SCANOUT_H
+#define SCANOUT_H
+
+#include <stdint.h>
+#include "hardware/pio.h"
+#include "frame_codec.h"
+
+#define SCANOUT_RING_LINES  8     // must be a power of two (DMA ring wrap)
+
+// words of line ring storage to pass to scanout_init_line_ring (the ring plus one spare line)
+#define SCANOUT_LINE_RING_WORDS(line_bytes)  ((SCANOUT_RING_LINES + 1) * (line_bytes) / 4)
+
+// words of storage to pass to scanout_init_window (the ring, a spare line and the zero line)
+#define SCANOUT_WINDOW_WORDS(line_bytes)  ((SCANOUT_RING_LINES + 2) * (line_bytes) / 4)
+
+#define SCANOUT_TILE_MAX_HEIGHT  128  // rows of a tile (channel 1's table of row pointers)
+
+// render line <y> of the frame into <line>; <prev_line> holds the previously rendered line
+typedef void (*scanout_render_fn)(uint16_t y, uint32_t *line, const uint32_t *prev_line, void *ctx);
+
+typedef struct {
+    volatile uint32_t frames;      // completed frames
+    volatile uint32_t lines;       // completed lines (all modes but framebuffer)
+    volatile uint32_t underruns;   // lines scanned out before they were rendered (tile: late rewinds)
+    volatile uint32_t late_reloads;     // channel 0 not restarted yet when the interrupt ran
+    volatile uint32_t reload_lag_last;  // bytes sent since the restart when the interrupt ran
+    volatile uint32_t reload_lag_max;
+} scanout_stats_t;
+
+extern scanout_stats_t scanout_stats;
+
+void scanout_init_framebuffer(PIO pio, uint sm, const void *buffer, uint32_t line_bytes, uint16_t height);
+void scanout_init_line_ring(PIO pio, uint sm, uint32_t line_bytes, uint16_t height, uint32_t *buffers,
+                            scanout_render_fn render, void *ctx);
+// <window> shows at column <x> (a whole number of words into the line) and line <y>, everything
+// around it is blank. The window's rows are read while they are scanned out.
+void scanout_init_window(PIO pio, uint sm, uint32_t line_bytes, uint16_t height, uint32_t *buffers,
+                         const framebuffer_t *window, uint16_t x, uint16_t y);
+// <tile> repeated over the whole frame from the top left corner. Supported sizes: the width a
+// power of two pixels from one word (32 / bpp pixels) up to 1024 pixels (the rows a power of two
+// bytes, at most a line, with no padding), the height a power of two from 1 to
+// SCANOUT_TILE_MAX_HEIGHT rows. The tile's words must be aligned to a row. Tiles of up to 16
+// rows go into the 720 lines of a frame a whole number of times; taller ones are rewound by
+// DMA_IRQ_0 at the end of every frame. The tile is read while it is scanned out: drawing into it
+// changes the whole field from the next line on.
+void scanout_init_tile(PIO pio, uint sm, uint32_t line_bytes, uint16_t height, const framebuffer_t *tile);
+
+// start the DMA; call after the state machines have been enabled
+void scanout_start(void);
+
+// framebuffer mode: scan out <buffer> from the next frame on, e.g. a frame in flash (see
+// frame_library.h). It must be as large as the buffer passed to scanout_init_framebuffer().
+void scanout_set_framebuffer(const void *buffer);
+
+// framebuffer mode: true if the frame the DMA is streaming comes from <buffer>. From the frame
+// callback this tells whether a scanout_set_framebuffer() made it in time for the frame that
+// has just started (channel 1 may have reloaded before the call).
+bool scanout_showing(const void *buffer);
+
+// called from DMA_IRQ_0 at the end of every frame (when the last pixel data of a frame has
+// been handed to the PIO). It runs in interrupt context just as the DMA restarts at the top of
+// the frame, so anything it writes in row order stays ahead of the beam.
+void scanout_set_frame_callback(void (*callback)(void));
+
+// line of the frame that the DMA is currently fetching (the "beam" position, give or take the
+// up to 16 bytes that sit in the PIO TX FIFO)
+uint16_t scanout_beam_line(void);
+
+void scanout_report(void);
+
+// accesses to SRAM banks 0-3 over one frame period (and how many had to wait for another bus
+// master), next to what the scan-out DMA takes of them. Uses the four bus performance counters
+// and busy waits for about two frames, so the firmware only calls it at boot in a
+// DLP_BOOT_DIAGNOSTICS build.
+void scanout_bus_report(void);
+
+// ready made line source that decodes a DLPF frame (see frame_codec.h) line by line,
+// restarting from the top at every new frame
+typedef struct {
+    const uint8_t *data;
+    uint32_t length;
+    frame_decoder_t decoder;
+} scanout_frame_source_t;
+
+void scanout_render_frame(uint16_t y, uint32_t *line, const uint32_t *prev_line, void *ctx);
+
+#endif
@@ -0,0 +1,215 @@
+/**
+ * Image upload over a PIO SPI slave (see spi_link.h for the protocol)
+ *
+ * One state machine on pio1, one (claimed) DMA channel, and the DMA sniffer for the CRC.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "spi_link.h"
+#include "staging.h"
+#include "delta.h"
+#include "dma_crc.h"
+
+#include "spi_slave.pio.h"
+
+#define HEADER_WORDS 4
+#define SPI_PIO      pio1  // pio0 is full with the video timing programs
+
+spi_link_stats_t spi_link_stats;
+
+static uint sm;
+static uint program_offset;
+static uint dma_chan;
+static uint nak_gpio;
+
+static uint8_t *framebuffer_base;
+static uint32_t framebuffer_size;
+static usb_link_handler_t upload_handler;
+
+// packet being received
+static uint32_t header_words[HEADER_WORDS];
+static uint32_t begin_words[2];   // BEGIN is the only payload that isn't pixel data
+static uint32_t chunk_words[SPI_LINK_MAX_CHUNK / 4];  // DATA, until its CRC checks out
+static bool payload_phase;        // the armed transfer is a payload (else a header)
+static uint8_t type;
+static uint16_t length;
+static uint32_t offset;
+static uint32_t crc;
+static uint8_t *payload_start;
+
+// upload in progress
+static bool active;
+static uint8_t target;
+static uint8_t *target_base;
+static uint32_t target_length;
+static uint64_t begin_time;
+
+static inline uint16_t read_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t read_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// restart the state machine at the top of the program (which raises READY) with the DMA
+// waiting to move <words> words from the RX FIFO to <dst>
+static void arm(void *dst, uint32_t words) {
+    pio_sm_set_enabled(SPI_PIO, sm, false);
+    pio_sm_clear_fifos(SPI_PIO, sm);
+    pio_sm_restart(SPI_PIO, sm);
+    pio_sm_exec(SPI_PIO, sm, pio_encode_jmp(program_offset));
+
+    dma_channel_config c = dma_channel_get_default_config(dma_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);   // 32-bit txfers
+    channel_config_set_read_increment(&c, false);              // always the RX FIFO
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, pio_get_dreq(SPI_PIO, sm, false)); // RX FIFO pacing
+    channel_config_set_bswap(&c, true);                        // the first bit in is the MSB
+    dma_channel_configure(dma_chan, &c, dst, &SPI_PIO->rxf[sm], words, true);
+
+    pio_sm_set_enabled(SPI_PIO, sm, true);
+}
+
+// answer the transaction that just finished and wait for the next header
+static void reply(bool ok) {
+    if (!ok) { spi_link_stats.naks++; }
+    gpio_put(nak_gpio, !ok);  // valid before READY rises again
+    payload_phase = false;
+    arm(header_words, HEADER_WORDS);
+}
+
+static void finish_begin(void) {
+    uint8_t *begin_payload = (uint8_t *)begin_words;
+    target = begin_payload[0];
+    target_length = read_u32(&begin_payload[4]);
+
+    if (target == USB_TARGET_FRAMEBUFFER && framebuffer_base && target_length <= framebuffer_size) {
+        target_base = framebuffer_base;
+    } else if ((target == USB_TARGET_FRAME || target == USB_TARGET_DELTA || target == USB_TARGET_BITPLANES ||
+                target == USB_TARGET_VECTOR || target == USB_TARGET_JOB) &&
+               target_length <= STAGING_SIZE && !staging_locked) {
+        target_base = staging_buffer;
+    } else {
+        active = false;
+        reply(false);
+        return;
+    }
+
+    active = true;
+    begin_time = time_us_64();
+    reply(true);
+}
+
+static void finish_end(void) {
+    active = false;
+    spi_link_stats.uploads++;
+    spi_link_stats.last_upload_us = time_us_64() - begin_time;
+    int status = upload_handler ? upload_handler(target, target_base, target_length) : 0;
+    reply(status >= 0);
+}
+
+// the header is in; refuse it, or arm the payload transfer
+static void finish_header(void) {
+    const uint8_t *header = (const uint8_t *)header_words;
+    spi_link_stats.packets++;
+
+    if (header[0] != 0xD1 || header[1] != 0x50) {
+        reply(false);
+        return;
+    }
+    type = header[2];
+    length = read_u16(&header[6]);
+    offset = read_u32(&header[8]);
+    crc = read_u32(&header[12]);
+
+    uint32_t padded = (length + 3) & ~3u;
+    switch (type) {
+        case USB_PKT_PING:
+            reply(length == 0);
+            return;
+        case USB_PKT_END:
+            if (length != 0 || !active) {
+                reply(false);
+            } else {
+                finish_end();
+            }
+            return;
+        case USB_PKT_BEGIN:
+            if (length != sizeof(begin_words)) {
+                reply(false);
+                return;
+            }
+            payload_start = (uint8_t *)begin_words;
+            break;
+        case USB_PKT_DATA:
+            // never write outside of the upload target
+            if (!active || length > SPI_LINK_MAX_CHUNK || (offset & 3) || offset > target_length ||
+                length > target_length - offset) {
+                reply(false);
+                return;
+            }
+            payload_start = (uint8_t *)chunk_words;
+            break;
+        default:
+            reply(false);
+            return;
+    }
+
+    gpio_put(nak_gpio, 0);
+    payload_phase = true;
+    arm(payload_start, padded / 4);
+}
+
+static void finish_payload(void) {
+    if (dma_crc32(payload_start, length) != crc) {
+        spi_link_stats.crc_errors++;
+        reply(false);
+        return;
+    }
+
+    if (type == USB_PKT_BEGIN) {
+        finish_begin();
+        return;
+    }
+    memcpy(target_base + offset, chunk_words, length);
+    spi_link_stats.bytes += length;
+    reply(true);
+}
+
+void spi_link_init(uint mosi_pin, uint ready_pin, uint nak_pin,
+                   uint8_t *framebuffer, uint32_t framebuffer_length, usb_link_handler_t handler) {
+    framebuffer_base = framebuffer;
+    framebuffer_size = framebuffer_length;
+    upload_handler = handler;
+
+    nak_gpio = nak_pin;
+    gpio_init(nak_pin);
+    gpio_set_dir(nak_pin, GPIO_OUT);
+
+    program_offset = pio_add_program(SPI_PIO, &spi_slave_program);
+    sm = pio_claim_unused_sm(SPI_PIO, true);
+    spi_slave_program_init(SPI_PIO, sm, program_offset, mosi_pin, ready_pin);
+    dma_chan = dma_claim_unused_channel(true);
+
+    reply(true);
+}
+
+void spi_link_poll(void) {
+    if (dma_channel_is_busy(dma_chan)) {
+        return;  // transaction still in progress (or none started yet)
+    }
+    // hold the host off (READY stays low) while a queued delta still reads the staging area
+    if (delta_pending()) {
+        return;
+    }
+
+    if (payload_phase) {
+        finish_payload();
+    } else {
+        finish_header();
+    }
+}
@@ -0,0 +1,57 @@
+/**
+ * Image upload over a PIO SPI slave on pio1
+ *
+ * The receive-only counterpart of usb_link.h for a host with an SPI master (e.g. a Raspberry
+ * Pi, see utils/spi_frame_upload.py). It uses the same packets, targets and completion handler,
+ * but every packet is two SPI transactions: the 16 byte header, then (if length > 0) the
+ * payload, padded with zeros to a multiple of 4 bytes. The payload is DMA'd from the PIO RX
+ * FIFO into a chunk buffer; the CPU only looks at the headers, checks the CRC there and copies
+ * a chunk that checks out to its destination (the framebuffer, or the staging area for
+ * compressed frames/deltas), so a corrupt chunk never shows up on the projector.
+ *
+ * Pins: MOSI, SCK = MOSI + 1, CS = MOSI + 2 (inputs, SPI mode 0, MSB first, SCK <= 15 MHz)
+ *       READY (output, driven by the state machine), NAK (output)
+ *
+ * Flow control: the host waits for READY high before every transaction. READY drops as soon
+ * as CS is asserted and only comes back once the pico has armed the next transfer, which it
+ * doesn't do while a queued delta still needs the staging area. When READY comes back NAK
+ * tells the host whether the previous transaction was accepted:
+ *    after a header:   NAK low  -> send the payload (if any)
+ *                      NAK high -> header refused (bad sync, range or state), no payload
+ *    after a payload:  NAK high -> CRC mismatch, or the completion handler failed
+ * A refused packet is resent as a whole, header first.
+ *
+ * Unlike usb_link there is only ever one packet in flight, so seq is not checked; DATA
+ * offsets must be a multiple of 4 and a packet may carry up to SPI_LINK_MAX_CHUNK bytes.
+ * The pixel scan-out DMA channels run at high priority, so the upload DMA only gets the
+ * bus cycles the scan-out leaves over.
+ */
+#ifndef SPI_LINK_H
+#define SPI_LINK_H
+
+#include <stdint.h>
+#include "pico/stdlib.h"
+#include "usb_link.h"   // packet types, targets and handler type are shared
+
+#define SPI_LINK_MAX_CHUNK  4096   // the chunk buffer
+
+typedef struct {
+    uint32_t packets;
+    uint32_t bytes;          // payload bytes accepted
+    uint32_t crc_errors;
+    uint32_t naks;           // refused headers and payloads (including CRC errors)
+    uint32_t uploads;        // completed uploads
+    uint32_t last_upload_us; // BEGIN to END of the most recent upload
+} spi_link_stats_t;
+
+extern spi_link_stats_t spi_link_stats;
+
+// claims a state machine on pio1 and a DMA channel. <framebuffer> may be NULL in builds
+// without one (it must be word aligned otherwise).
+void spi_link_init(uint mosi_pin, uint ready_pin, uint nak_pin,
+                   uint8_t *framebuffer, uint32_t framebuffer_length, usb_link_handler_t handler);
+
+// service the link; never blocks. Call as often as possible.
+void spi_link_poll(void);
+
+#endif
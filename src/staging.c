@@ -0,0 +1,14 @@
+#include "staging.h"
+
+// word aligned, the delta and frame decoders read it a word at a time
+static uint8_t staging_areas[STAGING_BUFFERS][STAGING_SIZE] __attribute__((aligned(4)));
+static uint32_t current;
+
+uint8_t *staging_buffer = staging_areas[0];
+
+volatile bool staging_locked;
+
+void staging_flip(void) {
+    current = (current + 1) % STAGING_BUFFERS;
+    staging_buffer = staging_areas[current];
+}
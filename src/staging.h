@@ -0,0 +1,43 @@
+/**
+ * Staging area for compressed frames and layer deltas on their way into the framebuffer
+ *
+ * With the full framebuffer there is only room for a small staging area next to
+ * DLP_data_array (more with a 1-bit framebuffer); in line ring builds most of the RAM is available.
+ */
+#ifndef STAGING_H
+#define STAGING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef STAGING_SIZE
+#if DLP_LINE_RING
+#define STAGING_SIZE  (80 * 1024)   // twice, see staging_flip()
+#elif DLP_PIXEL_BPP == 1
+#define STAGING_SIZE  (96 * 1024)   // a 1-bit framebuffer is half the size
+#else
+#define STAGING_SIZE  (16 * 1024)
+#endif
+#endif
+
+// Line ring builds render straight from the staging area: an uploaded frame or display list is
+// decoded or rasterised from it line by line for as long as it is shown. There are two staging
+// areas there, uploads go into one while the scan-out reads the other.
+#if DLP_LINE_RING
+#define STAGING_BUFFERS  2
+#else
+#define STAGING_BUFFERS  1
+#endif
+
+// the staging area the next upload goes into
+extern uint8_t *staging_buffer;
+
+// the upload in staging_buffer is being shown: the next one goes into the other staging area
+// (which stays locked until the scan-out has stopped reading it)
+void staging_flip(void);
+
+// set while a completed upload is still being read from the staging area (a bit-plane sequence
+// being exposed, see bitplane.h); no new uploads go into it until it is cleared
+extern volatile bool staging_locked;
+
+#endif
@@ -0,0 +1,72 @@
+/**
+ * Scan-out telemetry (see telemetry.h)
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "telemetry.h"
+#include "scanout.h"
+#include "clock_plan.h"
+#include "i2c_queue.h"
+#include "exposure.h"
+#include "usb_link.h"
+#include "spi_link.h"
+
+static_assert(sizeof(telemetry_t) == 84, "telemetry_t is the wire format, see utils/telemetry.py");
+
+telemetry_t telemetry;
+
+static PIO video_pio;
+
+void telemetry_init(PIO pio, uint8_t bpp) {
+    memset(&telemetry, 0, sizeof(telemetry));
+    telemetry.version = TELEMETRY_VERSION;
+    telemetry.bpp = bpp;
+    telemetry.size = sizeof(telemetry);
+    telemetry.pclk_khz = clock_plan_current()->pclk_hz / 1000;
+
+    // forget the stalls from before the scan-out DMA was started
+    pio->fdebug = PIO_FDEBUG_TXSTALL_BITS | PIO_FDEBUG_TXOVER_BITS;
+    video_pio = pio;
+}
+
+void __not_in_flash_func(telemetry_frame_end)(void) {
+    if (!video_pio) { return; }
+
+    uint32_t flags = video_pio->fdebug & (PIO_FDEBUG_TXSTALL_BITS | PIO_FDEBUG_TXOVER_BITS);
+    if (!flags) { return; }
+    video_pio->fdebug = flags;  // write 1 to clear
+
+    for (uint sm = 0; sm < 4; sm++) {
+        if (flags & (1u << (PIO_FDEBUG_TXSTALL_LSB + sm))) { telemetry.tx_stall[sm]++; }
+        if (flags & (1u << (PIO_FDEBUG_TXOVER_LSB + sm))) { telemetry.tx_over[sm]++; }
+    }
+}
+
+const telemetry_t *telemetry_read(void) {
+    telemetry.uptime_us = time_us_32();
+    telemetry.frames = scanout_stats.frames;
+    telemetry.lines = scanout_stats.lines;
+    telemetry.underruns = scanout_stats.underruns;
+    telemetry.late_reloads = scanout_stats.late_reloads;
+    telemetry.reload_lag_last = scanout_stats.reload_lag_last;
+    telemetry.reload_lag_max = scanout_stats.reload_lag_max;
+    telemetry.i2c_commands = i2c_queue_stats.commands;
+    telemetry.i2c_errors = i2c_queue_stats.errors;
+    telemetry.exposure_i2c_errors = exposure_stats.i2c_errors;
+    telemetry.upload_crc_errors = usb_link_stats.crc_errors + spi_link_stats.crc_errors;
+    return &telemetry;
+}
+
+void telemetry_report(void) {
+    const telemetry_t *t = telemetry_read();
+    printf("telemetry: %lu frames, %lu lines, %lu underruns, %lu late reloads, reload lag %lu bytes (max %lu)\n",
+           t->frames, t->lines, t->underruns, t->late_reloads, t->reload_lag_last, t->reload_lag_max);
+    printf("  frames with TX stalls per state machine: %lu %lu %lu %lu, TX overflows: %lu %lu %lu %lu\n",
+           t->tx_stall[0], t->tx_stall[1], t->tx_stall[2], t->tx_stall[3],
+           t->tx_over[0], t->tx_over[1], t->tx_over[2], t->tx_over[3]);
+    printf("  I2C: %lu commands, %lu errors (%lu in exposures); %lu upload CRC errors\n",
+           t->i2c_commands, t->i2c_errors, t->exposure_i2c_errors, t->upload_crc_errors);
+}
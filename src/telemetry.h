@@ -0,0 +1,56 @@
+/**
+ * Scan-out telemetry: one block of always-on counters, queryable over USB
+ *
+ * The block gathers what tells whether the scan-out keeps up: frames and lines sent, line ring
+ * underruns, late or lagging DMA reloads (see scanout.h), and per state machine of the video
+ * PIO the frames in which FDEBUG flagged a TX stall (the state machine wanted data from an
+ * empty TX FIFO, so the image shifts) or a TX overflow (a write to a full FIFO was lost). The
+ * FDEBUG flags are sticky; they are collected and cleared once per frame, in the scan-out
+ * frame interrupt. I2C and upload error counts are copied in from their modules when the
+ * block is read.
+ *
+ * The host reads the block with USB_CMD_TELEMETRY (see usb_link.h); utils/telemetry.py decodes
+ * it and streams the rates live. The layout is the wire format: little-endian, no padding.
+ */
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "hardware/pio.h"
+
+#define TELEMETRY_VERSION  1
+
+typedef struct {
+    uint8_t version;               // TELEMETRY_VERSION
+    uint8_t bpp;                   // bits per pixel of the scan-out
+    uint16_t size;                 // bytes in this block
+    uint32_t uptime_us;            // time_us_32() when the block was read
+    uint32_t pclk_khz;             // pixel clock
+    uint32_t frames;               // scan-out (scanout_stats)
+    uint32_t lines;
+    uint32_t underruns;
+    uint32_t late_reloads;
+    uint32_t reload_lag_last;      // bytes
+    uint32_t reload_lag_max;
+    uint32_t tx_stall[4];          // frames with FDEBUG TXSTALL, per state machine
+    uint32_t tx_over[4];           // frames with FDEBUG TXOVER, per state machine
+    uint32_t i2c_commands;         // I2C command queue
+    uint32_t i2c_errors;
+    uint32_t exposure_i2c_errors;  // failed START/STOP writes
+    uint32_t upload_crc_errors;    // USB and SPI
+} telemetry_t;
+
+extern telemetry_t telemetry;
+
+// start counting on the video state machines of <pio>; call once the scan-out is running
+void telemetry_init(PIO pio, uint8_t bpp);
+
+// collect the FDEBUG flags; call from the scan-out frame callback (see scanout_set_frame_callback)
+void telemetry_frame_end(void);
+
+// bring the block up to date and return it
+const telemetry_t *telemetry_read(void);
+
+void telemetry_report(void);
+
+#endif
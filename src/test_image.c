@@ -1,6 +1,9 @@
+#include "test_image.h"  // DLP_DATA_BYTES
 
 // not a very elegant way of storing this information. 
 
 // paste big comma separated hex list below. You can use the utils/grayscale_tiff_to_bytes.py to
 // generate this
-unsigned char DLP_data_array[230400];  // = {};
\ No newline at end of file
+#if !DLP_LINE_RING  // the line ring scan-out mode does not need a framebuffer
+unsigned char DLP_data_array[DLP_DATA_BYTES] __attribute__((aligned(DLP_DATA_ALIGN)));  // = {};  (word aligned for framebuffer.c)
+#endif
\ No newline at end of file
@@ -1 +1,29 @@
+#include "video_mode.h"
+#include "framebuffer.h"
+#include "scanout.h"
+
+#ifndef DLP_PIXEL_BPP
+#define DLP_PIXEL_BPP  2
+#endif
+
+#if DLP_TILE_WIDTH
+// a single tile (cmake DLP_TILE), aligned to its rows for the scan-out's read ring wrap
+#define DLP_DATA_BYTES  (FB_ROW_BYTES(DLP_TILE_WIDTH, DLP_PIXEL_BPP) * DLP_TILE_HEIGHT)
+#define DLP_DATA_ALIGN  FB_ROW_BYTES(DLP_TILE_WIDTH, DLP_PIXEL_BPP)
+#elif !defined(DLP_ROI_WIDTH)
+#define DLP_ROI_X       0
+#define DLP_ROI_Y       0
+#define DLP_ROI_WIDTH   VIDEO_WIDTH
+#define DLP_ROI_HEIGHT  VIDEO_HEIGHT
+#define DLP_DATA_BYTES  VIDEO_FRAME_BYTES(DLP_PIXEL_BPP)  // one frame at the compiled-in bit depth
+#else
+// only the window (cmake DLP_ROI), and the line buffers that scan it out (see scanout.h)
+#define DLP_DATA_BYTES  (FB_ROW_BYTES(DLP_ROI_WIDTH, DLP_PIXEL_BPP) * DLP_ROI_HEIGHT + \
+                         SCANOUT_WINDOW_WORDS(VIDEO_LINE_BYTES(DLP_PIXEL_BPP)) * 4)
+#endif
+
+#ifndef DLP_DATA_ALIGN
+#define DLP_DATA_ALIGN  4
+#endif
+
 extern unsigned char DLP_data_array[];  // just make sure our DLP_pico.c can access this array
\ No newline at end of file
@@ -0,0 +1,246 @@
+/**
+ * Binary frame upload over the USB CDC serial port (see usb_link.h for the protocol)
+ *
+ * The chunk CRCs are computed by the DMA sniffer (see dma_crc.h).
+ */
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include "usb_link.h"
+#include "staging.h"
+#include "delta.h"
+#include "dma_crc.h"
+
+#define HEADER_SIZE 16
+#define ACK_SIZE    12
+
+usb_link_stats_t usb_link_stats;
+
+static uint8_t *framebuffer_base;
+static uint32_t framebuffer_size;
+static usb_link_handler_t upload_handler;
+static usb_link_command_t command_handler;
+
+// packet being received
+static uint8_t header[HEADER_SIZE];
+static uint32_t header_fill;
+static uint8_t type;
+static uint16_t seq;
+static uint16_t length;
+static uint32_t offset;
+static uint32_t crc;
+static uint8_t *payload_start;
+static uint8_t *payload_dst;
+static uint32_t payload_left;
+static bool discard;               // payload is read but dropped (range error)
+static uint8_t begin_payload[8];   // BEGIN and COMMAND are the only payloads that aren't pixel data
+static uint8_t chunk[USB_LINK_MAX_CHUNK] __attribute__((aligned(4)));  // DATA, until its CRC checks out
+
+// upload in progress
+static bool active;
+static uint8_t target;
+static uint8_t *target_base;
+static uint32_t target_length;
+static uint16_t expected_seq;
+static uint64_t begin_time;
+
+static inline uint16_t read_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t read_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void send_reply(uint8_t status, uint8_t acked_type, uint16_t acked_seq, uint32_t value,
+                       const void *reply, uint16_t reply_length) {
+    uint8_t ack[ACK_SIZE] = {
+        0xD1, 0x5A, status, acked_type,
+        acked_seq & 0xFF, acked_seq >> 8, reply_length & 0xFF, reply_length >> 8,
+        value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24
+    };
+    tud_cdc_write(ack, ACK_SIZE);
+    if (reply_length) {
+        tud_cdc_write(reply, reply_length);  // fits in the CDC FIFO next to the ack
+    }
+    tud_cdc_write_flush();
+}
+
+static void send_ack(uint8_t status, uint8_t acked_type, uint16_t acked_seq, uint32_t value) {
+    send_reply(status, acked_type, acked_seq, value, NULL, 0);
+}
+
+// the header is complete; work out where the payload goes
+static void start_payload(void) {
+    type = header[2];
+    seq = read_u16(&header[4]);
+    length = read_u16(&header[6]);
+    offset = read_u32(&header[8]);
+    crc = read_u32(&header[12]);
+    discard = false;
+
+    if (length > USB_LINK_MAX_CHUNK) {
+        discard = true;
+    } else if (type == USB_PKT_BEGIN || type == USB_PKT_COMMAND) {
+        discard = (length != sizeof(begin_payload));
+        payload_start = begin_payload;
+    } else if (type == USB_PKT_DATA) {
+        // never write outside of the upload target
+        discard = !active || offset > target_length || length > target_length - offset;
+        payload_start = discard ? NULL : chunk;
+    } else {
+        discard = (length != 0);
+    }
+
+    payload_dst = payload_start;
+    payload_left = length;
+}
+
+static void finish_begin(void) {
+    target = begin_payload[0];
+    target_length = read_u32(&begin_payload[4]);
+
+    bool staging_target = target == USB_TARGET_FRAME || target == USB_TARGET_DELTA ||
+                          target == USB_TARGET_BITPLANES || target == USB_TARGET_VECTOR || target == USB_TARGET_JOB;
+    if (staging_target && (delta_pending() || staging_locked)) {
+        // the staging area is still being read: by a queued delta until the next frame end (the
+        // SPI link holds READY low for that), or by what is being shown or exposed; the host retries
+        active = false;
+        send_ack(USB_ACK_STATE, type, seq, 0);
+        return;
+    }
+
+    if (target == USB_TARGET_FRAMEBUFFER && framebuffer_base && target_length <= framebuffer_size) {
+        target_base = framebuffer_base;
+    } else if (staging_target && target_length <= STAGING_SIZE) {
+        target_base = staging_buffer;
+    } else {
+        active = false;
+        send_ack(USB_ACK_RANGE, type, seq, 0);
+        return;
+    }
+
+    active = true;
+    expected_seq = seq + 1;
+    begin_time = time_us_64();
+    send_ack(USB_ACK_OK, type, seq, 0);
+}
+
+static void finish_command(void) {
+    uint32_t value = 0;
+    const void *reply = NULL;
+    uint16_t reply_length = 0;
+    int status = command_handler ? command_handler(begin_payload[0], read_u32(&begin_payload[4]), &value,
+                                                   &reply, &reply_length) : -1;
+    if (status < 0 || reply_length > USB_LINK_MAX_REPLY) {
+        reply_length = 0;
+    }
+    send_reply(status < 0 ? (uint8_t)status : USB_ACK_OK, type, seq, value, reply, reply_length);
+}
+
+static void finish_packet(void) {
+    usb_link_stats.packets++;
+
+    if (discard) {
+        // DATA without an upload (e.g. after a refused BEGIN) is a state error, not a range one
+        send_ack(type == USB_PKT_DATA && !active ? USB_ACK_STATE : USB_ACK_RANGE, type, seq, 0);
+        return;
+    }
+    if (length && dma_crc32(payload_start, length) != crc) {
+        usb_link_stats.crc_errors++;
+        send_ack(USB_ACK_CRC, type, seq, 0);
+        return;
+    }
+
+    switch (type) {
+        case USB_PKT_PING:
+            send_ack(USB_ACK_OK, type, seq, 0);
+            return;
+        case USB_PKT_BEGIN:
+            finish_begin();
+            return;
+        case USB_PKT_COMMAND:
+            finish_command();
+            return;
+        case USB_PKT_DATA:
+        case USB_PKT_END:
+            break;
+        default:
+            send_ack(USB_ACK_STATE, type, seq, 0);
+            return;
+    }
+
+    if (!active) {
+        send_ack(USB_ACK_STATE, type, seq, 0);
+        return;
+    }
+    if (seq != expected_seq) {
+        // a retransmit of something we already have is acked and dropped; a gap
+        // means a packet got lost, so ask for everything from the expected one onwards
+        bool duplicate = (int16_t)(seq - expected_seq) < 0;
+        if (!duplicate) { usb_link_stats.seq_errors++; }
+        send_ack(duplicate ? USB_ACK_OK : USB_ACK_SEQUENCE, type, duplicate ? seq : expected_seq, 0);
+        return;
+    }
+    expected_seq++;
+
+    if (type == USB_PKT_DATA) {
+        memcpy(target_base + offset, chunk, length);
+        usb_link_stats.bytes += length;
+        send_ack(USB_ACK_OK, type, seq, 0);
+        return;
+    }
+
+    // USB_PKT_END
+    active = false;
+    usb_link_stats.uploads++;
+    usb_link_stats.last_upload_us = time_us_64() - begin_time;
+    int status = upload_handler ? upload_handler(target, target_base, target_length) : 0;
+    send_ack(status < 0 ? (uint8_t)status : USB_ACK_OK, type, seq, usb_link_stats.last_upload_us);
+}
+
+void usb_link_init(uint8_t *framebuffer, uint32_t framebuffer_length, usb_link_handler_t handler) {
+    framebuffer_base = framebuffer;
+    framebuffer_size = framebuffer_length;
+    upload_handler = handler;
+}
+
+void usb_link_set_command_handler(usb_link_command_t handler) {
+    command_handler = handler;
+}
+
+void usb_link_poll(void) {
+    while (tud_cdc_connected() && tud_cdc_available()) {
+        if (header_fill < HEADER_SIZE) {
+            uint8_t byte;
+            tud_cdc_read(&byte, 1);
+
+            // resynchronise on the sync bytes if we ever lose track of the stream
+            if ((header_fill == 0 && byte != 0xD1) || (header_fill == 1 && byte != 0x50)) {
+                header_fill = 0;
+                continue;
+            }
+            header[header_fill++] = byte;
+
+            if (header_fill == HEADER_SIZE) {
+                start_payload();
+            }
+        } else if (payload_left) {
+            uint32_t count;
+            if (discard) {
+                uint8_t scratch[64];
+                count = tud_cdc_read(scratch, MIN(payload_left, sizeof(scratch)));
+            } else {
+                count = tud_cdc_read(payload_dst, payload_left);
+                payload_dst += count;
+            }
+            payload_left -= count;
+        }
+
+        if (header_fill == HEADER_SIZE && payload_left == 0) {
+            finish_packet();
+            header_fill = 0;
+        }
+    }
+}
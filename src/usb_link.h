@@ -0,0 +1,93 @@
+/**
+ * Binary frame upload over the USB CDC serial port
+ *
+ * The host (utils/usb_frame_upload.py) sends packets, each answered with an ack. A chunk is
+ * read from the USB stack into a chunk buffer and its CRC computed there by the DMA sniffer;
+ * only a chunk that checks out is copied to its destination (the framebuffer, or the staging
+ * area for compressed frames/deltas), so a corrupt chunk never shows up on the projector.
+ *
+ * Packet (host -> pico), little-endian, 16 byte header + payload:
+ *    u8  0xD1, u8 0x50      sync
+ *    u8  type               USB_PKT_*
+ *    u8  reserved
+ *    u16 seq                increments by one per packet, starting at 0 with USB_PKT_BEGIN
+ *    u16 length             payload bytes (at most USB_LINK_MAX_CHUNK)
+ *    u32 offset             destination offset of the payload within the upload
+ *    u32 crc32              CRC-32 (zlib) of the payload
+ *
+ *  USB_PKT_BEGIN payload:   u8 target (USB_TARGET_*), u8 reserved[3], u32 total length
+ *  USB_PKT_DATA payload:    data for [offset, offset + length)
+ *  USB_PKT_END:             no payload; the upload is handed to the completion handler
+ *  USB_PKT_PING:            no payload
+ *  USB_PKT_COMMAND payload: u8 command (USB_CMD_*), u8 reserved[3], u32 argument; handled
+ *                           straight away, also while an upload is in progress
+ *
+ * Ack (pico -> host), 12 bytes:
+ *    u8  0xD1, u8 0x5A      sync
+ *    u8  status             USB_ACK_* (or the negative handler status for USB_PKT_END)
+ *    u8  type               type of the packet being acknowledged
+ *    u16 seq                seq of the packet being acknowledged
+ *    u16 reply length       USB_PKT_COMMAND: bytes of reply following the ack, otherwise 0
+ *    u32 value              USB_PKT_END: microseconds between BEGIN and END on the pico
+ *                           USB_PKT_COMMAND: the command's result
+ */
+#ifndef USB_LINK_H
+#define USB_LINK_H
+
+#include <stdint.h>
+
+#define USB_LINK_MAX_CHUNK  4096
+
+#define USB_PKT_BEGIN   0x01
+#define USB_PKT_DATA    0x02
+#define USB_PKT_END     0x03
+#define USB_PKT_PING    0x04
+#define USB_PKT_COMMAND 0x05
+
+#define USB_CMD_SELECT_FRAME    0x01   // show frame <argument> of the flash frame library
+#define USB_CMD_TELEMETRY       0x02   // reply: the telemetry block (see telemetry.h)
+#define USB_CMD_END_SESSION     0x03   // stop once the queued exposures and the job are done
+
+#define USB_LINK_MAX_REPLY      128    // bytes of command reply
+
+#define USB_TARGET_FRAMEBUFFER  0x00   // raw packed pixels, written straight into the framebuffer
+#define USB_TARGET_FRAME        0x01   // DLPF compressed frame (staging area)
+#define USB_TARGET_DELTA        0x02   // DLPD layer delta (staging area)
+#define USB_TARGET_BITPLANES    0x03   // DLPB bit-plane sequence (staging area, see bitplane.h)
+#define USB_TARGET_VECTOR       0x04   // DLPV display list (staging area, see vector.h)
+#define USB_TARGET_JOB          0x05   // DLPJ job manifest (staging area, see job.h)
+
+#define USB_ACK_OK          0x00
+#define USB_ACK_CRC         0x01   // payload CRC mismatch, resend
+#define USB_ACK_SEQUENCE    0x02   // unexpected seq (a packet went missing), resend from seq
+#define USB_ACK_RANGE       0x03   // offset/length outside the target
+#define USB_ACK_STATE       0x04   // DATA/END without BEGIN, unknown type/target, or staging busy
+
+typedef struct {
+    uint32_t packets;
+    uint32_t bytes;          // payload bytes accepted
+    uint32_t crc_errors;
+    uint32_t seq_errors;
+    uint32_t uploads;        // completed uploads
+    uint32_t last_upload_us; // BEGIN to END of the most recent upload
+} usb_link_stats_t;
+
+extern usb_link_stats_t usb_link_stats;
+
+// called at USB_PKT_END with the received upload; return 0 or a negative error code
+typedef int (*usb_link_handler_t)(uint8_t target, uint8_t *data, uint32_t length);
+
+// called for USB_PKT_COMMAND; return 0 or a negative error code. <value> goes into the ack,
+// followed by <reply_length> bytes from <reply> if the command sets it (data that stays valid)
+typedef int (*usb_link_command_t)(uint8_t command, uint32_t argument, uint32_t *value,
+                                  const void **reply, uint16_t *reply_length);
+
+// <framebuffer> may be NULL in builds without one
+void usb_link_init(uint8_t *framebuffer, uint32_t framebuffer_length, usb_link_handler_t handler);
+
+void usb_link_set_command_handler(usb_link_command_t handler);
+
+// service the link; never blocks. Call as often as possible.
+void usb_link_poll(void);
+
+#endif
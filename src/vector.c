@@ -0,0 +1,454 @@
+/**
+ * Display-list rasteriser (see vector.h for the format)
+ *
+ * Runs on core1 when rasterising into the framebuffer, or in the scan-out interrupt when
+ * rendering into the line ring.
+ */
+#include <string.h>
+#include "pico/stdlib.h"
+#include "vector.h"
+
+#define SUBPIXEL       (1 << VECTOR_SUBPIXEL_BITS)
+#define HALF           (SUBPIXEL / 2)
+
+static inline uint16_t read_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline int16_t read_i16(const uint8_t *p) {
+    return (int16_t)read_u16(p);
+}
+
+static inline uint32_t read_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// the records are word aligned, so their coordinates can be read in place
+static inline const int16_t *coords(const uint8_t *record) {
+    return (const int16_t *)(record + 4);
+}
+
+static inline int32_t div_floor(int32_t a, int32_t b) {  // b > 0
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static inline int32_t div_ceil(int32_t a, int32_t b) {  // b > 0
+    return -div_floor(-a, b);
+}
+
+static inline int64_t div_floor64(int64_t a, int64_t b) {  // b > 0
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static uint32_t isqrt(uint64_t v) {
+    uint64_t root = 0;
+    uint64_t bit = 1ull << 62;
+    while (bit > v) { bit >>= 2; }
+    while (bit) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+static uint32_t record_size(const uint8_t *record) {
+    switch (record[0]) {
+        case VECTOR_RECT:
+        case VECTOR_CIRCLE:
+            return 12;
+        case VECTOR_TRACE:
+            return 16;
+        case VECTOR_POLYGON:
+            return 8 + 8 * (uint32_t)read_u16(&record[2]);
+        default:
+            return 0;
+    }
+}
+
+// first line centre the primitive can cover, and the first one below it
+static int32_t record_top(const uint8_t *record) {
+    const int16_t *c = coords(record);
+    switch (record[0]) {
+        case VECTOR_CIRCLE:
+            return c[1] - c[2];
+        case VECTOR_TRACE:
+            return MIN(c[1], c[3]) - c[4];
+        default:  // rect: y0, polygon: top
+            return record[0] == VECTOR_RECT ? c[1] : c[0];
+    }
+}
+
+static int32_t record_bottom(const uint8_t *record) {
+    const int16_t *c = coords(record);
+    switch (record[0]) {
+        case VECTOR_CIRCLE:
+            return c[1] + c[2] + 1;
+        case VECTOR_TRACE:
+            return MAX(c[1], c[3]) + c[4] + 1;
+        default:  // rect: y1, polygon: bottom
+            return record[0] == VECTOR_RECT ? c[3] : c[1];
+    }
+}
+
+// within VECTOR_MARGIN of a width x height field (in pixels)
+static bool in_range(int32_t x, int32_t y, uint16_t width, uint16_t height) {
+    return x >= -VECTOR_MARGIN && x <= width * SUBPIXEL + VECTOR_MARGIN &&
+           y >= -VECTOR_MARGIN && y <= height * SUBPIXEL + VECTOR_MARGIN;
+}
+
+int vector_validate(const uint8_t *data, uint32_t length, uint16_t width, uint16_t height) {
+    if (length < VECTOR_HEADER_SIZE || ((uintptr_t)data & 3)) { return VECTOR_ERROR_HEADER; }
+    if (data[0] != 'D' || data[1] != 'L' || data[2] != 'P' || data[3] != 'V') { return VECTOR_ERROR_HEADER; }
+    if (data[4] != VECTOR_VERSION || read_u16(&data[6]) > VECTOR_MAX_LAYERS) { return VECTOR_ERROR_HEADER; }
+    if (read_u16(&data[8]) != width || read_u16(&data[10]) > height) { return VECTOR_ERROR_HEADER; }
+    if (read_u32(&data[12]) > length - VECTOR_HEADER_SIZE) { return VECTOR_ERROR_TRUNCATED; }
+
+    const uint16_t rows = read_u16(&data[10]);
+    const uint8_t *pos = data + VECTOR_HEADER_SIZE;
+    const uint8_t *end = pos + read_u32(&data[12]);
+    for (uint layer = 0; layer < read_u16(&data[6]); layer++) {
+        if (end - pos < 8) { return VECTOR_ERROR_TRUNCATED; }
+        if (pos[0] != VECTOR_LAYER) { return VECTOR_ERROR_RECORD; }
+        uint16_t count = read_u16(&pos[2]);
+        uint32_t bytes = read_u32(&pos[4]);
+        pos += 8;
+        if ((uint32_t)(end - pos) < bytes) { return VECTOR_ERROR_TRUNCATED; }
+
+        const uint8_t *layer_end = pos + bytes;
+        int32_t previous_top = INT32_MIN;
+        for (uint i = 0; i < count; i++) {
+            if (layer_end - pos < 4) { return VECTOR_ERROR_TRUNCATED; }
+            uint32_t size = record_size(pos);
+            if (size == 0) { return VECTOR_ERROR_RECORD; }
+            if ((uint32_t)(layer_end - pos) < size) { return VECTOR_ERROR_TRUNCATED; }
+
+            int32_t top = record_top(pos);
+            if (top < previous_top) { return VECTOR_ERROR_RECORD; }  // the activation relies on the order
+            previous_top = top;
+
+            const int16_t *c = coords(pos);
+            if (pos[0] == VECTOR_POLYGON) {
+                int32_t edge_top = INT32_MIN;
+                for (uint e = 0; e < read_u16(&pos[2]); e++) {
+                    const uint8_t *edge = pos + 8 + 8 * e;
+                    int16_t y0 = read_i16(&edge[2]);
+                    int16_t y1 = read_i16(&edge[6]);
+                    if (y0 >= y1 || y0 < edge_top || y0 < c[0] || y1 > c[1] ||
+                        !in_range(read_i16(&edge[0]), y0, width, rows) ||
+                        !in_range(read_i16(&edge[4]), y1, width, rows)) {
+                        return VECTOR_ERROR_RECORD;
+                    }
+                    edge_top = y0;
+                }
+            } else if (pos[0] == VECTOR_CIRCLE) {
+                if (!in_range(c[0], c[1], width, rows) || c[2] < 0 || c[2] > VECTOR_MARGIN) {
+                    return VECTOR_ERROR_RECORD;
+                }
+            } else if (!in_range(c[0], c[1], width, rows) || !in_range(c[2], c[3], width, rows) ||
+                       (pos[0] == VECTOR_TRACE && (c[4] < 0 || c[4] > VECTOR_MARGIN))) {
+                return VECTOR_ERROR_RECORD;  // rect or trace
+            }
+            pos += size;
+        }
+        if (pos != layer_end) { return VECTOR_ERROR_TRUNCATED; }
+    }
+    return VECTOR_OK;
+}
+
+static void rewind(vector_raster_t *r) {
+    r->y = 0;
+    r->active_count = 0;
+    r->edge_count = 0;
+    for (uint i = 0; i < r->layer_count; i++) {
+        r->layers[i].next = r->layers[i].first;
+        r->layers[i].left = r->layers[i].count;
+    }
+}
+
+void vector_start(vector_raster_t *r, const uint8_t *data) {
+    r->data = data;
+    r->width = read_u16(&data[8]);
+    r->height = read_u16(&data[10]);
+    r->layer_count = read_u16(&data[6]);
+    r->primitives = 0;
+    r->max_active = 0;
+    r->max_edges = 0;
+    r->dropped = 0;
+
+    const uint8_t *pos = data + VECTOR_HEADER_SIZE;
+    for (uint i = 0; i < r->layer_count; i++) {
+        r->layers[i].clear = pos[1] & VECTOR_LAYER_CLEAR;
+        r->layers[i].count = read_u16(&pos[2]);
+        r->layers[i].first = pos + 8;
+        r->primitives += r->layers[i].count;
+        pos += 8 + read_u32(&pos[4]);
+    }
+    rewind(r);
+}
+
+// put a primitive whose top edge has been reached into the active list, behind its layer
+static void activate(vector_raster_t *r, const uint8_t *record, uint8_t layer, int32_t yc) {
+    int32_t bottom = record_bottom(record);
+    if (bottom <= yc) {
+        return;  // between two line centres
+    }
+    if (r->active_count >= VECTOR_MAX_ACTIVE) {
+        r->dropped++;
+        return;
+    }
+
+    uint position = r->active_count;
+    while (position > 0 && r->active[position - 1].layer > layer) { position--; }
+    memmove(&r->active[position + 1], &r->active[position], (r->active_count - position) * sizeof(vector_active_t));
+    r->active_count++;
+
+    vector_active_t *a = &r->active[position];
+    a->record = record;
+    a->bottom = bottom;
+    a->layer = layer;
+    a->edges_left = 0;
+    if (record[0] == VECTOR_POLYGON) {
+        a->next_edge = coords(record) + 2;
+        a->edges_left = read_u16(&record[2]);
+    } else if (record[0] == VECTOR_TRACE) {
+        const int16_t *c = coords(record);
+        int32_t dx = c[2] - c[0];
+        int32_t dy = c[3] - c[1];
+        a->reach = isqrt((uint64_t)((int64_t)c[4] * c[4]) * (uint32_t)(dx * dx + dy * dy));
+    }
+}
+
+// fill the pixels whose centre lies in [lo, hi] (1/16 pixel)
+static void fill_closed(framebuffer_t *fb, uint16_t row, int32_t lo, int32_t hi, uint8_t value) {
+    int32_t first = div_ceil(lo - HALF, SUBPIXEL);
+    int32_t end = div_floor(hi - HALF, SUBPIXEL) + 1;
+    if (first < 0) { first = 0; }
+    if (end > fb->width) { end = fb->width; }
+    if (first < end) { fb_fill_span(fb, first, end, row, value); }
+}
+
+// fill the pixels whose centre lies in [lo, hi) (1/16 pixel with VECTOR_EDGE_FIX more bits)
+static void fill_edges(framebuffer_t *fb, uint16_t row, int32_t lo, int32_t hi, uint8_t value) {
+    const int32_t half = HALF << VECTOR_EDGE_FIX;
+    const int32_t unit = SUBPIXEL << VECTOR_EDGE_FIX;
+    int32_t first = div_ceil(lo - half, unit);
+    int32_t end = div_ceil(hi - half, unit);
+    if (first < 0) { first = 0; }
+    if (end > fb->width) { end = fb->width; }
+    if (first < end) { fb_fill_span(fb, first, end, row, value); }
+}
+
+static bool circle_span(int32_t cx, int32_t cy, int32_t radius, int32_t yc, int32_t *lo, int32_t *hi) {
+    int32_t dy = yc - cy;
+    int32_t h2 = radius * radius - dy * dy;
+    if (h2 < 0) {
+        return false;
+    }
+    int32_t h = isqrt(h2);
+    *lo = cx - h;
+    *hi = cx + h;
+    return true;
+}
+
+// the line through a trace is a single interval: the union of the spans of both caps and of
+// the band along the segment (points whose projection falls on it)
+static bool trace_span(const int16_t *c, int32_t reach, int32_t yc, int32_t *lo, int32_t *hi) {
+    int32_t x0 = c[0], y0 = c[1], x1 = c[2], y1 = c[3], radius = c[4];
+    int32_t dx = x1 - x0;
+    int32_t dy = y1 - y0;
+    bool found = false;
+    int32_t a, b;
+
+    if (circle_span(x0, y0, radius, yc, &a, &b)) {
+        *lo = a;
+        *hi = b;
+        found = true;
+    }
+    if (circle_span(x1, y1, radius, yc, &a, &b)) {
+        *lo = found ? MIN(*lo, a) : a;
+        *hi = found ? MAX(*hi, b) : b;
+        found = true;
+    }
+
+    int32_t l2 = dx * dx + dy * dy;
+    if (l2 == 0) {
+        return found;
+    }
+    int32_t ey = yc - y0;
+    int32_t band_lo = INT32_MIN;
+    int32_t band_hi = INT32_MAX;
+
+    // distance from the line through the segment: |dx * ey - dy * (x - x0)| <= reach
+    if (dy == 0) {
+        if (dx * ey > reach || -dx * ey > reach) { return found; }
+    } else {
+        a = dx * ey - reach;
+        b = dx * ey + reach;
+        if (dy < 0) { int32_t t = a; a = -b; b = -t; }
+        band_lo = x0 + div_ceil(a, dy < 0 ? -dy : dy);
+        band_hi = x0 + div_floor(b, dy < 0 ? -dy : dy);
+    }
+    // projection onto the segment: 0 <= dx * (x - x0) + dy * ey <= l2
+    if (dx == 0) {
+        if (dy * ey < 0 || dy * ey > l2) { return found; }
+    } else {
+        a = -dy * ey;
+        b = l2 - dy * ey;
+        if (dx < 0) { int32_t t = a; a = -b; b = -t; }
+        band_lo = MAX(band_lo, x0 + div_ceil(a, dx < 0 ? -dx : dx));
+        band_hi = MIN(band_hi, x0 + div_floor(b, dx < 0 ? -dx : dx));
+    }
+    if (band_lo <= band_hi) {
+        *lo = found ? MIN(*lo, band_lo) : band_lo;
+        *hi = found ? MAX(*hi, band_hi) : band_hi;
+        found = true;
+    }
+    return found;
+}
+
+// drop the edges of polygon <owner> that end at or above line centre <yc>
+static void retire_edges(vector_raster_t *r, uint16_t owner, int32_t yc) {
+    uint kept = 0;
+    for (uint i = 0; i < r->edge_count; i++) {
+        if (r->edges[i].owner != owner || r->edges[i].y1 > yc) {
+            r->edges[kept++] = r->edges[i];
+        }
+    }
+    r->edge_count = kept;
+}
+
+// active edge table of one polygon for this line: retire the edges that ended, add the ones
+// starting, fill between pairs of crossings and step the edges to the next line
+static void polygon_line(vector_raster_t *r, vector_active_t *a, int32_t yc, framebuffer_t *fb, uint16_t row,
+                         uint8_t value) {
+    uint16_t owner = (a->record - r->data) / 4;
+    retire_edges(r, owner, yc);
+
+    while (a->edges_left && a->next_edge[1] <= yc) {
+        const int16_t *e = a->next_edge;
+        a->next_edge += 4;
+        a->edges_left--;
+        if (e[3] <= yc) {
+            continue;
+        }
+        if (r->edge_count >= VECTOR_MAX_EDGES) {
+            r->dropped++;
+            continue;
+        }
+        int32_t dx = e[2] - e[0];
+        int32_t dy = e[3] - e[1];
+        vector_edge_t *edge = &r->edges[r->edge_count++];
+        edge->x = e[0] * (1 << VECTOR_EDGE_FIX) +
+                  (int32_t)div_floor64((int64_t)(yc - e[1]) * dx * (1 << VECTOR_EDGE_FIX), dy);
+        edge->step = (int32_t)div_floor64((int64_t)dx * SUBPIXEL * (1 << VECTOR_EDGE_FIX), dy);
+        edge->y1 = e[3];
+        edge->owner = owner;
+    }
+
+    int32_t crossings[VECTOR_MAX_EDGES];
+    uint count = 0;
+    for (uint i = 0; i < r->edge_count; i++) {
+        vector_edge_t *edge = &r->edges[i];
+        if (edge->owner != owner) {
+            continue;
+        }
+        // insertion sort, there are only a few crossings per polygon
+        uint j = count++;
+        while (j > 0 && crossings[j - 1] > edge->x) {
+            crossings[j] = crossings[j - 1];
+            j--;
+        }
+        crossings[j] = edge->x;
+        edge->x += edge->step;
+    }
+    if (fb) {
+        for (uint i = 0; i + 1 < count; i += 2) {
+            fill_edges(fb, row, crossings[i], crossings[i + 1], value);
+        }
+    }
+}
+
+// rasterise line r->y into <row> of <fb> (or only advance the state if fb is NULL)
+static void scan_line(vector_raster_t *r, framebuffer_t *fb, uint16_t row) {
+    int32_t yc = r->y * SUBPIXEL + HALF;
+    uint8_t on = fb ? (1u << fb->bpp) - 1 : 0;
+
+    for (uint i = 0; i < r->layer_count; i++) {
+        vector_layer_t *layer = &r->layers[i];
+        while (layer->left && record_top(layer->next) <= yc) {
+            activate(r, layer->next, i, yc);
+            layer->next += record_size(layer->next);
+            layer->left--;
+        }
+    }
+
+    uint kept = 0;
+    for (uint i = 0; i < r->active_count; i++) {
+        vector_active_t *a = &r->active[i];
+        if (a->bottom <= yc) {
+            if (a->record[0] == VECTOR_POLYGON) {
+                retire_edges(r, (a->record - r->data) / 4, INT32_MAX);
+            }
+            continue;
+        }
+        r->active[kept++] = *a;
+        a = &r->active[kept - 1];
+
+        uint8_t value = r->layers[a->layer].clear ? 0 : on;
+        const int16_t *c = coords(a->record);
+        int32_t lo, hi;
+        switch (a->record[0]) {
+            case VECTOR_RECT:
+                if (fb) { fill_edges(fb, row, c[0] * (1 << VECTOR_EDGE_FIX), c[2] * (1 << VECTOR_EDGE_FIX), value); }
+                break;
+            case VECTOR_CIRCLE:
+                if (fb && circle_span(c[0], c[1], c[2], yc, &lo, &hi)) { fill_closed(fb, row, lo, hi, value); }
+                break;
+            case VECTOR_TRACE:
+                if (fb && trace_span(c, a->reach, yc, &lo, &hi)) { fill_closed(fb, row, lo, hi, value); }
+                break;
+            case VECTOR_POLYGON:
+                polygon_line(r, a, yc, fb, row, value);
+                break;
+        }
+    }
+    r->active_count = kept;
+
+    if (kept > r->max_active) { r->max_active = kept; }
+    if (r->edge_count > r->max_edges) { r->max_edges = r->edge_count; }
+    r->y++;
+}
+
+void vector_render_line(vector_raster_t *r, uint16_t y, uint32_t *line, uint8_t bpp) {
+    framebuffer_t fb;
+    fb_init(&fb, line, r->width, 1, bpp);
+    memset(line, 0, fb.stride * 4);
+    if (y >= r->height) {
+        return;
+    }
+
+    if (y < r->y) {
+        rewind(r);
+    }
+    while (r->y < y) {
+        scan_line(r, NULL, 0);
+    }
+    scan_line(r, &fb, 0);
+}
+
+void vector_render(vector_raster_t *r, framebuffer_t *fb) {
+    rewind(r);
+    uint16_t height = MIN(fb->height, r->height);
+    for (uint16_t y = 0; y < height; y++) {
+        memset(fb_row(fb, y), 0, fb->stride * 4);
+        scan_line(r, fb, y);
+    }
+    for (uint16_t y = height; y < fb->height; y++) {
+        memset(fb_row(fb, y), 0, fb->stride * 4);
+    }
+}
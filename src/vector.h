@@ -0,0 +1,129 @@
+/**
+ * Display-list rasteriser ("DLPV") for PCB artwork
+ *
+ * Instead of a full raster per exposure the host sends the primitives of a Gerber layer
+ * (utils/gerber_to_vector.py): rectangles, circles (flashed pads), traces (segments with round
+ * caps, i.e. draws with a round aperture) and polygons (regions and macro outlines, filled
+ * even-odd so contours inside contours are holes). They are rasterised one line at a time,
+ * either into the framebuffer or straight into the scan-out line ring, using only integer
+ * arithmetic: rectangles, circles and traces are intersected with the line directly, polygons
+ * keep an active edge table whose x positions are stepped from line to line.
+ *
+ * Primitives come in layers of one polarity, drawn in order: dark layers set their pixels to
+ * full value, clear layers erase what the layers before them drew (Gerber %LPD / %LPC).
+ * Coordinates are in 1/16 pixel, y pointing down; a pixel is covered when its centre
+ * (x + 0.5, y + 0.5) lies inside a primitive. utils/dlpvector.py holds a port of this
+ * rasteriser and an independent reference to check it against.
+ *
+ * Layout (all multi-byte values little-endian, the buffer must be 32-bit aligned):
+ *
+ *  header (16 bytes)
+ *    'D' 'L' 'P' 'V'   magic
+ *    u8  version       VECTOR_VERSION
+ *    u8  reserved
+ *    u16 layers        at most VECTOR_MAX_LAYERS
+ *    u16 width, u16 height
+ *    u32 payload length (bytes following the header)
+ *
+ *  payload: per layer a layer record, followed by its primitives sorted by their top edge.
+ *  Every record starts with u8 kind, u8 flags, u16 n:
+ *    VECTOR_LAYER    flags VECTOR_LAYER_CLEAR, n primitives; u32 bytes of primitives following
+ *    VECTOR_RECT     i16 x0, y0, x1, y1                 covers [x0, x1) x [y0, y1)
+ *    VECTOR_CIRCLE   i16 cx, cy, r, reserved            covers dx^2 + dy^2 <= r^2
+ *    VECTOR_TRACE    i16 x0, y0, x1, y1, r, reserved    points within r of the segment
+ *    VECTOR_POLYGON  i16 top, bottom, then n edges of i16 x0, y0, x1, y1 with y0 < y1, sorted
+ *                    by y0 (horizontal edges left out); an edge crosses the lines y0 <= y < y1
+ *
+ * Coordinates stay within VECTOR_MARGIN of the field and radii at most VECTOR_MARGIN, which
+ * keeps the squared lengths and cross products of the rasteriser inside an int32.
+ */
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "framebuffer.h"
+
+#define VECTOR_VERSION        1
+#define VECTOR_HEADER_SIZE    16
+#define VECTOR_SUBPIXEL_BITS  4      // coordinates are in 1/16 pixel
+#define VECTOR_EDGE_FIX       12     // extra fractional bits of the polygon edge positions
+#define VECTOR_MARGIN         4096   // 1/16 pixel (256 pixels) coordinates may reach past the field
+
+#define VECTOR_MAX_LAYERS     8
+#define VECTOR_MAX_ACTIVE     128    // primitives crossing one line
+#define VECTOR_MAX_EDGES      128    // polygon edges crossing one line
+
+#define VECTOR_LAYER          0x00
+#define VECTOR_RECT           0x01
+#define VECTOR_CIRCLE         0x02
+#define VECTOR_TRACE          0x03
+#define VECTOR_POLYGON        0x04
+
+#define VECTOR_LAYER_CLEAR    0x01
+
+enum VectorStatus {
+    VECTOR_OK = 0,
+    VECTOR_ERROR_HEADER = -1,     // bad magic, version, alignment or size
+    VECTOR_ERROR_TRUNCATED = -2,  // a record runs past the end of its layer or the payload
+    VECTOR_ERROR_RECORD = -3,     // unknown record, bad edge, coordinate out of range, or primitives out of order
+};
+
+typedef struct {
+    const uint8_t *first;   // first primitive of the layer
+    const uint8_t *next;    // next primitive to become active
+    uint16_t count;
+    uint16_t left;          // primitives not active yet
+    bool clear;
+} vector_layer_t;
+
+typedef struct {
+    const uint8_t *record;
+    union {
+        const int16_t *next_edge;   // polygon: first edge not in the active edge table yet
+        int32_t reach;              // trace: r times the segment length
+    };
+    uint16_t edges_left;            // polygon: edges not in the active edge table yet
+    int32_t bottom;                 // first line centre below the primitive
+    uint8_t layer;
+} vector_active_t;
+
+typedef struct {
+    int32_t x;          // at the current line centre, 1/16 pixel with VECTOR_EDGE_FIX more bits
+    int32_t step;       // per line
+    int16_t y1;
+    uint16_t owner;     // polygon record offset in the list / 4
+} vector_edge_t;
+
+typedef struct {
+    const uint8_t *data;
+    uint16_t width;
+    uint16_t height;
+    uint16_t y;                     // next line
+    uint8_t layer_count;
+    vector_layer_t layers[VECTOR_MAX_LAYERS];
+    uint16_t active_count;
+    vector_active_t active[VECTOR_MAX_ACTIVE];  // in layer order
+    uint16_t edge_count;
+    vector_edge_t edges[VECTOR_MAX_EDGES];
+
+    uint16_t primitives;            // in the list
+    uint16_t max_active;            // most primitives on one line
+    uint16_t max_edges;             // most polygon edges on one line
+    uint32_t dropped;               // primitives or edges left out for lack of room
+} vector_raster_t;
+
+// check the header and every record; <width> has to match, the list may be shorter than <height>
+int vector_validate(const uint8_t *data, uint32_t length, uint16_t width, uint16_t height);
+
+// start rasterising a validated list from line 0
+void vector_start(vector_raster_t *r, const uint8_t *data);
+
+// rasterise line <y> into a row of packed pixels. Lines are cheapest in order; going back
+// starts over from line 0. Lines below the list are blank.
+void vector_render_line(vector_raster_t *r, uint16_t y, uint32_t *line, uint8_t bpp);
+
+// rasterise all rows of <fb>
+void vector_render(vector_raster_t *r, framebuffer_t *fb);
+
+#endif
@@ -0,0 +1,71 @@
+/**
+ * Pixel bit depth modes (see video_mode.h)
+ */
+#include <assert.h>
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "pxl.pio.h"
+#include "video_mode.h"
+#include "clock_plan.h"
+#include "framebuffer.h"
+#include "scanout.h"
+
+// the scan-out DMA sends whole words (see scanout.c)
+static_assert(VIDEO_LINE_BYTES(1) % 4 == 0, "a line must be a whole number of words in every mode");
+
+static const video_mode_t modes[] = {
+    { 1, &pxl_1bpp_program, VIDEO_LINE_BYTES(1), VIDEO_FRAME_BYTES(1) },
+    { 2, &pxl_2bpp_program, VIDEO_LINE_BYTES(2), VIDEO_FRAME_BYTES(2) },
+    { 4, &pxl_4bpp_program, VIDEO_LINE_BYTES(4), VIDEO_FRAME_BYTES(4) },
+    { 8, &pxl_8bpp_program, VIDEO_LINE_BYTES(8), VIDEO_FRAME_BYTES(8) },
+};
+
+// the pxl program currently in instruction memory
+static const pio_program_t *loaded_program;
+static PIO loaded_pio;
+static uint loaded_offset;
+
+const video_mode_t *video_mode_find(uint8_t bpp) {
+    for (uint i = 0; i < count_of(modes); i++) {
+        if (modes[i].bpp == bpp) {
+            return &modes[i];
+        }
+    }
+    return NULL;
+}
+
+video_window_t video_mode_fit_window(const video_mode_t *mode, video_window_t window, uint32_t buffer_bytes) {
+    uint32_t word_pixels = 32 / mode->bpp;
+    uint32_t right = MIN((uint32_t)window.x + window.width, VIDEO_WIDTH);
+    uint32_t bottom = MIN((uint32_t)window.y + window.height, VIDEO_HEIGHT);
+    window.x = MIN(window.x, right) / word_pixels * word_pixels;
+    window.y = MIN(window.y, bottom);
+    window.width = (right + word_pixels - 1) / word_pixels * word_pixels - window.x;
+    window.height = bottom - window.y;
+
+    uint32_t row_bytes = FB_ROW_BYTES(window.width, mode->bpp);
+    if (video_window_full(&window) && mode->frame_bytes <= buffer_bytes) {
+        return window;
+    }
+    uint32_t ring_bytes = SCANOUT_WINDOW_WORDS(mode->line_bytes) * 4;
+    uint32_t rows = buffer_bytes > ring_bytes && row_bytes ? (buffer_bytes - ring_bytes) / row_bytes : 0;
+    window.height = MIN(window.height, rows);
+    return window;
+}
+
+void video_mode_load(const video_mode_t *mode, PIO pio, uint sm, uint pin, uint validpin) {
+    // the pio0 instruction memory has no room for more than one pxl program next to the
+    // hsync, vsync and pxl_clk programs
+    if (loaded_program) {
+        pio_remove_program(loaded_pio, loaded_program, loaded_offset);
+    }
+    loaded_program = mode->program;
+    loaded_pio = pio;
+    loaded_offset = pio_add_program(pio, mode->program);
+
+    uint16_t div_int;
+    uint8_t div_frac;
+    clock_plan_sm_div(clock_plan_current(), VIDEO_PCLK_DIV, &div_int, &div_frac);
+    pxl_program_init(pio, sm, loaded_offset, mode->bpp, pin, validpin, div_int, div_frac);
+    pio_sm_put_blocking(pio, sm, VIDEO_PXL_COUNTER);
+}
@@ -0,0 +1,79 @@
+/**
+ * Video timing and pixel bit depth modes of the scan-out
+ *
+ * All the numbers that depend on the timing or the pixel packing are derived here: the bytes
+ * per line and per frame (buffer sizes and the DMA transfer count) and the counters that the
+ * hsync, vsync and pxl state machines are started with. The DLPC samples 8 PDATA lines; the
+ * firmware can drive 1, 2, 4 or 8 of them per pixel, each mode with its own program in
+ * pxl.pio, selected when the scan-out is set up.
+ *
+ * A full 8-bit frame (921.6 kB) does not fit in RAM, and a 4-bit one (460.8 kB) doesn't
+ * either: with a framebuffer those modes show a window of the frame (by default the top rows
+ * that fit, see video_mode_fit_window()) with the rest blank; the line ring scan-out supports
+ * all modes at full size. A 1-bit frame only needs 115.2 kB.
+ */
+#ifndef VIDEO_MODE_H
+#define VIDEO_MODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware/pio.h"
+
+#define VIDEO_WIDTH         1280   // active pixels per line
+#define VIDEO_HEIGHT        720    // active lines per frame
+#define VIDEO_H_FRONT_PORCH 16     // PCLK periods of the hsync active loop after the active pixels
+
+// state machine cycles per PCLK period at clock divider 1: the pxl_clk.pio period, the clock
+// divider of hsync.pio and vsync.pio relative to the others, and the loop length of the pxl
+// programs (pxl.pio). The clock divider itself comes from the clock plan (clock_plan.h).
+#define VIDEO_PCLK_DIV      4
+
+// PCLK periods per line outside the hsync.pio jmp loop (front porch, sync pulse, back porch),
+// and lines per frame: the active ones, then 2 each of front porch, sync and back porch
+#define VIDEO_H_BLANK       28
+#define VIDEO_FRAME_LINES   (VIDEO_HEIGHT + 6)
+#define VIDEO_LINE_PCLK(h_counter)  ((h_counter) + 1 + VIDEO_H_BLANK)
+
+// counters the state machines pull before their .wrap_target
+#define VIDEO_H_COUNTER     (VIDEO_WIDTH + VIDEO_H_FRONT_PORCH - 1)   // hsync: jmp x-- loop (at least)
+#define VIDEO_V_COUNTER     (VIDEO_HEIGHT - 1)                        // vsync: active lines - 1
+#define VIDEO_PXL_COUNTER   (VIDEO_WIDTH - 1)                         // pxl: one iteration per pixel
+
+// bytes of pixel data per line and per frame (the DMA sends them as words: a line is a whole
+// number of words in every mode)
+#define VIDEO_LINE_BYTES(bpp)   (VIDEO_WIDTH * (bpp) / 8)
+#define VIDEO_FRAME_BYTES(bpp)  (VIDEO_LINE_BYTES(bpp) * VIDEO_HEIGHT)
+
+typedef struct {
+    uint8_t bpp;
+    const pio_program_t *program;   // pxl program for this bit depth
+    uint32_t line_bytes;
+    uint32_t frame_bytes;
+} video_mode_t;
+
+// the mode for <bpp> bits per pixel, NULL if there is none
+const video_mode_t *video_mode_find(uint8_t bpp);
+
+// the part of the frame that holds pixel data (region of interest); the rest is blank
+typedef struct {
+    uint16_t x, y;           // top left corner
+    uint16_t width, height;
+} video_window_t;
+
+// true if <window> is the whole frame (the scan-out can stream it as is)
+static inline bool video_window_full(const video_window_t *window) {
+    return window->x == 0 && window->y == 0 && window->width == VIDEO_WIDTH && window->height == VIDEO_HEIGHT;
+}
+
+// <window> fitted to <mode> and <buffer_bytes> of framebuffer: clipped to the frame, x rounded
+// down and the right edge up to whole words of pixels (the scan-out copies words), and rows
+// dropped from the bottom until the rows plus, for anything but the whole frame, the line
+// buffers of the window scan-out (SCANOUT_WINDOW_WORDS) fit
+video_window_t video_mode_fit_window(const video_mode_t *mode, video_window_t window, uint32_t buffer_bytes);
+
+// load the pxl program of <mode> into <pio> (replacing the one loaded before, the state machine
+// must be stopped) and set up state machine <sm> with its pixel counter and the clock divider
+// of the clock plan. Pixel data goes out on 8 pins from <pin>, DATAEN_CMD on <validpin>.
+void video_mode_load(const video_mode_t *mode, PIO pio, uint sm, uint pin, uint validpin);
+
+#endif
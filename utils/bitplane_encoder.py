@@ -0,0 +1,189 @@
+import tifffile as tif
+import numpy as np
+import argparse
+import struct
+import os
+import sys
+
+import dlpframe
+import pio_sim
+
+# Split an 8-bit grayscale image into binary bit-planes and write them as a DLPB bit-plane
+# sequence (see src/bitplane.h), with an exposure time and LED PWM per plane so that the dose
+# each pixel accumulates over the sequence is proportional to its gray value:
+#
+#   python bitplane_encoder.py layer.tif --bits 8 --exposure 10 --check
+#
+# Weighting:
+#   time   every plane at full PWM, exposure time halves from plane to plane
+#   pwm    every plane equally long, PWM halves from plane to plane (only ~log2(pwm) bits)
+#   mixed  by time, but planes shorter than --min-plane-ms are stretched to that and run at a
+#          proportionally lower PWM (default)
+#
+# The dose model replays the planes exactly like the firmware (dlpframe.decode/apply_delta) and adds
+# up dose = shown pixels x LED output(pwm) x light on time per plane, with the imperfections
+# given on the command line: START/STOP timing jitter (see exposure_report() on the pico),
+# LED turn-on latency, a PWM offset below which the LED stays dark, and optionally whole-frame
+# exposure times (if the planes were timed by DLPC frame counts instead of the hardware alarm),
+# with the frame period the clock plan gives at --sys-mhz (19.2 ms at the default 200 MHz).
+# The result is compared with the dose the target image asks for; --check exits with 1 if any
+# gray level is off by more than --tolerance of a level, or the dose is not monotonic in the
+# gray level.
+
+BITPLANE_VERSION = 1
+BITPLANE_FRAME, BITPLANE_DELTA = 0x00, 0x01
+STAGING_SIZE = {1: 96 * 1024, 2: 16 * 1024}   # src/staging.h, by framebuffer bit depth
+
+
+def load_image(filepath, bits):
+    with tif.TiffFile(filepath) as image:
+        pixelarray = image.asarray()
+        assert pixelarray.shape == (dlpframe.HEIGHT, dlpframe.WIDTH)  # check the image size
+    return dlpframe.quantise(pixelarray, bits)
+
+
+def schedule(bits, exposure_s, pwm_max, weighting, min_plane_ms, latency_us=0.0):
+    # (duration_us, pwm) per plane, LSB first. A full white pixel gets exposure_s at pwm_max.
+    total_weight = (1 << bits) - 1
+    planes = []
+    for k in range(bits):
+        weight = (1 << k) / total_weight
+        if weighting == 'pwm':
+            duration = exposure_s * 1e6 * (1 << (bits - 1)) / total_weight
+            pwm = pwm_max * (1 << k) / (1 << (bits - 1))
+        else:
+            duration = exposure_s * 1e6 * weight
+            pwm = pwm_max
+            if weighting == 'mixed' and duration < min_plane_ms * 1e3:
+                pwm = pwm_max * duration / (min_plane_ms * 1e3)
+                duration = min_plane_ms * 1e3
+        # requested on time, compensated for the known LED latency
+        planes.append((int(round(duration + latency_us)), max(1, int(round(pwm)))))
+    return planes
+
+
+def led_output(pwm, pwm_max, pwm_offset):
+    # relative light output: linear in the PWM above the offset, 1.0 at pwm_max
+    return np.clip((np.asarray(pwm, dtype=float) - pwm_offset) / (pwm_max - pwm_offset), 0, None)
+
+
+def encode(levels, bits, planes, bpp):
+    # DLPB sequence; plane k shows the pixels with bit k set, at the framebuffer's full value.
+    # Each plane is a DLPF frame or a delta from the previous plane, whichever is smaller.
+    on = (1 << bpp) - 1
+    payload = b''
+    previous = None
+    for k, (duration, pwm) in enumerate(planes):
+        plane = (((levels >> k) & 1) * on).astype(np.uint8)
+        kind, data = BITPLANE_FRAME, dlpframe.encode(plane, bpp)
+        if previous is not None:
+            delta = dlpframe.encode_delta(previous, plane, bpp)
+            if len(delta) < len(data):
+                kind, data = BITPLANE_DELTA, delta
+        payload += struct.pack('<IHBBI', duration, pwm, kind, 0, len(data)) + data + bytes(-len(data) % 4)
+        previous = plane
+    header = b'DLPB' + struct.pack('<BBHHHI', BITPLANE_VERSION, bits, 0, dlpframe.WIDTH, dlpframe.HEIGHT, len(payload))
+    return header + payload
+
+
+def replay(data, bpp):
+    # reference playback: what the framebuffer holds during each plane, and its (duration, pwm)
+    magic, version, count, _, width, height, length = struct.unpack_from('<4sBBHHHI', data)
+    assert magic == b'DLPB' and version == BITPLANE_VERSION, "not a DLPB sequence"
+    levels = np.full((height, width), 0xAA & ((1 << bpp) - 1), dtype=np.uint8)  # whatever was there before
+    pos = 16
+    for _ in range(count):
+        duration, pwm, kind, _, length = struct.unpack_from('<IHBBI', data, pos)
+        pos += 12
+        if kind == BITPLANE_FRAME:
+            levels[:] = dlpframe.decode(data[pos:pos + length])[1]
+        else:
+            dlpframe.apply_delta(levels, data[pos:pos + length])
+        pos += length + (-length % 4)
+        yield levels.copy(), duration, pwm
+
+
+def dose_model(data, levels, bits, bpp, args, rng):
+    # accumulated dose map for one run of the sequence, in units of a full white target dose
+    full_dose = args.exposure * 1e6
+    dose = np.zeros(levels.shape)
+    for shown, duration, pwm in replay(data, bpp):
+        on_time = duration - args.latency_us + rng.uniform(-args.jitter_us, args.jitter_us)
+        if args.frames:
+            on_time = np.round(on_time / args.frame_us) * args.frame_us
+        output = led_output(pwm, args.pwm, args.pwm_offset)
+        dose += (shown / ((1 << bpp) - 1)) * output * max(on_time, 0)
+    return dose / full_dose
+
+
+def report(data, levels, bits, bpp, args):
+    rng = np.random.default_rng(1)
+    lsb = 1.0 / ((1 << bits) - 1)
+    target = levels * lsb
+
+    # the dose only depends on the gray level, so evaluate one pixel per level that occurs
+    used, first = np.unique(levels, return_index=True)
+    worst = np.zeros(len(used))
+    monotonic = True
+    for _ in range(args.trials):
+        dose = dose_model(data, levels, bits, bpp, args, rng).ravel()[first]
+        worst = np.maximum(worst, np.abs(dose - target.ravel()[first]) / lsb)
+        monotonic = monotonic and bool(np.all(np.diff(dose) > 0))
+
+    # dose error of every pixel for the last trial
+    error = (dose_model(data, levels, bits, bpp, args, rng) - target) / lsb
+    rms = float(np.sqrt(np.mean(error ** 2)))
+    max_error = float(worst.max())
+    effective = bits - max(0.0, np.log2(2 * max_error)) if max_error > 0 else bits
+    print("dose error: %.3f levels RMS, %.3f levels max over %d runs, %s, ~%.1f effective bits" % (
+        rms, max_error, args.trials, "monotonic" if monotonic else "NOT MONOTONIC", min(bits, effective)))
+    return max_error <= args.tolerance and monotonic
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Encode an 8-bit 720x1280 tif as a DLPB bit-plane sequence")
+    parser.add_argument("file", type=str, help="grayscale TIF (the target dose map)")
+    parser.add_argument("--bits", type=int, default=8, choices=range(1, 9), help="gray levels to reproduce, in bits")
+    parser.add_argument("--bpp", type=int, default=1, choices=[1, 2, 4, 8], help="bits per pixel of the framebuffer")
+    parser.add_argument("--exposure", type=float, default=10.0, help="seconds of light for a white pixel at full PWM")
+    parser.add_argument("--pwm", type=int, default=0xB4, help="LED PWM (10 bit) for full intensity")
+    parser.add_argument("--weighting", choices=['time', 'pwm', 'mixed'], default='mixed')
+    parser.add_argument("--min-plane-ms", type=float, default=50.0, help="shortest plane with --weighting mixed")
+    parser.add_argument("--jitter-us", type=float, default=10.0, help="START/STOP timing error (uniform, +-)")
+    parser.add_argument("--latency-us", type=float, default=0.0, help="LED turn-on latency (compensated in the schedule)")
+    parser.add_argument("--pwm-offset", type=float, default=0.0, help="PWM value below which the LED is dark")
+    parser.add_argument("--frames", action="store_true", help="model whole-frame exposure times (DLPC frame counts)")
+    parser.add_argument("--sys-mhz", type=float, default=200.0,
+                        help="system clock in MHz, for the frame period of --frames (default: the clock plan's)")
+    parser.add_argument("--trials", type=int, default=20, help="runs of the dose model (random jitter)")
+    parser.add_argument("--tolerance", type=float, default=0.5, help="largest dose error allowed by --check, in levels")
+    parser.add_argument("--check", action="store_true", help="exit with 1 if the dose model is out of tolerance")
+    parser.add_argument("--outdir", type=str, default=None, help="output directory (default: next to input)")
+
+    args = parser.parse_args()
+    args.frame_us = pio_sim.frame_period_us(args.sys_mhz)
+    levels = load_image(args.file, args.bits)
+    planes = schedule(args.bits, args.exposure, args.pwm, args.weighting, args.min_plane_ms, args.latency_us)
+    data = encode(levels, args.bits, planes, args.bpp)
+
+    # the framebuffer must show exactly one bit-plane during each exposure
+    on = (1 << args.bpp) - 1
+    for k, (shown, _, _) in enumerate(replay(data, args.bpp)):
+        assert np.array_equal(shown, ((levels >> k) & 1) * on), "replay mismatch in plane %d" % k
+
+    filename_base = os.path.splitext(os.path.basename(args.file))[0]
+    if args.outdir:
+        os.makedirs(args.outdir, exist_ok=True)
+    with open(os.path.join(args.outdir or os.path.dirname(args.file), filename_base + '.dlpb'), 'wb') as f:
+        f.write(data)
+
+    for k, (duration, pwm) in enumerate(planes):
+        print("plane %d: %9.3f ms at PWM %4d" % (k, duration / 1e3, pwm))
+    print("%d planes, %d bytes, %.2f s in total" % (args.bits, len(data), sum(d for d, _ in planes) / 1e6))
+    if len(data) > STAGING_SIZE.get(args.bpp, 0):
+        print("WARNING: larger than the pico's staging area (%d bytes with a %d-bit framebuffer); "
+              "try fewer --bits" % (STAGING_SIZE.get(args.bpp, 0), args.bpp))
+
+    ok = report(data, levels, args.bits, args.bpp, args)
+    if args.check:
+        sys.exit(0 if ok else 1)
@@ -0,0 +1,65 @@
+import tifffile as tif
+import numpy as np
+import argparse
+import os
+
+import dlpframe
+
+# Turn a sequence of exposure layers (720x1280 grayscale tiffs, in exposure order) into DLPD
+# delta updates (see src/delta.h). The first delta is relative to an empty (all zero) frame;
+# every following one only contains the row spans that changed since the previous layer.
+#
+#   python delta_encoder.py layer_000.tif layer_001.tif layer_002.tif
+#
+# The whole sequence is replayed with the reference implementation afterwards, and the packed
+# result of every step is compared byte for byte with the packed target layer. --reference also
+# writes every packed target layer as <name>_target.raw, for replaying the deltas with the
+# firmware's delta.c on the host:
+#
+#   build-host/dlp_delta_check layer_000.dlpd layer_001.dlpd layer_002.dlpd
+
+
+def load_layer(filepath, bpp):
+    with tif.TiffFile(filepath) as image:
+        pixelarray = image.asarray()
+        assert pixelarray.shape == (dlpframe.HEIGHT, dlpframe.WIDTH)  # check the image size
+    return dlpframe.quantise(pixelarray, bpp)
+
+
+def encode_sequence(filepaths, bpp, max_gap, outdir=None, reference=False):
+    previous = np.zeros((dlpframe.HEIGHT, dlpframe.WIDTH), dtype=np.uint8)
+    replay = previous.copy()
+    full_size = dlpframe.HEIGHT * dlpframe.WIDTH * bpp // 8
+
+    for filepath in filepaths:
+        layer = load_layer(filepath, bpp)
+        delta = dlpframe.encode_delta(previous, layer, bpp, max_gap)
+
+        # replay and check the framebuffer contents byte for byte
+        dlpframe.apply_delta(replay, delta)
+        assert dlpframe.pack(replay, bpp).tobytes() == dlpframe.pack(layer, bpp).tobytes(), \
+            "replay mismatch after %s" % filepath
+
+        filename_base = os.path.splitext(os.path.basename(filepath))[0]
+        with open(os.path.join(outdir or os.path.dirname(filepath), filename_base + '.dlpd'), 'wb') as f:
+            f.write(delta)
+        if reference:
+            with open(os.path.join(outdir or os.path.dirname(filepath), filename_base + '_target.raw'), 'wb') as f:
+                f.write(dlpframe.pack(layer, bpp).tobytes())
+
+        changed = np.count_nonzero(previous != layer)
+        print("%-40s %6.2f%% of pixels changed, delta %7d bytes (%5.1f%% of a full frame)" % (
+            os.path.basename(filepath), 100 * changed / layer.size, len(delta), 100 * len(delta) / full_size))
+        previous = layer
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Encode a sequence of 8-bit 720x1280 tifs as DLPD layer deltas")
+    parser.add_argument("files", nargs='+', help="grayscale TIF layers, in exposure order")
+    parser.add_argument("--bpp", type=int, default=2, choices=[1, 2, 4, 8], help="bits per pixel of the frame")
+    parser.add_argument("--gap", type=int, default=16, help="merge changed spans closer than this many pixels")
+    parser.add_argument("--reference", action="store_true", help="also write each packed target layer, for dlp_delta_check")
+    parser.add_argument("--outdir", type=str, default=None, help="output directory (default: next to input)")
+
+    args = parser.parse_args()
+    encode_sequence(args.files, args.bpp, args.gap, args.outdir, args.reference)
@@ -0,0 +1,304 @@
+import numpy as np
+import struct
+
+# Helpers shared by the utilities that produce data for the pico firmware.
+#
+# Pixel packing matches src/framebuffer.h: pixel x of a row sits in bits [x*bpp, (x+1)*bpp)
+# counting from bit 0 of the first byte (LSB-first), which is the order pxl.pio shifts out.
+#
+# The DLPF frame format matches src/frame_codec.h:
+#   16 byte header: b'DLPF', version, bpp, reserved u16, width u16, height u16, payload u32
+#   followed by row records: 0x00 RLE runs, 0x01 repeat previous row, 0x02 literal row.
+
+FRAME_VERSION = 1
+ROW_RLE = 0x00
+ROW_REPEAT = 0x01
+ROW_LITERAL = 0x02
+
+WIDTH = 1280
+HEIGHT = 720
+
+
+def quantise(pixelarray, bpp):
+    # map 8-bit intensities onto 2**bpp evenly sized bins, e.g. for 2 bit:
+    # [0, 63], [64, 127] [128, 191] [192,255] -> 0, 1, 2, 3
+    return (np.asarray(pixelarray, dtype=np.uint16) >> (8 - bpp)).astype(np.uint8)
+
+
+def bayer(n):
+    # n x n ordered dither matrix (n a power of two) holding 0 .. n*n-1
+    m = np.array([[0, 2], [3, 1]])
+    while m.shape[0] < n:
+        m = np.block([[4 * m, 4 * m + 2], [4 * m + 3, 4 * m + 1]])
+    return m
+
+
+def dither_ordered(pixelarray, bpp, size=8):
+    # 8-bit intensities -> pixel values, with a tiled Bayer threshold instead of a fixed one
+    levels = (1 << bpp) - 1
+    rows, cols = np.shape(pixelarray)
+    threshold = (bayer(size) + 0.5) / (size * size)
+    threshold = np.tile(threshold, (-(-rows // size), -(-cols // size)))[:rows, :cols]
+    scaled = np.asarray(pixelarray, dtype=np.float32) * (levels / 255.0)
+    return np.clip(np.floor(scaled + threshold), 0, levels).astype(np.uint8)
+
+
+def dither_floyd_steinberg(pixelarray, bpp):
+    # 8-bit intensities -> pixel values, Floyd-Steinberg error diffusion (every row left to
+    # right, the error leaving the image is dropped). A pixel only depends on its left
+    # neighbour and the three above it, so all pixels with the same x + 2y are independent and
+    # are done at once: one numpy step per anti-diagonal instead of one Python step per pixel.
+    levels = (1 << bpp) - 1
+    rows, cols = np.shape(pixelarray)
+    work = np.zeros((rows + 1, cols + 2), dtype=np.float32)   # a spare column each side, a row below
+    work[:rows, 1:cols + 1] = np.asarray(pixelarray, dtype=np.float32) * (levels / 255.0)
+    out = np.zeros((rows, cols), dtype=np.uint8)
+
+    for t in range(cols + 2 * (rows - 1)):
+        y = np.arange(max(0, (t - cols) // 2 + 1), min(rows - 1, t // 2) + 1)
+        x = t - 2 * y
+        old = work[y, x + 1]
+        new = np.clip(np.rint(old), 0, levels)
+        out[y, x] = new
+        error = old - new
+        work[y, x + 2] += error * (7 / 16)
+        work[y + 1, x] += error * (3 / 16)
+        work[y + 1, x + 1] += error * (5 / 16)
+        work[y + 1, x + 2] += error * (1 / 16)
+    return out
+
+
+DITHER = {'none': quantise, 'ordered': dither_ordered, 'floyd-steinberg': dither_floyd_steinberg}
+
+
+def pack(levels, bpp):
+    # (rows, cols) array of pixel values -> (rows, ceil(cols*bpp/8)) packed bytes, LSB-first
+    levels = np.asarray(levels, dtype=np.uint8)
+    rows, cols = levels.shape
+    per_byte = 8 // bpp
+    padded = np.zeros((rows, -(-cols // per_byte) * per_byte), dtype=np.uint8)
+    padded[:, :cols] = levels
+    groups = padded.reshape(rows, -1, per_byte).astype(np.uint16)
+    shifts = (np.arange(per_byte) * bpp).astype(np.uint16)
+    return (groups << shifts).sum(axis=2).astype(np.uint8)
+
+
+def unpack(packed, bpp, cols):
+    # inverse of pack()
+    packed = np.asarray(packed, dtype=np.uint8)
+    per_byte = 8 // bpp
+    shifts = (np.arange(per_byte) * bpp).astype(np.uint8)
+    levels = (packed[:, :, None] >> shifts) & ((1 << bpp) - 1)
+    return levels.reshape(packed.shape[0], -1)[:, :cols]
+
+
+def parse_roi(text):
+    # "x,y,width,height", as given to cmake -DDLP_ROI
+    values = tuple(int(value) for value in text.split(','))
+    if len(values) != 4:
+        raise ValueError("a region of interest is x,y,width,height, not %r" % text)
+    return values
+
+
+def fit_window(roi, bpp):
+    # the window of the frame a DLP_ROI build stores (video_mode_fit_window() in
+    # src/video_mode.c): clipped to the frame, x rounded down and the right edge up to whole
+    # words of pixels
+    x, y, width, height = roi
+    word_pixels = 32 // bpp
+    right, bottom = min(x + width, WIDTH), min(y + height, HEIGHT)
+    x, y = min(x, right) // word_pixels * word_pixels, min(y, bottom)
+    return x, y, -(-right // word_pixels) * word_pixels - x, bottom - y
+
+
+def crop(levels, roi, bpp):
+    # the pixels of a whole frame that fall in the window of fit_window()
+    x, y, width, height = fit_window(roi, bpp)
+    return np.asarray(levels)[y:y + height, x:x + width]
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def encode_row_runs(row, bpp):
+    # run-length encode a single row of pixel values
+    change = np.flatnonzero(row[1:] != row[:-1]) + 1
+    starts = np.concatenate(([0], change))
+    lengths = np.diff(np.concatenate((starts, [len(row)])))
+    values = row[starts]
+    return b''.join(varint(((int(n) - 1) << bpp) | int(v)) for n, v in zip(lengths, values))
+
+
+def encode(levels, bpp):
+    # (height, width) array of pixel values -> DLPF bytes
+    levels = np.asarray(levels, dtype=np.uint8)
+    height, width = levels.shape
+    packed = pack(levels, bpp)
+    payload = bytearray()
+
+    y = 0
+    while y < height:
+        if y > 0:
+            # collapse rows identical to the one before into a single repeat record
+            repeat = 0
+            while y + repeat < height and np.array_equal(levels[y + repeat], levels[y - 1]):
+                repeat += 1
+            if repeat:
+                payload += bytes([ROW_REPEAT]) + varint(repeat)
+                y += repeat
+                continue
+
+        # every run takes at least a byte: don't bother encoding rows that can't get smaller
+        run_count = np.count_nonzero(levels[y, 1:] != levels[y, :-1]) + 1
+        runs = encode_row_runs(levels[y], bpp) if run_count < packed.shape[1] else b''
+        if runs and len(runs) < packed.shape[1]:
+            payload += bytes([ROW_RLE]) + runs
+        else:  # noisy (e.g. dithered) row, store as is
+            payload += bytes([ROW_LITERAL]) + packed[y].tobytes()
+        y += 1
+
+    header = b'DLPF' + struct.pack('<BBHHHI', FRAME_VERSION, bpp, 0, width, height, len(payload))
+    return header + bytes(payload)
+
+
+def decode(data):
+    # reference decoder (mirrors src/frame_codec.c); returns (bpp, levels)
+    magic, version, bpp, _, width, height, length = struct.unpack_from('<4sBBHHHI', data)
+    assert magic == b'DLPF' and version == FRAME_VERSION, "not a DLPF frame"
+    levels = np.zeros((height, width), dtype=np.uint8)
+    pos = 16
+    end = pos + length
+    y = 0
+
+    def read_varint():
+        nonlocal pos
+        value, shift = 0, 0
+        while True:
+            byte = data[pos]
+            pos += 1
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value
+
+    while y < height and pos < end:
+        record = data[pos]
+        pos += 1
+        if record == ROW_RLE:
+            x = 0
+            while x < width:
+                run = read_varint()
+                n = (run >> bpp) + 1
+                levels[y, x:x + n] = run & ((1 << bpp) - 1)
+                x += n
+            y += 1
+        elif record == ROW_REPEAT:
+            n = read_varint()
+            levels[y:y + n] = levels[y - 1]
+            y += n
+        elif record == ROW_LITERAL:
+            nbytes = -(-width * bpp // 8)
+            row = np.frombuffer(data, dtype=np.uint8, count=nbytes, offset=pos)
+            levels[y] = unpack(row[None, :], bpp, width)[0]
+            pos += nbytes
+            y += 1
+        else:
+            raise ValueError("corrupt frame: unknown record 0x%02x" % record)
+
+    assert y == height, "truncated frame"
+    return bpp, levels
+
+
+def c_array(name, data):
+    # C source that places the bytes in flash (const), for linking into the firmware
+    lines = ['#include <stdint.h>', '',
+             'const uint32_t %s_len = %d;' % (name, len(data)),
+             'const uint8_t %s[%d] __attribute__((aligned(4))) = {' % (name, len(data))]
+    for i in range(0, len(data), 16):
+        lines.append('    ' + ', '.join('0x%02x' % b for b in data[i:i + 16]) + ',')
+    lines.append('};')
+    return '\n'.join(lines) + '\n'
+
+
+HEX_BYTES = np.array(['0x%02x' % value for value in range(256)])
+
+
+def c_header(name, data):
+    # the same as a header to #include into one source file (the array is static)
+    guard = name.upper() + '_H'
+    lines = ['#ifndef ' + guard, '#define ' + guard, '', '#include <stdint.h>', '',
+             '#define %s_LEN %d' % (name.upper(), len(data)), '',
+             'static const uint8_t %s[%d] __attribute__((aligned(4))) = {' % (name, len(data))]
+    hex_bytes = HEX_BYTES[np.frombuffer(data, dtype=np.uint8)]
+    for i in range(0, len(data), 16):
+        lines.append('    ' + ', '.join(hex_bytes[i:i + 16]) + ',')
+    lines += ['};', '', '#endif']
+    return '\n'.join(lines) + '\n'
+
+
+# Delta updates ("DLPD", see src/delta.h): only the row spans that changed between two layers.
+DELTA_VERSION = 1
+SPAN_DATA = 0x00
+SPAN_FILL = 0x01
+
+
+def changed_spans(old_row, new_row, max_gap):
+    # [start, end) column ranges where the rows differ. Spans closer together than max_gap
+    # pixels are merged, since every record costs 8 bytes of header.
+    changed = np.flatnonzero(old_row != new_row)
+    if len(changed) == 0:
+        return []
+    breaks = np.flatnonzero(np.diff(changed) > max_gap)
+    starts = np.concatenate(([changed[0]], changed[breaks + 1]))
+    ends = np.concatenate((changed[breaks], [changed[-1]])) + 1
+    return list(zip(starts.tolist(), ends.tolist()))
+
+
+def encode_delta(old, new, bpp, max_gap=16):
+    # two (height, width) arrays of pixel values -> DLPD bytes that turn old into new
+    old = np.asarray(old, dtype=np.uint8)
+    new = np.asarray(new, dtype=np.uint8)
+    height, width = new.shape
+    payload = bytearray()
+
+    for y in np.flatnonzero((old != new).any(axis=1)):
+        for x0, x1 in changed_spans(old[y], new[y], max_gap):
+            span = new[y, x0:x1]
+            if np.all(span == span[0]):
+                payload += struct.pack('<BBHHH', SPAN_FILL, int(span[0]), y, x0, x1 - x0)
+            else:
+                data = pack(span[None, :], bpp)[0].tobytes()
+                data += bytes(-len(data) % 4)  # keep the next record word aligned
+                payload += struct.pack('<BBHHH', SPAN_DATA, 0, y, x0, x1 - x0) + data
+
+    header = b'DLPD' + struct.pack('<BBHHHI', DELTA_VERSION, bpp, 0, width, height, len(payload))
+    return header + bytes(payload)
+
+
+def apply_delta(levels, data):
+    # reference implementation of src/delta.c; updates levels in place
+    magic, version, bpp, _, width, height, length = struct.unpack_from('<4sBBHHHI', data)
+    assert magic == b'DLPD' and version == DELTA_VERSION, "not a DLPD delta"
+    assert levels.shape == (height, width)
+    pos = 16
+    end = pos + length
+    while pos < end:
+        kind, value, y, x, count = struct.unpack_from('<BBHHH', data, pos)
+        pos += 8
+        if kind == SPAN_FILL:
+            levels[y, x:x + count] = value
+        else:
+            nbytes = -(-count * bpp // 32) * 4
+            row = np.frombuffer(data, dtype=np.uint8, count=nbytes, offset=pos)
+            levels[y, x:x + count] = unpack(row[None, :], bpp, count)[0]
+            pos += nbytes
+    return levels
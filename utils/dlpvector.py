@@ -0,0 +1,445 @@
+import numpy as np
+import struct
+
+# The DLPV display-list format and its rasterisers, matching src/vector.h:
+#
+#   16 byte header: b'DLPV', version, reserved u8, layers u16, width u16, height u16, payload u32
+#   followed by the layers, each a layer record and its primitives sorted by their top edge.
+#
+# Coordinates are int16 in 1/16 pixel, y pointing down; a pixel is covered when its centre
+# (x + 0.5, y + 0.5) is inside a primitive. rasterise() is a line by line port of the firmware
+# (same integer arithmetic, same active-edge tables), reference() tests every pixel centre
+# against the primitives independently; the two should agree up to pixels whose centre lies
+# right on an edge.
+
+VECTOR_VERSION = 1
+SUBPIXEL = 16
+LAYER, RECT, CIRCLE, TRACE, POLYGON = 0x00, 0x01, 0x02, 0x03, 0x04
+LAYER_CLEAR = 0x01
+MAX_LAYERS = 8
+MAX_ACTIVE = 128      # src/vector.h: primitives crossing one line
+MAX_EDGES = 128       # src/vector.h: polygon edges crossing one line
+FIX = 12              # fractional bits of the polygon edge x positions
+
+MARGIN = 4096         # src/vector.h: 1/16 pixel coordinates may reach past the field, and largest radius
+
+
+def top(p):
+    kind = p[0]
+    if kind == RECT:
+        return p[2]
+    if kind == CIRCLE:
+        return p[2] - p[3]
+    if kind == TRACE:
+        return min(p[2], p[4]) - p[5]
+    return p[1]
+
+
+def bottom(p):
+    # first line centre (in 1/16 pixel) below the primitive
+    kind = p[0]
+    if kind == RECT:
+        return p[4]
+    if kind == CIRCLE:
+        return p[2] + p[3] + 1
+    if kind == TRACE:
+        return max(p[2], p[4]) + p[5] + 1
+    return p[2]
+
+
+def polygon_edges(contours):
+    # contours in 1/16 pixel -> ('polygon' record tuple) with sorted, downward edges
+    edges = []
+    for contour in contours:
+        for (x0, y0), (x1, y1) in zip(contour, contour[1:] + contour[:1]):
+            if y0 == y1:
+                continue
+            if y0 > y1:
+                x0, y0, x1, y1 = x1, y1, x0, y0
+            edges.append((x0, y0, x1, y1))
+    if not edges:
+        return None
+    edges.sort(key=lambda e: (e[1], e[0]))
+    return (POLYGON, min(e[1] for e in edges), max(e[3] for e in edges), edges)
+
+
+def encode(layers, width, height):
+    # [(dark, [primitive, ...]), ...] with primitives as record tuples:
+    #   (RECT, x0, y0, x1, y1), (CIRCLE, cx, cy, r), (TRACE, x0, y0, x1, y1, r),
+    #   (POLYGON, ytop, ybottom, [(x0, y0, x1, y1), ...])
+    assert len(layers) <= MAX_LAYERS, "too many layers (polarity changes)"
+    payload = b''
+    for dark, primitives in layers:
+        body = b''
+        for p in sorted(primitives, key=top):
+            assert _in_range(p, width, height), "coordinate out of range"
+            if p[0] == RECT:
+                body += struct.pack('<BBHhhhh', RECT, 0, 0, *p[1:5])
+            elif p[0] == CIRCLE:
+                body += struct.pack('<BBHhhhh', CIRCLE, 0, 0, p[1], p[2], p[3], 0)
+            elif p[0] == TRACE:
+                body += struct.pack('<BBHhhhhhh', TRACE, 0, 0, *p[1:6], 0)
+            else:
+                assert len(p[3]) <= 0xFFFF
+                body += struct.pack('<BBHhh', POLYGON, 0, len(p[3]), p[1], p[2])
+                body += b''.join(struct.pack('<hhhh', *e) for e in p[3])
+        payload += struct.pack('<BBHI', LAYER, 0 if dark else LAYER_CLEAR, len(primitives), len(body)) + body
+    header = b'DLPV' + struct.pack('<BBHHHI', VECTOR_VERSION, 0, len(layers), width, height, len(payload))
+    return header + payload
+
+
+def _in_range(p, width, height):
+    # the bounds vector_validate() checks
+    def inside(x, y):
+        return -MARGIN <= x <= width * SUBPIXEL + MARGIN and -MARGIN <= y <= height * SUBPIXEL + MARGIN
+    if p[0] == POLYGON:
+        return all(inside(x0, y0) and inside(x1, y1) for x0, y0, x1, y1 in p[3])
+    if p[0] == CIRCLE:
+        return inside(p[1], p[2]) and 0 <= p[3] <= MARGIN
+    if p[0] == TRACE and not 0 <= p[5] <= MARGIN:
+        return False
+    return inside(p[1], p[2]) and inside(p[3], p[4])
+
+
+def decode(data):
+    # DLPV bytes -> (width, height, [(dark, [record tuple, ...]), ...])
+    magic, version, _, count, width, height, length = struct.unpack_from('<4sBBHHHI', data)
+    assert magic == b'DLPV' and version == VECTOR_VERSION, "not a DLPV display list"
+    pos = 16
+    layers = []
+    for _ in range(count):
+        kind, flags, n, body = struct.unpack_from('<BBHI', data, pos)
+        assert kind == LAYER
+        pos += 8
+        primitives = []
+        for _ in range(n):
+            kind, _, edges = struct.unpack_from('<BBH', data, pos)
+            if kind in (RECT, CIRCLE):
+                values = struct.unpack_from('<hhhh', data, pos + 4)
+                primitives.append((kind,) + (values if kind == RECT else values[:3]))
+                pos += 12
+            elif kind == TRACE:
+                primitives.append((TRACE,) + struct.unpack_from('<hhhhh', data, pos + 4))
+                pos += 16
+            else:
+                ytop, ybottom = struct.unpack_from('<hh', data, pos + 4)
+                e = [struct.unpack_from('<hhhh', data, pos + 8 + 8 * i) for i in range(edges)]
+                primitives.append((POLYGON, ytop, ybottom, e))
+                pos += 8 + 8 * edges
+        layers.append((not (flags & LAYER_CLEAR), primitives))
+    return width, height, layers
+
+
+# -- firmware port -------------------------------------------------------------------------------
+
+def _isqrt(v):
+    return int(np.sqrt(v)) if v < (1 << 52) else int(v ** 0.5)
+
+
+def _div_floor(a, b):
+    return a // b
+
+
+def _div_ceil(a, b):
+    return -((-a) // b)
+
+
+def _circle_span(cx, cy, r, yc):
+    dy = yc - cy
+    h2 = r * r - dy * dy
+    if h2 < 0:
+        return None
+    h = _isqrt(h2)
+    while h * h > h2:
+        h -= 1
+    while (h + 1) * (h + 1) <= h2:
+        h += 1
+    return cx - h, cx + h
+
+
+def _trace_span(p, yc):
+    # closed interval of x (centre coordinates, 1/16 pixel) within r of the segment
+    _, x0, y0, x1, y1, r = p
+    dx, dy = x1 - x0, y1 - y0
+    lo, hi = None, None
+    for cx, cy in ((x0, y0), (x1, y1)):
+        span = _circle_span(cx, cy, r, yc)
+        if span:
+            lo = span[0] if lo is None else min(lo, span[0])
+            hi = span[1] if hi is None else max(hi, span[1])
+    l2 = dx * dx + dy * dy
+    if l2 == 0:
+        return (lo, hi) if lo is not None else None
+    reach = _isqrt(r * r * l2)   # r * |d|
+    while reach * reach > r * r * l2:
+        reach -= 1
+    ey = yc - y0
+    blo, bhi = -(1 << 40), 1 << 40
+    # |dx * ey - dy * (px - x0)| <= reach
+    if dy == 0:
+        if abs(dx * ey) > reach:
+            return (lo, hi) if lo is not None else None
+    else:
+        a, b = dx * ey - reach, dx * ey + reach
+        if dy < 0:
+            a, b = -b, -a
+        blo, bhi = max(blo, x0 + _div_ceil(a, abs(dy))), min(bhi, x0 + _div_floor(b, abs(dy)))
+    # 0 <= dx * (px - x0) + dy * ey <= l2
+    if dx == 0:
+        if not 0 <= dy * ey <= l2:
+            return (lo, hi) if lo is not None else None
+    else:
+        a, b = -dy * ey, l2 - dy * ey
+        if dx < 0:
+            a, b = -b, -a
+        blo, bhi = max(blo, x0 + _div_ceil(a, abs(dx))), min(bhi, x0 + _div_floor(b, abs(dx)))
+    if blo <= bhi:
+        lo = blo if lo is None else min(lo, blo)
+        hi = bhi if hi is None else max(hi, bhi)
+    return (lo, hi) if lo is not None else None
+
+
+def _fill_closed(row, lo, hi, value):
+    # pixels whose centre 16x+8 lies in [lo, hi]
+    first = max(0, _div_ceil(lo - SUBPIXEL // 2, SUBPIXEL))
+    end = min(len(row), _div_floor(hi - SUBPIXEL // 2, SUBPIXEL) + 1)
+    if first < end:
+        row[first:end] = value
+
+
+def _fill_half_open(row, lo, hi, value, shift=0):
+    # pixels whose centre lies in [lo, hi), with <shift> extra fractional bits
+    unit = SUBPIXEL << shift
+    half = (SUBPIXEL // 2) << shift
+    first = max(0, _div_ceil(lo - half, unit))
+    end = min(len(row), _div_ceil(hi - half, unit))
+    if first < end:
+        row[first:end] = value
+
+
+def rasterise(data, bpp=1, stats=None):
+    # the firmware's scanline rasteriser (src/vector.c) -> (height, width) pixel values
+    width, height, layers = decode(data)
+    on = (1 << bpp) - 1
+    out = np.zeros((height, width), dtype=np.uint8)
+    cursors = [[0, primitives] for _, primitives in layers]
+    active = []          # [layer, primitive, next edge], in layer order
+    edges = []           # [x (FIX bits), step, y1, owner]
+    max_active = max_edges = dropped = 0
+
+    for y in range(height):
+        yc = y * SUBPIXEL + SUBPIXEL // 2
+        for index, cursor in enumerate(cursors):
+            while cursor[0] < len(cursor[1]) and top(cursor[1][cursor[0]]) <= yc:
+                p = cursor[1][cursor[0]]
+                cursor[0] += 1
+                if bottom(p) <= yc:
+                    continue
+                if len(active) >= MAX_ACTIVE:
+                    dropped += 1
+                    continue
+                position = len(active)
+                while position > 0 and active[position - 1][0] > index:
+                    position -= 1
+                active.insert(position, [index, p, 0])
+
+        row = out[y]
+        kept = []
+        for entry in active:
+            index, p, _ = entry
+            if bottom(p) <= yc:
+                edges = [e for e in edges if e[3] is not p]
+                continue
+            kept.append(entry)
+            value = on if layers[index][0] else 0
+            kind = p[0]
+            if kind == RECT:
+                if p[2] <= yc:
+                    _fill_half_open(row, p[1], p[3], value)
+            elif kind == CIRCLE:
+                span = _circle_span(p[1], p[2], p[3], yc)
+                if span:
+                    _fill_closed(row, span[0], span[1], value)
+            elif kind == TRACE:
+                span = _trace_span(p, yc)
+                if span:
+                    _fill_closed(row, span[0], span[1], value)
+            else:
+                # active edge table of this polygon: retire, then add the edges starting here
+                edges = [e for e in edges if e[3] is not p or e[2] > yc]
+                polygon_edges_list = p[3]
+                while entry[2] < len(polygon_edges_list) and polygon_edges_list[entry[2]][1] <= yc:
+                    x0, y0, x1, y1 = polygon_edges_list[entry[2]]
+                    entry[2] += 1
+                    if y1 <= yc:
+                        continue
+                    if len(edges) >= MAX_EDGES:
+                        dropped += 1
+                        continue
+                    x = (x0 << FIX) + _div_floor((yc - y0) * (x1 - x0) << FIX, y1 - y0)
+                    step = _div_floor((x1 - x0) * SUBPIXEL << FIX, y1 - y0)
+                    edges.append([x, step, y1, p])
+                crossings = sorted(e[0] for e in edges if e[3] is p)
+                for a, b in zip(crossings[0::2], crossings[1::2]):
+                    _fill_half_open(row, a, b, value, FIX)
+                for e in edges:
+                    if e[3] is p:
+                        e[0] += e[1]
+        active = kept
+        max_active = max(max_active, len(active))
+        max_edges = max(max_edges, len(edges))
+
+    if stats is not None:
+        stats.update(max_active=max_active, max_edges=max_edges, dropped=dropped)
+    return out
+
+
+# -- independent reference -----------------------------------------------------------------------
+
+def reference(data, bpp=1):
+    # test every pixel centre against the primitives (floating point geometry)
+    width, height, layers = decode(data)
+    on = (1 << bpp) - 1
+    out = np.zeros((height, width), dtype=np.uint8)
+    px = np.arange(width) * SUBPIXEL + SUBPIXEL / 2
+    py = np.arange(height) * SUBPIXEL + SUBPIXEL / 2
+
+    def window(x0, y0, x1, y1):
+        cols = slice(max(0, int(np.floor(x0 / SUBPIXEL)) - 1), max(0, min(width, int(np.ceil(x1 / SUBPIXEL)) + 1)))
+        rows = slice(max(0, int(np.floor(y0 / SUBPIXEL)) - 1), max(0, min(height, int(np.ceil(y1 / SUBPIXEL)) + 1)))
+        return rows, cols
+
+    for dark, primitives in layers:
+        value = on if dark else 0
+        for p in primitives:
+            kind = p[0]
+            if kind == RECT:
+                rows, cols = window(*p[1:5])
+                X, Y = np.meshgrid(px[cols], py[rows])
+                mask = (X >= p[1]) & (X < p[3]) & (Y >= p[2]) & (Y < p[4])
+            elif kind == CIRCLE:
+                _, cx, cy, r = p
+                rows, cols = window(cx - r, cy - r, cx + r, cy + r)
+                X, Y = np.meshgrid(px[cols], py[rows])
+                mask = (X - cx) ** 2 + (Y - cy) ** 2 <= r * r
+            elif kind == TRACE:
+                _, x0, y0, x1, y1, r = p
+                rows, cols = window(min(x0, x1) - r, min(y0, y1) - r, max(x0, x1) + r, max(y0, y1) + r)
+                X, Y = np.meshgrid(px[cols], py[rows])
+                dx, dy = float(x1 - x0), float(y1 - y0)
+                l2 = dx * dx + dy * dy
+                t = np.clip(((X - x0) * dx + (Y - y0) * dy) / l2, 0, 1) if l2 else 0.0
+                mask = (X - x0 - t * dx) ** 2 + (Y - y0 - t * dy) ** 2 <= r * r
+            else:
+                _, ytop, ybottom, e = p
+                xs = [v for edge in e for v in (edge[0], edge[2])]
+                rows, cols = window(min(xs), ytop, max(xs), ybottom)
+                # every crossing flips the parity of the pixels at and right of it
+                ncols = cols.stop - cols.start
+                flips = np.zeros((rows.stop - rows.start, ncols + 1), dtype=np.uint8)
+                centres = py[rows]
+                for x0, y0, x1, y1 in e:
+                    hit = np.flatnonzero((centres >= y0) & (centres < y1))
+                    xc = x0 + (centres[hit] - y0) * (x1 - x0) / (y1 - y0)
+                    first = np.clip(np.ceil((xc - SUBPIXEL / 2) / SUBPIXEL) - cols.start, 0, ncols).astype(int)
+                    np.add.at(flips, (hit, first), 1)
+                mask = (np.cumsum(flips, axis=1)[:, :ncols] & 1).astype(bool)
+            out[rows, cols][mask] = value
+    return out
+
+
+# -- conversion from gerber.py primitives ----------------------------------------------------------
+
+def from_gerber(layers, origin, pitch, width, height, margin=64):
+    # gerber.py layers (mm, y up) -> record tuples (1/16 pixel, y down) for a width x height
+    # field whose top left corner is at <origin> (mm). Primitives outside the field are dropped,
+    # the others clipped to the field plus <margin> pixels, well inside MARGIN.
+    ox, oy = origin
+    scale = SUBPIXEL / pitch
+    lo_x, lo_y = -margin * SUBPIXEL, -margin * SUBPIXEL
+    hi_x, hi_y = (width + margin) * SUBPIXEL, (height + margin) * SUBPIXEL
+
+    def to_px(x, y):
+        return (x - ox) * scale, (oy - y) * scale
+
+    def outside(x0, y0, x1, y1):
+        return x1 < 0 or y1 < 0 or x0 > width * SUBPIXEL or y0 > height * SUBPIXEL
+
+    out = []
+    for dark, primitives in layers:
+        records = []
+        for p in primitives:
+            kind = p[0]
+            if kind == 'circle':
+                (cx, cy), r = to_px(p[1], p[2]), p[3] * scale
+                if outside(cx - r, cy - r, cx + r, cy + r):
+                    continue
+                records.append((CIRCLE, round(cx), round(cy), max(1, round(r))))
+            elif kind == 'rect':
+                (x0, y1), (x1, y0) = to_px(p[1], p[2]), to_px(p[3], p[4])
+                if outside(x0, y0, x1, y1):
+                    continue
+                records.append((RECT, round(max(x0, lo_x)), round(max(y0, lo_y)),
+                                round(min(x1, hi_x)), round(min(y1, hi_y))))
+            elif kind == 'trace':
+                (x0, y0), (x1, y1), r = to_px(p[1], p[2]), to_px(p[3], p[4]), p[5] * scale
+                if outside(min(x0, x1) - r, min(y0, y1) - r, max(x0, x1) + r, max(y0, y1) + r):
+                    continue
+                clipped = _clip_segment(x0, y0, x1, y1, lo_x - r, lo_y - r, hi_x + r, hi_y + r)
+                if clipped:
+                    records.append((TRACE,) + tuple(round(v) for v in clipped) + (max(1, round(r)),))
+            else:
+                contours = []
+                for contour in p[1]:
+                    points = _clip_polygon([to_px(x, y) for x, y in contour], lo_x, lo_y, hi_x, hi_y)
+                    if len(points) > 2:
+                        contours.append([(round(x), round(y)) for x, y in points])
+                if not contours:
+                    continue
+                ys = [q[1] for c in contours for q in c]
+                xs = [q[0] for c in contours for q in c]
+                if outside(min(xs), min(ys), max(xs), max(ys)):
+                    continue
+                record = polygon_edges(contours)
+                if record:
+                    records.append(record)
+        if records or not dark:
+            out.append((dark, records))
+    return out
+
+
+def _clip_segment(x0, y0, x1, y1, xmin, ymin, xmax, ymax):
+    # Liang-Barsky
+    t0, t1 = 0.0, 1.0
+    dx, dy = x1 - x0, y1 - y0
+    for p, q in ((-dx, x0 - xmin), (dx, xmax - x0), (-dy, y0 - ymin), (dy, ymax - y0)):
+        if p == 0:
+            if q < 0:
+                return None
+        else:
+            t = q / p
+            if p < 0:
+                t0 = max(t0, t)
+            else:
+                t1 = min(t1, t)
+    if t0 > t1:
+        return None
+    return x0 + t0 * dx, y0 + t0 * dy, x0 + t1 * dx, y0 + t1 * dy
+
+
+def _clip_polygon(points, xmin, ymin, xmax, ymax):
+    # Sutherland-Hodgman against the field; keeps the even-odd parity inside it
+    for axis, limit, keep_above in ((0, xmin, True), (0, xmax, False), (1, ymin, True), (1, ymax, False)):
+        if not points:
+            break
+        result = []
+        for a, b in zip(points, points[1:] + points[:1]):
+            a_in = a[axis] >= limit if keep_above else a[axis] <= limit
+            b_in = b[axis] >= limit if keep_above else b[axis] <= limit
+            if a_in:
+                result.append(a)
+            if a_in != b_in:
+                t = (limit - a[axis]) / (b[axis] - a[axis])
+                result.append((a[0] + t * (b[0] - a[0]), a[1] + t * (b[1] - a[1])))
+        points = result
+    return points
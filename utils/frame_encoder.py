@@ -0,0 +1,72 @@
+import tifffile as tif
+import numpy as np
+import argparse
+import time
+import os
+
+import dlpframe
+
+# Encode 720x1280 grayscale tiffs into the compact DLPF frame format that the firmware can
+# decode straight into DLP_data_array (see src/frame_codec.h). For each file the compression
+# ratio against the raw packed frame and the encode/decode time is reported, so you can get
+# a feel for how well a set of masks compresses, e.g.
+#
+#   python frame_encoder.py *.tif
+#
+# writes gradient_sample_image.dlpf and open_mla_logo_sample_image.dlpf next to the inputs.
+# --roi encodes only the window that a DLP_ROI build stores (see src/video_mode.h).
+
+
+def encode_file(filepath, bpp, outdir=None, write_c=False, roi=None):
+    filename_base = os.path.splitext(os.path.basename(filepath))[0]
+    outdir = outdir or os.path.dirname(filepath)
+
+    with tif.TiffFile(filepath) as image:
+        pixelarray = image.asarray()
+        assert pixelarray.shape == (dlpframe.HEIGHT, dlpframe.WIDTH)  # check the image size
+
+    levels = dlpframe.quantise(pixelarray, bpp)
+    if roi:
+        levels = dlpframe.crop(levels, roi, bpp)
+
+    start = time.perf_counter()
+    frame = dlpframe.encode(levels, bpp)
+    encode_time = time.perf_counter() - start
+
+    # always check the round trip with the reference decoder; cheap compared to encoding
+    start = time.perf_counter()
+    decoded_bpp, decoded = dlpframe.decode(frame)
+    decode_time = time.perf_counter() - start
+    assert decoded_bpp == bpp and np.array_equal(decoded, levels), "round trip mismatch!"
+
+    with open(os.path.join(outdir, filename_base + '.dlpf'), 'wb') as f:
+        f.write(frame)
+
+    if write_c:
+        with open(os.path.join(outdir, filename_base + '_frame.c'), 'w') as f:
+            f.write(dlpframe.c_array(filename_base + '_frame', frame))
+
+    raw_size = levels.size * bpp // 8
+    print("%-40s %7d -> %7d bytes  ratio %6.1fx  encode %6.1f ms  decode (python) %6.1f ms" % (
+        os.path.basename(filepath), raw_size, len(frame), raw_size / len(frame),
+        encode_time * 1000, decode_time * 1000))
+    return raw_size, len(frame)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Encode 8-bit 720x1280 tifs into DLPF frames")
+    parser.add_argument("files", nargs='+', help="grayscale TIF file(s)")
+    parser.add_argument("--bpp", type=int, default=2, choices=[1, 2, 4, 8], help="bits per pixel of the frame")
+    parser.add_argument("--outdir", type=str, default=None, help="output directory (default: next to input)")
+    parser.add_argument("--c-array", action='store_true', help="also write a C source file with the frame as a const array")
+    parser.add_argument("--roi", type=dlpframe.parse_roi, default=None,
+                        help="x,y,width,height: encode only this window, as set with cmake -DDLP_ROI")
+
+    args = parser.parse_args()
+    total_raw, total_frame = 0, 0
+    for filepath in args.files:
+        raw_size, frame_size = encode_file(filepath, args.bpp, args.outdir, args.c_array, args.roi)
+        total_raw += raw_size
+        total_frame += frame_size
+
+    print("total: %d -> %d bytes (%.1fx)" % (total_raw, total_frame, total_raw / total_frame))
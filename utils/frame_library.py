@@ -0,0 +1,126 @@
+import tifffile as tif
+import argparse
+import struct
+import zlib
+import os
+
+import dlpframe
+
+# Pack frames into a flash frame library for the pico (see src/frame_library.h) and write it as a
+# UF2 that is flashed next to the firmware (drag it onto the RPI-RP2 drive, like DLP_pico.uf2):
+#
+#   python frame_library.py open_mla_logo_sample_image.tif gradient_sample_image.tif --out library.uf2
+#
+# .tif images are packed as raw frames, which the scan-out reads straight from flash (or as DLPF
+# frames with --compress, smaller but decoded into the framebuffer first); .dlpf frames are
+# stored as they are. A frame is selected by its index over USB:
+#
+#   python usb_frame_upload.py --port /dev/ttyACM0 --select 1
+#
+# --offset must match FRAME_LIBRARY_OFFSET of the firmware (cmake DLP_LIBRARY_OFFSET). --list
+# prints the table of a library (.uf2 or .bin).
+
+FORMAT_RAW, FORMAT_DLPF = 0x00, 0x01
+LIBRARY_VERSION = 1
+HEADER_SIZE = 16
+ENTRY = struct.Struct('<IIBBHI16s')   # offset, length, format, bpp, height, crc, name
+ALIGN = 256                            # flash page
+
+XIP_BASE = 0x10000000
+UF2_MAGIC = (0x0A324655, 0x9E5D5157, 0x0AB16F30)
+UF2_FLAG_FAMILY = 0x00002000
+UF2_FAMILY_RP2040 = 0xE48BFF56
+UF2_PAYLOAD = 256
+
+
+def load(path, bpp, compress):
+    # (format, bpp, height, data) of one frame
+    if os.path.splitext(path)[1].lower() == '.dlpf':
+        data = open(path, 'rb').read()
+        _, _, frame_bpp, _, _, height, _ = struct.unpack('<4sBBHHHI', data[:16])
+        return FORMAT_DLPF, frame_bpp, height, data
+
+    with tif.TiffFile(path) as image:
+        pixelarray = image.asarray()
+        assert pixelarray.shape == (dlpframe.HEIGHT, dlpframe.WIDTH)  # check the image size
+    levels = dlpframe.quantise(pixelarray, bpp)
+    if compress:
+        return FORMAT_DLPF, bpp, dlpframe.HEIGHT, dlpframe.encode(levels, bpp)
+    return FORMAT_RAW, bpp, dlpframe.HEIGHT, dlpframe.pack(levels, bpp).tobytes()
+
+
+def build(frames):
+    # frames: list of (name, format, bpp, height, data) -> library image
+    table_end = HEADER_SIZE + len(frames) * ENTRY.size
+    offset = (table_end + ALIGN - 1) // ALIGN * ALIGN
+    table, body = b'', b''
+    for name, kind, bpp, height, data in frames:
+        table += ENTRY.pack(offset, len(data), kind, bpp, height, zlib.crc32(data), name.encode()[:16])
+        padded = data + bytes(-len(data) % ALIGN)
+        body += padded
+        offset += len(padded)
+
+    header = struct.pack('<4sBBHII', b'DLPL', LIBRARY_VERSION, 0, len(frames), zlib.crc32(table), 0)
+    image = header + table
+    return image + bytes(-len(image) % ALIGN) + body
+
+
+def parse(image):
+    magic, version, _, count, table_crc, _ = struct.unpack('<4sBBHII', image[:HEADER_SIZE])
+    table = image[HEADER_SIZE:HEADER_SIZE + count * ENTRY.size]
+    if magic != b'DLPL' or version != LIBRARY_VERSION or zlib.crc32(table) != table_crc:
+        raise ValueError("not a frame library (or a damaged one)")
+    entries = []
+    for i in range(count):
+        offset, length, kind, bpp, height, crc, name = ENTRY.unpack_from(table, i * ENTRY.size)
+        entries.append({'name': name.rstrip(b'\0').decode(), 'offset': offset, 'length': length, 'format': kind,
+                        'bpp': bpp, 'height': height, 'ok': zlib.crc32(image[offset:offset + length]) == crc})
+    return entries
+
+
+def to_uf2(image, address):
+    blocks = [image[i:i + UF2_PAYLOAD] for i in range(0, len(image), UF2_PAYLOAD)]
+    out = b''
+    for number, block in enumerate(blocks):
+        out += struct.pack('<8I', UF2_MAGIC[0], UF2_MAGIC[1], UF2_FLAG_FAMILY, address + number * UF2_PAYLOAD,
+                           UF2_PAYLOAD, number, len(blocks), UF2_FAMILY_RP2040)
+        out += block.ljust(476, b'\0') + struct.pack('<I', UF2_MAGIC[2])
+    return out
+
+
+def from_uf2(data):
+    blocks = sorted((struct.unpack_from('<3I', data, i + 12), i) for i in range(0, len(data), 512))
+    return b''.join(data[i + 32:i + 32 + size] for (_, size, _), i in blocks)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Pack frames into a flash frame library (UF2) for the pico")
+    parser.add_argument("files", type=str, nargs='*', help="720x1280 grayscale .tif images or .dlpf frames")
+    parser.add_argument("--bpp", type=int, default=2, choices=[1, 2, 4, 8], help="bits per pixel of the scan-out")
+    parser.add_argument("--compress", action="store_true", help="store images as DLPF instead of raw frames")
+    parser.add_argument("--offset", type=lambda v: int(v, 0), default=0x100000, help="flash offset of the library")
+    parser.add_argument("--flash-size", type=lambda v: int(v, 0), default=2 * 1024 * 1024, help="bytes of flash")
+    parser.add_argument("--out", type=str, default='library.uf2', help="output file (.uf2, or .bin for a raw image)")
+    parser.add_argument("--list", type=str, default=None, help="print the table of a .uf2 or .bin library")
+
+    args = parser.parse_args()
+    if args.list:
+        data = open(args.list, 'rb').read()
+        image = from_uf2(data) if args.list.lower().endswith('.uf2') else data
+        for index, entry in enumerate(parse(image)):
+            print("%2d %-16s %s %d bit, %d rows, %d bytes at +0x%x%s" % (
+                index, entry['name'], 'raw ' if entry['format'] == FORMAT_RAW else 'DLPF', entry['bpp'],
+                entry['height'], entry['length'], entry['offset'], '' if entry['ok'] else ', CRC mismatch!'))
+    else:
+        frames = []
+        for path in args.files:
+            kind, bpp, height, data = load(path, args.bpp, args.compress)
+            frames.append((os.path.splitext(os.path.basename(path))[0], kind, bpp, height, data))
+        image = build(frames)
+
+        room = args.flash_size - args.offset
+        print("%d frames, %d of %d bytes of the partition at 0x%x" % (len(frames), len(image), room, args.offset))
+        if len(image) > room:
+            raise SystemExit("ERROR: the library does not fit in flash")
+        with open(args.out, 'wb') as f:
+            f.write(image if args.out.lower().endswith('.bin') else to_uf2(image, XIP_BASE + args.offset))
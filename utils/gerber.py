@@ -0,0 +1,317 @@
+import math
+import re
+
+# Minimal Gerber X2 (RS-274X) reader for the copper and mask layers KiCad writes, e.g.
+# PCB/production/*.gbr. It turns the file into the primitives the firmware's display-list
+# rasteriser understands (see src/vector.h), in millimetres with Y pointing up:
+#
+#   ('circle', cx, cy, r)
+#   ('rect', x0, y0, x1, y1)             axis aligned
+#   ('trace', x0, y0, x1, y1, r)         segment with round caps (a draw with a round aperture)
+#   ('polygon', [[(x, y), ...], ...])    contours, filled even-odd (regions, macro outlines)
+#
+# grouped in layers of one polarity: [(dark, [primitive, ...]), ...], drawn in order; clear
+# layers erase what the layers before them drew. Arcs are split into segments no further than
+# <arc_tolerance> (mm) from the true arc.
+#
+# Supported: %FS (absolute, leading zeros omitted), %MO, %LP, %AD with C/R/O/P and macro
+# apertures, %AM with primitives 1 (circle), 4 (outline), 20 (vector line) and 21 (center line),
+# G01/G02/G03 (multi quadrant), G36/G37 regions, D01/D02/D03. Step and repeat and block
+# apertures are not.
+
+
+class GerberError(Exception):
+    pass
+
+
+def _rotate(x, y, degrees):
+    a = math.radians(degrees)
+    return x * math.cos(a) - y * math.sin(a), x * math.sin(a) + y * math.cos(a)
+
+
+def _rect_outline(x0, y0, x1, y1, rotation=0.0):
+    return [_rotate(x, y, rotation) for x, y in ((x0, y0), (x1, y0), (x1, y1), (x0, y1))]
+
+
+def _line_outline(width, xs, ys, xe, ye, rotation=0.0):
+    # rectangle with square ends around the line (macro primitive 20)
+    length = math.hypot(xe - xs, ye - ys)
+    if length == 0:
+        return []
+    nx, ny = -(ye - ys) / length * width / 2, (xe - xs) / length * width / 2
+    corners = [(xs + nx, ys + ny), (xe + nx, ye + ny), (xe - nx, ye - ny), (xs - nx, ys - ny)]
+    return [_rotate(x, y, rotation) for x, y in corners]
+
+
+def _evaluate(expression, variables):
+    # macro arithmetic: $n, numbers, + - / and x (multiply)
+    text = re.sub(r'\$(\d+)', lambda m: repr(variables.get(int(m.group(1)), 0.0)), expression)
+    text = text.replace('x', '*').replace('X', '*')
+    if not re.fullmatch(r'[0-9.eE+\-*/() ]+', text):
+        raise GerberError("unsupported macro expression %r" % expression)
+    return float(eval(text, {'__builtins__': {}}))
+
+
+def arc_points(start, end, centre, clockwise, tolerance):
+    # points along an arc from start to end (start excluded), at most <tolerance> off the arc
+    r = math.hypot(start[0] - centre[0], start[1] - centre[1])
+    a0 = math.atan2(start[1] - centre[1], start[0] - centre[0])
+    a1 = math.atan2(end[1] - centre[1], end[0] - centre[0])
+    sweep = a1 - a0
+    if clockwise:
+        sweep = sweep if sweep < 0 else sweep - 2 * math.pi
+    else:
+        sweep = sweep if sweep > 0 else sweep + 2 * math.pi
+    if abs(end[0] - start[0]) < 1e-9 and abs(end[1] - start[1]) < 1e-9:
+        sweep = -2 * math.pi if clockwise else 2 * math.pi  # full circle
+    step = 2 * math.acos(max(-1.0, 1 - tolerance / r)) if r > tolerance else math.pi / 2
+    n = max(1, int(math.ceil(abs(sweep) / step)))
+    points = [(centre[0] + r * math.cos(a0 + sweep * k / n), centre[1] + r * math.sin(a0 + sweep * k / n))
+              for k in range(1, n)]
+    return points + [end]
+
+
+class Aperture:
+    def __init__(self, shape, params, macro=None):
+        self.shape = shape
+        self.params = params
+        self.macro = macro
+
+    def flash(self, x, y):
+        # primitives of this aperture flashed at (x, y)
+        p = self.params
+        if self.shape == 'C':
+            return [('circle', x, y, p[0] / 2)]
+        if self.shape == 'R':
+            return [('rect', x - p[0] / 2, y - p[1] / 2, x + p[0] / 2, y + p[1] / 2)]
+        if self.shape == 'O':
+            w, h = p[0], p[1]
+            r = min(w, h) / 2
+            if w > h:
+                return [('trace', x - w / 2 + r, y, x + w / 2 - r, y, r)]
+            return [('trace', x, y - h / 2 + r, x, y + h / 2 - r, r)]
+        if self.shape == 'P':
+            rotation = p[2] if len(p) > 2 else 0.0
+            n = int(p[1])
+            outline = [_rotate(p[0] / 2 * math.cos(2 * math.pi * k / n), p[0] / 2 * math.sin(2 * math.pi * k / n),
+                               rotation) for k in range(n)]
+            return [('polygon', [[(x + px, y + py) for px, py in outline]])]
+        return [_offset(primitive, x, y) for primitive in self.macro]
+
+    def draw(self, start, end):
+        # primitives swept by this aperture along a straight line
+        if self.shape == 'C' or self.shape == 'O' or self.shape == 'P':
+            r = (self.params[0] if self.shape != 'O' else min(self.params[0], self.params[1])) / 2
+            return [('trace', start[0], start[1], end[0], end[1], r)]
+        if self.shape == 'R':
+            w, h = self.params[0] / 2, self.params[1] / 2
+            corners = [(px + dx, py + dy) for px, py in (start, end) for dx in (-w, w) for dy in (-h, h)]
+            return [('polygon', [_convex_hull(corners)])]
+        raise GerberError("drawing with a macro aperture is not supported")
+
+
+def _offset(primitive, x, y):
+    kind = primitive[0]
+    if kind == 'circle':
+        return ('circle', primitive[1] + x, primitive[2] + y, primitive[3])
+    if kind == 'polygon':
+        return ('polygon', [[(px + x, py + y) for px, py in contour] for contour in primitive[1]])
+    raise GerberError("unexpected macro primitive %r" % kind)
+
+
+def _convex_hull(points):
+    points = sorted(set(points))
+    if len(points) <= 2:
+        return points
+
+    def cross(o, a, b):
+        return (a[0] - o[0]) * (b[1] - o[1]) - (a[1] - o[1]) * (b[0] - o[0])
+
+    lower, upper = [], []
+    for p in points:
+        while len(lower) >= 2 and cross(lower[-2], lower[-1], p) <= 0:
+            lower.pop()
+        lower.append(p)
+    for p in reversed(points):
+        while len(upper) >= 2 and cross(upper[-2], upper[-1], p) <= 0:
+            upper.pop()
+        upper.append(p)
+    return lower[:-1] + upper[:-1]
+
+
+def _expand_macro(body, params):
+    # macro primitives (around the aperture centre) for the given aperture parameters
+    variables = {i + 1: v for i, v in enumerate(params)}
+    primitives = []
+    for statement in body:
+        if statement.startswith('0'):
+            continue  # comment
+        if statement.startswith('$'):
+            name, expression = statement.split('=', 1)
+            variables[int(name[1:])] = _evaluate(expression, variables)
+            continue
+        fields = statement.split(',')
+        code = int(fields[0])
+        v = [_evaluate(field, variables) for field in fields[1:] if field.strip()]
+        if v[0] == 0:
+            raise GerberError("clear macro primitives are not supported")
+        if code == 1:
+            rotation = v[4] if len(v) > 4 else 0.0
+            cx, cy = _rotate(v[2], v[3], rotation)
+            primitives.append(('circle', cx, cy, v[1] / 2))
+        elif code == 4:
+            n = int(v[1])
+            points = [(v[2 + 2 * k], v[3 + 2 * k]) for k in range(n + 1)]
+            rotation = v[4 + 2 * n] if len(v) > 4 + 2 * n else 0.0
+            primitives.append(('polygon', [[_rotate(x, y, rotation) for x, y in points[:-1]]]))
+        elif code == 20:
+            outline = _line_outline(v[1], v[2], v[3], v[4], v[5], v[6] if len(v) > 6 else 0.0)
+            if outline:
+                primitives.append(('polygon', [outline]))
+        elif code == 21:
+            w, h, cx, cy = v[1], v[2], v[3], v[4]
+            primitives.append(('polygon', [_rect_outline(cx - w / 2, cy - h / 2, cx + w / 2, cy + h / 2,
+                                                         v[5] if len(v) > 5 else 0.0)]))
+        else:
+            raise GerberError("unsupported macro primitive %d" % code)
+    return primitives
+
+
+def parse(path, arc_tolerance=0.001):
+    with open(path) as f:
+        text = f.read()
+    return parse_text(text, arc_tolerance)
+
+
+def parse_text(text, arc_tolerance=0.001):
+    scale = 1e-6          # per coordinate unit, from %FS and %MO
+    digits = 6
+    units = 1.0
+    macros = {}
+    apertures = {}
+    aperture = None
+    layers = [(True, [])]
+    interpolation = 'G01'
+    x = y = 0.0
+    region = None         # contours while inside G36/G37
+    contour = None
+
+    def coordinate(word, letter, default):
+        m = re.search(letter + r'([+-]?\d+)', word)
+        return int(m.group(1)) * scale if m else default
+
+    def close_contour():
+        if contour and len(contour) > 2:
+            region.append(contour)
+
+    # extended commands (%...%) and word commands (...*)
+    for block in re.finditer(r'%([^%]*)%|([^%*]*)\*', text, re.S):
+        if block.group(1) is not None:
+            command = block.group(1).replace('\n', '').replace('\r', '')
+            if command.startswith('FS'):
+                m = re.match(r'FSLAX(\d)(\d)Y(\d)(\d)\*', command)
+                if not m:
+                    raise GerberError("unsupported format %r" % command)
+                digits = int(m.group(2))
+                scale = units * 10.0 ** -digits
+            elif command.startswith('MO'):
+                units = 25.4 if command.startswith('MOIN') else 1.0
+                scale = units * 10.0 ** -digits
+            elif command.startswith('LP'):
+                dark = command[2] == 'D'
+                if layers[-1][1]:
+                    layers.append((dark, []))
+                else:
+                    layers[-1] = (dark, [])
+            elif command.startswith('AM'):
+                name, _, body = command[2:].partition('*')
+                macros[name] = [s.strip() for s in body.split('*') if s.strip()]
+            elif command.startswith('AD'):
+                m = re.match(r'ADD(\d+)([^,*]+),?([^*]*)\*', command)
+                number, shape = int(m.group(1)), m.group(2)
+                params = [float(p) * units for p in m.group(3).split('X') if p]
+                if shape in ('C', 'R', 'O', 'P'):
+                    if shape == 'P':
+                        params[1:] = [p / units for p in params[1:]]  # vertices and rotation are unitless
+                    apertures[number] = Aperture(shape, params)
+                elif shape in macros:
+                    raw = [float(p) for p in m.group(3).split('X') if p]
+                    apertures[number] = Aperture('M', raw, _expand_macro(macros[shape], raw))
+                else:
+                    raise GerberError("unknown aperture %r" % shape)
+            elif command.startswith('SR') and command != 'SR*':
+                raise GerberError("step and repeat is not supported")
+            continue
+
+        word = block.group(2).strip()
+        if not word or word.startswith('G04'):
+            continue
+        if word.startswith('M02'):
+            break
+        for g in re.findall(r'G0*(\d+)', word):
+            g = int(g)
+            if g in (1, 2, 3):
+                interpolation = 'G0%d' % g
+            elif g == 36:
+                region, contour = [], None
+            elif g == 37:
+                close_contour()
+                if region:
+                    layers[-1][1].append(('polygon', region))
+                region = contour = None
+            elif g == 74:
+                raise GerberError("single quadrant arcs are not supported")
+        m = re.search(r'D0*(\d+)$', word)
+        if not m:
+            continue
+        d = int(m.group(1))
+        if d >= 10:
+            aperture = apertures[d]
+            continue
+
+        nx, ny = coordinate(word, 'X', x), coordinate(word, 'Y', y)
+        if d == 1:
+            if interpolation == 'G01':
+                points = [(nx, ny)]
+            else:
+                centre = (x + coordinate(word, 'I', 0.0), y + coordinate(word, 'J', 0.0))
+                points = arc_points((x, y), (nx, ny), centre, interpolation == 'G02', arc_tolerance)
+            if region is not None:
+                if contour is None:
+                    contour = [(x, y)]
+                contour.extend(points)
+            else:
+                previous = (x, y)
+                for point in points:
+                    layers[-1][1].extend(aperture.draw(previous, point))
+                    previous = point
+        elif d == 2:
+            if region is not None:
+                close_contour()
+                contour = None
+        elif d == 3:
+            layers[-1][1].extend(aperture.flash(nx, ny))
+        x, y = nx, ny
+
+    return [layer for layer in layers if layer[1]]
+
+
+def bounds(layers):
+    # (xmin, ymin, xmax, ymax) in mm over all primitives
+    xs, ys = [], []
+    for _, primitives in layers:
+        for p in primitives:
+            if p[0] == 'circle':
+                xs += [p[1] - p[3], p[1] + p[3]]
+                ys += [p[2] - p[3], p[2] + p[3]]
+            elif p[0] == 'rect':
+                xs += [p[1], p[3]]
+                ys += [p[2], p[4]]
+            elif p[0] == 'trace':
+                xs += [min(p[1], p[3]) - p[5], max(p[1], p[3]) + p[5]]
+                ys += [min(p[2], p[4]) - p[5], max(p[2], p[4]) + p[5]]
+            else:
+                for contour in p[1]:
+                    xs += [q[0] for q in contour]
+                    ys += [q[1] for q in contour]
+    return min(xs), min(ys), max(xs), max(ys)
@@ -0,0 +1,180 @@
+import multiprocessing
+import numpy as np
+import argparse
+import hashlib
+import json
+import time
+import glob
+import os
+import shutil
+import tempfile
+
+import dlpframe
+import dlpvector
+import gerber
+import gerber_to_vector
+
+# Compile Gerber layers into a step-and-repeat exposure plan for boards larger than the DMD
+# field, e.g.
+#
+#   python gerber_plan.py ../PCB/production/*_Cu.gbr --pitch 30 --outdir plan
+#
+# Every layer is cut into overlapping 1280x720 tiles on one grid (so the layers stay in
+# register), each tile is rasterised at --pitch and written as a DLPF frame (see
+# src/frame_codec.h) that can be uploaded as is. Layers are parsed and tiles rasterised in
+# parallel on all CPU cores (--jobs).
+#
+# Tiles are cached by the hash of their display list (the geometry that ends up inside the
+# tile, see src/vector.h) and the raster settings, so after a change to the board only the
+# tiles that actually changed are rasterised again. The cache lives in --cache (default:
+# .tile_cache in the output directory).
+#
+# Neighbouring tiles overlap by --overlap pixels; with --seam middle (default) each tile
+# leaves out its half of the overlap, so every point is exposed exactly once and the overlap
+# is left for alignment. plan.json lists every tile with its origin on the board and the stage
+# offset from the first tile, in mm. --bench compiles the plan three times (one process with a
+# cold cache, all cores with a cold cache, all cores with a warm cache) and prints the times.
+
+CACHE_VERSION = 1
+WIDTH, HEIGHT = dlpframe.WIDTH, dlpframe.HEIGHT
+
+_layers = {}   # parsed layers by name, shared with the worker processes
+
+
+def parse_layer(args):
+    path, pitch = args
+    return os.path.splitext(os.path.basename(path))[0], gerber.parse(path, arc_tolerance=pitch / 8)
+
+
+def tile_grid(bounds, pitch, overlap):
+    # origins (mm, top left corner) of the tiles covering <bounds>, row by row
+    xmin, ymin, xmax, ymax = bounds
+    step_x, step_y = (WIDTH - overlap) * pitch, (HEIGHT - overlap) * pitch
+    cols = max(1, int(np.ceil(((xmax - xmin) - overlap * pitch) / step_x)))
+    rows = max(1, int(np.ceil(((ymax - ymin) - overlap * pitch) / step_y)))
+    return rows, cols, [(r, c, (xmin + c * step_x, ymax - r * step_y)) for r in range(rows) for c in range(cols)]
+
+
+def seam_window(row, col, rows, cols, overlap, seam):
+    # pixels [x0, x1) x [y0, y1) this tile exposes
+    if seam == 'none':
+        return 0, 0, WIDTH, HEIGHT
+    half, rest = overlap // 2, overlap - overlap // 2
+    return (half if col > 0 else 0, half if row > 0 else 0,
+            WIDTH - rest if col < cols - 1 else WIDTH, HEIGHT - rest if row < rows - 1 else HEIGHT)
+
+
+def compile_tile(job):
+    # one tile of one layer; returns its metadata and DLPF frame (None if it's in the cache)
+    name, row, col, origin, window, settings = job
+    vector = gerber_to_vector.compile_field(_layers[name], origin, settings['pitch'], settings['negative'])
+    key = hashlib.sha256(repr((CACHE_VERSION, settings['bpp'], window)).encode() + vector).hexdigest()[:24]
+    path = os.path.join(settings['cache'], key + '.dlpf')
+
+    _, _, records = dlpvector.decode(vector)
+    info = {'layer': name, 'row': row, 'col': col, 'origin_mm': [round(v, 6) for v in origin],
+            'primitives': sum(len(p) for _, p in records), 'hash': key}
+    if os.path.exists(path):
+        info['cached'] = True
+        return info
+
+    raster = dlpvector.reference(vector, settings['bpp'])
+    x0, y0, x1, y1 = window
+    mask = np.zeros_like(raster, dtype=bool)
+    mask[y0:y1, x0:x1] = True
+    raster[~mask] = 0
+    frame = dlpframe.encode(raster, settings['bpp'])
+
+    temporary = path + '.%d' % os.getpid()
+    with open(temporary, 'wb') as f:
+        f.write(frame)
+    os.replace(temporary, path)  # other runs may share the cache
+    info['cached'] = False
+    return info
+
+
+def _init_worker(layers):
+    _layers.update(layers)
+
+
+def build_plan(files, pitch_um, overlap, seam, bpp, negative, jobs, cache, outdir):
+    pitch = pitch_um / 1000
+    timing = {}
+    start = time.perf_counter()
+    with multiprocessing.Pool(jobs) as pool:
+        layers = dict(pool.map(parse_layer, [(path, pitch) for path in files]))
+    timing['parse'] = time.perf_counter() - start
+
+    # one grid over all layers, so that they stay in register
+    boxes = [gerber.bounds(layer) for layer in layers.values()]
+    bounds = (min(b[0] for b in boxes), min(b[1] for b in boxes), max(b[2] for b in boxes), max(b[3] for b in boxes))
+    rows, cols, grid = tile_grid(bounds, pitch, overlap)
+
+    os.makedirs(cache, exist_ok=True)
+    settings = {'pitch': pitch, 'negative': negative, 'bpp': bpp, 'cache': cache}
+    work = [(name, r, c, origin, seam_window(r, c, rows, cols, overlap, seam), settings)
+            for name in sorted(layers) for r, c, origin in grid]
+
+    start = time.perf_counter()
+    with multiprocessing.Pool(jobs, initializer=_init_worker, initargs=(layers,)) as pool:
+        tiles = pool.map(compile_tile, work, chunksize=1)
+    timing['tiles'] = time.perf_counter() - start
+
+    first = grid[0][2]
+    for tile in tiles:
+        layer_dir = os.path.join(outdir, tile['layer'])
+        os.makedirs(layer_dir, exist_ok=True)
+        tile['file'] = os.path.join(tile['layer'], 'r%dc%d.dlpf' % (tile['row'], tile['col']))
+        shutil.copyfile(os.path.join(cache, tile['hash'] + '.dlpf'), os.path.join(outdir, tile['file']))
+        tile['bytes'] = os.path.getsize(os.path.join(outdir, tile['file']))
+        tile['stage_mm'] = [round(tile['origin_mm'][0] - first[0], 6), round(tile['origin_mm'][1] - first[1], 6)]
+
+    plan = {'pitch_um': pitch_um, 'field': [WIDTH, HEIGHT], 'overlap_px': overlap, 'seam': seam, 'bpp': bpp,
+            'negative': negative, 'bounds_mm': [round(v, 6) for v in bounds], 'grid': [rows, cols], 'tiles': tiles}
+    with open(os.path.join(outdir, 'plan.json'), 'w') as f:
+        json.dump(plan, f, indent=1)
+    return plan, timing
+
+
+def summary(plan, timing, jobs):
+    tiles = plan['tiles']
+    built = sum(1 for t in tiles if not t['cached'])
+    print("%d layers, %dx%d tiles each: %d tiles, %d rasterised, %d from the cache, %d kB of frames" % (
+        len(set(t['layer'] for t in tiles)), plan['grid'][0], plan['grid'][1], len(tiles), built,
+        len(tiles) - built, sum(t['bytes'] for t in tiles) // 1024))
+    print("%d processes: parsing %.2f s, tiles %.2f s (%.1f tiles/s)" % (
+        jobs, timing['parse'], timing['tiles'], len(tiles) / max(timing['tiles'], 1e-9)))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Compile Gerber layers into tiled DLPF frames for step and repeat")
+    parser.add_argument("files", type=str, nargs='+', help="Gerber files (or glob patterns)")
+    parser.add_argument("--pitch", type=float, default=80.0, help="um per DMD pixel on the substrate")
+    parser.add_argument("--overlap", type=int, default=32, help="pixels shared by neighbouring tiles")
+    parser.add_argument("--seam", choices=['middle', 'none'], default='middle',
+                        help="middle: each tile exposes its half of the overlap; none: both expose all of it")
+    parser.add_argument("--bpp", type=int, default=1, choices=[1, 2], help="bits per pixel of the framebuffer")
+    parser.add_argument("--negative", action="store_true", help="expose everything except the artwork")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="worker processes (default: all cores)")
+    parser.add_argument("--cache", type=str, default=None, help="tile cache directory")
+    parser.add_argument("--outdir", type=str, default='plan', help="output directory")
+    parser.add_argument("--bench", action="store_true", help="compare one process, all cores and a warm cache")
+
+    args = parser.parse_args()
+    files = sorted(set(f for pattern in args.files for f in (glob.glob(pattern) or [pattern])))
+    cache = args.cache or os.path.join(args.outdir, '.tile_cache')
+
+    if args.bench:
+        with tempfile.TemporaryDirectory() as cold:
+            for label, jobs, cache_dir in (("1 process, cold cache", 1, os.path.join(cold, 'a')),
+                                           ("all cores, cold cache", args.jobs, os.path.join(cold, 'b')),
+                                           ("all cores, warm cache", args.jobs, os.path.join(cold, 'b'))):
+                start = time.perf_counter()
+                plan, timing = build_plan(files, args.pitch, args.overlap, args.seam, args.bpp, args.negative,
+                                          jobs, cache_dir, args.outdir)
+                print("-- %s: %.2f s" % (label, time.perf_counter() - start))
+                summary(plan, timing, jobs)
+    else:
+        plan, timing = build_plan(files, args.pitch, args.overlap, args.seam, args.bpp, args.negative,
+                                  args.jobs, cache, args.outdir)
+        summary(plan, timing, args.jobs)
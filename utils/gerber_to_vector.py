@@ -0,0 +1,117 @@
+import tifffile as tif
+import numpy as np
+import argparse
+import time
+import os
+import sys
+
+import dlpframe
+import dlpvector
+import gerber
+
+# Compile a Gerber layer (e.g. PCB/production/*.gbr) into a DLPV display list that the pico
+# rasterises itself (see src/vector.h), instead of shipping a full raster per exposure:
+#
+#   python gerber_to_vector.py ../PCB/production/micromirror-board-controller-F_Cu.gbr --check
+#
+# The board is mapped onto the 1280x720 field at --pitch (um per DMD pixel on the substrate),
+# with the top left corner of the board (or --origin, in Gerber mm) in the top left corner of
+# the field. Whatever does not fit is cut off.
+#
+# --check rasterises the list twice: with a port of the firmware's scanline rasteriser and with
+# a per-pixel reference, and exits with 1 if more than --tolerance of the covered pixels differ
+# (only pixels whose centre sits right on an edge should), or if a line has more primitives or
+# polygon edges than the firmware keeps track of. The port's speed is printed as lines/ms; the
+# pico prints its own figure when it rasterises an uploaded list.
+#
+# --reference writes the reference raster as <name>_reference.raw (the packed rows of the
+# field at --bpp, as in the framebuffer), for checking vector.c itself on the host:
+#
+#   build-host/dlp_vector_check <name>.dlpv <name>_reference.raw
+
+STAGING_SIZE = {1: 96 * 1024, 2: 16 * 1024}   # src/staging.h, by framebuffer bit depth
+
+
+def compile_field(layers, origin, pitch, negative=False, width=dlpframe.WIDTH, height=dlpframe.HEIGHT):
+    # parsed Gerber layers -> DLPV display list of the field whose top left corner is at <origin>
+    if negative:
+        # expose everything but the artwork: a full field first, then every layer inverted
+        layers = [(True, [('rect', origin[0], origin[1] - height * pitch, origin[0] + width * pitch, origin[1])])] + \
+                 [(not dark, primitives) for dark, primitives in layers]
+    records = dlpvector.from_gerber(layers, origin, pitch, width, height)
+    return dlpvector.encode(records, width, height)
+
+
+def compile_layer(path, pitch_um, origin=None, negative=False, width=dlpframe.WIDTH, height=dlpframe.HEIGHT):
+    pitch = pitch_um / 1000
+    layers = gerber.parse(path, arc_tolerance=pitch / 8)
+    if origin is None:
+        xmin, _, _, ymax = gerber.bounds(layers)
+        origin = (xmin, ymax)
+    return compile_field(layers, origin, pitch, negative, width, height), origin
+
+
+def check(data, bpp, tolerance):
+    stats = {}
+    start = time.perf_counter()
+    raster = dlpvector.rasterise(data, bpp, stats)
+    elapsed = time.perf_counter() - start
+    expected = dlpvector.reference(data, bpp)
+
+    differ = int(np.count_nonzero(raster != expected))
+    covered = max(1, int(np.count_nonzero(expected)))
+    print("scanline port: %.1f lines/ms; up to %d primitives and %d polygon edges on a line (firmware: %d, %d)" % (
+        raster.shape[0] / elapsed / 1e3, stats['max_active'], stats['max_edges'],
+        dlpvector.MAX_ACTIVE, dlpvector.MAX_EDGES))
+    print("reference: %d of %d covered pixels differ (%.4f%%)" % (differ, covered, 100.0 * differ / covered))
+    ok = stats['dropped'] == 0 and differ <= tolerance * covered
+    if stats['dropped']:
+        print("ERROR: %d primitives or edges would be dropped on the pico" % stats['dropped'])
+    return raster, ok
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Compile a Gerber layer into a DLPV display list")
+    parser.add_argument("file", type=str, help="Gerber file")
+    parser.add_argument("--pitch", type=float, default=80.0, help="um per DMD pixel on the substrate")
+    parser.add_argument("--origin", type=float, nargs=2, default=None, help="Gerber X Y (mm) of the top left pixel")
+    parser.add_argument("--negative", action="store_true", help="expose everything except the artwork")
+    parser.add_argument("--bpp", type=int, default=1, choices=[1, 2], help="bits per pixel of the framebuffer")
+    parser.add_argument("--check", action="store_true", help="compare with the reference raster, exit with 1 on mismatch")
+    parser.add_argument("--tolerance", type=float, default=0.001, help="share of covered pixels allowed to differ")
+    parser.add_argument("--reference", action="store_true", help="also write the reference raster as packed rows")
+    parser.add_argument("--tif", action="store_true", help="also write the rasterised field as a tif")
+    parser.add_argument("--outdir", type=str, default=None, help="output directory (default: next to input)")
+
+    args = parser.parse_args()
+    start = time.perf_counter()
+    data, origin = compile_layer(args.file, args.pitch, args.origin, args.negative)
+    compile_time = time.perf_counter() - start
+
+    _, _, layers = dlpvector.decode(data)
+    raw = dlpframe.HEIGHT * dlpframe.WIDTH * args.bpp // 8
+    print("%s: %d primitives in %d layers, %d bytes (%.1fx smaller than the raw frame), origin %.3f %.3f mm, %.2f s" % (
+        os.path.basename(args.file), sum(len(p) for _, p in layers), len(layers), len(data), raw / len(data),
+        origin[0], origin[1], compile_time))
+    if len(data) > STAGING_SIZE.get(args.bpp, 0):
+        print("WARNING: larger than the pico's staging area (%d bytes with a %d-bit framebuffer)" % (
+            STAGING_SIZE.get(args.bpp, 0), args.bpp))
+
+    filename_base = os.path.splitext(os.path.basename(args.file))[0]
+    outdir = args.outdir or os.path.dirname(args.file)
+    with open(os.path.join(outdir, filename_base + '.dlpv'), 'wb') as f:
+        f.write(data)
+
+    if args.reference:
+        expected = dlpvector.reference(data, args.bpp)
+        with open(os.path.join(outdir, filename_base + '_reference.raw'), 'wb') as f:
+            f.write(dlpframe.pack(expected, args.bpp).tobytes())
+
+    ok = True
+    if args.check or args.tif:
+        raster, ok = check(data, args.bpp, args.tolerance)
+        if args.tif:
+            tif.imwrite(os.path.join(outdir, filename_base + '_vector.tif'),
+                        (raster.astype(np.uint16) * 255 // ((1 << args.bpp) - 1)).astype(np.uint8))
+    if args.check:
+        sys.exit(0 if ok else 1)
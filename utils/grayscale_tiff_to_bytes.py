@@ -1,75 +1,159 @@
 import tifffile as tif
 import numpy as np
 import argparse
+import time
 import os
-
-# code assumes the input image is an 8-bit grayscale tiff file with only two values: 0 and 255.
-# and dimensions 720x1280
-# you can achieve this in imageJ/Fiji (https://imagej.net/software/fiji/downloads) 
-# with the following operations from an image:
-# * IMAGE > COLOR > RGB TO LUMINANCE
-# * PROCESS > BINARY > MAKE BINARY 
-
-def format_into_binary(row):
-    # e.g. [0, 1, 2, 2] -> 0b10100100
-    x = sum(map(lambda x: x[1] << x[0]*2, enumerate(row)))
-    return bin(x)
-
-
-def format_into_hex(row):
-    # e.g. [0, 3, 3, 2] -> 0b10111100
-    x = sum(map(lambda x: x[1] << x[0]*2, enumerate(row)))
-    return hex(x)
-
-
-def make_image_byte_array_string(filepath, do_binary=False, skipimage=False):
-
-    filename_base = os.path.splitext(os.path.basename(filepath))[0] 
-
-    with tif.TiffFile(filepath) as image: # "open_mla_logo_sample_image.tif"
-        pixelarray = image.asarray()
-        assert pixelarray.shape == (720, 1280)  #  check that the image is the correct size
-
-        # now we will split the pixel intensities into 4 regions
-        # namely: [0, 63], [64, 127] [128, 191] [192,255] with values 0, 1, 2, 3 (2-bit)
-        pixelarray_discrete = np.floor(pixelarray/256*4).astype(int)
-
-        if not skipimage:  # save the discretised version of array to disk, so you can inspect it
-            tif.imwrite(filename_base+"_discretised.tif", pixelarray_discrete*256/4, photometric='minisblack')
-
-        linear_array = pixelarray_discrete.reshape((720*1280, 1))  # make into linear array row by row
-
-        assert np.amax(linear_array) <= 3  # just some sanity checks 
-        assert np.amin(linear_array) >= 0  # just some sanity checks 
-                
-        # split into bytes, which means blocks of 4 pixels, as each pixel has 2-bit values 
-        pixel_array_per_4 = linear_array.reshape((int(720*1280/4), 4))   
-
-        # now make that into a c array string.
-        if do_binary:
-            byte_string_list = [format_into_binary(row) for row in pixel_array_per_4]
+import re
+from concurrent.futures import ProcessPoolExecutor
+
+import dlpframe
+import frame_library
+
+# Convert 8-bit 720x1280 grayscale tiffs into frames for the pico, whole directories at a time:
+#
+#   python grayscale_tiff_to_bytes.py masks/ --bpp 2 --dither floyd-steinberg --format bin --outdir out
+#
+# Every image is quantised to --bpp bits (plain thresholds into 2**bpp bins, or with ordered or
+# Floyd-Steinberg dithering), packed in the firmware's order (see src/framebuffer.h) and written as
+#   bin   the packed frame as it sits in DLP_data_array (upload it, or flash it)
+#   h     a C header with the packed frame as a static const array
+#   txt   the comma separated hex list to paste into test_image.c (the old output)
+#   dlpf  a compressed DLPF frame (see src/frame_codec.h)
+#   uf2   all frames together as one flash frame library (library.uf2, see frame_library.py)
+# Images are converted in parallel (--jobs), and for every frame the time spent reading,
+# quantising, packing and writing is printed. Every frame is read back from what was written
+# and checked pixel by pixel against the image, with the pixel positions worked out
+# independently of dlpframe.pack(), so a change to the packing order shows up right away.
+# --preview also writes the quantised image as a tif to look at.
+
+FORMATS = ['bin', 'h', 'txt', 'dlpf', 'uf2']
+
+
+def find_images(paths):
+    files = []
+    for path in paths:
+        if os.path.isdir(path):
+            for root, _, names in os.walk(path):
+                files += [os.path.join(root, name) for name in sorted(names)
+                          if os.path.splitext(name)[1].lower() in ('.tif', '.tiff')]
         else:
-            byte_string_list = [format_into_hex(row) for row in pixel_array_per_4]
-
-        print(byte_string_list[:10])  # preview some bytes 
-        assert len(byte_string_list) == 720*1280 / 4  # check that we have 4 pixels per byte
+            files.append(path)
+    return files
+
+
+def pixel_of_packed(packed, bpp, cols):
+    # the firmware's view of a packed row: pixel x is bits [x*bpp, (x+1)*bpp) counted from bit 0
+    # of the first byte, i.e. byte x*bpp // 8, shifted right by x*bpp % 8
+    bit = np.arange(cols) * bpp
+    return (packed[:, bit // 8] >> (bit % 8).astype(np.uint8)) & ((1 << bpp) - 1)
+
+
+def round_trip(levels, bpp, kind, data):
+    # read a written frame back; true if it holds exactly <levels>
+    if kind == 'dlpf':
+        decoded_bpp, decoded = dlpframe.decode(data)
+        return decoded_bpp == bpp and np.array_equal(decoded, levels)
+    if kind in ('txt', 'h'):
+        text = data.decode()
+        if kind == 'h':
+            text = text.split('{', 1)[1].split('}', 1)[0]
+        data = bytes.fromhex(text.replace('0x', '').replace(',', ''))
+    rows, cols = levels.shape
+    packed = np.frombuffer(data, dtype=np.uint8).reshape(rows, -1)
+    return np.array_equal(pixel_of_packed(packed, bpp, cols), levels)
+
+
+def convert(path, bpp, dither, kind, outdir, preview):
+    # -> (name, frame data or None, timings in s, ok)
+    name = os.path.splitext(os.path.basename(path))[0]
+    outdir = outdir or os.path.dirname(path)
+    times = {}
+
+    start = time.perf_counter()
+    pixelarray = tif.imread(path)
+    if pixelarray.shape != (dlpframe.HEIGHT, dlpframe.WIDTH):
+        raise SystemExit("%s: %s pixels, expected %dx%d" % (path, pixelarray.shape, dlpframe.HEIGHT, dlpframe.WIDTH))
+    times['read'] = time.perf_counter() - start
+
+    start = time.perf_counter()
+    levels = dlpframe.DITHER[dither](pixelarray, bpp)
+    times['quantise'] = time.perf_counter() - start
+
+    start = time.perf_counter()
+    if kind == 'dlpf':
+        data = dlpframe.encode(levels, bpp)
+    else:
+        data = dlpframe.pack(levels, bpp).tobytes()
+    if kind == 'h':
+        data = dlpframe.c_header(re.sub(r'\W', '_', 'frame_' + name), data).encode()
+    elif kind == 'txt':
+        data = ','.join(dlpframe.HEX_BYTES[np.frombuffer(data, dtype=np.uint8)]).encode()
+    times['pack'] = time.perf_counter() - start
+
+    start = time.perf_counter()
+    if kind != 'uf2':
+        with open(os.path.join(outdir, name + '.' + kind), 'wb') as f:
+            f.write(data)
+    if preview:
+        scale = 255 // ((1 << bpp) - 1)
+        tif.imwrite(os.path.join(outdir, name + '_discretised.tif'), (levels * scale).astype(np.uint8),
+                    photometric='minisblack')
+    times['write'] = time.perf_counter() - start
+
+    start = time.perf_counter()
+    ok = round_trip(levels, bpp, kind, data)
+    times['check'] = time.perf_counter() - start
+    return name, data if kind == 'uf2' else None, times, ok
 
-        # and now make that list of hex or binary into something that we can copy paste.
-        byte_string_array = ','.join(byte_string_list)
 
-        # and write the result to a text file that we can copy paste from.
-        # should probably be a binary file but this is fine for now.
-        with open(filename_base+'.txt', 'w') as f:
-            f.write(byte_string_array)
-    
-    
 if __name__ == "__main__":
-    # example: python grayscale_tiff_to_bytes.py --file "open_mla_logo_sample_image.tif"
-
-    parser = argparse.ArgumentParser(description="Turn 8-bit 720x1280 tif into pasteable array string")
-    parser.add_argument("--file", type=str, help="filename of image. Must be grayscale TIF.")
-    parser.add_argument("--binary", action='store_true', help="use binary format for byte instead of hex")
-    parser.add_argument("--skipimage", action='store_true', help="do not write the discretised image to disk for inspection.")
+    parser = argparse.ArgumentParser(description="Convert 8-bit 720x1280 tifs into packed frames for the pico")
+    parser.add_argument("paths", type=str, nargs='*', help="grayscale TIF files, or directories of them")
+    parser.add_argument("--file", type=str, action='append', default=[], help="(as a path; for old scripts)")
+    parser.add_argument("--bpp", type=int, default=2, choices=[1, 2, 4, 8], help="bits per pixel of the frame")
+    parser.add_argument("--dither", type=str, default='none', choices=sorted(dlpframe.DITHER),
+                        help="none: plain thresholds; ordered: 8x8 Bayer; floyd-steinberg: error diffusion")
+    parser.add_argument("--format", type=str, default='bin', choices=FORMATS, help="what to write (see above)")
+    parser.add_argument("--outdir", type=str, default=None, help="output directory (default: next to the input)")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="images converted at once")
+    parser.add_argument("--preview", action='store_true', help="also write the quantised image as a tif")
+    parser.add_argument("--offset", type=lambda v: int(v, 0), default=0x100000,
+                        help="flash offset of the frame library (uf2)")
 
     args = parser.parse_args()
-    make_image_byte_array_string(args.file, args.binary, args.skipimage)
\ No newline at end of file
+    files = find_images(args.paths + args.file)
+    if not files:
+        raise SystemExit("no images given")
+    if args.outdir:
+        os.makedirs(args.outdir, exist_ok=True)
+
+    start = time.perf_counter()
+    with ProcessPoolExecutor(max_workers=max(args.jobs, 1)) as pool:
+        results = list(pool.map(convert, files, [args.bpp] * len(files), [args.dither] * len(files),
+                                [args.format] * len(files), [args.outdir] * len(files), [args.preview] * len(files)))
+    elapsed = time.perf_counter() - start
+
+    failed = 0
+    for path, (name, _, times, ok) in zip(files, results):
+        total = sum(times.values())
+        print("%-32s read %6.1f  quantise %6.1f  pack %6.1f  write %6.1f  check %6.1f ms  %6.1f Mpixel/s%s" % (
+            name[:32], times['read'] * 1000, times['quantise'] * 1000, times['pack'] * 1000, times['write'] * 1000,
+            times['check'] * 1000, dlpframe.WIDTH * dlpframe.HEIGHT / total / 1e6,
+            '' if ok else '  ROUND TRIP MISMATCH'))
+        failed += not ok
+
+    if args.format == 'uf2':
+        frames = [(name, frame_library.FORMAT_RAW, args.bpp, dlpframe.HEIGHT, data) for name, data, _, _ in results]
+        image = frame_library.build(frames)
+        path = os.path.join(args.outdir or '.', 'library.uf2')
+        uf2 = frame_library.to_uf2(image, frame_library.XIP_BASE + args.offset)
+        with open(path, 'wb') as f:
+            f.write(uf2)
+        library = frame_library.parse(frame_library.from_uf2(uf2))
+        failed += sum(not entry['ok'] for entry in library)
+        print("%s: %d frames, %d bytes at 0x%x" % (path, len(frames), len(image), args.offset))
+
+    print("%d frames in %.2f s with %d jobs: %.1f frames/s, %d round trip failures" % (
+        len(files), elapsed, args.jobs, len(files) / elapsed, failed))
+    if failed:
+        raise SystemExit(1)
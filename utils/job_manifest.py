@@ -0,0 +1,110 @@
+import argparse
+import struct
+import csv
+
+import frame_library
+
+# Write a DLPJ job manifest (see src/job.h): the layers of a job, each a frame of the flash frame
+# library with its own exposure time, LED PWM and dark frames, which the pico exposes back to
+# back once the manifest has been uploaded:
+#
+#   python job_manifest.py --frames 0-299 --exposure 2.5 --pwm 180 --dark 1 --out job.dlpj
+#   python usb_frame_upload.py job.dlpj --port /dev/ttyACM0
+#
+# --layers reads the layers from a CSV file instead, one per line: frame index, exposure (s),
+# pwm, dark frames (a header line is skipped). With --library (the .uf2 or .bin written by
+# frame_library.py) every frame is checked against the library and the layers are listed with
+# how the pico prepares each of them while the one before is exposing: raw frames are scanned
+# out of flash, a DLPF frame after a raw one is decoded into the framebuffer ahead, other DLPF
+# frames are copied into the staging area behind the manifest if they fit there, and are
+# decoded from flash after the STOP otherwise.
+
+JOB_VERSION = 1
+HEADER_SIZE = 16
+RECORD = struct.Struct('<HHIHH')   # frame, pwm, duration_us, dark_frames, reserved
+STAGING_SIZE = {1: 96 * 1024, 2: 16 * 1024}   # src/staging.h, by framebuffer bit depth
+
+
+def parse_range(text):
+    # "0-3,7,9-10" -> [0, 1, 2, 3, 7, 9, 10]
+    frames = []
+    for part in text.split(','):
+        first, _, last = part.partition('-')
+        frames += range(int(first), int(last or first) + 1)
+    return frames
+
+
+def read_layers(path):
+    layers = []
+    with open(path, newline='') as f:
+        for row in csv.reader(f):
+            if not row or not row[0].strip().isdigit():
+                continue  # header or empty line
+            frame, exposure, pwm, dark = (row + ['0'] * 4)[:4]
+            layers.append((int(frame), float(exposure), int(pwm), int(dark or 0)))
+    return layers
+
+
+def build(layers):
+    # layers: list of (frame, exposure_s, pwm, dark_frames) -> manifest
+    payload = b''.join(RECORD.pack(frame, pwm, int(round(exposure * 1e6)), dark, 0)
+                       for frame, exposure, pwm, dark in layers)
+    return struct.pack('<4sBBHII', b'DLPJ', JOB_VERSION, 0, len(layers), 0, len(payload)) + payload
+
+
+def plan(layers, entries, manifest_length, staging_size):
+    # how each layer is prepared, as job_poll() does it; raises ValueError for a missing frame
+    room = staging_size - (manifest_length + 3) // 4 * 4
+    previous_raw = False
+    for index, (frame, exposure, pwm, dark) in enumerate(layers):
+        if frame >= len(entries):
+            raise ValueError("layer %d: there is no frame %d in the library" % (index, frame))
+        entry = entries[frame]
+        if entry['format'] == frame_library.FORMAT_RAW:
+            how = "scanned out of flash"
+        elif previous_raw:
+            how = "decoded ahead into the framebuffer"
+        elif entry['length'] <= room:
+            how = "copied ahead into RAM, decoded after the STOP"
+        else:
+            how = "decoded from flash after the STOP (%d bytes, %d of room)" % (entry['length'], max(room, 0))
+        yield index, entry, how
+        previous_raw = entry['format'] == frame_library.FORMAT_RAW
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Write a job manifest: layers of the flash frame library")
+    parser.add_argument("--frames", type=str, default=None, help="frame indices, e.g. 0-299 or 0,2,4-9")
+    parser.add_argument("--layers", type=str, default=None, help="CSV: frame, exposure (s), pwm, dark frames")
+    parser.add_argument("--exposure", type=float, default=2.0, help="seconds per layer (with --frames)")
+    parser.add_argument("--pwm", type=int, default=0xB4, help="LED PWM per layer, 10 bit (with --frames)")
+    parser.add_argument("--dark", type=int, default=0, help="dark frames before each layer (with --frames)")
+    parser.add_argument("--library", type=str, default=None, help="frame library (.uf2 or .bin) to check against")
+    parser.add_argument("--bpp", type=int, default=2, choices=[1, 2], help="framebuffer bit depth of the firmware")
+    parser.add_argument("--out", type=str, default='job.dlpj', help="output file")
+
+    args = parser.parse_args()
+    if (args.frames is None) == (args.layers is None):
+        parser.error("give either --frames or --layers")
+    if args.layers:
+        layers = read_layers(args.layers)
+    else:
+        layers = [(frame, args.exposure, args.pwm, args.dark) for frame in parse_range(args.frames)]
+    manifest = build(layers)
+
+    if args.library:
+        data = open(args.library, 'rb').read()
+        image = frame_library.from_uf2(data) if args.library.lower().endswith('.uf2') else data
+        entries = frame_library.parse(image)
+        try:
+            for index, entry, how in plan(layers, entries, len(manifest), STAGING_SIZE[args.bpp]):
+                print("%4d %-16s %s" % (index, entry['name'], how))
+        except ValueError as error:
+            raise SystemExit("ERROR: %s" % error)
+    if len(manifest) > STAGING_SIZE[args.bpp]:
+        raise SystemExit("ERROR: %d layers do not fit in the staging area" % len(layers))
+
+    total = sum(exposure for _, exposure, _, _ in layers)
+    print("%d layers, %.1f s of exposure, %d byte manifest" % (len(layers), total, len(manifest)))
+    with open(args.out, 'wb') as f:
+        f.write(manifest)
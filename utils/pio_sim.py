@@ -0,0 +1,744 @@
+import numpy as np
+import argparse
+import collections
+import re
+import os
+import sys
+
+import dlpframe
+
+# Cycle-accurate simulation of the video timing state machines (src/hsync.pio, vsync.pio,
+# pxl.pio and pxl_clk.pio) together with the DMA that feeds the pxl TX FIFO, so timing changes
+# can be checked without a scope:
+#
+#   python pio_sim.py                       # the firmware's checkerboard, two frames
+#   python pio_sim.py --image logo.tif --lines 40 --vcd start.vcd
+#
+# The programs are read straight from the .pio files and the counters/pins from the firmware
+# sources. The resulting HSYNC/VSYNC/DATAEN/PCLK/PDATA waveforms are decoded the way the DLPC
+# would (PDATA sampled on the rising PCLK edge while DATAEN is high), the frame is rebuilt and
+# compared with the buffer that was DMA'd out, and the line/frame timing, blanking overhead
+# and the headroom for a faster pixel clock are reported. Exits with 1 on a mismatch.
+# --roi scans out only a window of the frame the way a DLP_ROI build does (blank lines from a
+# shared zero line, the window's rows through the line ring) and checks that the frame on the
+# pins is the window on a blank frame. --tile repeats a tile over the frame with the DMA ring
+# wraps of a DLP_TILE build, and checks the frame on the pins and that the pattern holds still
+# from frame to frame. --dma-latency delays every DMA write into the FIFO by that many sys
+# cycles (with the writes in flight still holding their FIFO slot), and the report shows how
+# low the FIFO ran; a latency the FIFO can't cover shows up as a mismatch.
+#
+# Supports the subset of PIO the firmware uses: jmp (all conditions), wait (gpio/pin/irq), in,
+# out, push/pull (block), mov (no operations), irq set/wait/clear, set and nop, with delays,
+# optional side-set and .wrap. IRQ flags and FIFO pushes set in a cycle are visible to the
+# other state machines from the next cycle on, as in the hardware.
+
+SRC = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'src')
+FIFO_DEPTH = 4
+
+
+def frame_period_us(sys_mhz, pio_div=1, front_porch=0, defines=None):
+    # scan-out frame period of a clock plan, as clock_plan.c works it out: VIDEO_FRAME_LINES
+    # lines of VIDEO_LINE_PCLK periods of VIDEO_PCLK_DIV * <pio_div> sys cycles each
+    defines = defines or firmware_defines()
+    line_pclk = defines['VIDEO_H_COUNTER'] + front_porch + 1 + defines['VIDEO_H_BLANK']
+    return defines['VIDEO_PCLK_DIV'] * pio_div * line_pclk * defines['VIDEO_FRAME_LINES'] / sys_mhz
+
+
+def firmware_defines():
+    # integer #defines from the firmware sources (timing counters, pin numbers, ...), including
+    # the ones that are arithmetic on other defines, like those in video_mode.h
+    expressions = {}
+    for name in sorted(os.listdir(SRC)):
+        if name.endswith(('.c', '.h')):
+            for match in re.finditer(r'^#define\s+(\w+)[ \t]+([^\n]+)$', open(os.path.join(SRC, name)).read(), re.M):
+                expressions.setdefault(match.group(1), match.group(2).split('//')[0].strip())
+
+    defines = {}
+    while True:
+        added = False
+        for name, expression in expressions.items():
+            if name in defines or not re.fullmatch(r'[\w\s()+\-*/]+', expression):
+                continue
+            try:
+                value = eval(expression.replace('/', '//'), {'__builtins__': {}}, dict(defines))
+            except (NameError, SyntaxError, TypeError):
+                continue  # depends on something not (yet) known
+            if isinstance(value, int):
+                defines[name] = value
+                added = True
+        if not added:
+            return defines
+
+
+class Program:
+    # minimal assembler for the .pio syntax the firmware uses
+    def __init__(self, path, name=None):
+        self.instructions = []    # (op, args, side, delay)
+        self.labels = {}
+        self.side_bits = 0
+        self.side_opt = False
+        self.wrap_target = 0
+        self.wrap = None
+        self.name = name
+
+        pending = []
+        active = False
+        for raw in open(path):
+            line = raw.split(';')[0].split('//')[0].strip()
+            if line.startswith('%'):
+                active = False  # c-sdk block
+                continue
+            if line.startswith('.program'):
+                active = name is None or line.split()[1] == name
+                self.name = self.name or line.split()[1]
+                continue
+            if not active or not line:
+                continue
+            if line.startswith('.side_set'):
+                parts = line.split()
+                self.side_bits, self.side_opt = int(parts[1]), 'opt' in parts
+            elif line == '.wrap_target':
+                self.wrap_target = len(self.instructions)
+            elif line == '.wrap':
+                self.wrap = len(self.instructions) - 1
+            elif line.startswith('.'):
+                continue  # .origin, .define etc. are not used by the firmware
+            elif line.endswith(':'):
+                self.labels[line[:-1].replace('public', '').strip()] = len(self.instructions)
+            else:
+                pending.append(line)
+                self.instructions.append(None)
+
+        if self.wrap is None:
+            self.wrap = len(self.instructions) - 1
+        it = iter(pending)
+        self.instructions = [self.parse(next(it)) for _ in self.instructions]
+
+    def parse(self, text):
+        delay = 0
+        match = re.search(r'\[(\d+)\]', text)
+        if match:
+            delay = int(match.group(1))
+            text = text[:match.start()] + text[match.end():]
+        side = None
+        match = re.search(r'\bside\s+(\d+)', text)
+        if match:
+            side = int(match.group(1))
+            text = text[:match.start()] + text[match.end():]
+        words = text.replace(',', ' ').split()
+        op, args = words[0], words[1:]
+        if op == 'nop':
+            op, args = 'mov', ['y', 'y']
+        delay_bits = 5 - self.side_bits - (1 if self.side_opt else 0)
+        assert delay < (1 << delay_bits), "delay [%d] does not fit next to the side-set in %s" % (delay, text)
+        return op, args, side, delay
+
+    def target(self, label):
+        return self.labels[label] if label in self.labels else int(label)
+
+
+class StateMachine:
+    def __init__(self, program, clkdiv=1, set_pins=None, out_pins=None, in_base=0, sideset_base=None,
+                 out_shift_right=True, autopull=False, pull_threshold=32,
+                 in_shift_right=True, autopush=False, push_threshold=32):
+        self.program = program
+        self.clkdiv = clkdiv
+        self.set_pins = set_pins       # (base, count)
+        self.out_pins = out_pins
+        self.in_base = in_base
+        self.sideset_base = sideset_base
+        self.out_shift_right, self.autopull, self.pull_threshold = out_shift_right, autopull, pull_threshold
+        self.in_shift_right, self.autopush, self.push_threshold = in_shift_right, autopush, push_threshold
+        self.tx = []                   # TX FIFO
+        self.rx = []
+        self.pc = 0
+        self.x = self.y = 0
+        self.osr = self.isr = 0
+        self.osr_count = 32            # shifted out: OSR starts empty
+        self.isr_count = 0
+        self.next_cycle = 0
+        self.stalled = False
+        self.stall_cycles = 0
+
+    def shift_out(self, count):
+        mask = (1 << count) - 1 if count < 32 else 0xFFFFFFFF
+        if self.out_shift_right:
+            value = self.osr & mask
+            self.osr = (self.osr >> count) if count < 32 else 0
+        else:
+            value = (self.osr >> (32 - count)) & mask
+            self.osr = (self.osr << count) & 0xFFFFFFFF if count < 32 else 0
+        self.osr_count = min(32, self.osr_count + count)
+        return value
+
+    def shift_in(self, value, count):
+        mask = (1 << count) - 1 if count < 32 else 0xFFFFFFFF
+        value &= mask
+        if self.in_shift_right:
+            self.isr = ((self.isr >> count) | (value << (32 - count))) & 0xFFFFFFFF if count < 32 else value
+        else:
+            self.isr = ((self.isr << count) | value) & 0xFFFFFFFF if count < 32 else value
+        self.isr_count = min(32, self.isr_count + count)
+
+
+class Simulator:
+    def __init__(self):
+        self.machines = []
+        self.pins = 0                  # GPIO levels
+        self.irq = 0                   # PIO IRQ flags
+        self.cycle = 0
+        self.watchers = []             # called as watcher(cycle, old_pins, new_pins)
+
+    def add(self, machine):
+        self.machines.append(machine)
+        return machine
+
+    @staticmethod
+    def write_pins(pins, base, count, value):
+        mask = ((1 << count) - 1) << base
+        return (pins & ~mask) | ((value << base) & mask)
+
+    def step(self, sm, effects):
+        # execute (or retry) the instruction at sm.pc; returns False if it stalls
+        op, args, side, delay = sm.program.instructions[sm.pc]
+        program = sm.program
+
+        # side-set happens at the start of the instruction, even if it then stalls
+        if side is not None and sm.sideset_base is not None:
+            effects['pins'].append((sm.sideset_base, program.side_bits, side))
+
+        next_pc = sm.pc + 1 if sm.pc != program.wrap else program.wrap_target
+
+        if op == 'jmp':
+            cond, label = (args[0], args[1]) if len(args) == 2 else (None, args[0])
+            take = True
+            if cond == '!x':
+                take = sm.x == 0
+            elif cond == 'x--':
+                take = sm.x != 0
+                sm.x = (sm.x - 1) & 0xFFFFFFFF
+            elif cond == '!y':
+                take = sm.y == 0
+            elif cond == 'y--':
+                take = sm.y != 0
+                sm.y = (sm.y - 1) & 0xFFFFFFFF
+            elif cond == 'x!=y':
+                take = sm.x != sm.y
+            elif cond == '!osre':
+                take = sm.osr_count < sm.pull_threshold
+            elif cond == 'pin':
+                take = bool(self.pins >> sm.jmp_pin & 1)
+            if take:
+                next_pc = program.target(label)
+
+        elif op == 'wait':
+            polarity, source, index = int(args[0]), args[1], int(args[2])
+            if source == 'irq':
+                if bool(self.irq >> index & 1) != bool(polarity):
+                    return False
+                if polarity:
+                    effects['irq_clear'] |= 1 << index
+            else:
+                gpio = index if source == 'gpio' else sm.in_base + index
+                if (self.pins >> gpio & 1) != polarity:
+                    return False
+
+        elif op == 'irq':
+            mode, index = (args[0], int(args[1])) if len(args) == 2 else ('set', int(args[0]))
+            if mode == 'clear':
+                effects['irq_clear'] |= 1 << index
+            else:
+                effects['irq_set'] |= 1 << index
+                if mode == 'wait':
+                    sm.waiting_irq = index  # not used by the firmware
+
+        elif op == 'pull':
+            block = 'noblock' not in args
+            if sm.autopull and sm.osr_count < sm.pull_threshold:
+                pass  # OSR not yet empty: pull is a no-op with autopull
+            elif sm.tx:
+                sm.osr = sm.tx.pop(0)
+                sm.osr_count = 0
+                effects['pulled'].append(sm)
+            elif block:
+                return False
+            else:
+                sm.osr = sm.x
+                sm.osr_count = 0
+
+        elif op == 'push':
+            if len(sm.rx) >= FIFO_DEPTH:
+                if 'noblock' not in args:
+                    return False
+            else:
+                sm.rx.append(sm.isr)
+            sm.isr, sm.isr_count = 0, 0
+
+        elif op == 'out':
+            dest, count = args[0], int(args[1])
+            if sm.autopull and sm.osr_count >= sm.pull_threshold:
+                if not sm.tx:
+                    return False
+                sm.osr = sm.tx.pop(0)
+                sm.osr_count = 0
+                effects['pulled'].append(sm)
+            value = sm.shift_out(count)
+            if dest == 'pins':
+                base, width = sm.out_pins
+                effects['pins'].append((base, min(count, width), value))
+            elif dest == 'x':
+                sm.x = value
+            elif dest == 'y':
+                sm.y = value
+            elif dest == 'pc':
+                next_pc = value
+            # null: discarded
+
+        elif op == 'in':
+            source, count = args[0], int(args[1])
+            if sm.autopush and sm.isr_count >= sm.push_threshold and len(sm.rx) >= FIFO_DEPTH:
+                return False
+            value = {'pins': self.pins >> sm.in_base, 'x': sm.x, 'y': sm.y, 'osr': sm.osr,
+                     'isr': sm.isr, 'null': 0}[source]
+            sm.shift_in(value, count)
+            if sm.autopush and sm.isr_count >= sm.push_threshold:
+                sm.rx.append(sm.isr)
+                sm.isr, sm.isr_count = 0, 0
+
+        elif op == 'mov':
+            dest, source = args[0], args[1]
+            value = {'x': sm.x, 'y': sm.y, 'osr': sm.osr, 'isr': sm.isr, 'null': 0,
+                     'pins': self.pins >> sm.in_base}[source]
+            if dest == 'x':
+                sm.x = value
+            elif dest == 'y':
+                sm.y = value
+            elif dest == 'osr':
+                sm.osr, sm.osr_count = value, 0
+            elif dest == 'isr':
+                sm.isr, sm.isr_count = value, 0
+            elif dest == 'pins':
+                effects['pins'].append((sm.out_pins[0], sm.out_pins[1], value))
+
+        elif op == 'set':
+            dest, value = args[0], int(args[1], 0)
+            if dest == 'pins':
+                effects['pins'].append((sm.set_pins[0], sm.set_pins[1], value))
+            elif dest == 'x':
+                sm.x = value
+            elif dest == 'y':
+                sm.y = value
+            # pindirs: all pins are outputs already
+
+        else:
+            raise ValueError("unsupported instruction: %s" % op)
+
+        sm.pc = next_pc
+        return delay
+
+    def run(self, until, dma=None):
+        # advance cycle by cycle (skipping cycles in which nothing can happen) until
+        # until(cycle) is true
+        machines = self.machines
+        while not until(self.cycle):
+            cycle = min(sm.next_cycle for sm in machines)
+            if dma is not None and dma.next_cycle < cycle:
+                cycle = dma.next_cycle
+            self.cycle = cycle
+
+            effects = {'pins': [], 'irq_set': 0, 'irq_clear': 0, 'pulled': []}
+            for sm in machines:
+                if sm.next_cycle != cycle:
+                    continue
+                result = self.step(sm, effects)
+                if result is False:
+                    sm.stall_cycles += sm.clkdiv
+                    sm.next_cycle = cycle + sm.clkdiv
+                else:
+                    sm.next_cycle = cycle + (1 + result) * sm.clkdiv
+
+            if dma is not None:
+                dma.service(cycle, effects['pulled'])
+
+            # commit: everything done this cycle becomes visible from the next one
+            self.irq = (self.irq & ~effects['irq_clear']) | effects['irq_set']
+            if effects['pins']:
+                old = self.pins
+                new = old
+                for base, count, value in effects['pins']:
+                    new = self.write_pins(new, base, count, value)
+                if new != old:
+                    self.pins = new
+                    for watcher in self.watchers:
+                        watcher(cycle, old, new)
+            self.cycle = cycle + 1 if all(sm.next_cycle > cycle for sm in machines) else cycle
+
+
+class Dma:
+    # channel 0 (<size> byte transfers paced by the pxl TX FIFO DREQ) plus the channel 1 reload.
+    # At most one transfer is issued per cycle and lands in the FIFO <latency> cycles later; like
+    # the DMA's DREQ counter, transfers still in flight count against the free FIFO slots.
+    # <reload> extra cycles every <block> bytes (a frame, or a line in line ring mode)
+    def __init__(self, sm, data, block, latency=4, reload=8, size=4):
+        assert block % size == 0, "transfers must not straddle a reload"
+        self.sm = sm
+        self.size = size
+        self.data = data
+        self.block = block
+        self.latency = latency
+        self.reload = reload
+        self.position = 0
+        self.in_flight = collections.deque()    # (cycle the write lands, word)
+        self.issue_cycle = 0
+        self.next_cycle = 0
+        self.min_level = FIFO_DEPTH             # FIFO words left after a pull, once it has filled
+        self.filled = False
+        self.transfers = 0
+
+    def service(self, cycle, pulled):
+        if self.sm in pulled and self.filled:
+            self.min_level = min(self.min_level, len(self.sm.tx))
+        if cycle < self.next_cycle:
+            return
+        while self.in_flight and self.in_flight[0][0] <= cycle:
+            self.sm.tx.append(self.in_flight.popleft()[1])
+        self.filled = self.filled or len(self.sm.tx) >= FIFO_DEPTH
+
+        if cycle >= self.issue_cycle:
+            if len(self.sm.tx) + len(self.in_flight) >= FIFO_DEPTH:
+                self.issue_cycle = cycle + 1  # wait for DREQ (a pull frees a slot)
+            else:
+                position = self.position % len(self.data)
+                if self.size == 1:
+                    word = self.data[position] * 0x01010101  # byte writes are replicated over the bus lanes
+                else:
+                    word = int.from_bytes(self.data[position:position + 4], 'little')
+                if self.latency:
+                    self.in_flight.append((cycle + self.latency, word))
+                else:
+                    self.sm.tx.append(word)
+                self.position += self.size
+                self.transfers += 1
+                self.issue_cycle = cycle + 1
+                if self.position % self.block == 0:
+                    self.issue_cycle += self.reload
+        self.next_cycle = min(self.issue_cycle, self.in_flight[0][0]) if self.in_flight else self.issue_cycle
+
+
+class Capture:
+    # decodes the video signals like the DLPC: PDATA sampled on the rising PCLK edge while
+    # DATAEN is high; also keeps edge statistics and an optional VCD trace
+    def __init__(self, pins, bpp, vcd=None, vcd_cycles=0, sys_mhz=200.0):
+        self.pins = pins
+        self.bpp = bpp
+        self.rows = []
+        self.row = []
+        self.edges = {name: [] for name in ('hsync', 'vsync', 'dataen', 'pclk')}
+        self.last_pdata_change = 0
+        self.min_setup = None       # cycles between a PDATA change and the PCLK edge sampling it
+        self.vcd = vcd
+        self.vcd_cycles = vcd_cycles
+        self.cycle_ps = 1e6 / sys_mhz
+        if vcd:
+            self.vcd.write("$timescale 1 ps $end\n$scope module pico $end\n")
+            for code, name in zip('hvdcp', ('HSYNC', 'VSYNC', 'DATAEN', 'PCLK')):
+                self.vcd.write("$var wire 1 %s %s $end\n" % (code, name))
+            self.vcd.write("$var wire 8 x PDATA $end\n$upscope $end\n$enddefinitions $end\n")
+
+    def level(self, value, name):
+        return value >> self.pins[name] & 1
+
+    def __call__(self, cycle, old, new):
+        pdata_shift = self.pins['pdata']
+        if (old ^ new) >> pdata_shift & 0xFF:
+            self.last_pdata_change = cycle
+
+        for name in ('hsync', 'vsync', 'dataen', 'pclk'):
+            before, after = self.level(old, name), self.level(new, name)
+            if before != after:
+                if name != 'pclk':
+                    self.edges[name].append((cycle, after))
+                elif after:
+                    self.edges['pclk'].append(cycle)
+                    if self.level(old, 'dataen'):
+                        # the pins as they were during this cycle (a same-cycle change is too late)
+                        self.row.append((old >> pdata_shift) & ((1 << self.bpp) - 1))
+                        setup = cycle - self.last_pdata_change if self.last_pdata_change != cycle else 0
+                        self.min_setup = setup if self.min_setup is None else min(self.min_setup, setup)
+                if name == 'dataen' and not after and self.row:
+                    self.rows.append(self.row)
+                    self.row = []
+
+        if self.vcd and cycle < self.vcd_cycles:
+            self.vcd.write("#%d\n" % round(cycle * self.cycle_ps))
+            for code, name in zip('hvdcp', ('hsync', 'vsync', 'dataen', 'pclk')):
+                if self.level(old, name) != self.level(new, name):
+                    self.vcd.write("%d%s\n" % (self.level(new, name), code))
+            if (old ^ new) >> pdata_shift & 0xFF:
+                self.vcd.write("b{0:08b} x\n".format((new >> pdata_shift) & 0xFF))
+
+
+def checkerboard(bpp):
+    # the same pattern as checkerboard_PIO() in the firmware, for <bpp> bits per pixel
+    y, x = np.mgrid[0:dlpframe.HEIGHT, 0:dlpframe.WIDTH]
+    return ((x // 160 + y // 80) % (1 << bpp)).astype(np.uint8)
+
+
+def ramp(bpp):
+    # every pixel differs from its neighbours, and the pattern shifts from line to line: any
+    # change in the order the bits, bytes or words go out in shows up
+    y, x = np.mgrid[0:dlpframe.HEIGHT, 0:dlpframe.WIDTH]
+    return ((x + y) % (1 << bpp) ^ (x // (1 << bpp)) % 2).astype(np.uint8)
+
+
+PATTERNS = {'checkerboard': checkerboard, 'ramp': ramp}
+
+
+def window_scanout(window, x, y, bpp, ring_lines):
+    # the lines the DMA streams in the window scan-out (scanout_init_window() in src/scanout.c),
+    # one line per channel 1 reload: its slot pointer is the zero line outside the window, the
+    # window's row if that is a whole line, or otherwise the slot's line buffer with the row
+    # copied in at column <x>. The line buffers go round the ring and only the window's columns
+    # of them are ever written, the margins keep the zeros they were cleared to.
+    line_bytes = dlpframe.WIDTH * bpp // 8
+    rows = dlpframe.pack(window, bpp)
+    x_bytes = x * bpp // 8
+    zero_line = bytes(line_bytes)
+    line_buffers = [bytearray(line_bytes) for _ in range(ring_lines)]
+    lines = []
+    for line in range(dlpframe.HEIGHT):
+        row = line - y
+        if row < 0 or row >= len(rows):
+            lines.append(zero_line)
+        elif rows.shape[1] == line_bytes:
+            lines.append(rows[row].tobytes())
+        else:
+            buffer = line_buffers[line % ring_lines]
+            buffer[x_bytes:x_bytes + rows.shape[1]] = rows[row].tobytes()
+            lines.append(bytes(buffer))
+    return b''.join(lines)
+
+
+def tile_scanout(tile, bpp, frames=2):
+    # the lines the DMA streams in tile mode (scanout_init_tile() in src/scanout.c) over
+    # <frames> frames: for every line channel 1 restarts channel 0 on the next of the tile's
+    # row pointers (a read ring wrap over the table) and channel 0 reads a line's worth of words
+    # from that row, wrapping around it (a read ring wrap over the row). While the last line of
+    # a frame goes out, the interrupt rewinds channel 1 by frame height % tile height rows
+    # (rewind_tile()). Returns the first frame and the tile row sent on every line.
+    rows = dlpframe.pack(tile, bpp)
+    height, row_bytes = rows.shape
+    offsets = np.arange(dlpframe.WIDTH * bpp // 8) % row_bytes
+    row, reload = 0, 1 % height        # channel 0 starts on row 0, channel 1 on entry 1
+    sent = []
+    for line in range(frames * dlpframe.HEIGHT):
+        sent.append(row)
+        row, reload = reload, (reload + 1) % height
+        in_flight = line + 1
+        if in_flight % dlpframe.HEIGHT == dlpframe.HEIGHT - 1 and dlpframe.HEIGHT % height:
+            reload = (reload - dlpframe.HEIGHT % height) % height
+    return b''.join(rows[row, offsets].tobytes() for row in sent[:dlpframe.HEIGHT]), sent
+
+
+def parse_tile(text):
+    # "width,height", as given to cmake -DDLP_TILE
+    width, height = (int(value) for value in text.split(','))
+    return width, height
+
+
+def build(defines, data, bpp, line_ring=False, dma_latency=4, dma_reload=8, pio_div=1, front_porch=0, dma_size=4):
+    # mirrors the *_program_init() functions, video_mode_load() and main() in the firmware, for
+    # a clock plan with a whole video divider <pio_div> and the front porch stretched by
+    # <front_porch> PCLK periods (see src/clock_plan.h)
+    sim = Simulator()
+    sync_div = defines['VIDEO_PCLK_DIV'] * pio_div
+    hsync = sim.add(StateMachine(Program(os.path.join(SRC, 'hsync.pio')), clkdiv=sync_div,
+                                 set_pins=(defines['HSYNC'], 1)))
+    vsync = sim.add(StateMachine(Program(os.path.join(SRC, 'vsync.pio')), clkdiv=sync_div,
+                                 set_pins=(defines['VSYNC'], 1), sideset_base=defines['VSYNC']))
+    pxl = sim.add(StateMachine(Program(os.path.join(SRC, 'pxl.pio'), 'pxl_%dbpp' % bpp), clkdiv=pio_div,
+                               out_pins=(defines['BASE_PXL_PIN'], bpp), sideset_base=defines['DATAEN_CMD'],
+                               out_shift_right=True, autopull=True, pull_threshold=8 * dma_size))
+    clk = sim.add(StateMachine(Program(os.path.join(SRC, 'pxl_clk.pio')), clkdiv=pio_div,
+                               set_pins=(defines['PXL_CLK'], 1)))
+
+    hsync.tx.append(defines['VIDEO_H_COUNTER'] + front_porch)
+    vsync.tx.append(defines['VIDEO_V_COUNTER'])
+    pxl.tx.append(defines['VIDEO_PXL_COUNTER'])
+
+    line_bytes = len(data) // dlpframe.HEIGHT
+    dma = Dma(pxl, data, line_bytes if line_ring else len(data), dma_latency, dma_reload, dma_size)
+    return sim, dma, {'hsync': hsync, 'vsync': vsync, 'pxl': pxl, 'pxl_clk': clk}
+
+
+def report(sim, dma, capture, machines, levels, sys_mhz):
+    ok = True
+    cycles = sim.cycle
+    pclk = capture.edges['pclk']
+    pclk_period = np.median(np.diff(pclk)) if len(pclk) > 1 else float('nan')
+    print("PCLK: %.0f sys cycles per period (%.2f MHz at %g MHz sys clock)" % (
+        pclk_period, sys_mhz / pclk_period, sys_mhz))
+
+    hsync_rises = [c for c, level in capture.edges['hsync'] if level]
+    hsync_falls = [c for c, level in capture.edges['hsync'] if not level]
+    if len(hsync_rises) > 1:
+        line = np.median(np.diff(hsync_rises))
+        width = np.median([f - r for r, f in zip(hsync_rises, [f for f in hsync_falls if f > hsync_rises[0]])])
+        print("HSYNC: line %.0f PCLK, pulse %.0f PCLK" % (line / pclk_period, width / pclk_period))
+
+    dataen = capture.edges['dataen']
+    rises = [c for c, level in dataen if level]
+    falls = [c for c, level in dataen if not level]
+    widths = [f - r for r, f in zip(rises, [f for f in falls if f > rises[0]])] if rises else []
+    pixels = [len(row) for row in capture.rows]
+    if widths:
+        print("DATAEN: high for %.0f PCLK, %d-%d pixels sampled per line" % (
+            np.median(widths) / pclk_period, min(pixels), max(pixels)))
+
+    vsync_rises = [c for c, level in capture.edges['vsync'] if level]
+    if len(vsync_rises) > 1:
+        frame = vsync_rises[1] - vsync_rises[0]
+        active = dlpframe.WIDTH * dlpframe.HEIGHT * pclk_period
+        print("frame: %d sys cycles, %.2f fps; blanking overhead %.1f%%" % (
+            frame, sys_mhz * 1e6 / frame, 100 * (1 - active / frame)))
+    elif hsync_rises and len(hsync_rises) > 1:
+        line = np.median(np.diff(hsync_rises))
+        active = dlpframe.WIDTH * pclk_period
+        print("line: blanking overhead %.1f%% (run a whole frame for the frame rate)" % (100 * (1 - active / line)))
+
+    pxl = machines['pxl']
+    print("pxl: %d stall cycles waiting for data/sync, setup before the sampling edge >= %s cycles" % (
+        pxl.stall_cycles, capture.min_setup))
+    print("DMA: %d transfers of %d bytes, %.1f%% of the DMA's transfer slots used (%.0fx headroom), %d bus transfers per frame" % (
+        dma.transfers, dma.size, 100 * dma.transfers / max(cycles, 1), cycles / max(dma.transfers, 1),
+        len(dma.data) // dma.size))
+    print("DMA: %d cycle latency, pxl TX FIFO never below %d of %d words after a pull" % (
+        dma.latency, dma.min_level, FIFO_DEPTH))
+
+    # the per-pixel loop (pxlout: up to its jmp back) minus its delays is the least it could
+    # take; pxl_clk.pio needs at least 2 cycles per PCLK period
+    program = pxl.program
+    start = program.labels.get('pxlout')
+    if start is not None:
+        end = next(i for i in range(start, len(program.instructions))
+                   if program.instructions[i][0] == 'jmp')
+        loop = program.instructions[start:end + 1]
+        pixels = sum(int(i[1][1]) for i in loop if i[0] == 'out' and i[1][0] == 'pins') // capture.bpp
+        cycles_per_pixel = sum(1 + i[3] for i in loop) / pixels
+        minimum = max(2.0, sum(1 for i in loop) / pixels)
+        print("pxl loop: %.1f cycles per pixel, %.1f without delays: PCLK could run %.1fx faster (%.2f MHz)" % (
+            cycles_per_pixel, minimum, cycles_per_pixel / minimum, sys_mhz / pxl.clkdiv / minimum))
+    if capture.min_setup == 0:
+        print("WARNING: PDATA changes in the same cycle as the PCLK edge that samples it")
+        ok = False
+
+    rows = len(capture.rows)
+    got = np.zeros((rows, dlpframe.WIDTH), dtype=np.uint8)
+    for y, row in enumerate(capture.rows):
+        got[y, :min(len(row), dlpframe.WIDTH)] = row[:dlpframe.WIDTH]
+    expected = levels[np.arange(rows) % dlpframe.HEIGHT]
+    mismatched = np.argwhere(got != expected)
+    short = [y for y, row in enumerate(capture.rows) if len(row) != dlpframe.WIDTH]
+    if short:
+        print("MISMATCH: %d lines with the wrong number of pixels (first: line %d, %d pixels)" % (
+            len(short), short[0], len(capture.rows[short[0]])))
+        ok = False
+    if len(mismatched):
+        y, x = mismatched[0]
+        print("MISMATCH: %d pixels differ, first at line %d, column %d (got %d, expected %d)" % (
+            len(mismatched), y, x, got[y, x], expected[y, x]))
+        ok = False
+    if ok:
+        print("frame check: %d lines match the buffer" % rows)
+    return ok
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Cycle-accurate simulation of the video PIO programs")
+    parser.add_argument("--bpp", type=int, nargs='+', default=[2], choices=[1, 2, 4, 8],
+                        help="pixel bit depth(s) to simulate, see src/video_mode.h (e.g. --bpp 1 2 4 8)")
+    parser.add_argument("--image", type=str, default=None, help="720x1280 grayscale tif (default: --pattern)")
+    parser.add_argument("--pattern", type=str, default='checkerboard', choices=sorted(PATTERNS),
+                        help="checkerboard: the firmware's test pattern; ramp: shows up any pixel order mistake")
+    parser.add_argument("--lines", type=int, default=None, help="stop after this many active lines (default: two frames)")
+    parser.add_argument("--line-ring", action="store_true", help="DMA reload after every line, as with DLP_LINE_RING")
+    parser.add_argument("--roi", type=dlpframe.parse_roi, default=None,
+                        help="x,y,width,height: scan out only this window of the pattern, as with cmake -DDLP_ROI")
+    parser.add_argument("--tile", type=parse_tile, default=None,
+                        help="width,height: repeat the top left corner of the pattern, as with cmake -DDLP_TILE")
+    parser.add_argument("--dma-latency", type=int, default=4, help="DMA transfer issued to FIFO write landing, in sys cycles")
+    parser.add_argument("--dma-reload", type=int, default=8, help="extra sys cycles for a channel 1 reload")
+    parser.add_argument("--dma-size", type=int, default=4, choices=[1, 4],
+                        help="bytes per DMA transfer (1: the old 8-bit path, for comparison)")
+    parser.add_argument("--sys-mhz", type=float, default=200.0,
+                        help="system clock in MHz, for the report and the VCD times (default: the clock plan's, src/clock_plan.h)")
+    parser.add_argument("--pio-div", type=int, default=1, help="the clock plan's video divider (whole)")
+    parser.add_argument("--front-porch", type=int, default=0, help="PCLK periods the clock plan added to the front porch")
+    parser.add_argument("--vcd", type=str, default=None, help="write the waveforms to this VCD file")
+    parser.add_argument("--vcd-cycles", type=int, default=200000, help="sys cycles to write to the VCD file")
+
+    args = parser.parse_args()
+    defines = firmware_defines()
+    pins = {'hsync': defines['HSYNC'], 'vsync': defines['VSYNC'], 'dataen': defines['DATAEN_CMD'],
+            'pclk': defines['PXL_CLK'], 'pdata': defines['BASE_PXL_PIN']}
+
+    ok = True
+    for bpp in args.bpp:
+        if len(args.bpp) > 1:
+            print("\n== %d bit pixels ==" % bpp)
+        if args.image:
+            import tifffile as tif
+            levels = dlpframe.quantise(tif.imread(args.image), bpp)
+        else:
+            levels = PATTERNS[args.pattern](bpp)
+        if args.roi:
+            # the frame expected on the pins is the window on a blank frame
+            x, y, width, height = dlpframe.fit_window(args.roi, bpp)
+            window = dlpframe.crop(levels, args.roi, bpp)
+            levels = np.zeros_like(levels)
+            levels[y:y + height, x:x + width] = window
+            data = window_scanout(window, x, y, bpp, defines['SCANOUT_RING_LINES'])
+            print("window: %dx%d at (%d, %d), %d bytes of pixel data instead of %d" % (
+                width, height, x, y, window.size * bpp // 8, len(data)))
+        elif args.tile:
+            # the frame expected on the pins is the tile repeated from the top left corner
+            width, height = args.tile
+            word_pixels = 32 // bpp
+            if (width & (width - 1) or height & (height - 1) or not word_pixels <= width <= 1024
+                    or not 1 <= height <= defines['SCANOUT_TILE_MAX_HEIGHT']):
+                parser.error("%dx%d is not a supported tile size at %d bits (see src/scanout.h)" % (width, height, bpp))
+            tile = levels[:height, :width]
+            levels = np.tile(tile, (-(-dlpframe.HEIGHT // height), -(-dlpframe.WIDTH // width)))
+            levels = levels[:dlpframe.HEIGHT, :dlpframe.WIDTH]
+            data, sent = tile_scanout(tile, bpp)
+            print("tile: %dx%d, %d bytes, %s" % (width, height, tile.size * bpp // 8,
+                  "rewound at the end of the frame" if dlpframe.HEIGHT % height else "a whole number per frame"))
+            moved = [line for line, row in enumerate(sent) if row != line % dlpframe.HEIGHT % height]
+            if moved:
+                print("MISMATCH: the tile's rows move from frame to frame (first at line %d of frame %d)" % (
+                    moved[0] % dlpframe.HEIGHT, moved[0] // dlpframe.HEIGHT))
+                ok = False
+        else:
+            data = dlpframe.pack(levels, bpp).tobytes()
+        assert len(data) == defines['VIDEO_WIDTH'] * bpp // 8 * defines['VIDEO_HEIGHT'], "frame size differs from video_mode.h"
+
+        line_ring = args.line_ring or args.roi is not None or args.tile is not None  # a reload per line
+        sim, dma, machines = build(defines, data, bpp, line_ring, args.dma_latency, args.dma_reload,
+                                   args.pio_div, args.front_porch, args.dma_size)
+        vcd = None
+        if args.vcd:
+            root, extension = os.path.splitext(args.vcd)
+            vcd = open(args.vcd if len(args.bpp) == 1 else '%s_%dbpp%s' % (root, bpp, extension), 'w')
+        capture = Capture(pins, bpp, vcd, args.vcd_cycles, args.sys_mhz)
+        sim.watchers.append(capture)
+
+        if args.lines:
+            done = lambda cycle: len(capture.rows) >= args.lines
+        else:
+            # until the second VSYNC pulse: two whole frames, so the frame period and the DMA
+            # restarting at the top of the buffer are covered too (about a minute per mode)
+            done = lambda cycle: sum(level for _, level in capture.edges['vsync']) >= 2
+        sim.run(done, dma)
+
+        ok = report(sim, dma, capture, machines, levels, args.sys_mhz) and ok
+    sys.exit(0 if ok else 1)
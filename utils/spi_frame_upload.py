@@ -0,0 +1,215 @@
+import tifffile as tif
+import argparse
+import struct
+import time
+import zlib
+import random
+import os
+
+import dlpframe
+
+# Push an image to the running pico over the PIO SPI slave (see src/spi_link.h), from a host
+# with an SPI master, e.g. a Raspberry Pi wired to MOSI/SCK/CS (GPIO 2/3/4 on the pico) and
+# READY/NAK (GPIO 5/1):
+#
+#   python spi_frame_upload.py open_mla_logo_sample_image.dlpf --ready 24 --nak 23
+#
+# Every packet is a header transaction followed by a payload transaction. Before each one we
+# wait for READY, afterwards NAK says whether the pico accepted it; refused packets are resent.
+#
+# With --emulate no hardware is needed: the packets go to a model of the firmware side that
+# checks the framing and can flip random bits, and the transfer time is estimated for the
+# given SCK frequency.
+
+PKT_BEGIN, PKT_DATA, PKT_END = 0x01, 0x02, 0x03
+TARGET_FRAMEBUFFER, TARGET_FRAME, TARGET_DELTA, TARGET_BITPLANES, TARGET_VECTOR, TARGET_JOB = \
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05
+HEADER_SIZE = 16
+MAX_CHUNK = 4096  # the pico's chunk buffer
+STAGING_SIZE = 16 * 1024
+FRAMEBUFFER_SIZE = 230400
+
+
+def packet_header(kind, payload=b'', offset=0):
+    return b'\xd1\x50' + struct.pack('<BBHHII', kind, 0, 0, len(payload), offset, zlib.crc32(payload))
+
+
+def padded(data):
+    return data + bytes(-len(data) % 4)
+
+
+class SpiPico:
+    # the real thing: spidev for the bus, RPi.GPIO for READY and NAK
+    def __init__(self, bus, device, speed, ready_pin, nak_pin):
+        import spidev
+        import RPi.GPIO as GPIO
+        self.gpio = GPIO
+        GPIO.setmode(GPIO.BCM)
+        GPIO.setup(ready_pin, GPIO.IN)
+        GPIO.setup(nak_pin, GPIO.IN)
+        self.ready_pin, self.nak_pin = ready_pin, nak_pin
+        self.spi = spidev.SpiDev()
+        self.spi.open(bus, device)
+        self.spi.mode = 0
+        self.spi.max_speed_hz = speed
+
+    def wait_ready(self, timeout=1.0):
+        end = time.perf_counter() + timeout
+        while not self.gpio.input(self.ready_pin):
+            if time.perf_counter() > end:
+                raise TimeoutError("READY stays low, is the pico running?")
+
+    def transaction(self, data):
+        # returns True if the pico accepted it (NAK low once READY is back)
+        self.wait_ready()
+        self.spi.writebytes2(data)  # split into bufsiz pieces by spidev; the pico doesn't mind
+        self.wait_ready()
+        return not self.gpio.input(self.nak_pin)
+
+
+class EmulatedPico:
+    # model of src/spi_link.c, receiving the transactions a real pico would
+    def __init__(self, speed, bit_error_rate=0.0, seed=1):
+        self.random = random.Random(seed)
+        self.speed = speed
+        self.bit_error_rate = bit_error_rate
+        self.seconds = 0.0
+        self.targets = {TARGET_FRAMEBUFFER: bytearray(FRAMEBUFFER_SIZE),
+                        TARGET_FRAME: bytearray(STAGING_SIZE), TARGET_DELTA: bytearray(STAGING_SIZE),
+                        TARGET_BITPLANES: bytearray(STAGING_SIZE), TARGET_VECTOR: bytearray(STAGING_SIZE),
+                        TARGET_JOB: bytearray(STAGING_SIZE)}
+        self.header = None    # header waiting for its payload
+        self.active = None    # (target, length) of the upload in progress
+        self.completed = None
+
+    def line_noise(self, data):
+        data = bytearray(data)
+        if self.bit_error_rate:
+            for i in range(len(data) * 8):
+                if self.random.random() < self.bit_error_rate:
+                    data[i // 8] ^= 1 << (i % 8)
+        return bytes(data)
+
+    def transaction(self, data):
+        assert len(data) % 4 == 0, "transactions must be whole 32-bit words"
+        self.seconds += len(data) * 8 / self.speed + 20e-6  # plus READY turnaround
+        data = self.line_noise(data)
+        if self.header is None:
+            return self.receive_header(data)
+        return self.receive_payload(data)
+
+    def receive_header(self, data):
+        if len(data) != HEADER_SIZE or data[:2] != b'\xd1\x50':
+            return False
+        kind, _, _, length, offset, crc = struct.unpack('<BBHHII', data[2:])
+        if kind == PKT_END:
+            if length or self.active is None:
+                return False
+            self.completed, self.active = self.active, None
+            return True
+        if kind == PKT_BEGIN and length != 8:
+            return False
+        if kind == PKT_DATA:
+            if self.active is None:
+                return False
+            target, total = self.active
+            if length > MAX_CHUNK or offset % 4 or offset + length > total:
+                return False
+        if kind not in (PKT_BEGIN, PKT_DATA):
+            return length == 0
+        self.header = (kind, length, offset, crc)
+        return True
+
+    def receive_payload(self, data):
+        kind, length, offset, crc = self.header
+        self.header = None
+        assert len(data) == len(padded(bytes(length))), "host sent the wrong payload size"
+        payload = data[:length]
+        if zlib.crc32(payload) != crc:
+            return False
+        if kind == PKT_BEGIN:
+            target, total = struct.unpack('<B3xI', payload)
+            if target not in self.targets or total > len(self.targets[target]):
+                self.active = None
+                return False
+            self.active = (target, total)
+            return True
+        self.targets[self.active[0]][offset:offset + length] = payload  # only once the CRC checks out
+        return True
+
+    def received(self):
+        target, total = self.completed
+        return target, bytes(self.targets[target][:total])
+
+
+def load(filepath, bpp, roi=None):
+    # same file types as usb_frame_upload.py
+    extension = os.path.splitext(filepath)[1].lower()
+    if extension == '.dlpf':
+        return TARGET_FRAME, open(filepath, 'rb').read()
+    if extension == '.dlpd':
+        return TARGET_DELTA, open(filepath, 'rb').read()
+    if extension == '.dlpb':
+        return TARGET_BITPLANES, open(filepath, 'rb').read()
+    if extension == '.dlpv':
+        return TARGET_VECTOR, open(filepath, 'rb').read()
+    if extension == '.dlpj':
+        return TARGET_JOB, open(filepath, 'rb').read()
+
+    with tif.TiffFile(filepath) as image:
+        pixelarray = image.asarray()
+        assert pixelarray.shape == (dlpframe.HEIGHT, dlpframe.WIDTH)  # check the image size
+    levels = dlpframe.quantise(pixelarray, bpp)
+    if roi:
+        levels = dlpframe.crop(levels, roi, bpp)  # a DLP_ROI build only stores its window
+    return TARGET_FRAMEBUFFER, dlpframe.pack(levels, bpp).tobytes()
+
+
+def send_packet(link, kind, payload=b'', offset=0, retries=10):
+    for attempt in range(retries):
+        if not link.transaction(packet_header(kind, payload, offset)):
+            continue  # header refused: nothing to send, try again
+        if not payload or link.transaction(padded(payload)):
+            return attempt
+    raise RuntimeError("pico keeps refusing packet type %d at offset %d" % (kind, offset))
+
+
+def upload(link, target, data, chunk):
+    chunk -= chunk % 4  # DATA offsets must stay word aligned
+    start = time.perf_counter()
+    retransmits = send_packet(link, PKT_BEGIN, struct.pack('<B3xI', target, len(data)))
+    for offset in range(0, len(data), chunk):
+        retransmits += send_packet(link, PKT_DATA, data[offset:offset + chunk], offset)
+    retransmits += send_packet(link, PKT_END)
+    return time.perf_counter() - start, retransmits
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Upload a frame, delta or image to the pico over SPI")
+    parser.add_argument("file", type=str, help=".dlpf frame, .dlpd delta, .dlpb bit-planes, .dlpv display list, .dlpj job or 720x1280 grayscale .tif")
+    parser.add_argument("--bpp", type=int, default=2, help="bits per pixel when packing a tif")
+    parser.add_argument("--roi", type=dlpframe.parse_roi, default=None,
+                        help="x,y,width,height: send only this window of a tif, as set with cmake -DDLP_ROI")
+    parser.add_argument("--chunk", type=int, default=MAX_CHUNK, help="payload bytes per packet")
+    parser.add_argument("--speed", type=int, default=15000000, help="SCK frequency in Hz (max ~15 MHz)")
+    parser.add_argument("--bus", type=int, default=0, help="spidev bus")
+    parser.add_argument("--device", type=int, default=0, help="spidev chip select")
+    parser.add_argument("--ready", type=int, default=24, help="host GPIO (BCM) wired to READY")
+    parser.add_argument("--nak", type=int, default=23, help="host GPIO (BCM) wired to NAK")
+    parser.add_argument("--emulate", action="store_true", help="talk to a model of the pico instead")
+    parser.add_argument("--bit-errors", type=float, default=0.0, help="bit error rate when emulating")
+
+    args = parser.parse_args()
+    target, data = load(args.file, args.bpp, args.roi)
+
+    if args.emulate:
+        link = EmulatedPico(args.speed, args.bit_errors)
+    else:
+        link = SpiPico(args.bus, args.device, args.speed, args.ready, args.nak)
+    elapsed, retransmits = upload(link, target, data, min(args.chunk, MAX_CHUNK))
+
+    if args.emulate:
+        assert link.received() == (target, data), "emulated pico received something else"
+        elapsed = link.seconds
+    print("%d bytes, %d retransmits: %.2f MB/s%s" % (
+        len(data), retransmits, len(data) / elapsed / 1e6, " (estimated)" if args.emulate else ""))
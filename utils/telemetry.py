@@ -0,0 +1,82 @@
+import serial  # pyserial
+import argparse
+import struct
+import time
+import sys
+
+from usb_frame_upload import command, CMD_TELEMETRY
+
+# Stream the pico's scan-out telemetry (see src/telemetry.h) live over the USB serial port, e.g.
+#
+#   python telemetry.py --port /dev/ttyACM0 --interval 0.5
+#
+# Every interval the block is read with a single USB command (12 byte request, 96 byte answer)
+# and one line is printed with the rates since the previous read: frames/s, lines/s, underruns,
+# late DMA reloads, the reload lag (how far the DMA had got after a reload when the scan-out
+# interrupt ran, in us) and frames with a TX FIFO stall or overflow per state machine (0 hsync,
+# 1 vsync, 2 pxl, 3 pxl_clk). Any stall or underrun is the image tearing or shifting. --csv
+# also writes the raw counters of every read.
+
+VERSION = 1
+FIELDS = ['version', 'bpp', 'size', 'uptime_us', 'pclk_khz', 'frames', 'lines', 'underruns', 'late_reloads',
+          'reload_lag_last', 'reload_lag_max'] + ['tx_stall%d' % i for i in range(4)] + \
+         ['tx_over%d' % i for i in range(4)] + ['i2c_commands', 'i2c_errors', 'exposure_i2c_errors',
+                                                'upload_crc_errors']
+BLOCK = struct.Struct('<BBH' + 'I' * (len(FIELDS) - 3))
+
+
+def decode(data):
+    values = dict(zip(FIELDS, BLOCK.unpack_from(data)))
+    if values['version'] != VERSION or values['size'] != BLOCK.size:
+        raise ValueError("telemetry block version %d (%d bytes), expected version %d (%d bytes)" % (
+            values['version'], values['size'], VERSION, BLOCK.size))
+    return values
+
+
+def lag_us(block, lag_bytes):
+    # pixel data bytes -> time the pxl state machine takes to send them
+    return lag_bytes * 8 / block['bpp'] / block['pclk_khz'] * 1000
+
+
+def rates(previous, block):
+    elapsed = ((block['uptime_us'] - previous['uptime_us']) & 0xFFFFFFFF) / 1e6 or 1e-9
+    delta = {name: (block[name] - previous[name]) & 0xFFFFFFFF for name in FIELDS[5:]}
+    return ("%8.1f s  %5.1f frames/s  %6.0f lines/s  underruns %d  late reloads %d  lag %.1f us (max %.1f)  "
+            "stalls %s  overflows %s  I2C errors %d" % (
+                block['uptime_us'] / 1e6, delta['frames'] / elapsed, delta['lines'] / elapsed, delta['underruns'],
+                delta['late_reloads'], lag_us(block, block['reload_lag_last']),
+                lag_us(block, block['reload_lag_max']), '/'.join(str(delta['tx_stall%d' % i]) for i in range(4)),
+                '/'.join(str(delta['tx_over%d' % i]) for i in range(4)), delta['i2c_errors']))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Stream the pico's scan-out telemetry")
+    parser.add_argument("--port", type=str, required=True, help="serial port of the pico, e.g. /dev/ttyACM0 or COM3")
+    parser.add_argument("--interval", type=float, default=1.0, help="seconds between reads")
+    parser.add_argument("--count", type=int, default=0, help="stop after this many reads (0: until interrupted)")
+    parser.add_argument("--csv", type=str, default=None, help="also write every block to this file")
+
+    args = parser.parse_args()
+    csv = open(args.csv, 'w') if args.csv else None
+    if csv:
+        csv.write(','.join(['host_time'] + FIELDS) + '\n')
+
+    with serial.Serial(args.port, timeout=1) as port:
+        previous = None
+        reads = 0
+        try:
+            while not args.count or reads < args.count:
+                _, reply = command(port, CMD_TELEMETRY)
+                block = decode(reply)
+                reads += 1
+                if csv:
+                    csv.write(','.join(['%.3f' % time.time()] + [str(block[name]) for name in FIELDS]) + '\n')
+                if previous:
+                    print(rates(previous, block))
+                    sys.stdout.flush()
+                previous = block
+                time.sleep(args.interval)
+        except KeyboardInterrupt:
+            pass
+    if csv:
+        csv.close()
@@ -0,0 +1,160 @@
+import serial  # pyserial
+import tifffile as tif
+import argparse
+import struct
+import time
+import zlib
+import os
+
+import dlpframe
+
+# Push an image to the running pico over the USB serial port (see src/usb_link.h), e.g.
+#
+#   python usb_frame_upload.py --port /dev/ttyACM0 open_mla_logo_sample_image.dlpf
+#
+# .dlpf frames, .dlpd deltas, .dlpb bit-plane sequences and .dlpv display lists go to the
+# staging area and are decoded/applied/rasterised on the pico, .tif images are packed here and
+# written straight into the framebuffer (cropped to the window with --roi for a DLP_ROI build).
+# --select shows a frame of the flash frame library instead (see frame_library.py).
+# The firmware's printf output shares the port; it is skipped while looking for acks.
+
+PKT_BEGIN, PKT_DATA, PKT_END, PKT_PING, PKT_COMMAND = 0x01, 0x02, 0x03, 0x04, 0x05
+CMD_SELECT_FRAME, CMD_TELEMETRY, CMD_END_SESSION = 0x01, 0x02, 0x03
+TARGET_FRAMEBUFFER, TARGET_FRAME, TARGET_DELTA, TARGET_BITPLANES, TARGET_VECTOR, TARGET_JOB = \
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05
+ACK_OK, ACK_CRC, ACK_SEQUENCE, ACK_STATE = 0x00, 0x01, 0x02, 0x04
+ACK_NAMES = {0x00: "ok", 0x01: "crc", 0x02: "sequence", 0x03: "range", 0x04: "state"}
+MAX_CHUNK = 4096
+
+
+def packet(kind, seq, payload=b'', offset=0):
+    return b'\xd1\x50' + struct.pack('<BBHHII', kind, 0, seq, len(payload), offset,
+                                     zlib.crc32(payload)) + payload
+
+
+def read_ack(port):
+    # scan for the ack sync bytes (0xD1 never shows up in the ascii debug output)
+    previous = b''
+    while True:
+        byte = port.read(1)
+        if not byte:
+            raise TimeoutError("no ack from the pico")
+        if previous == b'\xd1' and byte == b'\x5a':
+            status, kind, seq, reply_length, value = struct.unpack('<bBHHI', port.read(10))
+            return status, kind, seq, value, port.read(reply_length)
+        previous = byte
+
+
+def upload(port, target, data, chunk=MAX_CHUNK, window=8, retries=50):
+    for attempt in range(retries):
+        port.write(packet(PKT_BEGIN, 0, struct.pack('<B3xI', target, len(data))))
+        status, _, _, _, _ = read_ack(port)
+        if status != ACK_STATE:
+            break
+        time.sleep(0.02)  # the staging area is busy until a queued delta has landed
+    if status != ACK_OK:
+        raise RuntimeError("upload refused: %s" % ACK_NAMES.get(status, status))
+
+    chunks = [(offset, data[offset:offset + chunk]) for offset in range(0, len(data), chunk)]
+    start = time.perf_counter()
+    acked = 0         # chunks acknowledged in order
+    sent = 0          # chunks sent
+    retransmits = 0
+    rewound_to = None
+
+    # go-back-N: keep up to <window> chunks in flight; seq of chunk i is i + 1
+    while acked < len(chunks):
+        while sent < len(chunks) and sent - acked < window:
+            offset, payload = chunks[sent]
+            port.write(packet(PKT_DATA, sent + 1, payload, offset))
+            sent += 1
+
+        try:
+            status, _, seq, _, _ = read_ack(port)
+        except TimeoutError:
+            sent = acked  # resend everything that is not acknowledged
+            retransmits += 1
+            continue
+
+        if status == ACK_OK:
+            if seq == acked + 1:
+                acked += 1
+                rewound_to = None
+        elif status in (ACK_CRC, ACK_SEQUENCE):
+            # CRC: resend that chunk; SEQUENCE: seq is the one the pico expects next. Chunks
+            # still in flight will all complain about the same gap, only rewind once.
+            if rewound_to != seq:
+                rewound_to = seq
+                sent = seq - 1
+                retransmits += 1
+        else:
+            raise RuntimeError("chunk rejected: %s" % ACK_NAMES.get(status, status))
+
+    port.write(packet(PKT_END, len(chunks) + 1))
+    status, _, _, device_us, _ = read_ack(port)
+    elapsed = time.perf_counter() - start
+    if status != ACK_OK:
+        raise RuntimeError("pico could not use the upload (status %d)" % status)
+
+    print("%d bytes in %d chunks, %d retransmits: %.2f MB/s (host), %.2f MB/s (pico, %d us)" % (
+        len(data), len(chunks), retransmits, len(data) / elapsed / 1e6,
+        len(data) / max(device_us, 1), device_us))
+
+
+def command(port, kind, argument=0):
+    # run a command on the pico (see src/usb_link.h); returns its result and reply
+    port.write(packet(PKT_COMMAND, 0, struct.pack('<B3xI', kind, argument)))
+    status, _, _, value, reply = read_ack(port)
+    if status != ACK_OK:
+        raise RuntimeError("command 0x%02x failed (status %d)" % (kind, status))
+    return value, reply
+
+
+def load(filepath, bpp, roi=None):
+    extension = os.path.splitext(filepath)[1].lower()
+    if extension == '.dlpf':
+        return TARGET_FRAME, open(filepath, 'rb').read()
+    if extension == '.dlpd':
+        return TARGET_DELTA, open(filepath, 'rb').read()
+    if extension == '.dlpb':
+        return TARGET_BITPLANES, open(filepath, 'rb').read()
+    if extension == '.dlpv':
+        return TARGET_VECTOR, open(filepath, 'rb').read()
+    if extension == '.dlpj':
+        return TARGET_JOB, open(filepath, 'rb').read()
+
+    with tif.TiffFile(filepath) as image:
+        pixelarray = image.asarray()
+        assert pixelarray.shape == (dlpframe.HEIGHT, dlpframe.WIDTH)  # check the image size
+    levels = dlpframe.quantise(pixelarray, bpp)
+    if roi:
+        levels = dlpframe.crop(levels, roi, bpp)  # a DLP_ROI build only stores its window
+    return TARGET_FRAMEBUFFER, dlpframe.pack(levels, bpp).tobytes()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Upload a frame, delta or image to the pico over USB")
+    parser.add_argument("file", type=str, nargs='?', help=".dlpf frame, .dlpd delta, .dlpb bit-planes, .dlpv display list, .dlpj job or 720x1280 grayscale .tif")
+    parser.add_argument("--port", type=str, required=True, help="serial port of the pico, e.g. /dev/ttyACM0 or COM3")
+    parser.add_argument("--bpp", type=int, default=2, help="bits per pixel when packing a tif")
+    parser.add_argument("--roi", type=dlpframe.parse_roi, default=None,
+                        help="x,y,width,height: send only this window of a tif, as set with cmake -DDLP_ROI")
+    parser.add_argument("--chunk", type=int, default=MAX_CHUNK, help="payload bytes per packet (max 4096)")
+    parser.add_argument("--window", type=int, default=8, help="packets in flight before waiting for acks")
+    parser.add_argument("--select", type=int, default=None, help="show this frame of the flash frame library")
+    parser.add_argument("--end", action="store_true",
+                        help="end the session: the pico finishes its exposures, prints its reports and goes to standby")
+
+    args = parser.parse_args()
+    if args.file is None and args.select is None and not args.end:
+        parser.error("give a file to upload, --select or --end")
+    with serial.Serial(args.port, timeout=1) as port:
+        if args.file:
+            target, data = load(args.file, args.bpp, args.roi)
+            upload(port, target, data, min(args.chunk, MAX_CHUNK), args.window)
+        if args.select is not None:
+            command(port, CMD_SELECT_FRAME, args.select)
+            print("showing frame %d of the flash library" % args.select)
+        if args.end:
+            command(port, CMD_END_SESSION)
+            print("session ended")